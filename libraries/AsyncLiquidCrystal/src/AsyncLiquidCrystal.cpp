@@ -315,13 +315,15 @@ bool AsyncLiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
     if (queue.availableForWrite() < 18) {
       return false;
     } else {
-      queue.write(LCD_QUEUE_CMD);
-      queue.write(LCD_SETCGRAMADDR | (location << 3));
-        
+      // One bulk write, built without commas as it is inside the macro
+      uint8_t entries[18];
+      entries[0] = LCD_QUEUE_CMD;
+      entries[1] = LCD_SETCGRAMADDR | (location << 3);
       for (int i=0; i<8; i++) {
-        queue.write(LCD_QUEUE_WRITE);
-        queue.write(charmap[i]);
+        entries[2 + 2*i] = LCD_QUEUE_WRITE;
+        entries[3 + 2*i] = charmap[i];
       }
+      queue.write(entries, 18);
       return true;
     }
   })
@@ -334,8 +336,10 @@ inline bool AsyncLiquidCrystal::command(uint8_t value) {
     if (queue.availableForWrite() < 2) {
       return false;
     } else {
-      queue.write(LCD_QUEUE_CMD);
-      queue.write(value);
+      uint8_t entry[2];
+      entry[0] = LCD_QUEUE_CMD;
+      entry[1] = value;
+      queue.write(entry, 2);
       return true;
     }
   })
@@ -346,8 +350,10 @@ inline size_t AsyncLiquidCrystal::write(uint8_t value) {
     if (queue.availableForWrite() < 2) {
       return 0;
     } else {
-      queue.write(LCD_QUEUE_WRITE);
-      queue.write(value);
+      uint8_t entry[2];
+      entry[0] = LCD_QUEUE_WRITE;
+      entry[1] = value;
+      queue.write(entry, 2);
       return 1;
     }
   })
@@ -17,7 +17,10 @@ struct MatrixBase
     constexpr static int Cols = cols;
     using DType = d_type;
 
-    DType &operator()(int i, int j = 0) { return static_cast<DerivedType *>(this)->operator()(i, j); }
+    typename ElementReference<DerivedType, DType>::Type operator()(int i, int j = 0)
+    {
+        return static_cast<DerivedType *>(this)->operator()(i, j);
+    }
 
     DType operator()(int i, int j = 0) const { return static_cast<const DerivedType *>(this)->operator()(i, j); }
 
@@ -51,17 +54,26 @@ struct MatrixBase
     template <typename MatType>
     MatrixBase &operator=(const MatrixBase<MatType, Rows, Cols, DType> &mat)
     {
-        for (int i = 0; i < rows; ++i)
+        const MatType &expr = static_cast<const MatType &>(mat);
+
+        // Expressions are evaluated straight into this matrix, so if one of them would read from this matrix after
+        // it's started writing to it then it needs to be evaluated into a temporary first
+        if (expr.AssignmentAliases(static_cast<DerivedType &>(*this).Storage()))
         {
-            for (int j = 0; j < cols; ++j)
-            {
-                static_cast<DerivedType &>(*this)(i, j) = mat(i, j);
-            }
+            return AssignThroughTemporary(expr);
         }
 
+        expr.AssignTo(static_cast<DerivedType &>(*this));
         return static_cast<DerivedType &>(*this);
     }
 
+    template <typename MatType>
+    MatrixBase &AssignThroughTemporary(const MatType &expr)
+    {
+        Matrix<Rows, Cols, DType> tmp = expr;
+        return *this = tmp;
+    }
+
     DerivedType &operator=(DType elem)
     {
         for (int i = 0; i < rows; ++i)
@@ -77,6 +89,59 @@ struct MatrixBase
 
     void Fill(const DType &val) { *this = val; }
 
+    // Returns true if writing to the matrix that owns the memory at storage could change the elements of this one.
+    // Matrices that refer to or are computed from other matrices override this to check those matrices instead.
+    bool Aliases(const void *storage) const { return this == storage; }
+
+    // Returns the matrix that owns the elements of this one
+    const void *Storage() const { return this; }
+
+    // Returns true if evaluating this matrix straight into the one at storage (using AssignTo, AddTo or SubtractFrom)
+    // could read an element of it after it's been written. Expressions which evaluate some of their operands up front
+    // override this to leave those operands out.
+    bool AssignmentAliases(const void *storage) const
+    {
+        return static_cast<const DerivedType *>(this)->Aliases(storage);
+    }
+
+    // Evaluate this matrix into dest element by element, skipping any elements that dest doesn't store. Expressions
+    // override these to evaluate more efficiently.
+    template <typename DestType>
+    void AssignTo(DestType &dest) const
+    {
+        for (int i = 0; i < rows; ++i)
+        {
+            for (int j = StoredColumns<DestType>::Begin(i); j < StoredColumns<DestType>::End(i); ++j)
+            {
+                dest(i, j) = (*this)(i, j);
+            }
+        }
+    }
+
+    template <typename DestType>
+    void AddTo(DestType &dest) const
+    {
+        for (int i = 0; i < rows; ++i)
+        {
+            for (int j = StoredColumns<DestType>::Begin(i); j < StoredColumns<DestType>::End(i); ++j)
+            {
+                dest(i, j) += (*this)(i, j);
+            }
+        }
+    }
+
+    template <typename DestType>
+    void SubtractFrom(DestType &dest) const
+    {
+        for (int i = 0; i < rows; ++i)
+        {
+            for (int j = StoredColumns<DestType>::Begin(i); j < StoredColumns<DestType>::End(i); ++j)
+            {
+                dest(i, j) -= (*this)(i, j);
+            }
+        }
+    }
+
     template <typename DestType>
     Matrix<Rows, Cols, DestType> Cast()
     {
@@ -156,3 +221,4 @@ using DownCast = MatrixBase<DerivedType, DerivedType::Rows, DerivedType::Cols, t
 
 #include "impl/BasicLinearAlgebra.h"
 #include "impl/NotSoBasicLinearAlgebra.h"
+#include "impl/BatchLinearAlgebra.h"
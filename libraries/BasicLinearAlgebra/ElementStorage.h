@@ -1,11 +1,22 @@
 #pragma once
 
+#include "FixedPoint.h"
+#include "impl/ProductKernels.h"
+
 namespace BLA
 {
 
 template <typename DerivedType, int rows, int cols, typename DType>
 struct MatrixBase;
 
+// What the non-const operator() of a matrix returns. That's a reference to the element unless the matrix only stores
+// some of its elements, in which case it's a StructuredElement.
+template <typename MatType, typename DType>
+struct ElementReference
+{
+    using Type = DType &;
+};
+
 template <int Rows, int Cols = 1, typename DType = float>
 class Matrix : public MatrixBase<Matrix<Rows, Cols, DType>, Rows, Cols, DType>
 {
@@ -52,6 +63,14 @@ class Matrix : public MatrixBase<Matrix<Rows, Cols, DType>, Rows, Cols, DType>
         static_cast<MatrixBase<Matrix<Rows, Cols, DType>, Rows, Cols, DType> &>(*this) = mat;
         return *this;
     }
+
+    // Evaluates expressions straight into this matrix rather than into a temporary that's then copied
+    template <typename DerivedType>
+    Matrix &operator=(const MatrixBase<DerivedType, Rows, Cols, DType> &mat)
+    {
+        static_cast<MatrixBase<Matrix<Rows, Cols, DType>, Rows, Cols, DType> &>(*this) = mat;
+        return *this;
+    }
 };
 
 template <int Rows, int Cols = 1, typename DType = float>
@@ -97,6 +116,9 @@ class RefMatrix : public MatrixBase<RefMatrix<RefType, Rows, Cols>, Rows, Cols,
     typename RefType::DType &operator()(int i, int j) { return parent_(i + row_offset_, j + col_offset_); }
     typename RefType::DType operator()(int i, int j) const { return parent_(i + row_offset_, j + col_offset_); }
 
+    bool Aliases(const void *storage) const { return parent_.Aliases(storage); }
+    const void *Storage() const { return parent_.Storage(); }
+
     template <typename MatType>
     RefMatrix &operator=(const MatType &mat)
     {
@@ -117,6 +139,11 @@ class MatrixTranspose
     typename RefType::DType &operator()(int i, int j) { return parent_(j, i); }
     typename RefType::DType operator()(int i, int j) const { return parent_(j, i); }
 
+    bool Aliases(const void *storage) const { return parent_.Aliases(storage); }
+    const void *Storage() const { return parent_.Storage(); }
+
+    const RefType &Parent() const { return parent_; }
+
     template <typename MatType>
     MatrixTranspose &operator=(const MatType &mat)
     {
@@ -139,6 +166,8 @@ struct HorizontalConcat : public MatrixBase<HorizontalConcat<LeftType, RightType
     {
         return col < LeftType::Cols ? left(row, col) : right(row, col - LeftType::Cols);
     }
+
+    bool Aliases(const void *storage) const { return left.Aliases(storage) || right.Aliases(storage); }
 };
 
 template <typename TopType, typename BottomType>
@@ -154,6 +183,8 @@ struct VerticalConcat : public MatrixBase<VerticalConcat<TopType, BottomType>, T
     {
         return row < TopType::Rows ? top(row, col) : bottom(row - TopType::Rows, col);
     }
+
+    bool Aliases(const void *storage) const { return top.Aliases(storage) || bottom.Aliases(storage); }
 };
 
 template <int Rows, int Cols, typename DType, int TableSize>
@@ -214,6 +245,177 @@ struct SparseMatrix : public MatrixBase<SparseMatrix<Rows, Cols, DType, TableSiz
     }
 };
 
+// Compressed sparse row storage. The nonzero elements are stored row after row with each row sorted by column, so a
+// product with one of these only visits its nonzeros instead of looking up every element the way SparseMatrix does.
+// It can be converted from a SparseMatrix or any other matrix, or built up an element at a time with Append. Nonzeros
+// beyond the first MaxNonZeros are dropped and overflowed is set to say so.
+template <int Rows, int Cols, typename DType, int MaxNonZeros>
+struct CompressedSparseRowMatrix
+    : public MatrixBase<CompressedSparseRowMatrix<Rows, Cols, DType, MaxNonZeros>, Rows, Cols, DType>
+{
+    // The nonzeros of row i are at [row_start[i], row_start[i + 1])
+    int row_start[Rows + 1];
+    int col[MaxNonZeros];
+    DType val[MaxNonZeros];
+    // Set when a conversion or an Append ran out of room and a nonzero was dropped
+    bool overflowed;
+
+    CompressedSparseRowMatrix() { Clear(); }
+
+    template <typename MatType>
+    CompressedSparseRowMatrix(const MatrixBase<MatType, Rows, Cols, DType> &mat)
+    {
+        int n = 0;
+        row_start[0] = 0;
+        overflowed = false;
+
+        for (int i = 0; i < Rows; ++i)
+        {
+            for (int j = 0; j < Cols; ++j)
+            {
+                DType elem = mat(i, j);
+
+                if (elem == 0)
+                {
+                    continue;
+                }
+
+                if (n == MaxNonZeros)
+                {
+                    overflowed = true;
+                    break;
+                }
+
+                col[n] = j;
+                val[n++] = elem;
+            }
+
+            row_start[i + 1] = n;
+        }
+    }
+
+    // Only the elements in use are visited rather than every element of the matrix
+    template <int TableSize>
+    CompressedSparseRowMatrix(const SparseMatrix<Rows, Cols, DType, TableSize> &mat)
+    {
+        static_assert(TableSize <= MaxNonZeros, "Not enough room for every element of the SparseMatrix");
+
+        overflowed = false;
+
+        // Sort the elements by their position in the matrix, stashing that position in col for now. The table is
+        // small so an insertion sort will do.
+        int n = 0;
+
+        for (int k = 0; k < TableSize; ++k)
+        {
+            const auto &elem = mat.table[k];
+
+            if (elem.row < 0 || elem.val == 0)
+            {
+                continue;
+            }
+
+            int pos = elem.row * Cols + elem.col, m = n++;
+
+            for (; m > 0 && col[m - 1] > pos; --m)
+            {
+                col[m] = col[m - 1];
+                val[m] = val[m - 1];
+            }
+
+            col[m] = pos;
+            val[m] = elem.val;
+        }
+
+        for (int i = 0, m = 0; i < Rows; ++i)
+        {
+            row_start[i] = m;
+
+            for (; m < n && col[m] / Cols == i; ++m)
+            {
+                col[m] %= Cols;
+            }
+        }
+
+        row_start[Rows] = n;
+    }
+
+    void Clear()
+    {
+        for (int i = 0; i <= Rows; ++i)
+        {
+            row_start[i] = 0;
+        }
+
+        overflowed = false;
+    }
+
+    // Adds an element after the ones already stored. Elements have to be inside the matrix and added in row major
+    // order, and this returns false if one isn't or if there's no room left for it (setting overflowed).
+    bool Append(int row, int column, DType value)
+    {
+        int n = row_start[Rows];
+
+        if (row < 0 || row >= Rows || column < 0 || column >= Cols ||
+            (n > 0 && (row < LastRow() || (row == LastRow() && column <= col[n - 1]))))
+        {
+            return false;
+        }
+
+        if (n == MaxNonZeros)
+        {
+            overflowed = true;
+            return false;
+        }
+
+        col[n] = column;
+        val[n] = value;
+
+        for (int i = row + 1; i <= Rows; ++i)
+        {
+            row_start[i] = n + 1;
+        }
+
+        return true;
+    }
+
+    int NonZeros() const { return row_start[Rows]; }
+
+    DType operator()(int row, int column) const
+    {
+        int lo = row_start[row], hi = row_start[row + 1];
+
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+
+            if (col[mid] < column)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        return lo < row_start[row + 1] && col[lo] == column ? val[lo] : DType(0);
+    }
+
+   private:
+    int LastRow() const
+    {
+        int row = Rows - 1;
+
+        while (row > 0 && row_start[row] == row_start[Rows])
+        {
+            --row;
+        }
+
+        return row;
+    }
+};
+
 template <int Dim, class DType>
 struct PermutationMatrix : public MatrixBase<PermutationMatrix<Dim, DType>, Dim, Dim, DType>
 {
@@ -230,6 +432,8 @@ struct LowerUnitriangularMatrix : public MatrixBase<LowerUnitriangularMatrix<Par
 
     LowerUnitriangularMatrix(const ParentType &obj) : parent(obj) {}
 
+    bool Aliases(const void *storage) const { return parent.Aliases(storage); }
+
     typename ParentType::DType operator()(int row, int col) const
     {
         if (row > col)
@@ -255,6 +459,8 @@ struct LowerTriangularMatrix : public MatrixBase<LowerTriangularMatrix<ParentTyp
 
     LowerTriangularMatrix(const ParentType &obj) : parent(obj) {}
 
+    bool Aliases(const void *storage) const { return parent.Aliases(storage); }
+
     typename ParentType::DType operator()(int row, int col) const
     {
         if (row >= col)
@@ -276,6 +482,8 @@ struct UpperTriangularMatrix : public MatrixBase<UpperTriangularMatrix<ParentTyp
 
     UpperTriangularMatrix(const ParentType &obj) : parent(obj) {}
 
+    bool Aliases(const void *storage) const { return parent.Aliases(storage); }
+
     typename ParentType::DType operator()(int row, int col) const
     {
         if (row <= col)
@@ -289,4 +497,616 @@ struct UpperTriangularMatrix : public MatrixBase<UpperTriangularMatrix<ParentTyp
     }
 };
 
+// Index of element (row, col), where row >= col, in the lower triangle of a matrix packed row by row
+inline int PackedLowerIndex(int row, int col) { return row * (row + 1) / 2 + col; }
+
+// Index of element (row, col), where row <= col, in the upper triangle of a Dim x Dim matrix packed row by row
+template <int Dim>
+inline int PackedUpperIndex(int row, int col)
+{
+    return row * Dim - row * (row - 1) / 2 + col - row;
+}
+
+// A symmetric matrix that only stores its lower triangle. Writing to element (i, j) also writes to (j, i).
+// Assigning an expression to it only evaluates the lower triangle, so the expression is assumed to be symmetric.
+template <int Dim, typename DType = float>
+class SymmetricMatrix : public MatrixBase<SymmetricMatrix<Dim, DType>, Dim, Dim, DType>
+{
+   public:
+    DType storage[Dim * (Dim + 1) / 2];
+
+    DType &operator()(int i, int j)
+    {
+        return i >= j ? storage[PackedLowerIndex(i, j)] : storage[PackedLowerIndex(j, i)];
+    }
+
+    DType operator()(int i, int j) const
+    {
+        return i >= j ? storage[PackedLowerIndex(i, j)] : storage[PackedLowerIndex(j, i)];
+    }
+
+    SymmetricMatrix() = default;
+
+    // Takes every element of the matrix in row major order, as for Matrix, and keeps the lower triangle
+    template <typename... TAIL>
+    SymmetricMatrix(DType head, TAIL... args) : SymmetricMatrix(Matrix<Dim, Dim, DType>(head, args...))
+    {
+    }
+
+    template <typename DerivedType>
+    SymmetricMatrix(const MatrixBase<DerivedType, Dim, Dim, DType> &mat)
+    {
+        static_cast<MatrixBase<SymmetricMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+    }
+
+    SymmetricMatrix &operator=(const SymmetricMatrix &mat)
+    {
+        static_cast<MatrixBase<SymmetricMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+        return *this;
+    }
+
+    template <typename DerivedType>
+    SymmetricMatrix &operator=(const MatrixBase<DerivedType, Dim, Dim, DType> &mat)
+    {
+        static_cast<MatrixBase<SymmetricMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+        return *this;
+    }
+};
+
+// An element of a matrix that only stores some of its elements. It reads as zero and ignores writes when the element
+// isn't stored, so unlike a reference to a dummy zero, a write to one element outside the structure can't show up in
+// another.
+template <typename DType>
+class StructuredElement
+{
+    DType *elem_;
+
+   public:
+    explicit StructuredElement(DType *elem) : elem_(elem) {}
+
+    operator DType() const { return elem_ ? *elem_ : DType(0); }
+
+    StructuredElement &operator=(const StructuredElement &other) { return *this = DType(other); }
+
+    StructuredElement &operator=(DType val)
+    {
+        if (elem_)
+        {
+            *elem_ = val;
+        }
+
+        return *this;
+    }
+
+    StructuredElement &operator+=(DType val) { return *this = DType(*this) + val; }
+    StructuredElement &operator-=(DType val) { return *this = DType(*this) - val; }
+    StructuredElement &operator*=(DType val) { return *this = DType(*this) * val; }
+    StructuredElement &operator/=(DType val) { return *this = DType(*this) / val; }
+};
+
+template <int Dim, typename DType = float>
+class DiagonalMatrix;
+
+template <int Dim, typename DType = float>
+class PackedLowerTriangularMatrix;
+
+template <int Dim, typename DType = float>
+class PackedUpperTriangularMatrix;
+
+template <int Dim, typename DType>
+struct ElementReference<DiagonalMatrix<Dim, DType>, DType>
+{
+    using Type = StructuredElement<DType>;
+};
+
+template <int Dim, typename DType>
+struct ElementReference<PackedLowerTriangularMatrix<Dim, DType>, DType>
+{
+    using Type = StructuredElement<DType>;
+};
+
+template <int Dim, typename DType>
+struct ElementReference<PackedUpperTriangularMatrix<Dim, DType>, DType>
+{
+    using Type = StructuredElement<DType>;
+};
+
+// A diagonal matrix that only stores its diagonal. Elements off the diagonal are always zero and writing to them has
+// no effect.
+template <int Dim, typename DType>
+class DiagonalMatrix : public MatrixBase<DiagonalMatrix<Dim, DType>, Dim, Dim, DType>
+{
+   public:
+    DType storage[Dim];
+
+    StructuredElement<DType> operator()(int i, int j) { return StructuredElement<DType>(i == j ? &storage[i] : nullptr); }
+
+    DType operator()(int i, int j) const { return i == j ? storage[i] : DType(0); }
+
+    DiagonalMatrix() = default;
+
+    // Takes every element of the matrix in row major order and ignores the ones off the diagonal
+    template <typename... TAIL>
+    DiagonalMatrix(DType head, TAIL... args) : DiagonalMatrix(Matrix<Dim, Dim, DType>(head, args...))
+    {
+    }
+
+    template <typename DerivedType>
+    DiagonalMatrix(const MatrixBase<DerivedType, Dim, Dim, DType> &mat)
+    {
+        static_cast<MatrixBase<DiagonalMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+    }
+
+    DiagonalMatrix &operator=(const DiagonalMatrix &mat)
+    {
+        static_cast<MatrixBase<DiagonalMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+        return *this;
+    }
+
+    template <typename DerivedType>
+    DiagonalMatrix &operator=(const MatrixBase<DerivedType, Dim, Dim, DType> &mat)
+    {
+        static_cast<MatrixBase<DiagonalMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+        return *this;
+    }
+};
+
+// Lower and upper triangular matrices that only store their nonzero triangle. Unlike the LowerTriangularMatrix and
+// UpperTriangularMatrix views these own their elements. Elements outside the triangle are always zero and writing to
+// them has no effect.
+template <int Dim, typename DType>
+class PackedLowerTriangularMatrix : public MatrixBase<PackedLowerTriangularMatrix<Dim, DType>, Dim, Dim, DType>
+{
+   public:
+    DType storage[Dim * (Dim + 1) / 2];
+
+    StructuredElement<DType> operator()(int i, int j)
+    {
+        return StructuredElement<DType>(i >= j ? &storage[PackedLowerIndex(i, j)] : nullptr);
+    }
+
+    DType operator()(int i, int j) const { return i >= j ? storage[PackedLowerIndex(i, j)] : DType(0); }
+
+    PackedLowerTriangularMatrix() = default;
+
+    template <typename DerivedType>
+    PackedLowerTriangularMatrix(const MatrixBase<DerivedType, Dim, Dim, DType> &mat)
+    {
+        static_cast<MatrixBase<PackedLowerTriangularMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+    }
+
+    PackedLowerTriangularMatrix &operator=(const PackedLowerTriangularMatrix &mat)
+    {
+        static_cast<MatrixBase<PackedLowerTriangularMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+        return *this;
+    }
+
+    template <typename DerivedType>
+    PackedLowerTriangularMatrix &operator=(const MatrixBase<DerivedType, Dim, Dim, DType> &mat)
+    {
+        static_cast<MatrixBase<PackedLowerTriangularMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+        return *this;
+    }
+};
+
+template <int Dim, typename DType>
+class PackedUpperTriangularMatrix : public MatrixBase<PackedUpperTriangularMatrix<Dim, DType>, Dim, Dim, DType>
+{
+   public:
+    DType storage[Dim * (Dim + 1) / 2];
+
+    StructuredElement<DType> operator()(int i, int j)
+    {
+        return StructuredElement<DType>(i <= j ? &storage[PackedUpperIndex<Dim>(i, j)] : nullptr);
+    }
+
+    DType operator()(int i, int j) const { return i <= j ? storage[PackedUpperIndex<Dim>(i, j)] : DType(0); }
+
+    PackedUpperTriangularMatrix() = default;
+
+    template <typename DerivedType>
+    PackedUpperTriangularMatrix(const MatrixBase<DerivedType, Dim, Dim, DType> &mat)
+    {
+        static_cast<MatrixBase<PackedUpperTriangularMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+    }
+
+    PackedUpperTriangularMatrix &operator=(const PackedUpperTriangularMatrix &mat)
+    {
+        static_cast<MatrixBase<PackedUpperTriangularMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+        return *this;
+    }
+
+    template <typename DerivedType>
+    PackedUpperTriangularMatrix &operator=(const MatrixBase<DerivedType, Dim, Dim, DType> &mat)
+    {
+        static_cast<MatrixBase<PackedUpperTriangularMatrix<Dim, DType>, Dim, Dim, DType> &>(*this) = mat;
+        return *this;
+    }
+};
+
+// The range of columns in each row of a matrix that it actually stores. When an expression is assigned to a matrix,
+// only those elements are evaluated.
+template <typename MatType>
+struct StoredColumns
+{
+    static constexpr bool All = true;
+    static int Begin(int) { return 0; }
+    static int End(int) { return MatType::Cols; }
+};
+
+template <int Dim, typename DType>
+struct StoredColumns<SymmetricMatrix<Dim, DType>>
+{
+    static constexpr bool All = false;
+    static int Begin(int) { return 0; }
+    static int End(int row) { return row + 1; }
+};
+
+template <int Dim, typename DType>
+struct StoredColumns<DiagonalMatrix<Dim, DType>>
+{
+    static constexpr bool All = false;
+    static int Begin(int row) { return row; }
+    static int End(int row) { return row + 1; }
+};
+
+template <int Dim, typename DType>
+struct StoredColumns<PackedLowerTriangularMatrix<Dim, DType>>
+{
+    static constexpr bool All = false;
+    static int Begin(int) { return 0; }
+    static int End(int row) { return row + 1; }
+};
+
+template <int Dim, typename DType>
+struct StoredColumns<PackedUpperTriangularMatrix<Dim, DType>>
+{
+    static constexpr bool All = false;
+    static int Begin(int row) { return row; }
+    static int End(int) { return Dim; }
+};
+
+// The arithmetic operators return these expressions rather than a Matrix. They hold on to their operands and are only
+// evaluated once they're assigned to a Matrix or RefMatrix, so something like P = F * P * ~F + Q is computed straight
+// into P with one temporary for F * P rather than one for every operator along the way. Since an expression refers to
+// its operands it shouldn't outlive them, and if it's kept with auto it'll reflect any later changes to them.
+
+// Expressions hold matrices that own their elements by reference. References, views and other expressions are cheap to
+// copy and are often temporaries so they're held by value.
+template <typename A, typename B>
+struct IsSame
+{
+    static constexpr bool value = false;
+};
+
+template <typename A>
+struct IsSame<A, A>
+{
+    static constexpr bool value = true;
+};
+
+template <typename MatType>
+struct ExpressionOperand
+{
+    using Type = const MatType &;
+};
+
+// Each element of a product reads a whole row and column of its operands, so when a product is evaluated, operands
+// which are themselves expressions are evaluated into a temporary first rather than once for every element
+template <typename MatType>
+struct ProductOperand
+{
+    using Type = typename ExpressionOperand<MatType>::Type;
+};
+
+template <typename LeftType, typename RightType,
+          typename LeftOperand = typename ExpressionOperand<LeftType>::Type,
+          typename RightOperand = typename ExpressionOperand<RightType>::Type>
+struct MatrixSum : public MatrixBase<MatrixSum<LeftType, RightType, LeftOperand, RightOperand>, LeftType::Rows,
+                                     LeftType::Cols, typename LeftType::DType>
+{
+    LeftOperand left;
+    RightOperand right;
+
+    MatrixSum(const LeftType &l, const RightType &r) : left(l), right(r) {}
+
+    typename LeftType::DType operator()(int i, int j) const { return left(i, j) + right(i, j); }
+
+    bool Aliases(const void *storage) const { return left.Aliases(storage) || right.Aliases(storage); }
+
+    // The right operand is evaluated after the left one has been written so it mustn't read the destination at all
+    bool AssignmentAliases(const void *storage) const
+    {
+        return left.AssignmentAliases(storage) || right.Aliases(storage);
+    }
+
+    template <typename DestType>
+    void AssignTo(DestType &dest) const
+    {
+        left.AssignTo(dest);
+        right.AddTo(dest);
+    }
+
+    template <typename DestType>
+    void AddTo(DestType &dest) const
+    {
+        left.AddTo(dest);
+        right.AddTo(dest);
+    }
+
+    template <typename DestType>
+    void SubtractFrom(DestType &dest) const
+    {
+        left.SubtractFrom(dest);
+        right.SubtractFrom(dest);
+    }
+};
+
+template <typename LeftType, typename RightType,
+          typename LeftOperand = typename ExpressionOperand<LeftType>::Type,
+          typename RightOperand = typename ExpressionOperand<RightType>::Type>
+struct MatrixDifference : public MatrixBase<MatrixDifference<LeftType, RightType, LeftOperand, RightOperand>,
+                                            LeftType::Rows, LeftType::Cols, typename LeftType::DType>
+{
+    LeftOperand left;
+    RightOperand right;
+
+    MatrixDifference(const LeftType &l, const RightType &r) : left(l), right(r) {}
+
+    typename LeftType::DType operator()(int i, int j) const { return left(i, j) - right(i, j); }
+
+    bool Aliases(const void *storage) const { return left.Aliases(storage) || right.Aliases(storage); }
+
+    bool AssignmentAliases(const void *storage) const
+    {
+        return left.AssignmentAliases(storage) || right.Aliases(storage);
+    }
+
+    template <typename DestType>
+    void AssignTo(DestType &dest) const
+    {
+        left.AssignTo(dest);
+        right.SubtractFrom(dest);
+    }
+
+    template <typename DestType>
+    void AddTo(DestType &dest) const
+    {
+        left.AddTo(dest);
+        right.SubtractFrom(dest);
+    }
+
+    template <typename DestType>
+    void SubtractFrom(DestType &dest) const
+    {
+        left.SubtractFrom(dest);
+        right.AddTo(dest);
+    }
+};
+
+template <typename LeftType, typename RightType,
+          typename LeftOperand = typename ExpressionOperand<LeftType>::Type,
+          typename RightOperand = typename ExpressionOperand<RightType>::Type>
+struct MatrixProduct : public MatrixBase<MatrixProduct<LeftType, RightType, LeftOperand, RightOperand>,
+                                         LeftType::Rows, RightType::Cols, typename LeftType::DType>
+{
+    using DType = typename LeftType::DType;
+
+    LeftOperand left;
+    RightOperand right;
+
+    MatrixProduct(const LeftType &l, const RightType &r) : left(l), right(r) {}
+
+    DType operator()(int i, int j) const { return ProductElement(left, right, i, j); }
+
+    bool Aliases(const void *storage) const { return left.Aliases(storage) || right.Aliases(storage); }
+
+    // Operands that are expressions are evaluated before anything is written so only the others need checking
+    bool AssignmentAliases(const void *storage) const
+    {
+        return (IsEvaluated<LeftType>() ? false : left.Aliases(storage)) ||
+               (IsEvaluated<RightType>() ? false : right.Aliases(storage));
+    }
+
+    template <typename DestType>
+    void AssignTo(DestType &dest) const
+    {
+        const typename ProductOperand<LeftType>::Type &l = left;
+        const typename ProductOperand<RightType>::Type &r = right;
+
+        // Each row is worked out into a local buffer before it's written out so that the compiler doesn't need to
+        // worry that writing to dest changes the operands, otherwise it won't vectorise the loops. If dest only stores
+        // some of its elements (like a SymmetricMatrix) then just those ones are worked out, one at a time.
+        DType row[RightType::Cols];
+
+        for (int i = 0; i < LeftType::Rows; ++i)
+        {
+            if (StoredColumns<DestType>::All)
+            {
+                ProductRow<LeftType::Rows>(l, r, i, row);
+
+                for (int j = 0; j < RightType::Cols; ++j)
+                {
+                    dest(i, j) = row[j];
+                }
+            }
+            else
+            {
+                for (int j = StoredColumns<DestType>::Begin(i); j < StoredColumns<DestType>::End(i); ++j)
+                {
+                    dest(i, j) = ProductElement(l, r, i, j);
+                }
+            }
+        }
+    }
+
+    template <typename DestType>
+    void AddTo(DestType &dest) const
+    {
+        const typename ProductOperand<LeftType>::Type &l = left;
+        const typename ProductOperand<RightType>::Type &r = right;
+
+        DType row[RightType::Cols];
+
+        for (int i = 0; i < LeftType::Rows; ++i)
+        {
+            if (StoredColumns<DestType>::All)
+            {
+                ProductRow<LeftType::Rows>(l, r, i, row);
+
+                for (int j = 0; j < RightType::Cols; ++j)
+                {
+                    dest(i, j) += row[j];
+                }
+            }
+            else
+            {
+                for (int j = StoredColumns<DestType>::Begin(i); j < StoredColumns<DestType>::End(i); ++j)
+                {
+                    dest(i, j) += ProductElement(l, r, i, j);
+                }
+            }
+        }
+    }
+
+    template <typename DestType>
+    void SubtractFrom(DestType &dest) const
+    {
+        const typename ProductOperand<LeftType>::Type &l = left;
+        const typename ProductOperand<RightType>::Type &r = right;
+
+        DType row[RightType::Cols];
+
+        for (int i = 0; i < LeftType::Rows; ++i)
+        {
+            if (StoredColumns<DestType>::All)
+            {
+                ProductRow<LeftType::Rows>(l, r, i, row);
+
+                for (int j = 0; j < RightType::Cols; ++j)
+                {
+                    dest(i, j) -= row[j];
+                }
+            }
+            else
+            {
+                for (int j = StoredColumns<DestType>::Begin(i); j < StoredColumns<DestType>::End(i); ++j)
+                {
+                    dest(i, j) -= ProductElement(l, r, i, j);
+                }
+            }
+        }
+    }
+
+   private:
+    template <typename MatType>
+    static constexpr bool IsEvaluated()
+    {
+        return !IsSame<typename ProductOperand<MatType>::Type, typename ExpressionOperand<MatType>::Type>::value;
+    }
+};
+template <typename RefType, int Rows, int Cols>
+struct ExpressionOperand<RefMatrix<RefType, Rows, Cols>>
+{
+    using Type = RefMatrix<RefType, Rows, Cols>;
+};
+
+template <typename RefType>
+struct ExpressionOperand<MatrixTranspose<RefType>>
+{
+    using Type = MatrixTranspose<RefType>;
+};
+
+template <typename LeftType, typename RightType>
+struct ExpressionOperand<HorizontalConcat<LeftType, RightType>>
+{
+    using Type = HorizontalConcat<LeftType, RightType>;
+};
+
+template <typename TopType, typename BottomType>
+struct ExpressionOperand<VerticalConcat<TopType, BottomType>>
+{
+    using Type = VerticalConcat<TopType, BottomType>;
+};
+
+template <int Rows, int Cols, typename DType>
+struct ExpressionOperand<Zeros<Rows, Cols, DType>>
+{
+    using Type = Zeros<Rows, Cols, DType>;
+};
+
+template <int Rows, int Cols, typename DType>
+struct ExpressionOperand<Ones<Rows, Cols, DType>>
+{
+    using Type = Ones<Rows, Cols, DType>;
+};
+
+template <int Rows, int Cols, typename DType>
+struct ExpressionOperand<Eye<Rows, Cols, DType>>
+{
+    using Type = Eye<Rows, Cols, DType>;
+};
+
+template <class ParentType>
+struct ExpressionOperand<LowerUnitriangularMatrix<ParentType>>
+{
+    using Type = LowerUnitriangularMatrix<ParentType>;
+};
+
+template <class ParentType>
+struct ExpressionOperand<LowerTriangularMatrix<ParentType>>
+{
+    using Type = LowerTriangularMatrix<ParentType>;
+};
+
+template <class ParentType>
+struct ExpressionOperand<UpperTriangularMatrix<ParentType>>
+{
+    using Type = UpperTriangularMatrix<ParentType>;
+};
+
+template <typename LeftType, typename RightType, typename LeftOperand, typename RightOperand>
+struct ExpressionOperand<MatrixSum<LeftType, RightType, LeftOperand, RightOperand>>
+{
+    using Type = MatrixSum<LeftType, RightType, LeftOperand, RightOperand>;
+};
+
+template <typename LeftType, typename RightType, typename LeftOperand, typename RightOperand>
+struct ExpressionOperand<MatrixDifference<LeftType, RightType, LeftOperand, RightOperand>>
+{
+    using Type = MatrixDifference<LeftType, RightType, LeftOperand, RightOperand>;
+};
+
+template <typename LeftType, typename RightType, typename LeftOperand, typename RightOperand>
+struct ExpressionOperand<MatrixProduct<LeftType, RightType, LeftOperand, RightOperand>>
+{
+    using Type = MatrixProduct<LeftType, RightType, LeftOperand, RightOperand>;
+};
+
+// Symmetric matrices are unpacked before they're multiplied so the product kernels don't have to work out where each
+// element is stored
+template <int Dim, typename DType>
+struct ProductOperand<SymmetricMatrix<Dim, DType>>
+{
+    using Type = Matrix<Dim, Dim, DType>;
+};
+
+template <typename LeftType, typename RightType, typename LeftOperand, typename RightOperand>
+struct ProductOperand<MatrixSum<LeftType, RightType, LeftOperand, RightOperand>>
+{
+    using Type = Matrix<LeftType::Rows, LeftType::Cols, typename LeftType::DType>;
+};
+
+template <typename LeftType, typename RightType, typename LeftOperand, typename RightOperand>
+struct ProductOperand<MatrixDifference<LeftType, RightType, LeftOperand, RightOperand>>
+{
+    using Type = Matrix<LeftType::Rows, LeftType::Cols, typename LeftType::DType>;
+};
+
+template <typename LeftType, typename RightType, typename LeftOperand, typename RightOperand>
+struct ProductOperand<MatrixProduct<LeftType, RightType, LeftOperand, RightOperand>>
+{
+    using Type = Matrix<LeftType::Rows, RightType::Cols, typename LeftType::DType>;
+};
+
 }  // namespace BLA
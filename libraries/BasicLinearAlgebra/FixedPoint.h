@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "impl/ProductKernels.h"
+
+namespace BLA
+{
+
+// A signed fixed point number in [-1, 1) with FracBits fractional bits, for boards without an FPU where every float
+// operation goes through a software library. Arithmetic saturates at the ends of the range rather than wrapping around
+// and rounds to the nearest representable value. Intermediate results are worked out in WideType.
+//
+// The functions that operate on these (fabs, sqrt and the operators) are friends so that they're only found through
+// argument dependent lookup and don't get in the way of the ones for float.
+template <typename RawType, typename WideType, int FracBits>
+struct FixedPoint
+{
+    RawType raw;
+
+    FixedPoint() = default;
+
+    constexpr FixedPoint(double value) : raw(FromScaled(value * double(int64_t(1) << FracBits))) {}
+
+    constexpr static RawType Max() { return RawType((int64_t(1) << FracBits) - 1); }
+    constexpr static RawType Min() { return RawType(-(int64_t(1) << FracBits)); }
+
+    static FixedPoint FromRaw(RawType raw)
+    {
+        FixedPoint ret;
+        ret.raw = raw;
+        return ret;
+    }
+
+    template <typename IntType>
+    static FixedPoint Saturate(IntType raw)
+    {
+        return FromRaw(raw > Max() ? Max() : raw < Min() ? Min() : RawType(raw));
+    }
+
+    // Divides by 2^shift, rounding to nearest
+    template <typename IntType>
+    static IntType RoundingShift(IntType value, int shift)
+    {
+        return (value + (IntType(1) << (shift - 1))) >> shift;
+    }
+
+    explicit operator float() const { return raw * (1.0f / float(int64_t(1) << FracBits)); }
+    explicit operator double() const { return raw * (1.0 / double(int64_t(1) << FracBits)); }
+
+    friend FixedPoint operator+(FixedPoint a, FixedPoint b) { return Saturate(WideType(a.raw) + b.raw); }
+    friend FixedPoint operator-(FixedPoint a, FixedPoint b) { return Saturate(WideType(a.raw) - b.raw); }
+    friend FixedPoint operator-(FixedPoint a) { return Saturate(-WideType(a.raw)); }
+
+    friend FixedPoint operator*(FixedPoint a, FixedPoint b)
+    {
+        return Saturate(RoundingShift(WideType(a.raw) * b.raw, FracBits));
+    }
+
+    friend FixedPoint operator/(FixedPoint a, FixedPoint b)
+    {
+        if (b.raw == 0)
+        {
+            return FromRaw(a.raw < 0 ? Min() : Max());
+        }
+
+        int64_t num = int64_t(a.raw) * (int64_t(1) << FracBits);
+        int64_t half = (b.raw < 0 ? -int64_t(b.raw) : int64_t(b.raw)) / 2;
+
+        return Saturate(((num < 0) == (b.raw < 0) ? num + half : num - half) / b.raw);
+    }
+
+    FixedPoint &operator+=(FixedPoint b) { return *this = *this + b; }
+    FixedPoint &operator-=(FixedPoint b) { return *this = *this - b; }
+    FixedPoint &operator*=(FixedPoint b) { return *this = *this * b; }
+    FixedPoint &operator/=(FixedPoint b) { return *this = *this / b; }
+
+    friend bool operator==(FixedPoint a, FixedPoint b) { return a.raw == b.raw; }
+    friend bool operator!=(FixedPoint a, FixedPoint b) { return a.raw != b.raw; }
+    friend bool operator<(FixedPoint a, FixedPoint b) { return a.raw < b.raw; }
+    friend bool operator<=(FixedPoint a, FixedPoint b) { return a.raw <= b.raw; }
+    friend bool operator>(FixedPoint a, FixedPoint b) { return a.raw > b.raw; }
+    friend bool operator>=(FixedPoint a, FixedPoint b) { return a.raw >= b.raw; }
+
+    friend FixedPoint fabs(FixedPoint a) { return a.raw < 0 ? -a : a; }
+
+    // Square roots of negative numbers come out as zero
+    friend FixedPoint sqrt(FixedPoint a)
+    {
+        if (a.raw <= 0)
+        {
+            return FromRaw(0);
+        }
+
+        // sqrt(raw / 2^FracBits) * 2^FracBits = sqrt(raw * 2^FracBits), worked out a bit at a time
+        uint64_t rem = uint64_t(a.raw) << FracBits;
+        uint64_t root = 0;
+
+        for (uint64_t bit = uint64_t(1) << (2 * FracBits - 2); bit != 0; bit >>= 2)
+        {
+            if (rem >= root + bit)
+            {
+                rem -= root + bit;
+                root = (root >> 1) + bit;
+            }
+            else
+            {
+                root >>= 1;
+            }
+        }
+
+        return Saturate(int64_t(root + (rem > root)));
+    }
+
+   private:
+    constexpr static RawType FromScaled(double scaled)
+    {
+        return scaled >= Max() ? Max() : scaled <= Min() ? Min() : RawType(scaled + (scaled < 0 ? -0.5 : 0.5));
+    }
+};
+
+using Q15 = FixedPoint<int16_t, int32_t, 15>;
+using Q31 = FixedPoint<int32_t, int64_t, 31>;
+
+template <typename DType>
+struct IsFixedPoint
+{
+    constexpr static bool value = false;
+};
+
+template <typename RawType, typename WideType, int FracBits>
+struct IsFixedPoint<FixedPoint<RawType, WideType, FracBits>>
+{
+    constexpr static bool value = true;
+};
+
+// Products of Q15s are exact in Q30 and add up in 64 bits without any risk of overflowing
+template <>
+struct ProductAccumulator<Q15>
+{
+    using Type = int64_t;
+    constexpr static bool Wide = true;
+
+    static Type Widen(Q15 a) { return Type(a.raw) * (1 << 15); }
+    static Type Multiply(Q15 a, Q15 b) { return int32_t(a.raw) * b.raw; }
+    static Q15 Round(Type sum) { return Q15::Saturate(Q15::RoundingShift(sum, 15)); }
+};
+
+// Products of Q31s are trimmed to Q47 before they're added up which leaves 16 bits of headroom in the sum
+template <>
+struct ProductAccumulator<Q31>
+{
+    using Type = int64_t;
+    constexpr static bool Wide = true;
+
+    static Type Widen(Q31 a) { return Type(a.raw) * (1 << 16); }
+    static Type Multiply(Q31 a, Q31 b) { return (int64_t(a.raw) * b.raw) >> 15; }
+    static Q31 Round(Type sum) { return Q31::Saturate(Q31::RoundingShift(sum, 16)); }
+};
+
+}  // namespace BLA
@@ -6,31 +6,57 @@
 
 #include "Arduino.h"
 
+// Adding, subtracting and multiplying matrices returns an expression that's evaluated when it's assigned. Define this as
+// 0 to have those operators return a Matrix instead, as they did before, for code that keeps their results with auto.
+#ifndef BLA_LAZY_EXPRESSIONS
+#define BLA_LAZY_EXPRESSIONS 1
+#endif
+
 namespace BLA
 {
+#if BLA_LAZY_EXPRESSIONS
 template <typename MatAType, typename MatBType, int MatARows, int MatACols, int MatBCols, typename DType>
-Matrix<MatARows, MatBCols, DType> operator*(const MatrixBase<MatAType, MatARows, MatACols, DType> &matA,
+MatrixProduct<MatAType, MatBType> operator*(const MatrixBase<MatAType, MatARows, MatACols, DType> &matA,
                                             const MatrixBase<MatBType, MatACols, MatBCols, DType> &matB)
 {
-    Matrix<MatARows, MatBCols, DType> ret;
+    return MatrixProduct<MatAType, MatBType>(static_cast<const MatAType &>(matA), static_cast<const MatBType &>(matB));
+}
 
-    for (int i = 0; i < MatARows; ++i)
-    {
-        for (int j = 0; j < MatBCols; ++j)
-        {
-            if (MatACols > 0)
-            {
-                ret(i, j) = matA(i, 0) * matB(0, j);
-            }
+// Temporary matrices (like the one returned by Inverse) are copied into the expression so that it stays valid after
+// the temporary is destroyed
+template <int MatARows, int MatACols, typename MatBType, int MatBCols, typename DType>
+MatrixProduct<Matrix<MatARows, MatACols, DType>, MatBType, Matrix<MatARows, MatACols, DType>> operator*(
+    Matrix<MatARows, MatACols, DType> &&matA, const MatrixBase<MatBType, MatACols, MatBCols, DType> &matB)
+{
+    return MatrixProduct<Matrix<MatARows, MatACols, DType>, MatBType, Matrix<MatARows, MatACols, DType>>(
+        matA, static_cast<const MatBType &>(matB));
+}
 
-            for (int k = 1; k < MatACols; k++)
-            {
-                ret(i, j) += matA(i, k) * matB(k, j);
-            }
-        }
-    }
-    return ret;
+template <typename MatAType, int MatARows, int MatACols, int MatBCols, typename DType>
+MatrixProduct<MatAType, Matrix<MatACols, MatBCols, DType>, typename ProductOperand<MatAType>::Type,
+              Matrix<MatACols, MatBCols, DType>>
+operator*(const MatrixBase<MatAType, MatARows, MatACols, DType> &matA, Matrix<MatACols, MatBCols, DType> &&matB)
+{
+    return MatrixProduct<MatAType, Matrix<MatACols, MatBCols, DType>, typename ProductOperand<MatAType>::Type,
+                         Matrix<MatACols, MatBCols, DType>>(static_cast<const MatAType &>(matA), matB);
+}
+
+template <int MatARows, int MatACols, int MatBCols, typename DType>
+MatrixProduct<Matrix<MatARows, MatACols, DType>, Matrix<MatACols, MatBCols, DType>, Matrix<MatARows, MatACols, DType>,
+              Matrix<MatACols, MatBCols, DType>>
+operator*(Matrix<MatARows, MatACols, DType> &&matA, Matrix<MatACols, MatBCols, DType> &&matB)
+{
+    return MatrixProduct<Matrix<MatARows, MatACols, DType>, Matrix<MatACols, MatBCols, DType>,
+                         Matrix<MatARows, MatACols, DType>, Matrix<MatACols, MatBCols, DType>>(matA, matB);
 }
+#else
+template <typename MatAType, typename MatBType, int MatARows, int MatACols, int MatBCols, typename DType>
+Matrix<MatARows, MatBCols, DType> operator*(const MatrixBase<MatAType, MatARows, MatACols, DType> &matA,
+                                            const MatrixBase<MatBType, MatACols, MatBCols, DType> &matB)
+{
+    return MatrixProduct<MatAType, MatBType>(static_cast<const MatAType &>(matA), static_cast<const MatBType &>(matB));
+}
+#endif
 
 template <typename MatAType, typename MatBType, int MatARows, int MatACols, int MatBCols, typename DType>
 MatrixBase<MatAType, MatARows, MatACols, DType> &operator*=(MatrixBase<MatAType, MatARows, MatACols, DType> &matA,
@@ -44,14 +70,15 @@ template <typename MatAType, typename MatBType, int Rows, int Cols, typename DTy
 MatrixBase<MatAType, Rows, Cols, DType> &operator+=(MatrixBase<MatAType, Rows, Cols, DType> &matA,
                                                     const MatrixBase<MatBType, Rows, Cols, DType> &matB)
 {
-    for (int i = 0; i < Rows; ++i)
+    const MatBType &expr = static_cast<const MatBType &>(matB);
+
+    if (expr.AssignmentAliases(static_cast<MatAType &>(matA).Storage()))
     {
-        for (int j = 0; j < Cols; ++j)
-        {
-            matA(i, j) += matB(i, j);
-        }
+        Matrix<Rows, Cols, DType> tmp = expr;
+        return matA += tmp;
     }
 
+    expr.AddTo(static_cast<MatAType &>(matA));
     return matA;
 }
 
@@ -59,14 +86,15 @@ template <typename MatAType, typename MatBType, int Rows, int Cols, typename DTy
 MatrixBase<MatAType, Rows, Cols, DType> &operator-=(MatrixBase<MatAType, Rows, Cols, DType> &matA,
                                                     const MatrixBase<MatBType, Rows, Cols, DType> &matB)
 {
-    for (int i = 0; i < Rows; ++i)
+    const MatBType &expr = static_cast<const MatBType &>(matB);
+
+    if (expr.AssignmentAliases(static_cast<MatAType &>(matA).Storage()))
     {
-        for (int j = 0; j < Cols; ++j)
-        {
-            matA(i, j) -= matB(i, j);
-        }
+        Matrix<Rows, Cols, DType> tmp = expr;
+        return matA -= tmp;
     }
 
+    expr.SubtractFrom(static_cast<MatAType &>(matA));
     return matA;
 }
 
@@ -120,23 +148,87 @@ MatrixBase<MatType, Rows, Cols, DType> &operator-=(MatrixBase<MatType, Rows, Col
     return mat;
 }
 
+#if BLA_LAZY_EXPRESSIONS
+template <typename MatAType, typename MatBType, int Rows, int Cols, typename DType>
+MatrixSum<MatAType, MatBType> operator+(const MatrixBase<MatAType, Rows, Cols, DType> &matA,
+                                        const MatrixBase<MatBType, Rows, Cols, DType> &matB)
+{
+    return MatrixSum<MatAType, MatBType>(static_cast<const MatAType &>(matA), static_cast<const MatBType &>(matB));
+}
+
+template <int Rows, int Cols, typename MatBType, typename DType>
+MatrixSum<Matrix<Rows, Cols, DType>, MatBType, Matrix<Rows, Cols, DType>> operator+(
+    Matrix<Rows, Cols, DType> &&matA, const MatrixBase<MatBType, Rows, Cols, DType> &matB)
+{
+    return MatrixSum<Matrix<Rows, Cols, DType>, MatBType, Matrix<Rows, Cols, DType>>(
+        matA, static_cast<const MatBType &>(matB));
+}
+
+template <typename MatAType, int Rows, int Cols, typename DType>
+MatrixSum<MatAType, Matrix<Rows, Cols, DType>, typename ExpressionOperand<MatAType>::Type, Matrix<Rows, Cols, DType>>
+operator+(const MatrixBase<MatAType, Rows, Cols, DType> &matA, Matrix<Rows, Cols, DType> &&matB)
+{
+    return MatrixSum<MatAType, Matrix<Rows, Cols, DType>, typename ExpressionOperand<MatAType>::Type,
+                     Matrix<Rows, Cols, DType>>(static_cast<const MatAType &>(matA), matB);
+}
+
+template <int Rows, int Cols, typename DType>
+MatrixSum<Matrix<Rows, Cols, DType>, Matrix<Rows, Cols, DType>, Matrix<Rows, Cols, DType>, Matrix<Rows, Cols, DType>>
+operator+(Matrix<Rows, Cols, DType> &&matA, Matrix<Rows, Cols, DType> &&matB)
+{
+    return MatrixSum<Matrix<Rows, Cols, DType>, Matrix<Rows, Cols, DType>, Matrix<Rows, Cols, DType>,
+                     Matrix<Rows, Cols, DType>>(matA, matB);
+}
+
+template <typename MatAType, typename MatBType, int Rows, int Cols, typename DType>
+MatrixDifference<MatAType, MatBType> operator-(const MatrixBase<MatAType, Rows, Cols, DType> &matA,
+                                               const MatrixBase<MatBType, Rows, Cols, DType> &matB)
+{
+    return MatrixDifference<MatAType, MatBType>(static_cast<const MatAType &>(matA),
+                                                static_cast<const MatBType &>(matB));
+}
+
+template <int Rows, int Cols, typename MatBType, typename DType>
+MatrixDifference<Matrix<Rows, Cols, DType>, MatBType, Matrix<Rows, Cols, DType>> operator-(
+    Matrix<Rows, Cols, DType> &&matA, const MatrixBase<MatBType, Rows, Cols, DType> &matB)
+{
+    return MatrixDifference<Matrix<Rows, Cols, DType>, MatBType, Matrix<Rows, Cols, DType>>(
+        matA, static_cast<const MatBType &>(matB));
+}
+
+template <typename MatAType, int Rows, int Cols, typename DType>
+MatrixDifference<MatAType, Matrix<Rows, Cols, DType>, typename ExpressionOperand<MatAType>::Type,
+                 Matrix<Rows, Cols, DType>>
+operator-(const MatrixBase<MatAType, Rows, Cols, DType> &matA, Matrix<Rows, Cols, DType> &&matB)
+{
+    return MatrixDifference<MatAType, Matrix<Rows, Cols, DType>, typename ExpressionOperand<MatAType>::Type,
+                            Matrix<Rows, Cols, DType>>(static_cast<const MatAType &>(matA), matB);
+}
+
+template <int Rows, int Cols, typename DType>
+MatrixDifference<Matrix<Rows, Cols, DType>, Matrix<Rows, Cols, DType>, Matrix<Rows, Cols, DType>,
+                 Matrix<Rows, Cols, DType>>
+operator-(Matrix<Rows, Cols, DType> &&matA, Matrix<Rows, Cols, DType> &&matB)
+{
+    return MatrixDifference<Matrix<Rows, Cols, DType>, Matrix<Rows, Cols, DType>, Matrix<Rows, Cols, DType>,
+                            Matrix<Rows, Cols, DType>>(matA, matB);
+}
+#else
 template <typename MatAType, typename MatBType, int Rows, int Cols, typename DType>
 Matrix<Rows, Cols, DType> operator+(const MatrixBase<MatAType, Rows, Cols, DType> &matA,
-                                    const MatrixBase<MatBType, Rows, Cols, DType> &matB)
+                                   const MatrixBase<MatBType, Rows, Cols, DType> &matB)
 {
-    Matrix<Rows, Cols, DType> ret = matA;
-    ret += matB;
-    return ret;
+    return MatrixSum<MatAType, MatBType>(static_cast<const MatAType &>(matA), static_cast<const MatBType &>(matB));
 }
 
 template <typename MatAType, typename MatBType, int Rows, int Cols, typename DType>
 Matrix<Rows, Cols, DType> operator-(const MatrixBase<MatAType, Rows, Cols, DType> &matA,
-                                    const MatrixBase<MatBType, Rows, Cols, DType> &matB)
+                                   const MatrixBase<MatBType, Rows, Cols, DType> &matB)
 {
-    Matrix<Rows, Cols, DType> ret = matA;
-    ret -= matB;
-    return ret;
+    return MatrixDifference<MatAType, MatBType>(static_cast<const MatAType &>(matA),
+                                                static_cast<const MatBType &>(matB));
 }
+#endif
 
 template <typename MatType, int Rows, int Cols, typename DType>
 Matrix<Rows, Cols, DType> operator+(const MatrixBase<MatType, Rows, Cols, DType> &mat, const DType k)
@@ -427,6 +519,13 @@ inline Print &operator<<(Print &strm, const float obj)
     return strm;
 }
 
+template <typename RawType, typename WideType, int FracBits>
+inline Print &operator<<(Print &strm, const FixedPoint<RawType, WideType, FracBits> obj)
+{
+    strm.print(float(obj));
+    return strm;
+}
+
 inline Print &operator<<(Print &strm, const char *obj)
 {
     strm.print(obj);
@@ -0,0 +1,550 @@
+#pragma once
+
+#ifdef BLA_BATCH_THREADS
+#include <thread>
+#include <vector>
+#endif
+
+// Batch operations work through a batch this many matrices at a time. Their temporaries are sized by it and the part of
+// the batch they're working on stays in cache while the whole algorithm runs over it.
+#ifndef BLA_BATCH_BLOCK
+#define BLA_BATCH_BLOCK 64
+#endif
+
+namespace BLA
+{
+
+template <typename BatchType>
+class BatchMember;
+
+// A batch of Size matrices that all have the same shape, stored so that element (i, j) of every matrix in the batch
+// is contiguous. The operations below work across the batch in their innermost loops, which the compiler can vectorise
+// no matter how small the matrices themselves are. Batches are usually too big for the stack so they're best declared
+// static or allocated on the heap.
+template <int rows, int cols, int size, typename d_type = float>
+struct MatrixBatch
+{
+    constexpr static int Rows = rows;
+    constexpr static int Cols = cols;
+    constexpr static int Size = size;
+    using DType = d_type;
+
+    // storage[i * Cols + j][n] is element (i, j) of matrix n
+    DType storage[Rows * Cols][Size];
+
+    BatchMember<MatrixBatch> operator[](int n) { return BatchMember<MatrixBatch>(*this, n); }
+    BatchMember<const MatrixBatch> operator[](int n) const { return BatchMember<const MatrixBatch>(*this, n); }
+};
+
+// One of the matrices in a batch, which can be read or assigned like any other matrix
+template <typename BatchType>
+class BatchMember
+    : public MatrixBase<BatchMember<BatchType>, BatchType::Rows, BatchType::Cols, typename BatchType::DType>
+{
+    BatchType &batch_;
+    const int n_;
+
+   public:
+    BatchMember(BatchType &batch, int n) : batch_(batch), n_(n) {}
+
+    typename BatchType::DType &operator()(int i, int j = 0) { return batch_.storage[i * BatchType::Cols + j][n_]; }
+    typename BatchType::DType operator()(int i, int j = 0) const
+    {
+        return batch_.storage[i * BatchType::Cols + j][n_];
+    }
+
+    bool Aliases(const void *storage) const { return &batch_ == storage; }
+    const void *Storage() const { return &batch_; }
+
+    template <typename MatType>
+    BatchMember &operator=(const MatType &mat)
+    {
+        static_cast<MatrixBase<BatchMember<BatchType>, BatchType::Rows, BatchType::Cols, typename BatchType::DType> &>(
+            *this) = mat;
+        return *this;
+    }
+};
+
+template <int Dim, int Size>
+struct LUBatchDecomposition
+{
+    // Row i of the factors of matrix n is row perm[i][n] of the original matrix
+    int perm[Dim][Size];
+    bool singular[Size];
+};
+
+template <int Size>
+struct CholeskyBatchDecomposition
+{
+    bool positive_definite[Size];
+};
+
+// Each of the operations below takes the range of the batch [begin, end) to work on so that a batch can be split up
+// between threads (see ParallelBatch). None of their outputs can be the same batch as one of their inputs unless it
+// says otherwise.
+
+// C = A * B for each matrix in the batch
+template <int Rows, int Inner, int Cols, int Size, typename DType>
+void Multiply(const MatrixBatch<Rows, Inner, Size, DType> &A, const MatrixBatch<Inner, Cols, Size, DType> &B,
+              MatrixBatch<Rows, Cols, Size, DType> &C, int begin = 0, int end = Size)
+{
+    for (int block = begin; block < end; block += BLA_BATCH_BLOCK)
+    {
+        const int len = end - block < BLA_BATCH_BLOCK ? end - block : BLA_BATCH_BLOCK;
+
+        for (int i = 0; i < Rows; ++i)
+        {
+            for (int j = 0; j < Cols; ++j)
+            {
+                // Each element of the product is summed in a register rather than being written back for every term
+                const DType *a[Inner], *b[Inner];
+
+                for (int k = 0; k < Inner; ++k)
+                {
+                    a[k] = A.storage[i * Inner + k] + block;
+                    b[k] = B.storage[k * Cols + j] + block;
+                }
+
+                DType *c = C.storage[i * Cols + j] + block;
+
+                for (int n = 0; n < len; ++n)
+                {
+                    DType sum = a[0][n] * b[0][n];
+
+                    for (int k = 1; k < Inner; ++k)
+                    {
+                        sum += a[k][n] * b[k][n];
+                    }
+
+                    c[n] = sum;
+                }
+            }
+        }
+    }
+}
+
+// LU decomposition with partial pivoting of a block of len matrices, in place. a[i * Dim + j] points to element (i, j)
+// of the first of them.
+template <int Dim, typename DType>
+void LUDecomposeBlock(DType *(&a)[Dim * Dim], int *(&perm)[Dim], bool *singular, int len)
+{
+    for (int n = 0; n < len; ++n)
+    {
+        singular[n] = false;
+    }
+
+    for (int i = 0; i < Dim; ++i)
+    {
+        for (int n = 0; n < len; ++n)
+        {
+            perm[i][n] = i;
+        }
+    }
+
+    for (int k = 0; k < Dim; ++k)
+    {
+        // Find the largest element in column k on or below the diagonal of each matrix
+        DType largest[BLA_BATCH_BLOCK];
+        int pivot[BLA_BATCH_BLOCK];
+
+        for (int n = 0; n < len; ++n)
+        {
+            largest[n] = fabs(a[k * Dim + k][n]);
+            pivot[n] = k;
+        }
+
+        for (int i = k + 1; i < Dim; ++i)
+        {
+            const DType *a_ik = a[i * Dim + k];
+
+            for (int n = 0; n < len; ++n)
+            {
+                DType elem = fabs(a_ik[n]);
+                bool larger = elem > largest[n];
+                largest[n] = larger ? elem : largest[n];
+                pivot[n] = larger ? i : pivot[n];
+            }
+        }
+
+        // The pivots are different for each matrix so the rows are swapped one matrix at a time
+        for (int n = 0; n < len; ++n)
+        {
+            const int p = pivot[n];
+
+            if (p != k)
+            {
+                for (int j = 0; j < Dim; ++j)
+                {
+                    bla_swap(a[k * Dim + j][n], a[p * Dim + j][n]);
+                }
+
+                bla_swap(perm[k][n], perm[p][n]);
+            }
+        }
+
+        const DType *a_kk = a[k * Dim + k];
+
+        for (int n = 0; n < len; ++n)
+        {
+            singular[n] = singular[n] || a_kk[n] == 0;
+        }
+
+        for (int i = k + 1; i < Dim; ++i)
+        {
+            DType *a_ik = a[i * Dim + k];
+
+            for (int n = 0; n < len; ++n)
+            {
+                a_ik[n] /= a_kk[n];
+            }
+
+            for (int j = k + 1; j < Dim; ++j)
+            {
+                DType *a_ij = a[i * Dim + j];
+                const DType *a_kj = a[k * Dim + j];
+
+                for (int n = 0; n < len; ++n)
+                {
+                    a_ij[n] -= a_ik[n] * a_kj[n];
+                }
+            }
+        }
+    }
+}
+
+// Solves L * U * x = y in place for a block of len matrices, where x[i] points to element i of the first of them and
+// starts out holding the permuted right hand side
+template <int Dim, typename LUType, typename DType>
+void LUSolveBlock(LUType *const (&lu)[Dim * Dim], DType *(&x)[Dim], int len)
+{
+    for (int i = 1; i < Dim; ++i)
+    {
+        for (int k = 0; k < i; ++k)
+        {
+            const LUType *l_ik = lu[i * Dim + k];
+
+            for (int n = 0; n < len; ++n)
+            {
+                x[i][n] -= l_ik[n] * x[k][n];
+            }
+        }
+    }
+
+    for (int i = Dim - 1; i >= 0; --i)
+    {
+        for (int k = i + 1; k < Dim; ++k)
+        {
+            const LUType *u_ik = lu[i * Dim + k];
+
+            for (int n = 0; n < len; ++n)
+            {
+                x[i][n] -= u_ik[n] * x[k][n];
+            }
+        }
+
+        const LUType *u_ii = lu[i * Dim + i];
+
+        for (int n = 0; n < len; ++n)
+        {
+            x[i][n] /= u_ii[n];
+        }
+    }
+}
+
+// Decomposes each matrix of the batch in place. Singular matrices are flagged in decomp and don't affect the others.
+template <int Dim, int Size, typename DType>
+void LUDecompose(MatrixBatch<Dim, Dim, Size, DType> &A, LUBatchDecomposition<Dim, Size> &decomp, int begin = 0,
+                 int end = Size)
+{
+    for (int block = begin; block < end; block += BLA_BATCH_BLOCK)
+    {
+        DType *a[Dim * Dim];
+        int *perm[Dim];
+
+        for (int e = 0; e < Dim * Dim; ++e)
+        {
+            a[e] = A.storage[e] + block;
+        }
+
+        for (int i = 0; i < Dim; ++i)
+        {
+            perm[i] = decomp.perm[i] + block;
+        }
+
+        LUDecomposeBlock<Dim>(a, perm, decomp.singular + block,
+                              end - block < BLA_BATCH_BLOCK ? end - block : BLA_BATCH_BLOCK);
+    }
+}
+
+// Solves A * X = B for each matrix in the batch given the decomposition of A
+template <int Dim, int Cols, int Size, typename DType>
+void LUSolve(const MatrixBatch<Dim, Dim, Size, DType> &LU, const LUBatchDecomposition<Dim, Size> &decomp,
+             const MatrixBatch<Dim, Cols, Size, DType> &B, MatrixBatch<Dim, Cols, Size, DType> &X, int begin = 0,
+             int end = Size)
+{
+    for (int block = begin; block < end; block += BLA_BATCH_BLOCK)
+    {
+        const int len = end - block < BLA_BATCH_BLOCK ? end - block : BLA_BATCH_BLOCK;
+        const DType *lu[Dim * Dim];
+
+        for (int e = 0; e < Dim * Dim; ++e)
+        {
+            lu[e] = LU.storage[e] + block;
+        }
+
+        for (int c = 0; c < Cols; ++c)
+        {
+            DType *x[Dim];
+
+            for (int i = 0; i < Dim; ++i)
+            {
+                x[i] = X.storage[i * Cols + c] + block;
+                const int *perm = decomp.perm[i] + block;
+
+                for (int n = 0; n < len; ++n)
+                {
+                    x[i][n] = B.storage[perm[n] * Cols + c][block + n];
+                }
+            }
+
+            LUSolveBlock<Dim>(lu, x, len);
+        }
+    }
+}
+
+// Decomposes each matrix of the batch into L * ~L in place. Like CholeskyDecompose the upper triangle is read and
+// the factor is written over the lower triangle.
+template <int Dim, int Size, typename DType>
+void CholeskyDecompose(MatrixBatch<Dim, Dim, Size, DType> &A, CholeskyBatchDecomposition<Size> &decomp,
+                       int begin = 0, int end = Size)
+{
+    for (int block = begin; block < end; block += BLA_BATCH_BLOCK)
+    {
+        const int len = end - block < BLA_BATCH_BLOCK ? end - block : BLA_BATCH_BLOCK;
+        bool *positive_definite = decomp.positive_definite + block;
+
+        for (int n = 0; n < len; ++n)
+        {
+            positive_definite[n] = true;
+        }
+
+        for (int j = 0; j < Dim; ++j)
+        {
+            DType *a_jj = A.storage[j * Dim + j] + block;
+
+            for (int k = 0; k < j; ++k)
+            {
+                const DType *a_jk = A.storage[j * Dim + k] + block;
+
+                for (int n = 0; n < len; ++n)
+                {
+                    a_jj[n] -= a_jk[n] * a_jk[n];
+                }
+            }
+
+            // Matrices that turn out not to be positive definite are flagged and carry on with a zero on the diagonal
+            for (int n = 0; n < len; ++n)
+            {
+                positive_definite[n] = positive_definite[n] && a_jj[n] > 0;
+                a_jj[n] = a_jj[n] > 0 ? sqrt(a_jj[n]) : DType(0);
+            }
+
+            for (int i = j + 1; i < Dim; ++i)
+            {
+                DType *a_ij = A.storage[i * Dim + j] + block;
+                const DType *a_ji = A.storage[j * Dim + i] + block;
+
+                for (int n = 0; n < len; ++n)
+                {
+                    a_ij[n] = a_ji[n];
+                }
+
+                for (int k = 0; k < j; ++k)
+                {
+                    const DType *a_ik = A.storage[i * Dim + k] + block;
+                    const DType *a_jk = A.storage[j * Dim + k] + block;
+
+                    for (int n = 0; n < len; ++n)
+                    {
+                        a_ij[n] -= a_ik[n] * a_jk[n];
+                    }
+                }
+
+                for (int n = 0; n < len; ++n)
+                {
+                    a_ij[n] /= a_jj[n];
+                }
+            }
+        }
+    }
+}
+
+// Solves A * X = B for each matrix in the batch given the Cholesky factor of A
+template <int Dim, int Cols, int Size, typename DType>
+void CholeskySolve(const MatrixBatch<Dim, Dim, Size, DType> &L, const MatrixBatch<Dim, Cols, Size, DType> &B,
+                   MatrixBatch<Dim, Cols, Size, DType> &X, int begin = 0, int end = Size)
+{
+    for (int block = begin; block < end; block += BLA_BATCH_BLOCK)
+    {
+        const int len = end - block < BLA_BATCH_BLOCK ? end - block : BLA_BATCH_BLOCK;
+
+        for (int c = 0; c < Cols; ++c)
+        {
+            for (int i = 0; i < Dim; ++i)
+            {
+                DType *x_i = X.storage[i * Cols + c] + block;
+                const DType *b_i = B.storage[i * Cols + c] + block;
+
+                for (int n = 0; n < len; ++n)
+                {
+                    x_i[n] = b_i[n];
+                }
+
+                for (int k = 0; k < i; ++k)
+                {
+                    const DType *l_ik = L.storage[i * Dim + k] + block;
+                    const DType *x_k = X.storage[k * Cols + c] + block;
+
+                    for (int n = 0; n < len; ++n)
+                    {
+                        x_i[n] -= l_ik[n] * x_k[n];
+                    }
+                }
+
+                const DType *l_ii = L.storage[i * Dim + i] + block;
+
+                for (int n = 0; n < len; ++n)
+                {
+                    x_i[n] /= l_ii[n];
+                }
+            }
+
+            for (int i = Dim - 1; i >= 0; --i)
+            {
+                DType *x_i = X.storage[i * Cols + c] + block;
+
+                for (int k = i + 1; k < Dim; ++k)
+                {
+                    const DType *l_ki = L.storage[k * Dim + i] + block;
+                    const DType *x_k = X.storage[k * Cols + c] + block;
+
+                    for (int n = 0; n < len; ++n)
+                    {
+                        x_i[n] -= l_ki[n] * x_k[n];
+                    }
+                }
+
+                const DType *l_ii = L.storage[i * Dim + i] + block;
+
+                for (int n = 0; n < len; ++n)
+                {
+                    x_i[n] /= l_ii[n];
+                }
+            }
+        }
+    }
+}
+
+// Inverts each matrix of the batch, flagging the ones that are singular. A and A_inv can be the same batch.
+template <int Dim, int Size, typename DType>
+void Invert(const MatrixBatch<Dim, Dim, Size, DType> &A, MatrixBatch<Dim, Dim, Size, DType> &A_inv,
+            bool (&singular)[Size], int begin = 0, int end = Size)
+{
+    for (int block = begin; block < end; block += BLA_BATCH_BLOCK)
+    {
+        const int len = end - block < BLA_BATCH_BLOCK ? end - block : BLA_BATCH_BLOCK;
+
+        // The block is decomposed in a scratch copy so that the input is left alone
+        DType lu_storage[Dim * Dim][BLA_BATCH_BLOCK];
+        int perm_storage[Dim][BLA_BATCH_BLOCK];
+        DType *lu[Dim * Dim];
+        int *perm[Dim];
+
+        for (int e = 0; e < Dim * Dim; ++e)
+        {
+            lu[e] = lu_storage[e];
+
+            for (int n = 0; n < len; ++n)
+            {
+                lu[e][n] = A.storage[e][block + n];
+            }
+        }
+
+        for (int i = 0; i < Dim; ++i)
+        {
+            perm[i] = perm_storage[i];
+        }
+
+        LUDecomposeBlock<Dim>(lu, perm, singular + block, len);
+
+        // Column c of the inverse solves A * x = e_c
+        for (int c = 0; c < Dim; ++c)
+        {
+            DType *x[Dim];
+
+            for (int i = 0; i < Dim; ++i)
+            {
+                x[i] = A_inv.storage[i * Dim + c] + block;
+
+                for (int n = 0; n < len; ++n)
+                {
+                    x[i][n] = perm[i][n] == c ? DType(1) : DType(0);
+                }
+            }
+
+            LUSolveBlock<Dim>(lu, x, len);
+        }
+    }
+}
+
+#ifdef BLA_BATCH_THREADS
+
+// Splits [0, Size) into one range per thread, each a whole number of blocks, and calls func(begin, end) for each of
+// them at once. Threads are started on every call so this is only worth it for batches of a few thousand matrices:
+//
+//     ParallelBatch<Size>(4, [&](int begin, int end) { Invert(A, A_inv, singular, begin, end); });
+template <int Size, typename Func>
+void ParallelBatch(int threads, Func func)
+{
+    const int blocks = (Size + BLA_BATCH_BLOCK - 1) / BLA_BATCH_BLOCK;
+
+    if (threads > blocks)
+    {
+        threads = blocks;
+    }
+
+    if (threads <= 1)
+    {
+        func(0, Size);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    int begin = 0;
+
+    for (int t = 0; t < threads; ++t)
+    {
+        int end = (blocks * (t + 1) / threads) * BLA_BATCH_BLOCK;
+        end = end < Size ? end : Size;
+
+        if (t == threads - 1)
+        {
+            func(begin, end);
+        }
+        else
+        {
+            workers.emplace_back(func, begin, end);
+        }
+
+        begin = end;
+    }
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+#endif
+
+}  // namespace BLA
@@ -38,9 +38,31 @@ struct CholeskyDecomposition
     }
 };
 
+template <typename ParentType>
+struct QRDecomposition
+{
+    bool singular;
+    int rank;
+    typename ParentType::DType tau[ParentType::Cols];
+    PermutationMatrix<ParentType::Cols, typename ParentType::DType> P;
+    UpperTriangularMatrix<ParentType> R;
+
+    QRDecomposition(MatrixBase<ParentType, ParentType::Rows, ParentType::Cols, typename ParentType::DType> &A)
+        : R(static_cast<ParentType &>(A))
+    {
+        static_assert(ParentType::Rows >= ParentType::Cols, "Input matrix must have at least as many rows as columns");
+    }
+};
+
 template <typename ParentType, int Dim>
 LUDecomposition<ParentType> LUDecompose(MatrixBase<ParentType, Dim, Dim, typename ParentType::DType> &A)
 {
+    using Acc = ProductAccumulator<typename ParentType::DType>;
+
+    // Fixed point elements can't hold the reciprocals of numbers smaller than one, so they're pivoted on magnitude
+    // alone and divided by the pivot directly. Elements of U larger than one saturate so A might need scaling down.
+    const bool fixed_point = IsFixedPoint<typename ParentType::DType>::value;
+
     LUDecomposition<ParentType> decomp(A);
     auto &idx = decomp.P.idx;
     decomp.parity = 1.0;
@@ -71,7 +93,7 @@ LUDecomposition<ParentType> LUDecompose(MatrixBase<ParentType, Dim, Dim, typenam
             return decomp;
         }
 
-        row_scale[i] = 1.0 / largest_elem;
+        row_scale[i] = fixed_point ? 1.0 : 1.0 / largest_elem;
     }
 
     // This is the loop over columns of Crout’s method.
@@ -80,27 +102,27 @@ LUDecomposition<ParentType> LUDecompose(MatrixBase<ParentType, Dim, Dim, typenam
         // Calculate beta ij
         for (int i = 0; i < j; ++i)
         {
-            typename ParentType::DType sum = 0.0;
+            typename Acc::Type sum = 0;
 
             for (int k = 0; k < i; ++k)
             {
-                sum += A(i, k) * A(k, j);
+                sum += Acc::Multiply(A(i, k), A(k, j));
             }
 
-            A(i, j) -= sum;
+            A(i, j) = Acc::Round(Acc::Widen(A(i, j)) - sum);
         }
 
         // Calcuate alpha ij (before division by the pivot)
         for (int i = j; i < Dim; ++i)
         {
-            typename ParentType::DType sum = 0.0;
+            typename Acc::Type sum = 0;
 
             for (int k = 0; k < j; ++k)
             {
-                sum += A(i, k) * A(k, j);
+                sum += Acc::Multiply(A(i, k), A(k, j));
             }
 
-            A(i, j) -= sum;
+            A(i, j) = Acc::Round(Acc::Widen(A(i, j)) - sum);
         }
 
         // Search for largest pivot element
@@ -109,7 +131,7 @@ LUDecomposition<ParentType> LUDecompose(MatrixBase<ParentType, Dim, Dim, typenam
 
         for (int i = j; i < Dim; i++)
         {
-            typename ParentType::DType this_elem = row_scale[i] * fabs(A(i, j));
+            typename ParentType::DType this_elem = fixed_point ? fabs(A(i, j)) : row_scale[i] * fabs(A(i, j));
 
             if (this_elem >= largest_elem)
             {
@@ -140,11 +162,21 @@ LUDecomposition<ParentType> LUDecompose(MatrixBase<ParentType, Dim, Dim, typenam
         if (j != Dim)
         {
             // Now, finally, divide by the pivot element.
-            typename ParentType::DType pivot_inv = 1.0 / A(j, j);
-
-            for (int i = j + 1; i < Dim; ++i)
+            if (fixed_point)
             {
-                A(i, j) *= pivot_inv;
+                for (int i = j + 1; i < Dim; ++i)
+                {
+                    A(i, j) /= A(j, j);
+                }
+            }
+            else
+            {
+                typename ParentType::DType pivot_inv = 1.0 / A(j, j);
+
+                for (int i = j + 1; i < Dim; ++i)
+                {
+                    A(i, j) *= pivot_inv;
+                }
             }
         }
     }
@@ -157,6 +189,8 @@ template <int Dim, class LUType, class BType>
 Matrix<Dim, 1, typename BType::DType> LUSolve(const LUDecomposition<LUType> &decomp,
                                               const MatrixBase<BType, Dim, 1, typename BType::DType> &b)
 {
+    using Acc = ProductAccumulator<typename BType::DType>;
+
     Matrix<Dim, 1, typename BType::DType> x, tmp;
 
     auto &idx = decomp.P.idx;
@@ -165,27 +199,27 @@ Matrix<Dim, 1, typename BType::DType> LUSolve(const LUDecomposition<LUType> &dec
     // Forward substitution to solve L * y = b
     for (int i = 0; i < Dim; ++i)
     {
-        typename BType::DType sum = 0.0;
+        typename Acc::Type sum = 0;
 
         for (int j = 0; j < i; ++j)
         {
-            sum += LU(i, j) * tmp(idx[j]);
+            sum += Acc::Multiply(LU(i, j), tmp(idx[j]));
         }
 
-        tmp(idx[i]) = b(idx[i]) - sum;
+        tmp(idx[i]) = Acc::Round(Acc::Widen(b(idx[i])) - sum);
     }
 
     // Backward substitution to solve U * x = y
     for (int i = Dim - 1; i >= 0; --i)
     {
-        typename BType::DType sum = 0.0;
+        typename Acc::Type sum = 0;
 
         for (int j = i + 1; j < Dim; ++j)
         {
-            sum += LU(i, j) * tmp(idx[j]);
+            sum += Acc::Multiply(LU(i, j), tmp(idx[j]));
         }
 
-        tmp(idx[i]) = (tmp(idx[i]) - sum) / LU(i, i);
+        tmp(idx[i]) = Acc::Round(Acc::Widen(tmp(idx[i])) - sum) / LU(i, i);
     }
 
     // Undo the permutation
@@ -200,19 +234,23 @@ Matrix<Dim, 1, typename BType::DType> LUSolve(const LUDecomposition<LUType> &dec
 template <typename ParentType, int Dim>
 CholeskyDecomposition<ParentType> CholeskyDecompose(MatrixBase<ParentType, Dim, Dim, typename ParentType::DType> &A)
 {
+    using Acc = ProductAccumulator<typename ParentType::DType>;
+
     CholeskyDecomposition<ParentType> chol(A);
 
     for (int i = 0; i < Dim; ++i)
     {
         for (int j = i; j < Dim; ++j)
         {
-            float sum = A(i, j);
+            typename Acc::Type acc = Acc::Widen(A(i, j));
 
             for (int k = i - 1; k >= 0; --k)
             {
-                sum -= A(i, k) * A(j, k);
+                acc -= Acc::Multiply(A(i, k), A(j, k));
             }
 
+            typename ParentType::DType sum = Acc::Round(acc);
+
             if (i == j)
             {
                 if (sum <= 0.0)
@@ -232,40 +270,319 @@ CholeskyDecomposition<ParentType> CholeskyDecompose(MatrixBase<ParentType, Dim,
     return chol;
 }
 
-template <int Dim, class LUType, class BType>
-Matrix<Dim, 1, typename BType::DType> CholeskySolve(const CholeskyDecomposition<LUType> &decomp,
-                                                    const MatrixBase<BType, Dim, 1, typename BType::DType> &b)
+// Solves A * X = B for each column of B. A SymmetricMatrix can be decomposed in place, in which case the factor stays
+// packed in its lower triangle.
+template <int Dim, int Cols, class LUType, class BType>
+Matrix<Dim, Cols, typename BType::DType> CholeskySolve(const CholeskyDecomposition<LUType> &decomp,
+                                                       const MatrixBase<BType, Dim, Cols, typename BType::DType> &B)
 {
-    Matrix<Dim, 1, typename BType::DType> x;
+    using DType = typename BType::DType;
+    using Acc = ProductAccumulator<DType>;
+
+    Matrix<Dim, Cols, DType> X;
     auto &A = decomp.L.parent;
 
-    for (int i = 0; i < Dim; ++i)
+    for (int c = 0; c < Cols; ++c)
     {
-        float sum = b(i);
+        for (int i = 0; i < Dim; ++i)
+        {
+            typename Acc::Type sum = Acc::Widen(B(i, c));
 
-        for (int k = i - 1; k >= 0; --k)
+            for (int k = i - 1; k >= 0; --k)
+            {
+                sum -= Acc::Multiply(A(i, k), X(k, c));
+            }
+
+            X(i, c) = Acc::Round(sum) / A(i, i);
+        }
+
+        for (int i = Dim - 1; i >= 0; --i)
         {
-            sum -= A(i, k) * x(k);
+            typename Acc::Type sum = Acc::Widen(X(i, c));
+
+            for (int k = i + 1; k < Dim; ++k)
+            {
+                sum -= Acc::Multiply(A(k, i), X(k, c));
+            }
+
+            X(i, c) = Acc::Round(sum) / A(i, i);
         }
+    }
+
+    return X;
+}
+
+// Reflect column k of A onto the k'th axis with a Householder transformation H = I - tau * v * v^T and apply it to
+// the columns to its right. v(k) = 1 is implicit and the rest of v overwrites the column below the diagonal.
+template <typename ParentType, int Rows, int Cols>
+void HouseholderStep(MatrixBase<ParentType, Rows, Cols, typename ParentType::DType> &A,
+                     typename ParentType::DType &tau, int k)
+{
+    typename ParentType::DType sigma = 0.0;
 
-        x(i) = sum / A(i, i);
+    for (int i = k + 1; i < Rows; ++i)
+    {
+        sigma += A(i, k) * A(i, k);
     }
 
-    for (int i = Dim - 1; i >= 0; --i)
+    if (sigma == 0.0)
     {
-        float sum = x(i);
+        // Already zero below the diagonal so H = I
+        tau = 0.0;
+        return;
+    }
+
+    typename ParentType::DType alpha = A(k, k);
+    typename ParentType::DType beta = sqrt(alpha * alpha + sigma);
+
+    // Choose the sign of beta to avoid cancellation in alpha - beta
+    if (alpha > 0.0)
+    {
+        beta = -beta;
+    }
+
+    tau = (beta - alpha) / beta;
+    typename ParentType::DType scale = 1.0 / (alpha - beta);
+
+    for (int i = k + 1; i < Rows; ++i)
+    {
+        A(i, k) *= scale;
+    }
+
+    A(k, k) = beta;
+
+    // w = tau * v^T * A then A -= v * w. Both loops run along the rows of A which are contiguous in a Matrix
+    typename ParentType::DType w[Cols];
+
+    for (int j = k + 1; j < Cols; ++j)
+    {
+        w[j] = A(k, j);
+    }
+
+    for (int i = k + 1; i < Rows; ++i)
+    {
+        for (int j = k + 1; j < Cols; ++j)
+        {
+            w[j] += A(i, k) * A(i, j);
+        }
+    }
+
+    for (int j = k + 1; j < Cols; ++j)
+    {
+        w[j] *= tau;
+        A(k, j) -= w[j];
+    }
 
-        for (int k = i + 1; k < Dim; ++k)
+    for (int i = k + 1; i < Rows; ++i)
+    {
+        for (int j = k + 1; j < Cols; ++j)
         {
-            sum -= A(k, i) * x(k);
+            A(i, j) -= A(i, k) * w[j];
         }
+    }
+}
 
-        x(i) = sum / A(i, i);
+template <typename ParentType, int Rows, int Cols>
+QRDecomposition<ParentType> QRDecompose(MatrixBase<ParentType, Rows, Cols, typename ParentType::DType> &A)
+{
+    QRDecomposition<ParentType> decomp(A);
+    decomp.singular = false;
+    decomp.rank = Cols;
+
+    for (int k = 0; k < Cols; ++k)
+    {
+        decomp.P.idx[k] = k;
+
+        HouseholderStep(A, decomp.tau[k], k);
+
+        if (A(k, k) == 0.0)
+        {
+            decomp.singular = true;
+        }
+    }
+
+    return decomp;
+}
+
+// QR with column pivoting. At each step the column with the largest remaining norm is moved to the front so that the
+// diagonal of R decreases in magnitude and A * P = Q * R. The rank is the number of diagonal elements of R larger than
+// tolerance * |R(0, 0)|.
+template <typename ParentType, int Rows, int Cols>
+QRDecomposition<ParentType> PivotedQRDecompose(MatrixBase<ParentType, Rows, Cols, typename ParentType::DType> &A,
+                                               const typename ParentType::DType tolerance = 1e-5)
+{
+    QRDecomposition<ParentType> decomp(A);
+    auto &idx = decomp.P.idx;
+
+    // Squared norms of the part of each column that is yet to be reduced and a reference value used to detect when
+    // downdating them has lost too much precision
+    typename ParentType::DType col_norm[Cols], ref_norm[Cols];
+
+    for (int j = 0; j < Cols; ++j)
+    {
+        idx[j] = j;
+        col_norm[j] = 0.0;
+
+        for (int i = 0; i < Rows; ++i)
+        {
+            col_norm[j] += A(i, j) * A(i, j);
+        }
+
+        ref_norm[j] = col_norm[j];
+    }
+
+    for (int k = 0; k < Cols; ++k)
+    {
+        int argmax = k;
+
+        for (int j = k + 1; j < Cols; ++j)
+        {
+            if (col_norm[j] > col_norm[argmax])
+            {
+                argmax = j;
+            }
+        }
+
+        if (argmax != k)
+        {
+            for (int i = 0; i < Rows; ++i)
+            {
+                bla_swap(A(i, k), A(i, argmax));
+            }
+
+            bla_swap(idx[k], idx[argmax]);
+            bla_swap(col_norm[k], col_norm[argmax]);
+            bla_swap(ref_norm[k], ref_norm[argmax]);
+        }
+
+        HouseholderStep(A, decomp.tau[k], k);
+
+        for (int j = k + 1; j < Cols; ++j)
+        {
+            col_norm[j] -= A(k, j) * A(k, j);
+
+            if (col_norm[j] <= ref_norm[j] * 1e-3)
+            {
+                // Most of the norm has cancelled out so recompute it from what's left of the column
+                col_norm[j] = 0.0;
+
+                for (int i = k + 1; i < Rows; ++i)
+                {
+                    col_norm[j] += A(i, j) * A(i, j);
+                }
+
+                ref_norm[j] = col_norm[j];
+            }
+        }
+    }
+
+    decomp.rank = 0;
+
+    while (decomp.rank < Cols && fabs(A(decomp.rank, decomp.rank)) > tolerance * fabs(A(0, 0)))
+    {
+        ++decomp.rank;
+    }
+
+    decomp.singular = decomp.rank < Cols;
+    return decomp;
+}
+
+// Returns the least squares solution of A * x = b. When the decomposition is pivoted and rank deficient, only the
+// first rank columns of A * P are used and the other elements of x are set to zero.
+template <class QRType, class BType>
+Matrix<QRType::Cols, 1, typename BType::DType> QRSolve(
+    const QRDecomposition<QRType> &decomp, const MatrixBase<BType, QRType::Rows, 1, typename BType::DType> &b)
+{
+    constexpr int Rows = QRType::Rows;
+    Matrix<Rows, 1, typename BType::DType> y = b;
+    Matrix<QRType::Cols, 1, typename BType::DType> x = Zeros<QRType::Cols, 1, typename BType::DType>();
+
+    auto &idx = decomp.P.idx;
+    auto &QR = decomp.R.parent;
+
+    // Apply Q^T = H(n-1) * ... * H(0) to b
+    for (int k = 0; k < decomp.rank; ++k)
+    {
+        if (decomp.tau[k] == 0.0)
+        {
+            continue;
+        }
+
+        typename BType::DType w = y(k);
+
+        for (int i = k + 1; i < Rows; ++i)
+        {
+            w += QR(i, k) * y(i);
+        }
+
+        w *= decomp.tau[k];
+        y(k) -= w;
+
+        for (int i = k + 1; i < Rows; ++i)
+        {
+            y(i) -= w * QR(i, k);
+        }
+    }
+
+    // Backward substitution to solve R * z = Q^T * b then undo the permutation
+    for (int i = decomp.rank - 1; i >= 0; --i)
+    {
+        typename BType::DType sum = y(i);
+
+        for (int j = i + 1; j < decomp.rank; ++j)
+        {
+            sum -= QR(i, j) * y(j);
+        }
+
+        y(i) = sum / QR(i, i);
+    }
+
+    for (int i = 0; i < decomp.rank; ++i)
+    {
+        x(idx[i]) = y(i);
     }
 
     return x;
 }
 
+// Accumulates the Householder reflections into the full orthogonal matrix Q such that A * P = Q * R
+template <class QRType>
+Matrix<QRType::Rows, QRType::Rows, typename QRType::DType> QRFormQ(const QRDecomposition<QRType> &decomp)
+{
+    constexpr int Rows = QRType::Rows;
+    Matrix<Rows, Rows, typename QRType::DType> Q = Eye<Rows, Rows, typename QRType::DType>();
+    auto &QR = decomp.R.parent;
+
+    // Q = H(0) * ... * H(n-1) * I, applied from the right-most reflection so each one only touches the rows below it
+    for (int k = QRType::Cols - 1; k >= 0; --k)
+    {
+        if (decomp.tau[k] == 0.0)
+        {
+            continue;
+        }
+
+        for (int j = k; j < Rows; ++j)
+        {
+            typename QRType::DType w = Q(k, j);
+
+            for (int i = k + 1; i < Rows; ++i)
+            {
+                w += QR(i, k) * Q(i, j);
+            }
+
+            w *= decomp.tau[k];
+            Q(k, j) -= w;
+
+            for (int i = k + 1; i < Rows; ++i)
+            {
+                Q(i, j) -= w * QR(i, k);
+            }
+        }
+    }
+
+    return Q;
+}
+
 template <int Dim, typename InType, typename OutType, typename DType>
 bool Invert(const MatrixBase<InType, Dim, Dim, DType> &A, MatrixBase<OutType, Dim, Dim, DType> &out)
 {
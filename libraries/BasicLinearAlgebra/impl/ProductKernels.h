@@ -0,0 +1,572 @@
+#pragma once
+
+// Rows in the products this library is used for are rarely wider than 12 elements, so 128 bit vectors are used even
+// where AVX is available
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BLA_SIMD_SSE
+#endif
+
+// Products whose dimensions are all no bigger than this are fully unrolled. On AVR every float operation is a library
+// call so unrolling doesn't buy much and costs a lot of flash, so it's off by default there.
+#ifndef BLA_UNROLL_LIMIT
+#ifdef __AVR__
+#define BLA_UNROLL_LIMIT 0
+#else
+#define BLA_UNROLL_LIMIT 6
+#endif
+#endif
+
+namespace BLA
+{
+
+template <int Rows, int Cols, typename DType>
+class Matrix;
+
+template <typename RefType>
+class MatrixTranspose;
+
+template <int Dim, typename DType>
+class DiagonalMatrix;
+
+template <int Dim, typename DType>
+class PackedLowerTriangularMatrix;
+
+template <int Dim, typename DType>
+class PackedUpperTriangularMatrix;
+
+template <int Rows, int Cols, typename DType, int MaxNonZeros>
+struct CompressedSparseRowMatrix;
+
+// The type the terms of a product are summed in. Element types that lose precision with every operation, like the
+// fixed point types in FixedPoint.h, specialise this to add the terms up in a wider type and round once at the end.
+template <typename DType>
+struct ProductAccumulator
+{
+    using Type = DType;
+    constexpr static bool Wide = false;
+
+    static Type Widen(DType a) { return a; }
+    static Type Multiply(DType a, DType b) { return a * b; }
+    static DType Round(Type sum) { return sum; }
+};
+
+// These kernels work out one row of a matrix product at a time: row = l.Row(i) * r
+
+// row[j] = a * r(k, j) for every j < J
+template <int J>
+struct UnrolledScale
+{
+    template <typename RType, typename DType, int N>
+    static void Apply(DType a, const RType &r, int k, DType (&row)[N])
+    {
+        UnrolledScale<J - 1>::Apply(a, r, k, row);
+        row[J - 1] = a * r(k, J - 1);
+    }
+};
+
+template <>
+struct UnrolledScale<0>
+{
+    template <typename RType, typename DType, int N>
+    static void Apply(DType, const RType &, int, DType (&)[N])
+    {
+    }
+};
+
+// row[j] += a * r(k, j) for every j < J
+template <int J>
+struct UnrolledAxpy
+{
+    template <typename RType, typename DType, int N>
+    static void Apply(DType a, const RType &r, int k, DType (&row)[N])
+    {
+        UnrolledAxpy<J - 1>::Apply(a, r, k, row);
+        row[J - 1] += a * r(k, J - 1);
+    }
+};
+
+template <>
+struct UnrolledAxpy<0>
+{
+    template <typename RType, typename DType, int N>
+    static void Apply(DType, const RType &, int, DType (&)[N])
+    {
+    }
+};
+
+// Sums the first K terms of row i of the product
+template <int K>
+struct UnrolledRowProduct
+{
+    template <typename LType, typename RType, typename DType, int N>
+    static void Apply(const LType &l, const RType &r, int i, DType (&row)[N])
+    {
+        UnrolledRowProduct<K - 1>::Apply(l, r, i, row);
+        UnrolledAxpy<N>::Apply(l(i, K - 1), r, K - 1, row);
+    }
+};
+
+template <>
+struct UnrolledRowProduct<1>
+{
+    template <typename LType, typename RType, typename DType, int N>
+    static void Apply(const LType &l, const RType &r, int i, DType (&row)[N])
+    {
+        UnrolledScale<N>::Apply(l(i, 0), r, 0, row);
+    }
+};
+
+template <int MatARows, int MatACols, int MatBCols,
+          bool Unroll = (MatARows <= BLA_UNROLL_LIMIT && MatACols <= BLA_UNROLL_LIMIT && MatBCols <= BLA_UNROLL_LIMIT)>
+struct ProductKernel
+{
+    template <typename LType, typename RType, typename DType>
+    static void Row(const LType &l, const RType &r, int i, DType (&row)[MatBCols])
+    {
+        for (int j = 0; j < MatBCols; ++j)
+        {
+            row[j] = l(i, 0) * r(0, j);
+        }
+
+        for (int k = 1; k < MatACols; ++k)
+        {
+            for (int j = 0; j < MatBCols; ++j)
+            {
+                row[j] += l(i, k) * r(k, j);
+            }
+        }
+    }
+};
+
+template <int MatARows, int MatACols, int MatBCols>
+struct ProductKernel<MatARows, MatACols, MatBCols, true>
+{
+    template <typename LType, typename RType, typename DType>
+    static void Row(const LType &l, const RType &r, int i, DType (&row)[MatBCols])
+    {
+        UnrolledRowProduct<MatACols>::Apply(l, r, i, row);
+    }
+};
+
+// The same as ProductKernel but the row is added up in the accumulator type
+template <int MatACols, typename LType, typename RType, typename DType, int MatBCols>
+void WideProductRow(const LType &l, const RType &r, int i, DType (&row)[MatBCols])
+{
+    using Acc = ProductAccumulator<DType>;
+    typename Acc::Type acc[MatBCols];
+
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        acc[j] = Acc::Multiply(l(i, 0), r(0, j));
+    }
+
+    for (int k = 1; k < MatACols; ++k)
+    {
+        for (int j = 0; j < MatBCols; ++j)
+        {
+            acc[j] += Acc::Multiply(l(i, k), r(k, j));
+        }
+    }
+
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        row[j] = Acc::Round(acc[j]);
+    }
+}
+
+// ProductRow picks a kernel based on the type of the left hand operand. If there isn't one for it, RightProductRow picks
+// one based on the right hand operand.
+template <int MatARows, typename LType, typename RType, typename DType, int MatBCols>
+void RightProductRow(const LType &l, const RType &r, int i, DType (&row)[MatBCols])
+{
+    if (ProductAccumulator<DType>::Wide)
+    {
+        WideProductRow<RType::Rows>(l, r, i, row);
+    }
+    else
+    {
+        ProductKernel<MatARows, RType::Rows, MatBCols>::Row(l, r, i, row);
+    }
+}
+
+// Element (i, j) of a product on its own. Like the rows, ProductElement picks a way to work it out based on the left
+// hand operand and RightProductElement based on the right.
+template <typename LType, typename RType>
+typename LType::DType RightProductElement(const LType &l, const RType &r, int i, int j)
+{
+    using Acc = ProductAccumulator<typename LType::DType>;
+    typename Acc::Type sum = Acc::Multiply(l(i, 0), r(0, j));
+
+    for (int k = 1; k < LType::Cols; ++k)
+    {
+        sum += Acc::Multiply(l(i, k), r(k, j));
+    }
+
+    return Acc::Round(sum);
+}
+
+// Products with diagonal and triangular operands skip the terms that are known to be zero. A diagonal operand takes
+// the product from Dim^3 multiplies down to Dim^2 and a triangular one roughly halves it.
+template <int MatARows, int Dim, typename DType, typename RType, int MatBCols>
+void ProductRow(const DiagonalMatrix<Dim, DType> &l, const RType &r, int i, DType (&row)[MatBCols])
+{
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        row[j] = l.storage[i] * r(i, j);
+    }
+}
+
+template <int MatARows, int Dim, typename DType, typename RType, int MatBCols>
+void ProductRow(const PackedLowerTriangularMatrix<Dim, DType> &l, const RType &r, int i, DType (&row)[MatBCols])
+{
+    using Acc = ProductAccumulator<DType>;
+    typename Acc::Type acc[MatBCols];
+
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        acc[j] = Acc::Multiply(l(i, 0), r(0, j));
+    }
+
+    for (int k = 1; k <= i; ++k)
+    {
+        for (int j = 0; j < MatBCols; ++j)
+        {
+            acc[j] += Acc::Multiply(l(i, k), r(k, j));
+        }
+    }
+
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        row[j] = Acc::Round(acc[j]);
+    }
+}
+
+template <int MatARows, int Dim, typename DType, typename RType, int MatBCols>
+void ProductRow(const PackedUpperTriangularMatrix<Dim, DType> &l, const RType &r, int i, DType (&row)[MatBCols])
+{
+    using Acc = ProductAccumulator<DType>;
+    typename Acc::Type acc[MatBCols];
+
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        acc[j] = Acc::Multiply(l(i, i), r(i, j));
+    }
+
+    for (int k = i + 1; k < Dim; ++k)
+    {
+        for (int j = 0; j < MatBCols; ++j)
+        {
+            acc[j] += Acc::Multiply(l(i, k), r(k, j));
+        }
+    }
+
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        row[j] = Acc::Round(acc[j]);
+    }
+}
+
+template <int MatARows, typename LType, int Dim, typename DType>
+void RightProductRow(const LType &l, const DiagonalMatrix<Dim, DType> &r, int i, DType (&row)[Dim])
+{
+    for (int j = 0; j < Dim; ++j)
+    {
+        row[j] = l(i, j) * r.storage[j];
+    }
+}
+
+template <int MatARows, typename LType, int Dim, typename DType>
+void RightProductRow(const LType &l, const PackedLowerTriangularMatrix<Dim, DType> &r, int i, DType (&row)[Dim])
+{
+    using Acc = ProductAccumulator<DType>;
+
+    for (int j = 0; j < Dim; ++j)
+    {
+        typename Acc::Type sum = Acc::Multiply(l(i, j), r(j, j));
+
+        for (int k = j + 1; k < Dim; ++k)
+        {
+            sum += Acc::Multiply(l(i, k), r(k, j));
+        }
+
+        row[j] = Acc::Round(sum);
+    }
+}
+
+template <int MatARows, typename LType, int Dim, typename DType>
+void RightProductRow(const LType &l, const PackedUpperTriangularMatrix<Dim, DType> &r, int i, DType (&row)[Dim])
+{
+    using Acc = ProductAccumulator<DType>;
+
+    for (int j = 0; j < Dim; ++j)
+    {
+        typename Acc::Type sum = Acc::Multiply(l(i, 0), r(0, j));
+
+        for (int k = 1; k <= j; ++k)
+        {
+            sum += Acc::Multiply(l(i, k), r(k, j));
+        }
+
+        row[j] = Acc::Round(sum);
+    }
+}
+
+// Sparse operands only contribute their nonzeros. A compressed sparse row matrix on the left picks out rows of the right
+// hand operand, on the right its rows are spread over the row of the product and transposed on the right each of its
+// rows is dotted with the row of the left hand operand.
+template <int MatARows, int Rows, int Cols, typename DType, int MaxNonZeros, typename RType, int MatBCols>
+void ProductRow(const CompressedSparseRowMatrix<Rows, Cols, DType, MaxNonZeros> &l, const RType &r, int i,
+                DType (&row)[MatBCols])
+{
+    using Acc = ProductAccumulator<DType>;
+    typename Acc::Type acc[MatBCols];
+
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        acc[j] = 0;
+    }
+
+    for (int n = l.row_start[i]; n < l.row_start[i + 1]; ++n)
+    {
+        for (int j = 0; j < MatBCols; ++j)
+        {
+            acc[j] += Acc::Multiply(l.val[n], r(l.col[n], j));
+        }
+    }
+
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        row[j] = Acc::Round(acc[j]);
+    }
+}
+
+template <int MatARows, typename LType, int Rows, int Cols, typename DType, int MaxNonZeros>
+void RightProductRow(const LType &l, const CompressedSparseRowMatrix<Rows, Cols, DType, MaxNonZeros> &r, int i,
+                     DType (&row)[Cols])
+{
+    using Acc = ProductAccumulator<DType>;
+    typename Acc::Type acc[Cols];
+
+    for (int j = 0; j < Cols; ++j)
+    {
+        acc[j] = 0;
+    }
+
+    for (int k = 0; k < Rows; ++k)
+    {
+        DType a = l(i, k);
+
+        for (int n = r.row_start[k]; n < r.row_start[k + 1]; ++n)
+        {
+            acc[r.col[n]] += Acc::Multiply(a, r.val[n]);
+        }
+    }
+
+    for (int j = 0; j < Cols; ++j)
+    {
+        row[j] = Acc::Round(acc[j]);
+    }
+}
+
+template <typename LType, int Rows, int Cols, typename DType, int MaxNonZeros>
+DType SparseRowDot(const LType &l, const CompressedSparseRowMatrix<Rows, Cols, DType, MaxNonZeros> &s, int i, int j)
+{
+    using Acc = ProductAccumulator<DType>;
+    typename Acc::Type sum = 0;
+
+    for (int n = s.row_start[j]; n < s.row_start[j + 1]; ++n)
+    {
+        sum += Acc::Multiply(l(i, s.col[n]), s.val[n]);
+    }
+
+    return Acc::Round(sum);
+}
+
+template <int MatARows, typename LType, int Rows, int Cols, typename DType, int MaxNonZeros>
+void RightProductRow(const LType &l, const MatrixTranspose<CompressedSparseRowMatrix<Rows, Cols, DType, MaxNonZeros>> &r,
+                     int i, DType (&row)[Rows])
+{
+    for (int j = 0; j < Rows; ++j)
+    {
+        row[j] = SparseRowDot(l, r.Parent(), i, j);
+    }
+}
+
+template <int MatARows, typename LType, int Rows, int Cols, typename DType, int MaxNonZeros>
+void RightProductRow(const LType &l,
+                     const MatrixTranspose<const CompressedSparseRowMatrix<Rows, Cols, DType, MaxNonZeros>> &r, int i,
+                     DType (&row)[Rows])
+{
+    for (int j = 0; j < Rows; ++j)
+    {
+        row[j] = SparseRowDot(l, r.Parent(), i, j);
+    }
+}
+
+template <int Rows, int Cols, typename DType, int MaxNonZeros, typename RType>
+DType ProductElement(const CompressedSparseRowMatrix<Rows, Cols, DType, MaxNonZeros> &l, const RType &r, int i, int j)
+{
+    using Acc = ProductAccumulator<DType>;
+    typename Acc::Type sum = 0;
+
+    for (int n = l.row_start[i]; n < l.row_start[i + 1]; ++n)
+    {
+        sum += Acc::Multiply(l.val[n], r(l.col[n], j));
+    }
+
+    return Acc::Round(sum);
+}
+
+template <typename LType, int Rows, int Cols, typename DType, int MaxNonZeros>
+DType RightProductElement(const LType &l,
+                          const MatrixTranspose<CompressedSparseRowMatrix<Rows, Cols, DType, MaxNonZeros>> &r, int i,
+                          int j)
+{
+    return SparseRowDot(l, r.Parent(), i, j);
+}
+
+template <typename LType, int Rows, int Cols, typename DType, int MaxNonZeros>
+DType RightProductElement(const LType &l,
+                          const MatrixTranspose<const CompressedSparseRowMatrix<Rows, Cols, DType, MaxNonZeros>> &r,
+                          int i, int j)
+{
+    return SparseRowDot(l, r.Parent(), i, j);
+}
+
+#ifdef BLA_SIMD_SSE
+
+// When the right hand operand is a float Matrix its rows are contiguous, so several columns of the result can be worked
+// out at once. The multiplies and adds happen in the same order as the scalar kernel so the results are identical.
+template <int MatARows, typename LType, int MatACols, int MatBCols>
+void RightProductRow(const LType &l, const Matrix<MatACols, MatBCols, float> &r, int i, float (&row)[MatBCols])
+{
+    // Rows narrower than a vector are better off unrolled
+    if (MatBCols < 4)
+    {
+        ProductKernel<MatARows, MatACols, MatBCols>::Row(l, r, i, row);
+        return;
+    }
+
+    // The row is kept in registers as a few vectors plus a few leftover scalars while the terms are added up
+    const int Vectors = MatBCols / 4;
+    const int Leftovers = MatBCols % 4;
+
+    __m128 acc[Vectors > 0 ? Vectors : 1];
+    float leftover[Leftovers + 1];
+
+    const float *r_row = r.storage;
+    float a = l(i, 0);
+
+    for (int v = 0; v < Vectors; ++v)
+    {
+        acc[v] = _mm_mul_ps(_mm_set1_ps(a), _mm_loadu_ps(r_row + 4 * v));
+    }
+
+    for (int j = 0; j < Leftovers; ++j)
+    {
+        leftover[j] = a * r_row[4 * Vectors + j];
+    }
+
+    for (int k = 1; k < MatACols; ++k)
+    {
+        r_row += MatBCols;
+        a = l(i, k);
+
+        for (int v = 0; v < Vectors; ++v)
+        {
+            acc[v] = _mm_add_ps(acc[v], _mm_mul_ps(_mm_set1_ps(a), _mm_loadu_ps(r_row + 4 * v)));
+        }
+
+        for (int j = 0; j < Leftovers; ++j)
+        {
+            leftover[j] += a * r_row[4 * Vectors + j];
+        }
+    }
+
+    for (int v = 0; v < Vectors; ++v)
+    {
+        _mm_storeu_ps(row + 4 * v, acc[v]);
+    }
+
+    for (int j = 0; j < Leftovers; ++j)
+    {
+        row[4 * Vectors + j] = leftover[j];
+    }
+}
+
+// When the right hand operand is a transposed float Matrix each element of the row is the dot product of row i of l with
+// one of the rows of the matrix that was transposed, so those can be vectorised instead. The terms are added up in a
+// different order to the scalar kernel so the results can differ in the last few bits.
+template <int MatARows, typename LType, int MatBCols, int MatACols>
+void TransposedProductRow(const LType &l, const Matrix<MatBCols, MatACols, float> &b, int i, float (&row)[MatBCols])
+{
+    // Dot products shorter than a vector aren't worth it. Unrolling doesn't help either since the compiler tends to copy
+    // the scalars out of the row in pairs, which stalls waiting for them to be written.
+    if (MatACols < 4)
+    {
+        ProductKernel<MatARows, MatACols, MatBCols, false>::Row(l, ~b, i, row);
+        return;
+    }
+
+    float l_row[MatACols];
+
+    for (int k = 0; k < MatACols; ++k)
+    {
+        l_row[k] = l(i, k);
+    }
+
+    for (int j = 0; j < MatBCols; ++j)
+    {
+        const float *b_row = b.storage + j * MatACols;
+        int k = 4;
+        float sum;
+
+        __m128 acc = _mm_mul_ps(_mm_loadu_ps(l_row), _mm_loadu_ps(b_row));
+
+        for (; k + 4 <= MatACols; k += 4)
+        {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(l_row + k), _mm_loadu_ps(b_row + k)));
+        }
+
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        sum = _mm_cvtss_f32(_mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1)));
+
+        for (; k < MatACols; ++k)
+        {
+            sum += l_row[k] * b_row[k];
+        }
+
+        row[j] = sum;
+    }
+}
+
+template <int MatARows, typename LType, int MatBCols, int MatACols>
+void RightProductRow(const LType &l, const MatrixTranspose<Matrix<MatBCols, MatACols, float>> &r, int i,
+                float (&row)[MatBCols])
+{
+    TransposedProductRow<MatARows>(l, r.Parent(), i, row);
+}
+
+template <int MatARows, typename LType, int MatBCols, int MatACols>
+void RightProductRow(const LType &l, const MatrixTranspose<const Matrix<MatBCols, MatACols, float>> &r, int i,
+                float (&row)[MatBCols])
+{
+    TransposedProductRow<MatARows>(l, r.Parent(), i, row);
+}
+
+#endif
+
+template <int MatARows, typename LType, typename RType, typename DType, int MatBCols>
+void ProductRow(const LType &l, const RType &r, int i, DType (&row)[MatBCols])
+{
+    RightProductRow<MatARows>(l, r, i, row);
+}
+
+template <typename LType, typename RType>
+typename LType::DType ProductElement(const LType &l, const RType &r, int i, int j)
+{
+    return RightProductElement(l, r, i, j);
+}
+
+}  // namespace BLA
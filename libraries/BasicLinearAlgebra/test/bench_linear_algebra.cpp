@@ -0,0 +1,367 @@
+#include <benchmark/benchmark.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <functional>
+
+#include "../BasicLinearAlgebra.h"
+
+using namespace BLA;
+
+template <int Rows, int Cols>
+void FillLeastSquares(Matrix<Rows, Cols> &A, Matrix<Rows> &b)
+{
+    for (int i = 0; i < Rows; ++i)
+    {
+        for (int j = 0; j < Cols; ++j)
+        {
+            A(i, j) = float((i * 7 + j * 13) % 17) / 17.0f + (i == j);
+        }
+
+        b(i) = float(i % 5);
+    }
+}
+
+// x = (A^T * A)^-1 * A^T * b, the way calibration fits were previously done
+template <int Rows, int Cols>
+void BM_NormalEquationsInverse(benchmark::State &state)
+{
+    Matrix<Rows, Cols> A;
+    Matrix<Rows> b;
+    FillLeastSquares(A, b);
+
+    for (auto _ : state)
+    {
+        Matrix<Cols> x = Inverse(~A * A) * (~A * b);
+        benchmark::DoNotOptimize(x);
+    }
+}
+
+template <int Rows, int Cols>
+void BM_NormalEquationsCholesky(benchmark::State &state)
+{
+    Matrix<Rows, Cols> A;
+    Matrix<Rows> b;
+    FillLeastSquares(A, b);
+
+    for (auto _ : state)
+    {
+        Matrix<Cols, Cols> AtA = ~A * A;
+        auto chol = CholeskyDecompose(AtA);
+        Matrix<Cols> x = CholeskySolve(chol, ~A * b);
+        benchmark::DoNotOptimize(x);
+    }
+}
+
+template <int Rows, int Cols>
+void BM_QRSolve(benchmark::State &state)
+{
+    Matrix<Rows, Cols> A;
+    Matrix<Rows> b;
+    FillLeastSquares(A, b);
+
+    for (auto _ : state)
+    {
+        Matrix<Rows, Cols> QR = A;
+        auto qr = QRDecompose(QR);
+        Matrix<Cols> x = QRSolve(qr, b);
+        benchmark::DoNotOptimize(x);
+    }
+}
+
+template <int Rows, int Cols>
+void BM_PivotedQRSolve(benchmark::State &state)
+{
+    Matrix<Rows, Cols> A;
+    Matrix<Rows> b;
+    FillLeastSquares(A, b);
+
+    for (auto _ : state)
+    {
+        Matrix<Rows, Cols> QR = A;
+        auto qr = PivotedQRDecompose(QR);
+        Matrix<Cols> x = QRSolve(qr, b);
+        benchmark::DoNotOptimize(x);
+    }
+}
+
+// Straight line (LM35 linearisation), quintic and a 9 parameter ellipsoid fit
+BENCHMARK_TEMPLATE(BM_NormalEquationsInverse, 20, 2);
+BENCHMARK_TEMPLATE(BM_NormalEquationsCholesky, 20, 2);
+BENCHMARK_TEMPLATE(BM_QRSolve, 20, 2);
+BENCHMARK_TEMPLATE(BM_PivotedQRSolve, 20, 2);
+
+BENCHMARK_TEMPLATE(BM_NormalEquationsInverse, 20, 6);
+BENCHMARK_TEMPLATE(BM_NormalEquationsCholesky, 20, 6);
+BENCHMARK_TEMPLATE(BM_QRSolve, 20, 6);
+BENCHMARK_TEMPLATE(BM_PivotedQRSolve, 20, 6);
+
+BENCHMARK_TEMPLATE(BM_NormalEquationsInverse, 50, 9);
+BENCHMARK_TEMPLATE(BM_NormalEquationsCholesky, 50, 9);
+BENCHMARK_TEMPLATE(BM_QRSolve, 50, 9);
+BENCHMARK_TEMPLATE(BM_PivotedQRSolve, 50, 9);
+
+// Runs func on a thread whose stack is a buffer painted with a pattern, then counts how much of the buffer has been
+// overwritten from the top. The count for an empty function, which is what starting the thread itself takes, is taken
+// off so that only the stack of func is left.
+void *RunStackProbe(void *func)
+{
+    (*static_cast<std::function<void()> *>(func))();
+    return nullptr;
+}
+
+size_t PaintedStackUse(std::function<void()> func)
+{
+    const size_t size = 1 << 18;
+    void *stack = nullptr;
+
+    if (posix_memalign(&stack, 4096, size) != 0)
+    {
+        return 0;
+    }
+
+    memset(stack, 0xA5, size);
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, size);
+    bool ran = pthread_create(&thread, &attr, RunStackProbe, &func) == 0 && pthread_join(thread, nullptr) == 0;
+    pthread_attr_destroy(&attr);
+
+    // The stack grows down, so the bytes still painted are at the bottom of the buffer
+    size_t untouched = 0;
+    const unsigned char *bytes = static_cast<const unsigned char *>(stack);
+
+    while (untouched < size && bytes[untouched] == 0xA5)
+    {
+        ++untouched;
+    }
+
+    free(stack);
+    return ran ? size - untouched : 0;
+}
+
+template <typename Func>
+size_t StackUsage(Func func)
+{
+    size_t used = PaintedStackUse(func);
+    size_t overhead = PaintedStackUse([] {});
+    return used > overhead ? used - overhead : 0;
+}
+
+template <int Dim>
+struct CovariancePredict
+{
+    // F is stable so P settles rather than growing without bound as the benchmark repeats the prediction
+    Matrix<Dim, Dim> F, P, Q;
+
+    CovariancePredict()
+    {
+        for (int i = 0; i < Dim; ++i)
+        {
+            for (int j = 0; j < Dim; ++j)
+            {
+                F(i, j) = (i == j) * 0.9f + (j == i + 1) * 0.1f;
+                P(i, j) = 1.0f / (1 + i + j);
+                Q(i, j) = (i == j) * 0.01f;
+            }
+        }
+    }
+
+    // What F * P * ~F + Q used to cost: a Matrix for the result of every operator then a copy into P
+    __attribute__((noinline)) void Temporaries()
+    {
+        Matrix<Dim, Dim> FP = F * P;
+        Matrix<Dim, Dim> FPFt = FP * ~F;
+        Matrix<Dim, Dim> sum = FPFt + Q;
+        P = sum;
+        benchmark::DoNotOptimize(P);
+    }
+
+    __attribute__((noinline)) void Expression()
+    {
+        P = F * P * ~F + Q;
+        benchmark::DoNotOptimize(P);
+    }
+};
+
+template <int Dim>
+void BM_CovarianceTemporaries(benchmark::State &state)
+{
+    CovariancePredict<Dim> kf;
+    state.counters["stack_bytes"] = StackUsage([&] { kf.Temporaries(); });
+
+    for (auto _ : state)
+    {
+        kf.Temporaries();
+    }
+}
+
+template <int Dim>
+void BM_CovarianceExpression(benchmark::State &state)
+{
+    CovariancePredict<Dim> kf;
+    state.counters["stack_bytes"] = StackUsage([&] { kf.Expression(); });
+
+    for (auto _ : state)
+    {
+        kf.Expression();
+    }
+}
+
+// The same prediction with P and Q stored as symmetric matrices, which only works out the lower triangle of the result
+template <int Dim>
+struct SymmetricCovariancePredict
+{
+    Matrix<Dim, Dim> F;
+    SymmetricMatrix<Dim> P, Q;
+
+    SymmetricCovariancePredict()
+    {
+        CovariancePredict<Dim> full;
+        F = full.F;
+        P = full.P;
+        Q = full.Q;
+    }
+
+    __attribute__((noinline)) void Expression()
+    {
+        P = F * P * ~F + Q;
+        benchmark::DoNotOptimize(P);
+    }
+};
+
+template <int Dim>
+void BM_CovarianceSymmetric(benchmark::State &state)
+{
+    SymmetricCovariancePredict<Dim> kf;
+    state.counters["stack_bytes"] = StackUsage([&] { kf.Expression(); });
+    state.counters["P_bytes"] = sizeof(kf.P);
+
+    for (auto _ : state)
+    {
+        kf.Expression();
+    }
+}
+
+// P = F * P * ~F + Q for the state sizes used by the filters
+BENCHMARK_TEMPLATE(BM_CovarianceTemporaries, 3);
+BENCHMARK_TEMPLATE(BM_CovarianceExpression, 3);
+BENCHMARK_TEMPLATE(BM_CovarianceSymmetric, 3);
+BENCHMARK_TEMPLATE(BM_CovarianceTemporaries, 6);
+BENCHMARK_TEMPLATE(BM_CovarianceExpression, 6);
+BENCHMARK_TEMPLATE(BM_CovarianceSymmetric, 6);
+BENCHMARK_TEMPLATE(BM_CovarianceTemporaries, 9);
+BENCHMARK_TEMPLATE(BM_CovarianceExpression, 9);
+BENCHMARK_TEMPLATE(BM_CovarianceSymmetric, 9);
+
+// An observation matrix for several sensors that each see two of the states
+template <int Rows, int Cols, typename MatType>
+void FillObservation(MatType &H)
+{
+    for (int i = 0; i < Rows; ++i)
+    {
+        H(i, (i * 5) % Cols) = 1.0f;
+        H(i, (i * 5 + 3) % Cols) = -0.5f;
+    }
+}
+
+template <int Rows, int Cols>
+void BM_ObserveHashSparse(benchmark::State &state)
+{
+    SparseMatrix<Rows, Cols, float, 4 * Rows> H;
+    FillObservation<Rows, Cols>(H);
+    Matrix<Cols> x;
+    x.Fill(0.5f);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(x);
+        Matrix<Rows> z = H * x;
+        benchmark::DoNotOptimize(z);
+    }
+}
+
+template <int Rows, int Cols>
+void BM_ObserveDense(benchmark::State &state)
+{
+    Matrix<Rows, Cols> H;
+    H.Fill(0.0f);
+    FillObservation<Rows, Cols>(H);
+    Matrix<Cols> x;
+    x.Fill(0.5f);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(x);
+        Matrix<Rows> z = H * x;
+        benchmark::DoNotOptimize(z);
+    }
+}
+
+template <int Rows, int Cols>
+void BM_ObserveCompressedSparse(benchmark::State &state)
+{
+    SparseMatrix<Rows, Cols, float, 4 * Rows> H_table;
+    FillObservation<Rows, Cols>(H_table);
+    CompressedSparseRowMatrix<Rows, Cols, float, 4 * Rows> H = H_table;
+    Matrix<Cols> x;
+    x.Fill(0.5f);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(x);
+        Matrix<Rows> z = H * x;
+        benchmark::DoNotOptimize(z);
+    }
+}
+
+// The innovation covariance S = H * P * ~H + R
+template <int Rows, int Cols>
+void BM_InnovationDense(benchmark::State &state)
+{
+    Matrix<Rows, Cols> H;
+    H.Fill(0.0f);
+    FillObservation<Rows, Cols>(H);
+    Matrix<Cols, Cols> P;
+    P.Fill(0.01f);
+    Matrix<Rows, Rows> R;
+    R.Fill(0.1f);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(P);
+        Matrix<Rows, Rows> S = H * P * ~H + R;
+        benchmark::DoNotOptimize(S);
+    }
+}
+
+template <int Rows, int Cols>
+void BM_InnovationCompressedSparse(benchmark::State &state)
+{
+    Matrix<Rows, Cols> H_dense;
+    H_dense.Fill(0.0f);
+    FillObservation<Rows, Cols>(H_dense);
+    CompressedSparseRowMatrix<Rows, Cols, float, 2 * Rows> H = H_dense;
+    Matrix<Cols, Cols> P;
+    P.Fill(0.01f);
+    Matrix<Rows, Rows> R;
+    R.Fill(0.1f);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(P);
+        Matrix<Rows, Rows> S = H * P * ~H + R;
+        benchmark::DoNotOptimize(S);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_ObserveHashSparse, 12, 48);
+BENCHMARK_TEMPLATE(BM_ObserveDense, 12, 48);
+BENCHMARK_TEMPLATE(BM_ObserveCompressedSparse, 12, 48);
+BENCHMARK_TEMPLATE(BM_InnovationDense, 12, 48);
+BENCHMARK_TEMPLATE(BM_InnovationCompressedSparse, 12, 48);
+
+BENCHMARK_MAIN();
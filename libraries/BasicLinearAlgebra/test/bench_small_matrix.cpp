@@ -0,0 +1,393 @@
+#include <benchmark/benchmark.h>
+
+#define BLA_BATCH_THREADS
+
+#include "../BasicLinearAlgebra.h"
+
+using namespace BLA;
+
+template <int Dim>
+void FillWellConditioned(Matrix<Dim, Dim> &A, int seed)
+{
+    for (int i = 0; i < Dim; ++i)
+    {
+        for (int j = 0; j < Dim; ++j)
+        {
+            A(i, j) = float((i * 7 + j * 13 + seed) % 17) / 17.0f + (i == j) * Dim;
+        }
+    }
+}
+
+// The plain triple loop that every product used before the size specialised kernels
+template <int Dim>
+void GenericMultiply(const Matrix<Dim, Dim> &A, const Matrix<Dim, Dim> &B, Matrix<Dim, Dim> &C)
+{
+    float row[Dim];
+
+    for (int i = 0; i < Dim; ++i)
+    {
+        ProductKernel<Dim, Dim, Dim, false>::Row(A, B, i, row);
+
+        for (int j = 0; j < Dim; ++j)
+        {
+            C(i, j) = row[j];
+        }
+    }
+}
+
+template <int Dim>
+void BM_MultiplyGeneric(benchmark::State &state)
+{
+    Matrix<Dim, Dim> A, B, C;
+    FillWellConditioned(A, 0);
+    FillWellConditioned(B, 5);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(A);
+        GenericMultiply(A, B, C);
+        benchmark::DoNotOptimize(C);
+    }
+}
+
+template <int Dim>
+void BM_Multiply(benchmark::State &state)
+{
+    Matrix<Dim, Dim> A, B, C;
+    FillWellConditioned(A, 0);
+    FillWellConditioned(B, 5);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(A);
+        C = A * B;
+        benchmark::DoNotOptimize(C);
+    }
+}
+
+template <int Dim>
+void BM_TransposeMultiply(benchmark::State &state)
+{
+    Matrix<Dim, Dim> A, B, C;
+    FillWellConditioned(A, 0);
+    FillWellConditioned(B, 5);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(A);
+        C = ~A * B;
+        benchmark::DoNotOptimize(C);
+    }
+}
+
+template <int Dim>
+void BM_MultiplyTranspose(benchmark::State &state)
+{
+    Matrix<Dim, Dim> A, B, C;
+    FillWellConditioned(A, 0);
+    FillWellConditioned(B, 5);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(A);
+        C = A * ~B;
+        benchmark::DoNotOptimize(C);
+    }
+}
+
+template <int Dim>
+void BM_Invert(benchmark::State &state)
+{
+    Matrix<Dim, Dim> A, A_inv;
+    FillWellConditioned(A, 0);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(A);
+        Invert(A, A_inv);
+        benchmark::DoNotOptimize(A_inv);
+    }
+}
+
+// The same product in float and fixed point. Elements are kept small enough that the fixed point results don't saturate.
+template <int Dim, typename DType>
+void BM_MultiplyElements(benchmark::State &state)
+{
+    Matrix<Dim, Dim, DType> A, B, C;
+
+    for (int i = 0; i < Dim; ++i)
+    {
+        for (int j = 0; j < Dim; ++j)
+        {
+            A(i, j) = float((i * 7 + j * 13) % 17) / (17.0f * Dim);
+            B(i, j) = float((i * 7 + j * 13 + 5) % 17) / (17.0f * Dim);
+        }
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(A);
+        C = A * B;
+        benchmark::DoNotOptimize(C);
+    }
+}
+
+template <int Dim, typename DType>
+void BM_CholeskyElements(benchmark::State &state)
+{
+    Matrix<Dim, Dim, DType> A;
+
+    for (int i = 0; i < Dim; ++i)
+    {
+        for (int j = 0; j < Dim; ++j)
+        {
+            A(i, j) = (i == j) * 0.5f + 0.25f / (1 + i + j) / Dim;
+        }
+    }
+
+    for (auto _ : state)
+    {
+        Matrix<Dim, Dim, DType> L = A;
+        auto chol = CholeskyDecompose(L);
+        benchmark::DoNotOptimize(chol);
+        benchmark::DoNotOptimize(L);
+    }
+}
+
+// Thousands of independent small problems, one per device being calibrated, either as separate matrices or as a batch
+const int BatchSize = 4096;
+
+template <int Dim>
+struct CalibrationProblems
+{
+    Matrix<Dim, Dim> A[BatchSize], A_inv[BatchSize];
+    Matrix<Dim> b[BatchSize], x[BatchSize];
+    MatrixBatch<Dim, Dim, BatchSize> A_batch, LU_batch, A_inv_batch;
+    MatrixBatch<Dim, 1, BatchSize> b_batch, x_batch;
+    LUBatchDecomposition<Dim, BatchSize> lu;
+    CholeskyBatchDecomposition<BatchSize> chol;
+    bool singular[BatchSize];
+
+    CalibrationProblems()
+    {
+        for (int n = 0; n < BatchSize; ++n)
+        {
+            FillWellConditioned(A[n], n);
+            // Symmetric so the same problems can be used for Cholesky
+            A[n] = A[n] + ~A[n];
+            A_batch[n] = A[n];
+            b[n].Fill(float(n % 7));
+            b_batch[n] = b[n];
+        }
+    }
+
+    // These are big so there's only one of each size
+    static CalibrationProblems &Get()
+    {
+        static CalibrationProblems *problems = new CalibrationProblems;
+        return *problems;
+    }
+};
+
+template <int Dim>
+void BM_LoopMultiply(benchmark::State &state)
+{
+    auto &p = CalibrationProblems<Dim>::Get();
+
+    for (auto _ : state)
+    {
+        for (int n = 0; n < BatchSize; ++n)
+        {
+            p.A_inv[n] = p.A[n] * p.A[n];
+        }
+
+        benchmark::DoNotOptimize(p.A_inv);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+template <int Dim>
+void BM_BatchMultiply(benchmark::State &state)
+{
+    auto &p = CalibrationProblems<Dim>::Get();
+
+    for (auto _ : state)
+    {
+        Multiply(p.A_batch, p.A_batch, p.A_inv_batch);
+        benchmark::DoNotOptimize(p.A_inv_batch);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+template <int Dim>
+void BM_LoopInvert(benchmark::State &state)
+{
+    auto &p = CalibrationProblems<Dim>::Get();
+
+    for (auto _ : state)
+    {
+        for (int n = 0; n < BatchSize; ++n)
+        {
+            p.singular[n] = !Invert(p.A[n], p.A_inv[n]);
+        }
+
+        benchmark::DoNotOptimize(p.A_inv);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+template <int Dim>
+void BM_BatchInvert(benchmark::State &state)
+{
+    auto &p = CalibrationProblems<Dim>::Get();
+
+    for (auto _ : state)
+    {
+        Invert(p.A_batch, p.A_inv_batch, p.singular);
+        benchmark::DoNotOptimize(p.A_inv_batch);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+template <int Dim>
+void BM_BatchInvertThreaded(benchmark::State &state)
+{
+    auto &p = CalibrationProblems<Dim>::Get();
+
+    for (auto _ : state)
+    {
+        ParallelBatch<BatchSize>(4, [&](int begin, int end) { Invert(p.A_batch, p.A_inv_batch, p.singular, begin, end); });
+        benchmark::DoNotOptimize(p.A_inv_batch);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+template <int Dim>
+void BM_LoopLUSolve(benchmark::State &state)
+{
+    auto &p = CalibrationProblems<Dim>::Get();
+
+    for (auto _ : state)
+    {
+        for (int n = 0; n < BatchSize; ++n)
+        {
+            Matrix<Dim, Dim> LU = p.A[n];
+            auto decomp = LUDecompose(LU);
+            p.x[n] = LUSolve(decomp, p.b[n]);
+        }
+
+        benchmark::DoNotOptimize(p.x);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+template <int Dim>
+void BM_BatchLUSolve(benchmark::State &state)
+{
+    auto &p = CalibrationProblems<Dim>::Get();
+
+    for (auto _ : state)
+    {
+        p.LU_batch = p.A_batch;
+        LUDecompose(p.LU_batch, p.lu);
+        LUSolve(p.LU_batch, p.lu, p.b_batch, p.x_batch);
+        benchmark::DoNotOptimize(p.x_batch);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+template <int Dim>
+void BM_LoopCholeskySolve(benchmark::State &state)
+{
+    auto &p = CalibrationProblems<Dim>::Get();
+
+    for (auto _ : state)
+    {
+        for (int n = 0; n < BatchSize; ++n)
+        {
+            Matrix<Dim, Dim> L = p.A[n];
+            auto decomp = CholeskyDecompose(L);
+            p.x[n] = CholeskySolve(decomp, p.b[n]);
+        }
+
+        benchmark::DoNotOptimize(p.x);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+template <int Dim>
+void BM_BatchCholeskySolve(benchmark::State &state)
+{
+    auto &p = CalibrationProblems<Dim>::Get();
+
+    for (auto _ : state)
+    {
+        p.LU_batch = p.A_batch;
+        CholeskyDecompose(p.LU_batch, p.chol);
+        CholeskySolve(p.LU_batch, p.b_batch, p.x_batch);
+        benchmark::DoNotOptimize(p.x_batch);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+#define BENCHMARK_SMALL_SIZES(func)  \
+    BENCHMARK_TEMPLATE(func, 2);     \
+    BENCHMARK_TEMPLATE(func, 3);     \
+    BENCHMARK_TEMPLATE(func, 4);     \
+    BENCHMARK_TEMPLATE(func, 5);     \
+    BENCHMARK_TEMPLATE(func, 6);     \
+    BENCHMARK_TEMPLATE(func, 7);     \
+    BENCHMARK_TEMPLATE(func, 8);     \
+    BENCHMARK_TEMPLATE(func, 9);     \
+    BENCHMARK_TEMPLATE(func, 10);    \
+    BENCHMARK_TEMPLATE(func, 11);    \
+    BENCHMARK_TEMPLATE(func, 12)
+
+BENCHMARK_SMALL_SIZES(BM_MultiplyGeneric);
+BENCHMARK_SMALL_SIZES(BM_Multiply);
+BENCHMARK_SMALL_SIZES(BM_TransposeMultiply);
+BENCHMARK_SMALL_SIZES(BM_MultiplyTranspose);
+BENCHMARK_SMALL_SIZES(BM_Invert);
+
+BENCHMARK_TEMPLATE(BM_MultiplyElements, 3, float);
+BENCHMARK_TEMPLATE(BM_MultiplyElements, 3, Q15);
+BENCHMARK_TEMPLATE(BM_MultiplyElements, 3, Q31);
+BENCHMARK_TEMPLATE(BM_MultiplyElements, 6, float);
+BENCHMARK_TEMPLATE(BM_MultiplyElements, 6, Q15);
+BENCHMARK_TEMPLATE(BM_MultiplyElements, 6, Q31);
+BENCHMARK_TEMPLATE(BM_MultiplyElements, 9, float);
+BENCHMARK_TEMPLATE(BM_MultiplyElements, 9, Q15);
+BENCHMARK_TEMPLATE(BM_MultiplyElements, 9, Q31);
+BENCHMARK_TEMPLATE(BM_CholeskyElements, 6, float);
+BENCHMARK_TEMPLATE(BM_CholeskyElements, 6, Q15);
+BENCHMARK_TEMPLATE(BM_CholeskyElements, 6, Q31);
+
+BENCHMARK_TEMPLATE(BM_LoopMultiply, 3);
+BENCHMARK_TEMPLATE(BM_BatchMultiply, 3);
+BENCHMARK_TEMPLATE(BM_LoopMultiply, 4);
+BENCHMARK_TEMPLATE(BM_BatchMultiply, 4);
+BENCHMARK_TEMPLATE(BM_LoopInvert, 3);
+BENCHMARK_TEMPLATE(BM_BatchInvert, 3);
+BENCHMARK_TEMPLATE(BM_BatchInvertThreaded, 3);
+BENCHMARK_TEMPLATE(BM_LoopInvert, 4);
+BENCHMARK_TEMPLATE(BM_BatchInvert, 4);
+BENCHMARK_TEMPLATE(BM_BatchInvertThreaded, 4);
+BENCHMARK_TEMPLATE(BM_LoopLUSolve, 3);
+BENCHMARK_TEMPLATE(BM_BatchLUSolve, 3);
+BENCHMARK_TEMPLATE(BM_LoopLUSolve, 4);
+BENCHMARK_TEMPLATE(BM_BatchLUSolve, 4);
+BENCHMARK_TEMPLATE(BM_LoopCholeskySolve, 3);
+BENCHMARK_TEMPLATE(BM_BatchCholeskySolve, 3);
+BENCHMARK_TEMPLATE(BM_LoopCholeskySolve, 4);
+BENCHMARK_TEMPLATE(BM_BatchCholeskySolve, 4);
+
+BENCHMARK_MAIN();
@@ -67,6 +67,10 @@ TEST(Arithmetic, EyeTest)
     }
 }
 
+// These keep the results of + - and * with auto and then modify them (or their operands), which only works when those
+// operators return a Matrix. With lazy expressions, the default, auto keeps an expression that refers to A and B, so
+// they're built with BLA_LAZY_EXPRESSIONS set to 0 instead (see the README).
+#if !BLA_LAZY_EXPRESSIONS
 TEST(Arithmetic, AdditionSubtraction)
 {
     Matrix<3, 3> A = {3.25, 5.67, 8.67, 4.55, 7.23, 9.00, 2.35, 5.73, 10.56};
@@ -96,6 +100,7 @@ TEST(Arithmetic, AdditionSubtraction)
         }
     }
 }
+#endif
 
 TEST(Arithmetic, OtherDTypes)
 {
@@ -155,6 +160,8 @@ TEST(Arithmetic, ElementwiseOperations)
     }
 }
 
+// Like AdditionSubtraction this needs C to be a Matrix, since A changes after C is computed
+#if !BLA_LAZY_EXPRESSIONS
 TEST(Arithmetic, Multiplication)
 {
     Matrix<3, 3> A = {3., 5., 8., 4., 7., 9., 2., 5.0, 10.};
@@ -191,6 +198,538 @@ TEST(Arithmetic, Multiplication)
         }
     }
 }
+#endif
+
+TEST(Arithmetic, LazyEvaluation)
+{
+    Matrix<3, 3> F = {1.0, 0.1, 0.0, 0.0, 1.0, 0.1, 0.0, 0.0, 1.0};
+    Matrix<3, 3> P = {2.0, 0.5, 0.1, 0.5, 1.0, 0.2, 0.1, 0.2, 0.5};
+    Matrix<3, 3> Q = {0.01, 0.0, 0.0, 0.0, 0.02, 0.0, 0.0, 0.0, 0.03};
+
+    Matrix<3, 3> FP = F * P;
+    Matrix<3, 3> FPFt = FP * ~F;
+    Matrix<3, 3> expected = FPFt + Q;
+
+    // Nothing is computed until the expression is assigned
+    auto expr = F * P * ~F + Q;
+
+    Matrix<3, 3> result = expr;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_FLOAT_EQ(result(i, j), expected(i, j));
+            EXPECT_FLOAT_EQ(expr(i, j), expected(i, j));
+        }
+    }
+
+    // Expressions can be assigned into references as well
+    Matrix<6, 6> big = Zeros<6, 6>();
+    big.Submatrix<3, 3>(3, 3) = F * P * ~F + Q;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_FLOAT_EQ(big(i + 3, j + 3), expected(i, j));
+            EXPECT_FLOAT_EQ(big(i, j), 0.0);
+        }
+    }
+
+    // A temporary operand is copied into the expression so it can be used after the temporary has gone
+    auto scaled = (P * 2.0f) * Eye<3, 3>();
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_FLOAT_EQ(scaled(i, j), P(i, j) * 2.0f);
+        }
+    }
+}
+
+TEST(Arithmetic, Aliasing)
+{
+    Matrix<3, 3> A = {3., 5., 8., 4., 7., 9., 2., 5.0, 10.};
+    Matrix<3, 3> B = {6., 3., 2., 3., 7., 5., 8., 9., 1.};
+    Matrix<3> x = {1.0, 2.0, 3.0};
+
+    Matrix<3, 3> AB = A * B;
+    Matrix<3, 3> BA = B * A;
+    Matrix<3> Ax = A * x;
+    Matrix<3, 3> At = ~A;
+
+    // Each of these reads from the matrix being written so they need to be evaluated into a temporary first
+    Matrix<3, 3> C = A;
+    C = C * B;
+
+    Matrix<3, 3> D = A;
+    D = B * D;
+
+    Matrix<3> y = x;
+    y = A * y;
+
+    Matrix<3> z = x;
+    z += A * z;
+
+    Matrix<3, 3> E = A;
+    E.Submatrix<3, 3>(0, 0) = ~E + Zeros<3, 3>();
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_FLOAT_EQ(C(i, j), AB(i, j));
+            EXPECT_FLOAT_EQ(D(i, j), BA(i, j));
+            EXPECT_FLOAT_EQ(E(i, j), At(i, j));
+        }
+
+        EXPECT_FLOAT_EQ(y(i), Ax(i));
+        EXPECT_FLOAT_EQ(z(i), x(i) + Ax(i));
+    }
+
+#if BLA_LAZY_EXPRESSIONS
+    // Expressions which don't touch the destination don't need a temporary
+    EXPECT_FALSE((A * B + A).Aliases(x.Storage()));
+    EXPECT_TRUE((A * B + A).Aliases(A.Storage()));
+    EXPECT_TRUE((B * ~A.Submatrix<3, 3>(0, 0)).Aliases(A.Storage()));
+    EXPECT_TRUE((A * B * x).Aliases(A.Storage()));
+
+    // A * B is evaluated into a temporary before anything is written so it can be assigned straight into A
+    EXPECT_FALSE((A * B * x).AssignmentAliases(A.Storage()));
+    EXPECT_TRUE((A * B * ~A).AssignmentAliases(A.Storage()));
+#endif
+
+    Matrix<3, 3> F = A;
+    F = F * B * ~A + B;
+
+    Matrix<3, 3> ABAt = AB * At;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_FLOAT_EQ(F(i, j), ABAt(i, j) + B(i, j));
+        }
+    }
+}
+
+// Checks A * B, ~A * B and A * ~B against a plain triple loop for a product whose dimensions select a particular kernel
+template <int Rows, int Inner, int Cols, typename DType>
+void CheckProductKernels()
+{
+    Matrix<Rows, Inner, DType> A;
+    Matrix<Inner, Cols, DType> B;
+    Matrix<Inner, Rows, DType> At;
+    Matrix<Cols, Inner, DType> Bt;
+
+    for (int i = 0; i < Rows; ++i)
+    {
+        for (int k = 0; k < Inner; ++k)
+        {
+            At(k, i) = A(i, k) = DType((i * 7 + k * 3) % 11) - DType(5);
+        }
+    }
+
+    for (int k = 0; k < Inner; ++k)
+    {
+        for (int j = 0; j < Cols; ++j)
+        {
+            Bt(j, k) = B(k, j) = DType((k * 5 + j * 2) % 13) / DType(4);
+        }
+    }
+
+    Matrix<Rows, Cols, DType> C = A * B;
+    Matrix<Rows, Cols, DType> D = ~At * B;
+    Matrix<Rows, Cols, DType> E = A * ~Bt;
+
+    for (int i = 0; i < Rows; ++i)
+    {
+        for (int j = 0; j < Cols; ++j)
+        {
+            DType expected = 0;
+
+            for (int k = 0; k < Inner; ++k)
+            {
+                expected += A(i, k) * B(k, j);
+            }
+
+            EXPECT_FLOAT_EQ(C(i, j), expected);
+            EXPECT_FLOAT_EQ(D(i, j), expected);
+            EXPECT_FLOAT_EQ(E(i, j), expected);
+        }
+    }
+}
+
+TEST(Arithmetic, ProductKernels)
+{
+    // Unrolled, vectorised with leftover columns and plain loops, both square and not
+    CheckProductKernels<2, 2, 2, float>();
+    CheckProductKernels<3, 3, 3, float>();
+    CheckProductKernels<4, 4, 4, float>();
+    CheckProductKernels<6, 6, 6, float>();
+    CheckProductKernels<3, 6, 1, float>();
+    CheckProductKernels<6, 3, 7, float>();
+    CheckProductKernels<9, 5, 11, float>();
+    CheckProductKernels<12, 12, 12, float>();
+    CheckProductKernels<4, 7, 9, double>();
+    CheckProductKernels<5, 5, 5, int>();
+}
+
+TEST(Arithmetic, SymmetricMatrix)
+{
+    Matrix<3, 3> F = {1.0, 0.1, 0.0, 0.0, 1.0, 0.1, 0.0, 0.0, 1.0};
+    Matrix<3, 3> P_full = {4.0, 1.0, 0.5, 1.0, 3.0, 0.2, 0.5, 0.2, 2.0};
+    Matrix<3, 3> Q_full = {0.1, 0.0, 0.0, 0.0, 0.2, 0.0, 0.0, 0.0, 0.3};
+
+    SymmetricMatrix<3> P = P_full;
+    SymmetricMatrix<3> Q = Q_full;
+
+    EXPECT_EQ(sizeof(P), sizeof(float) * 6);
+
+    // Both halves refer to the same element
+    P(0, 2) = 0.6;
+    EXPECT_FLOAT_EQ(P(2, 0), 0.6);
+    P_full(0, 2) = P_full(2, 0) = 0.6;
+
+    // Only the lower triangle of the result is worked out
+    P = F * P * ~F + Q;
+    Matrix<3, 3> expected = F * P_full * ~F + Q_full;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_FLOAT_EQ(P(i, j), expected(i, j));
+        }
+    }
+
+    P -= Q;
+    expected -= Q_full;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_FLOAT_EQ(P(i, j), expected(i, j));
+        }
+    }
+}
+
+TEST(Arithmetic, DiagonalMatrix)
+{
+    Matrix<3, 3> A = {3., 5., 8., 4., 7., 9., 2., 5., 10.};
+    DiagonalMatrix<3> D = Zeros<3, 3>();
+
+    EXPECT_EQ(sizeof(D.storage), sizeof(float) * 3);
+
+    D(0, 0) = 2.0;
+    D(1, 1) = -1.0;
+    D(2, 2) = 0.5;
+
+    // Writing off the diagonal doesn't do anything, even to an element that was looked up before
+    auto &&D10 = D(1, 0);
+    D(0, 1) = 7.0;
+    D(2, 0) += 3.0;
+    EXPECT_FLOAT_EQ(D10, 0.0);
+    EXPECT_FLOAT_EQ(D(0, 1), 0.0);
+    EXPECT_FLOAT_EQ(D(2, 0), 0.0);
+
+    Matrix<3, 3> DA = D * A;
+    Matrix<3, 3> AD = A * D;
+    DiagonalMatrix<3> DD = D * D + D;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_FLOAT_EQ(DA(i, j), D(i, i) * A(i, j));
+            EXPECT_FLOAT_EQ(AD(i, j), A(i, j) * D(j, j));
+            EXPECT_FLOAT_EQ(DD(i, j), i == j ? D(i, i) * D(i, i) + D(i, i) : 0.0);
+        }
+    }
+}
+
+TEST(Arithmetic, PackedTriangularMatrix)
+{
+    Matrix<4, 4> A = {3., 5., 8., 1., 4., 7., 9., 2., 2., 5., 10., 3., 1., 6., 2., 4.};
+    Matrix<4, 4> B = {1., 2., 0., 1., 3., 1., 4., 2., 0., 2., 1., 5., 2., 3., 1., 1.};
+
+    PackedLowerTriangularMatrix<4> L = A;
+    PackedUpperTriangularMatrix<4> U = A;
+
+    EXPECT_EQ(sizeof(L.storage), sizeof(float) * 10);
+    EXPECT_EQ(sizeof(U.storage), sizeof(float) * 10);
+
+    // Nor does writing outside the triangle
+    PackedLowerTriangularMatrix<4> L_written = L;
+    PackedUpperTriangularMatrix<4> U_written = U;
+    auto &&L03 = L_written(0, 3);
+    auto &&U30 = U_written(3, 0);
+    L_written(0, 1) = 5.0;
+    U_written(1, 0) = 5.0;
+    L_written(1, 0) *= 2.0;
+    U_written(0, 1) *= 2.0;
+
+    EXPECT_FLOAT_EQ(L03, 0.0);
+    EXPECT_FLOAT_EQ(U30, 0.0);
+    EXPECT_FLOAT_EQ(L_written(0, 1), 0.0);
+    EXPECT_FLOAT_EQ(U_written(1, 0), 0.0);
+    EXPECT_FLOAT_EQ(L_written(1, 0), 2 * A(1, 0));
+    EXPECT_FLOAT_EQ(U_written(0, 1), 2 * A(0, 1));
+
+    // A scalar only changes the stored elements
+    L_written *= 0.5f;
+    EXPECT_FLOAT_EQ(L_written(1, 0), A(1, 0));
+    EXPECT_FLOAT_EQ(L_written(0, 1), 0.0);
+
+    Matrix<4, 4> L_full = LowerTriangularMatrix<Matrix<4, 4>>(A);
+    Matrix<4, 4> U_full = UpperTriangularMatrix<Matrix<4, 4>>(A);
+
+    Matrix<4, 4> LB = L * B, BL = B * L, UB = U * B, BU = B * U, LU = L * U;
+    Matrix<4, 4> LB_full = L_full * B, BL_full = B * L_full, UB_full = U_full * B, BU_full = B * U_full,
+                 LU_full = L_full * U_full;
+
+    // Only the lower triangle of L * L is stored
+    PackedLowerTriangularMatrix<4> LL = L * L;
+    Matrix<4, 4> LL_full = L_full * L_full;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            EXPECT_FLOAT_EQ(L(i, j), i >= j ? A(i, j) : 0.0);
+            EXPECT_FLOAT_EQ(U(i, j), i <= j ? A(i, j) : 0.0);
+            EXPECT_FLOAT_EQ(LB(i, j), LB_full(i, j));
+            EXPECT_FLOAT_EQ(BL(i, j), BL_full(i, j));
+            EXPECT_FLOAT_EQ(UB(i, j), UB_full(i, j));
+            EXPECT_FLOAT_EQ(BU(i, j), BU_full(i, j));
+            EXPECT_FLOAT_EQ(LU(i, j), LU_full(i, j));
+            EXPECT_FLOAT_EQ(LL(i, j), LL_full(i, j));
+        }
+    }
+}
+
+TEST(Arithmetic, CompressedSparseRowMatrix)
+{
+    SparseMatrix<4, 6, float, 10> H_table;
+    H_table(2, 5) = 3.0;
+    H_table(0, 1) = 1.0;
+    H_table(2, 0) = -2.0;
+    H_table(3, 3) = 0.5;
+    H_table(0, 4) = 4.0;
+
+    CompressedSparseRowMatrix<4, 6, float, 10> H = H_table;
+    Matrix<4, 6> H_dense = {0.0, 1.0, 0.0, 0.0, 4.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+                            -2.0, 0.0, 0.0, 0.0, 0.0, 3.0, 0.0, 0.0, 0.0, 0.5, 0.0, 0.0};
+
+    EXPECT_EQ(H.NonZeros(), 5);
+    EXPECT_EQ(H.row_start[1], 2);
+    EXPECT_EQ(H.row_start[2], 2);
+    EXPECT_EQ(H.col[2], 0);
+    EXPECT_EQ(H.col[3], 5);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 6; ++j)
+        {
+            EXPECT_FLOAT_EQ(H(i, j), H_dense(i, j));
+        }
+    }
+
+    // Converting from a dense matrix gives the same thing
+    CompressedSparseRowMatrix<4, 6, float, 10> H2 = H_dense;
+
+    EXPECT_EQ(H2.NonZeros(), 5);
+
+    for (int i = 0; i <= 4; ++i)
+    {
+        EXPECT_EQ(H2.row_start[i], H.row_start[i]);
+    }
+
+    Matrix<6, 6> P;
+    Matrix<6> x;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int j = 0; j < 6; ++j)
+        {
+            P(i, j) = 1.0f / (1 + i + j);
+        }
+
+        x(i) = i - 2.5f;
+    }
+
+    Matrix<4> Hx = H * x;
+    Matrix<4, 6> HP = H * P;
+    Matrix<6, 4> PHt = P * ~H;
+    Matrix<4, 4> S = H * P * ~H + H * ~H;
+    SymmetricMatrix<4> S_sym = H * P * ~H + H * ~H;
+    Matrix<6, 6> HtH = ~H_dense * H;
+
+    Matrix<4> Hx_expected = H_dense * x;
+    Matrix<4, 6> HP_expected = H_dense * P;
+    Matrix<6, 4> PHt_expected = P * ~H_dense;
+    Matrix<4, 4> S_expected = H_dense * P * ~H_dense + H_dense * ~H_dense;
+    Matrix<6, 6> HtH_expected = ~H_dense * H_dense;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_FLOAT_EQ(Hx(i), Hx_expected(i));
+
+        for (int j = 0; j < 6; ++j)
+        {
+            EXPECT_FLOAT_EQ(HP(i, j), HP_expected(i, j));
+            EXPECT_FLOAT_EQ(PHt(j, i), PHt_expected(j, i));
+        }
+
+        for (int j = 0; j < 4; ++j)
+        {
+            EXPECT_FLOAT_EQ(S(i, j), S_expected(i, j));
+            EXPECT_FLOAT_EQ(S_sym(i, j), S_expected(i, j));
+        }
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int j = 0; j < 6; ++j)
+        {
+            EXPECT_FLOAT_EQ(HtH(i, j), HtH_expected(i, j));
+        }
+    }
+
+    // Building one up an element at a time
+    CompressedSparseRowMatrix<3, 3, float, 3> D;
+
+    EXPECT_TRUE(D.Append(0, 2, 1.0));
+    EXPECT_TRUE(D.Append(2, 0, 2.0));
+    EXPECT_FALSE(D.Append(1, 1, 3.0));
+    EXPECT_FALSE(D.Append(2, 0, 3.0));
+    EXPECT_TRUE(D.Append(2, 1, 3.0));
+    EXPECT_FALSE(D.Append(2, 2, 4.0));
+
+    EXPECT_EQ(D.NonZeros(), 3);
+    EXPECT_FLOAT_EQ(D(0, 2), 1.0);
+    EXPECT_FLOAT_EQ(D(1, 1), 0.0);
+    EXPECT_FLOAT_EQ(D(2, 0), 2.0);
+    EXPECT_FLOAT_EQ(D(2, 1), 3.0);
+    EXPECT_TRUE(D.overflowed);
+    EXPECT_FALSE(D.Append(3, 0, 1.0));
+    EXPECT_FALSE(D.Append(-1, 0, 1.0));
+
+    D.Clear();
+    EXPECT_FALSE(D.overflowed);
+    EXPECT_FALSE(D.Append(0, 3, 1.0));
+    EXPECT_FALSE(D.overflowed);
+    EXPECT_EQ(D.NonZeros(), 0);
+}
+
+TEST(Arithmetic, CompressedSparseRowMatrixOverflow)
+{
+    Matrix<4, 6> H_dense = {0.0, 1.0, 0.0, 0.0, 4.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+                            -2.0, 0.0, 0.0, 0.0, 0.0, 3.0, 0.0, 0.0, 0.0, 0.5, 0.0, 0.0};
+
+    CompressedSparseRowMatrix<4, 6, float, 5> exact = H_dense;
+    EXPECT_FALSE(exact.overflowed);
+    EXPECT_EQ(exact.NonZeros(), 5);
+
+    // The nonzeros that fit are kept in order and the rest are reported rather than written past the arrays
+    CompressedSparseRowMatrix<4, 6, float, 3> H = H_dense;
+    EXPECT_TRUE(H.overflowed);
+    EXPECT_EQ(H.NonZeros(), 3);
+
+    for (int i = 0; i <= 4; ++i)
+    {
+        EXPECT_LE(H.row_start[i], 3);
+    }
+
+    EXPECT_FLOAT_EQ(H(0, 1), 1.0);
+    EXPECT_FLOAT_EQ(H(0, 4), 4.0);
+    EXPECT_FLOAT_EQ(H(2, 0), -2.0);
+    EXPECT_FLOAT_EQ(H(2, 5), 0.0);
+    EXPECT_FLOAT_EQ(H(3, 3), 0.0);
+}
+
+TEST(Arithmetic, FixedPoint)
+{
+    EXPECT_EQ(Q15(0.5).raw, 16384);
+    EXPECT_EQ(Q15(-1.0).raw, -32768);
+    EXPECT_EQ(Q31(0.25).raw, 1 << 29);
+
+    // Values outside [-1, 1) saturate rather than wrapping around
+    EXPECT_EQ(Q15(1.0).raw, 32767);
+    EXPECT_EQ(Q15(-3.0).raw, -32768);
+    EXPECT_EQ((Q15(0.75) + Q15(0.5)).raw, 32767);
+    EXPECT_EQ((Q15(-0.75) - Q15(0.5)).raw, -32768);
+    EXPECT_EQ((-Q15(-1.0)).raw, 32767);
+    EXPECT_EQ((Q15(-1.0) * Q15(-1.0)).raw, 32767);
+    EXPECT_EQ((Q31(0.5) / Q31(0.25)).raw, 2147483647);
+    EXPECT_EQ((Q15(-0.5) / Q15(0.0)).raw, -32768);
+
+    // Results are rounded to nearest
+    EXPECT_EQ((Q15::FromRaw(3) * Q15(0.5)).raw, 2);
+    EXPECT_EQ((Q15::FromRaw(-3) * Q15(0.5)).raw, -1);
+    EXPECT_EQ((Q15::FromRaw(1) / Q15::FromRaw(3)).raw, 10923);
+
+    EXPECT_NEAR(float(Q15(0.3) * Q15(-0.5)), -0.15f, 1.0f / 32768);
+    EXPECT_NEAR(double(Q31(0.3) * Q31(-0.5)), -0.15, 1e-9);
+    EXPECT_NEAR(double(Q31(0.3) / Q31(-0.5)), -0.6, 1e-9);
+
+    EXPECT_NEAR(float(sqrt(Q15(0.25))), 0.5f, 1.0f / 32768);
+    EXPECT_NEAR(double(sqrt(Q31(0.01))), 0.1, 1e-8);
+    EXPECT_EQ(sqrt(Q15(-0.25)).raw, 0);
+    EXPECT_EQ(fabs(Q15(-0.25)), Q15(0.25));
+    EXPECT_TRUE(Q31(-0.1) < Q31(0.1));
+}
+
+template <typename DType>
+Matrix<6, 6, DType> FixedPointTestMatrix(int seed)
+{
+    Matrix<6, 6, DType> A;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int j = 0; j < 6; ++j)
+        {
+            A(i, j) = ((i * 7 + j * 13 + seed) % 17 - 8) / 50.0;
+        }
+    }
+
+    return A;
+}
+
+TEST(Arithmetic, FixedPointMultiplication)
+{
+    Matrix<6, 6> A = FixedPointTestMatrix<float>(0), B = FixedPointTestMatrix<float>(5);
+    Matrix<6, 6> C = A * B, D = A * ~B + A;
+
+    Matrix<6, 6, Q15> A15 = FixedPointTestMatrix<Q15>(0), B15 = FixedPointTestMatrix<Q15>(5);
+    Matrix<6, 6, Q15> C15 = A15 * B15, D15 = A15 * ~B15 + A15;
+
+    Matrix<6, 6, Q31> A31 = FixedPointTestMatrix<Q31>(0), B31 = FixedPointTestMatrix<Q31>(5);
+    Matrix<6, 6, Q31> C31 = A31 * B31, D31 = A31 * ~B31 + A31;
+
+    // Each dot product is only rounded once so the error stays within a couple of steps of the inputs' rounding no
+    // matter how long it is
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int j = 0; j < 6; ++j)
+        {
+            EXPECT_NEAR(float(C15(i, j)), C(i, j), 2.0f / 32768);
+            EXPECT_NEAR(float(D15(i, j)), D(i, j), 3.0f / 32768);
+            EXPECT_NEAR(float(C31(i, j)), C(i, j), 1e-6);
+            EXPECT_NEAR(float(D31(i, j)), D(i, j), 1e-6);
+        }
+    }
+
+    // Products that overflow saturate
+    Matrix<2, 2, Q15> E = {0.9, 0.9, -0.9, -0.9};
+    Matrix<2, 2, Q15> E2 = E * ~E;
+
+    EXPECT_EQ(E2(0, 0).raw, 32767);
+    EXPECT_EQ(E2(0, 1).raw, -32768);
+}
 
 TEST(Arithmetic, Concatenation)
 {
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#define BLA_BATCH_THREADS
+
 #include "../BasicLinearAlgebra.h"
 
 using namespace BLA;
@@ -97,6 +99,369 @@ TEST(LinearAlgebra, CholeskySolution)
     }
 }
 
+TEST(LinearAlgebra, SymmetricCholeskySolution)
+{
+    Matrix<5, 5> A = {0.78183123,  0.08385324,  0.37172332,  -0.72518705, -1.11317593, 0.08385324, 0.56011595,
+                      0.19965695,  -0.17488402, -0.12703805, 0.37172332,  0.19965695,  0.52769031, -0.19284881,
+                      -0.45321194, -0.72518705, -0.17488402, -0.19284881, 2.19127456,  2.13045896, -1.11317593,
+                      -0.12703805, -0.45321194, 2.13045896,  3.50184434};
+
+    // The factor is stored in the lower triangle in place of A so only half as much memory is needed
+    SymmetricMatrix<5> S = A;
+
+    EXPECT_EQ(sizeof(S), sizeof(float) * 15);
+
+    auto chol = CholeskyDecompose(S);
+
+    EXPECT_TRUE(chol.positive_definite);
+
+    // Solve for several right hand sides at once
+    Matrix<5, 2> B = {1.0, 2.0, 2.0, -1.0, 3.0, 0.5, 4.0, 0.0, 5.0, 1.0};
+    Matrix<5, 2> X = CholeskySolve(chol, B);
+    Matrix<5, 2> AX = A * X;
+
+    Matrix<5> x_expected = {3.15866835, 2.12529984, 5.23818026, 0.98626514, 2.58690994};
+
+    for (int i = 0; i < 5; ++i)
+    {
+        EXPECT_NEAR(x_expected(i), X(i, 0), 1e-4);
+
+        for (int j = 0; j < 2; ++j)
+        {
+            EXPECT_NEAR(AX(i, j), B(i, j), 1e-4);
+        }
+    }
+}
+
+TEST(LinearAlgebra, FixedPointCholeskySolution)
+{
+    // The matrix from CholeskySolution scaled down to fit in [-1, 1)
+    Matrix<5, 5> A = {0.78183123,  0.08385324,  0.37172332,  -0.72518705, -1.11317593, 0.08385324, 0.56011595,
+                      0.19965695,  -0.17488402, -0.12703805, 0.37172332,  0.19965695,  0.52769031, -0.19284881,
+                      -0.45321194, -0.72518705, -0.17488402, -0.19284881, 2.19127456,  2.13045896, -1.11317593,
+                      -0.12703805, -0.45321194, 2.13045896,  3.50184434};
+    A *= 0.25f;
+
+    Matrix<5> x_expected = {0.5, -0.3, 0.2, 0.1, -0.4};
+    Matrix<5> b = A * x_expected;
+
+    Matrix<5, 5, Q15> A15;
+    Matrix<5, 5, Q31> A31;
+    Matrix<5, 1, Q15> b15;
+    Matrix<5, 1, Q31> b31;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        for (int j = 0; j < 5; ++j)
+        {
+            A15(i, j) = A(i, j);
+            A31(i, j) = A(i, j);
+        }
+
+        b15(i) = b(i);
+        b31(i) = b(i);
+    }
+
+    auto chol = CholeskyDecompose(A);
+    auto chol15 = CholeskyDecompose(A15);
+    auto chol31 = CholeskyDecompose(A31);
+
+    EXPECT_TRUE(chol15.positive_definite);
+    EXPECT_TRUE(chol31.positive_definite);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        for (int j = 0; j <= i; ++j)
+        {
+            EXPECT_NEAR(float(chol15.L(i, j)), chol.L(i, j), 5e-4);
+            EXPECT_NEAR(float(chol31.L(i, j)), chol.L(i, j), 1e-6);
+        }
+    }
+
+    // The solve divides by the diagonal of L so errors in the input get amplified by its condition number
+    auto x15 = CholeskySolve(chol15, b15);
+    auto x31 = CholeskySolve(chol31, b31);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        EXPECT_NEAR(float(x15(i)), x_expected(i), 5e-3);
+        EXPECT_NEAR(float(x31(i)), x_expected(i), 1e-6);
+    }
+}
+
+TEST(LinearAlgebra, FixedPointLUSolution)
+{
+    Matrix<4, 4> A = {0.1, 0.6, -0.2, 0.1, 0.5, 0.1, 0.2, -0.1, 0.1, -0.2, 0.3, 0.7, 0.2, 0.1, 0.8, 0.1};
+    Matrix<4> x_expected = {0.3, -0.6, 0.4, 0.2};
+    Matrix<4> b = A * x_expected;
+
+    Matrix<4, 4, Q15> A15;
+    Matrix<4, 4, Q31> A31;
+    Matrix<4, 1, Q15> b15;
+    Matrix<4, 1, Q31> b31;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            A15(i, j) = A(i, j);
+            A31(i, j) = A(i, j);
+        }
+
+        b15(i) = b(i);
+        b31(i) = b(i);
+    }
+
+    auto lu15 = LUDecompose(A15);
+    auto lu31 = LUDecompose(A31);
+
+    EXPECT_FALSE(lu15.singular);
+    EXPECT_FALSE(lu31.singular);
+
+    auto x15 = LUSolve(lu15, b15);
+    auto x31 = LUSolve(lu31, b31);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_NEAR(float(x15(i)), x_expected(i), 1e-3);
+        EXPECT_NEAR(float(x31(i)), x_expected(i), 1e-6);
+    }
+}
+
+TEST(LinearAlgebra, BatchOperations)
+{
+    // Not a whole number of blocks so that the last one is only partly full
+    const int N = 150;
+    static MatrixBatch<4, 4, N> A, B, C, LU, A_inv, L;
+    static MatrixBatch<4, 2, N> RHS, X_lu, X_chol;
+    static LUBatchDecomposition<4, N> lu;
+    static CholeskyBatchDecomposition<N> chol;
+    static bool singular[N];
+
+    for (int n = 0; n < N; ++n)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                A[n](i, j) = float((i * 7 + j * 13 + n) % 17) / 17.0f + (i == (j + n) % 4);
+                B[n](i, j) = float((i * 5 + j * 3 + n) % 11) / 11.0f;
+            }
+
+            for (int j = 0; j < 2; ++j)
+            {
+                RHS[n](i, j) = float((i + j + n) % 5) - 2.0f;
+            }
+        }
+    }
+
+    // One of them is singular, which mustn't upset the others
+    A[7].Fill(1.0);
+
+    Multiply(A, B, C);
+
+    LU = A;
+    LUDecompose(LU, lu);
+    LUSolve(LU, lu, RHS, X_lu);
+
+    Invert(A, A_inv, singular);
+
+    // Symmetric positive definite matrices for the Cholesky decomposition
+    for (int n = 0; n < N; ++n)
+    {
+        L[n] = A[n] * ~A[n] + Eye<4, 4>();
+    }
+
+    CholeskyDecompose(L, chol);
+    CholeskySolve(L, RHS, X_chol);
+
+    for (int n = 0; n < N; ++n)
+    {
+        Matrix<4, 4> A_n = A[n];
+        Matrix<4, 2> RHS_n = RHS[n];
+        Matrix<4, 4> C_expected = A_n * Matrix<4, 4>(B[n]);
+
+        EXPECT_EQ(lu.singular[n], n == 7);
+        EXPECT_EQ(singular[n], n == 7);
+        EXPECT_TRUE(chol.positive_definite[n]);
+
+        Matrix<4, 2> AX_lu = A_n * Matrix<4, 2>(X_lu[n]);
+        Matrix<4, 4> AA_inv = A_n * Matrix<4, 4>(A_inv[n]);
+        Matrix<4, 2> SX_chol = (A_n * ~A_n + Eye<4, 4>()) * Matrix<4, 2>(X_chol[n]);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                EXPECT_FLOAT_EQ(C[n](i, j), C_expected(i, j));
+
+                if (n != 7)
+                {
+                    EXPECT_NEAR(AA_inv(i, j), i == j, 1e-5);
+                }
+            }
+
+            for (int j = 0; j < 2; ++j)
+            {
+                if (n != 7)
+                {
+                    EXPECT_NEAR(AX_lu(i, j), RHS_n(i, j), 1e-5);
+                }
+
+                EXPECT_NEAR(SX_chol(i, j), RHS_n(i, j), 1e-4);
+            }
+        }
+    }
+
+    // Splitting the batch between threads gives the same answer
+    static MatrixBatch<4, 4, N> A_inv_threaded;
+    static bool singular_threaded[N];
+
+    ParallelBatch<N>(3, [&](int begin, int end) { Invert(A, A_inv_threaded, singular_threaded, begin, end); });
+
+    for (int n = 0; n < N; ++n)
+    {
+        EXPECT_EQ(singular_threaded[n], singular[n]);
+
+        for (int i = 0; i < 4 && n != 7; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                EXPECT_EQ(A_inv_threaded[n](i, j), A_inv[n](i, j));
+            }
+        }
+    }
+}
+
+TEST(LinearAlgebra, QRDecomposition)
+{
+    Matrix<6, 4> A = {16, 78, 50, 84, 70, 63, 2,  32, 33, 61, 40, 17, 96, 98, 50, 80,
+                      78, 27, 86, 49, 57, 10, 42, 96};
+
+    auto A_orig = A;
+
+    auto qr = QRDecompose(A);
+
+    EXPECT_FALSE(qr.singular);
+
+    auto Q = QRFormQ(qr);
+    auto A_reconstructed = Q * qr.R;
+    auto I = ~Q * Q;
+
+    for (int i = 0; i < A.Rows; ++i)
+    {
+        for (int j = 0; j < A.Cols; ++j)
+        {
+            EXPECT_NEAR(A_reconstructed(i, j), A_orig(i, j), 1e-4);
+        }
+
+        for (int j = 0; j < A.Rows; ++j)
+        {
+            EXPECT_NEAR(I(i, j), i == j ? 1.0 : 0.0, 1e-6);
+        }
+    }
+}
+
+TEST(LinearAlgebra, QRSolution)
+{
+    // A square system should give the same answer as LUSolve
+    Matrix<3, 3> A{2, 5, 8, 0, 8, 6, 6, 7, 5};
+    Matrix<3, 1> b{10, 11, 12};
+    Matrix<3, 1> x_expected = {0.41826923, 0.97115385, 0.53846154};
+
+    auto qr = QRDecompose(A);
+
+    auto x = QRSolve(qr, b);
+
+    for (int i = 0; i < x_expected.Rows; ++i)
+    {
+        EXPECT_NEAR(x_expected(i), x(i), 1e-6);
+    }
+}
+
+TEST(LinearAlgebra, QRLeastSquares)
+{
+    // Fit a fifth order polynomial to exact samples. The normal equations square the condition number of this
+    // Vandermonde matrix (about 1e5) which is more than single precision can cope with
+    Matrix<6> coeffs = {0.5, -1.0, 2.0, 0.25, -3.0, 1.5};
+    Matrix<20, 6> A;
+    Matrix<20> b;
+
+    for (int i = 0; i < A.Rows; ++i)
+    {
+        float t = i / 19.0, t_pow = 1.0;
+        b(i) = 0.0;
+
+        for (int j = 0; j < A.Cols; ++j)
+        {
+            A(i, j) = t_pow;
+            b(i) += coeffs(j) * t_pow;
+            t_pow *= t;
+        }
+    }
+
+    Matrix<6> x_normal = Inverse(~A * A) * (~A * b);
+
+    auto A_copy = A;
+    auto qr = QRDecompose(A_copy);
+    auto x = QRSolve(qr, b);
+
+    for (int i = 0; i < x.Rows; ++i)
+    {
+        EXPECT_NEAR(x(i), coeffs(i), 5e-3);
+    }
+
+    EXPECT_LT(Norm(x - coeffs) * 10, Norm(x_normal - coeffs));
+}
+
+TEST(LinearAlgebra, PivotedQRDecomposition)
+{
+    // The last column is the sum of the first two so the rank is 3
+    Matrix<6, 4> A = {1.0, 2.0, 0.5, 3.0,  4.0, -1.0, 2.0, 3.0,  0.0, 1.0, 1.0, 1.0,
+                      2.0, 2.0, 3.0, 4.0, -1.0, 5.0,  0.0, 4.0, 3.0, 0.0, 1.0, 3.0};
+
+    auto A_orig = A;
+
+    auto qr = PivotedQRDecompose(A);
+
+    EXPECT_TRUE(qr.singular);
+    EXPECT_EQ(qr.rank, 3);
+
+    auto Q = QRFormQ(qr);
+    auto A_reconstructed = Q * qr.R * ~qr.P;
+
+    for (int i = 0; i < A.Rows; ++i)
+    {
+        for (int j = 0; j < A.Cols; ++j)
+        {
+            EXPECT_NEAR(A_reconstructed(i, j), A_orig(i, j), 1e-5);
+        }
+    }
+
+    for (int k = 1; k < A.Cols; ++k)
+    {
+        EXPECT_LE(fabs(qr.R(k, k)), fabs(qr.R(k - 1, k - 1)));
+    }
+
+    // b is in the range of A so the basic solution should reproduce it exactly
+    Matrix<4> x_true = {1.0, -2.0, 0.5, 0.0};
+    Matrix<6> b = A_orig * x_true;
+
+    auto x = QRSolve(qr, b);
+    auto residual = A_orig * x - b;
+
+    EXPECT_NEAR(Norm(residual), 0.0, 1e-5);
+
+    int zeros = 0;
+
+    for (int i = 0; i < x.Rows; ++i)
+    {
+        zeros += x(i) == 0.0;
+    }
+
+    EXPECT_EQ(zeros, 1);
+}
+
 TEST(LinearAlgebra, Inversion)
 {
     BLA::Matrix<3, 3> A = {9.79, 9.33, 11.62, 7.77, 14.77, 14.12, 11.33, 15.72, 12.12};
@@ -0,0 +1,46 @@
+/*
+ * Feeds TinyGPSPlus from a buffer filled by an interrupt handler, with no critical sections.
+ *
+ * For an Arduino Mega, with the GPS TX on pin 19 (RX1) at 9600 baud. The sketch drives USART1 itself, so Serial1
+ * must not be used.
+ */
+#include <SpscStream.h>
+#include <TinyGPS++.h>
+
+SpscStream gpsBuffer(128);  // written by the interrupt, read by loop()
+TinyGPSPlus gps;
+unsigned long dropped = 0;
+
+ISR(USART1_RX_vect) {
+  uint8_t c = UDR1;
+  if (!gpsBuffer.write(c)) {
+    dropped++;
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  uint16_t ubrr = F_CPU / 16 / 9600 - 1;
+  UBRR1H = ubrr >> 8;
+  UBRR1L = ubrr;
+  UCSR1A = 0;
+  UCSR1C = (1 << UCSZ11) | (1 << UCSZ10);  // 8N1
+  UCSR1B = (1 << RXEN1) | (1 << RXCIE1);
+}
+
+void loop() {
+  // Parse straight from the buffer, without copying
+  const uint8_t *data;
+  size_t n = gpsBuffer.peekSpan(data);
+  for (size_t i = 0; i < n; i++) {
+    gps.encode(data[i]);
+  }
+  gpsBuffer.consume(n);
+
+  if (gps.location.isUpdated()) {
+    Serial.print(gps.location.lat(), 6);
+    Serial.print(",");
+    Serial.println(gps.location.lng(), 6);
+  }
+}
@@ -1,8 +1,11 @@
 #include "LoopbackStream.h"
 
+#include <string.h>
+
 LoopbackStream::LoopbackStream(uint16_t buffer_size) {
   this->buffer = (uint8_t*) malloc(buffer_size);
   this->buffer_size = buffer_size;
+  this->mask = buffer_size > 1 && (buffer_size & (buffer_size - 1)) == 0 ? buffer_size - 1 : 0;
   this->pos = 0;
   this->size = 0;
 }
@@ -10,6 +13,14 @@ LoopbackStream::~LoopbackStream() {
   free(buffer);
 }
 
+uint16_t LoopbackStream::wrap(size_t p) const {
+  // p < 2 * buffer_size
+  if (mask) {
+    return p & mask;
+  }
+  return p >= buffer_size ? p - buffer_size : p;
+}
+
 void LoopbackStream::clear() {
   this->pos = 0;
   this->size = 0;
@@ -20,29 +31,60 @@ int LoopbackStream::read() {
     return -1;
   } else {
     int ret = buffer[pos];
-    pos++;
+    pos = wrap(pos + 1);
     size--;
-    if (pos == buffer_size) {
-      pos = 0;
-    }
     return ret;
   }
 }
 
+size_t LoopbackStream::readAvailable(char *data, size_t length) {
+  if (length > size) {
+    length = size;
+  }
+  if (length == 0) {
+    return 0;
+  }
+  size_t first = buffer_size - pos;
+  if (first >= length) {
+    memcpy(data, buffer + pos, length);
+  } else {
+    memcpy(data, buffer + pos, first);
+    memcpy(data + first, buffer, length - first);
+  }
+  pos = wrap(pos + length);
+  size -= length;
+  return length;
+}
+
 size_t LoopbackStream::write(uint8_t v) {
   if (size == buffer_size) {
     return 0;
   } else {
-    int p = pos + size;
-    if (p >= buffer_size) {
-      p -= buffer_size;
-    }
-    buffer[p] = v;
+    buffer[wrap(pos + size)] = v;
     size++;
     return 1;
   }  
 }
 
+size_t LoopbackStream::write(const uint8_t *data, size_t length) {
+  if (length > (size_t)(buffer_size - size)) {
+    length = buffer_size - size;
+  }
+  if (length == 0) {
+    return 0;
+  }
+  uint16_t end = wrap(pos + size);
+  size_t first = buffer_size - end;
+  if (first >= length) {
+    memcpy(buffer + end, data, length);
+  } else {
+    memcpy(buffer + end, data, first);
+    memcpy(buffer, data + first, length - first);
+  }
+  size += length;
+  return length;
+}
+
 int LoopbackStream::available() {
   return size;
 }
@@ -52,13 +94,15 @@ int LoopbackStream::availableForWrite() {
 }
 
 bool LoopbackStream::contains(char ch) {
-  for (int i=0; i<size; i++){
-    int p = (pos + i) % buffer_size;
-    if (buffer[p] == ch) {
-      return true;
-    }
+  // The data is in at most two contiguous segments: from pos to the end of the buffer, then from its start
+  if (size == 0) {
+    return false;
+  }
+  size_t first = buffer_size - pos;
+  if (first >= size) {
+    return memchr(buffer + pos, ch, size) != NULL;
   }
-  return false;
+  return memchr(buffer + pos, ch, first) != NULL || memchr(buffer, ch, size - first) != NULL;
 }
 
 int LoopbackStream::peek() {
@@ -8,11 +8,19 @@
  * If the buffer overflows, the last bytes written are lost.
  * 
  * It can be used as a buffering layer between components.
+ *
+ * It isn't safe to write from an interrupt handler or another thread while reading, or the other way around:
+ * use a SpscStream for that.
+ *
+ * With a power of two buffer_size (like the default), positions wrap around with a mask instead of a comparison.
  */
 class LoopbackStream : public Stream {
   uint8_t *buffer;
   uint16_t buffer_size;
+  uint16_t mask;  // buffer_size - 1 if it is a power of two, 0 otherwise
   uint16_t pos, size;
+
+  uint16_t wrap(size_t p) const;
 public:
   static const uint16_t DEFAULT_SIZE = 64;
   
@@ -23,11 +31,18 @@ public:
   void clear(); 
   
   virtual size_t write(uint8_t);
+  /** Writes as much of data as fits, with at most two copies. Returns the number of bytes written */
+  virtual size_t write(const uint8_t *data, size_t length);
+  using Print::write;
   virtual int availableForWrite(void);
   
   virtual int available();
   virtual bool contains(char);
   virtual int read();
+  /** Reads what is in the buffer, up to length bytes, with at most two copies. Unlike Stream::readBytes() it
+   *  doesn't wait for more data */
+  size_t readAvailable(char *data, size_t length);
+  size_t readAvailable(uint8_t *data, size_t length) { return readAvailable((char *)data, length); }
   virtual int peek();
   virtual void flush();
 };
@@ -14,10 +14,18 @@ int PipedStream::read() {
   return in.read();
 }
 
+size_t PipedStream::readAvailable(char *data, size_t length) {
+  return in.readAvailable(data, length);
+}
+
 size_t PipedStream::write(uint8_t v) {
   return out.write(v);
 }
 
+size_t PipedStream::write(const uint8_t *data, size_t length) {
+  return out.write(data, length);
+}
+
 int PipedStream::available() {
   return in.available();
 }
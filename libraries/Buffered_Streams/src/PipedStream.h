@@ -20,10 +20,14 @@ public:
   void clear(); 
 
   virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t *data, size_t length);
+  using Print::write;
   virtual int availableForWrite(void);
   
   virtual int available();
   virtual int read();
+  size_t readAvailable(char *data, size_t length);
+  size_t readAvailable(uint8_t *data, size_t length) { return readAvailable((char *)data, length); }
   virtual int peek();
   virtual void flush();
 };
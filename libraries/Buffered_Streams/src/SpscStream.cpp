@@ -0,0 +1,190 @@
+#include "SpscStream.h"
+
+#include <string.h>
+
+SpscStream::SpscStream(uint16_t buffer_size) {
+  uint16_t c = 1;
+  while (c < buffer_size && c < MAX_SIZE) {
+    c <<= 1;
+  }
+  this->buffer = (uint8_t*) malloc(c);
+  if (this->buffer == NULL) {
+    // Out of memory: a stream with no room, where every write and read does nothing
+    c = 0;
+  }
+  this->capacity = c;
+  this->mask = c - 1;
+  this->head = 0;
+  this->tail = 0;
+  this->cachedHead = 0;
+  this->cachedTail = 0;
+}
+
+SpscStream::~SpscStream() {
+  free(buffer);
+}
+
+#if defined(__AVR__)
+// A single core: the byte sized volatile accesses are atomic, the barriers stop the compiler from moving the buffer
+// accesses across them
+SpscStream::index_t SpscStream::own(const shared_index_t &index) {
+  return index;
+}
+
+SpscStream::index_t SpscStream::acquire(const shared_index_t &index) {
+  index_t value = index;
+  asm volatile("" ::: "memory");
+  return value;
+}
+
+void SpscStream::release(shared_index_t &index, index_t value) {
+  asm volatile("" ::: "memory");
+  index = value;
+}
+#else
+SpscStream::index_t SpscStream::own(const shared_index_t &index) {
+  return index.load(std::memory_order_relaxed);
+}
+
+SpscStream::index_t SpscStream::acquire(const shared_index_t &index) {
+  return index.load(std::memory_order_acquire);
+}
+
+void SpscStream::release(shared_index_t &index, index_t value) {
+  index.store(value, std::memory_order_release);
+}
+#endif
+
+/*********** writer side */
+
+// Free bytes, loading tail again only if the last copy leaves less than wanted
+size_t SpscStream::writable(size_t wanted) {
+  index_t h = own(head);
+  size_t free = capacity - (index_t)(h - cachedTail);
+  if (free < wanted) {
+    cachedTail = acquire(tail);
+    free = capacity - (index_t)(h - cachedTail);
+  }
+  return free;
+}
+
+size_t SpscStream::write(uint8_t v) {
+  if (writable(1) == 0) {
+    return 0;
+  }
+  index_t h = own(head);
+  buffer[h & mask] = v;
+  release(head, h + 1);
+  return 1;
+}
+
+size_t SpscStream::write(const uint8_t *data, size_t length) {
+  size_t free = writable(length);
+  if (length > free) {
+    length = free;
+  }
+  if (length == 0) {
+    return 0;
+  }
+  index_t h = own(head);
+  size_t offset = h & mask;
+  size_t first = capacity - offset;
+  if (first >= length) {
+    memcpy(buffer + offset, data, length);
+  } else {
+    memcpy(buffer + offset, data, first);
+    memcpy(buffer, data + first, length - first);
+  }
+  release(head, h + length);
+  return length;
+}
+
+int SpscStream::availableForWrite() {
+  return writable(capacity);
+}
+
+size_t SpscStream::reserve(uint8_t *&data) {
+  size_t free = writable(capacity);
+  size_t offset = own(head) & mask;
+  data = buffer + offset;
+  return free < capacity - offset ? free : capacity - offset;
+}
+
+void SpscStream::commit(size_t length) {
+  release(head, own(head) + length);
+}
+
+/*********** reader side */
+
+// Stored bytes, loading head again only if the last copy leaves less than wanted
+size_t SpscStream::readable(size_t wanted) {
+  index_t t = own(tail);
+  size_t stored = (index_t)(cachedHead - t);
+  if (stored < wanted) {
+    cachedHead = acquire(head);
+    stored = (index_t)(cachedHead - t);
+  }
+  return stored;
+}
+
+int SpscStream::available() {
+  return readable(capacity);
+}
+
+int SpscStream::read() {
+  if (readable(1) == 0) {
+    return -1;
+  }
+  index_t t = own(tail);
+  int ret = buffer[t & mask];
+  release(tail, t + 1);
+  return ret;
+}
+
+int SpscStream::peek() {
+  if (readable(1) == 0) {
+    return -1;
+  }
+  return buffer[own(tail) & mask];
+}
+
+size_t SpscStream::readAvailable(char *data, size_t length) {
+  size_t stored = readable(length);
+  if (length > stored) {
+    length = stored;
+  }
+  if (length == 0) {
+    return 0;
+  }
+  index_t t = own(tail);
+  size_t offset = t & mask;
+  size_t first = capacity - offset;
+  if (first >= length) {
+    memcpy(data, buffer + offset, length);
+  } else {
+    memcpy(data, buffer + offset, first);
+    memcpy(data + first, buffer, length - first);
+  }
+  release(tail, t + length);
+  return length;
+}
+
+size_t SpscStream::peekSpan(const uint8_t *&data) {
+  size_t stored = readable(capacity);
+  size_t offset = own(tail) & mask;
+  data = buffer + offset;
+  return stored < capacity - offset ? stored : capacity - offset;
+}
+
+void SpscStream::consume(size_t length) {
+  release(tail, own(tail) + length);
+}
+
+void SpscStream::clear() {
+  cachedHead = acquire(head);
+  release(tail, cachedHead);
+}
+
+void SpscStream::flush() {
+  // Nothing to send, the reader takes the bytes when it wants them
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Stream.h>
+
+#if !defined(__AVR__)
+#include <atomic>
+#endif
+
+/*
+ * A SpscStream is a LoopbackStream for exactly one writer and one reader running concurrently, with no locks and
+ * no critical sections: an interrupt handler writing while loop() reads (or the other way around), or two threads.
+ *
+ * The writer owns the head index and the reader owns the tail index. Each side only ever stores its own index, after
+ * the bytes it covers, and the other side loads it before touching those bytes (release/acquire atomics, or volatile
+ * with compiler barriers on single core AVR).
+ *
+ * The capacity is rounded up to a power of two: at most 128 bytes on AVR, where the indices are single bytes so that
+ * they are loaded and stored in one instruction, and 32768 bytes elsewhere.
+ *
+ * Writer side: write(), availableForWrite(), reserve() and commit().
+ * Reader side: read(), readAvailable(), peek(), available(), peekSpan(), consume() and clear().
+ *
+ * If the buffer overflows, the last bytes written are lost. If it can't be allocated, size() is 0 and the stream
+ * never holds anything.
+ */
+class SpscStream : public Stream {
+#if defined(__AVR__)
+  typedef uint8_t index_t;
+  typedef volatile uint8_t shared_index_t;
+#else
+  typedef uint16_t index_t;
+  typedef std::atomic<uint16_t> shared_index_t;
+#endif
+
+  uint8_t *buffer;
+  index_t capacity, mask;
+
+  // Each index is stored by its owner only, next to the owner's copy of the other index, which is refreshed when
+  // it looks like there's no room (writer) or no data (reader). On hosts they're on separate cache lines.
+#if !defined(ARDUINO)
+  alignas(64)
+#endif
+  shared_index_t head;
+  index_t cachedTail;
+#if !defined(ARDUINO)
+  alignas(64)
+#endif
+  shared_index_t tail;
+  index_t cachedHead;
+
+  static index_t own(const shared_index_t &index);
+  static index_t acquire(const shared_index_t &index);
+  static void release(shared_index_t &index, index_t value);
+  size_t writable(size_t wanted);
+  size_t readable(size_t wanted);
+public:
+  static const uint16_t DEFAULT_SIZE = 64;
+#if defined(__AVR__)
+  static const uint16_t MAX_SIZE = 128;
+#else
+  static const uint16_t MAX_SIZE = 32768;
+#endif
+
+  SpscStream(uint16_t buffer_size = SpscStream::DEFAULT_SIZE);
+  ~SpscStream();
+
+  /** Capacity in bytes, after rounding up to a power of two, or 0 if the buffer couldn't be allocated */
+  uint16_t size() const { return capacity; }
+
+  virtual size_t write(uint8_t);
+  /** Writes as much of data as fits, with at most two copies. Returns the number of bytes written */
+  virtual size_t write(const uint8_t *data, size_t length);
+  using Print::write;
+  virtual int availableForWrite(void);
+
+  /**
+   * Zero copy writing: points data at the free space after the last byte written and returns how many bytes can be
+   * written there, which may be less than availableForWrite() at the end of the buffer. Fill some and commit() them.
+   */
+  size_t reserve(uint8_t *&data);
+  /** Makes the first length bytes of the last reserve() readable */
+  void commit(size_t length);
+
+  virtual int available();
+  virtual int read();
+  /** Reads what is in the buffer, up to length bytes, with at most two copies. Doesn't wait for more data */
+  size_t readAvailable(char *data, size_t length);
+  size_t readAvailable(uint8_t *data, size_t length) { return readAvailable((char *)data, length); }
+  virtual int peek();
+  virtual void flush();
+
+  /**
+   * Zero copy reading: points data at the oldest byte and returns how many bytes can be read there, which may be
+   * less than available() at the end of the buffer. Use some and consume() them.
+   */
+  size_t peekSpan(const uint8_t *&data);
+  /** Drops the first length bytes, which must be available */
+  void consume(size_t length);
+  /** Drops everything written so far. Reader side */
+  void clear();
+};
@@ -0,0 +1,217 @@
+#include <benchmark/benchmark.h>
+
+#include "../src/LoopbackStream.h"
+#include "../src/SpscStream.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <vector>
+
+// LoopbackStream as it was: one byte per virtual call, wrapping with a compare, and Stream's
+// default bulk write() and readBytes() on top. Not inlined, as the library's methods can't be either.
+#define OUT_OF_LINE __attribute__((noinline))
+
+class ByteLoopback : public Stream
+{
+    uint8_t* buffer;
+    uint16_t buffer_size;
+    uint16_t pos, size;
+
+public:
+    ByteLoopback(uint16_t buffer_size) : buffer((uint8_t*)malloc(buffer_size)), buffer_size(buffer_size), pos(0), size(0) {}
+    ~ByteLoopback() { free(buffer); }
+
+    OUT_OF_LINE size_t write(uint8_t v) override
+    {
+        if (size == buffer_size) return 0;
+        int p = pos + size;
+        if (p >= buffer_size) p -= buffer_size;
+        buffer[p] = v;
+        size++;
+        return 1;
+    }
+    using Print::write;
+
+    OUT_OF_LINE int read() override
+    {
+        if (size == 0) return -1;
+        int ret = buffer[pos];
+        pos++;
+        size--;
+        if (pos == buffer_size) pos = 0;
+        return ret;
+    }
+
+    int available() override { return size; }
+    int peek() override { return size == 0 ? -1 : buffer[pos]; }
+
+    OUT_OF_LINE bool contains(char ch)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            if (buffer[(pos + i) % buffer_size] == ch) return true;
+        }
+        return false;
+    }
+};
+
+// The bulk read a sketch would use: Stream's readBytes() as it was, readAvailable() now
+static size_t ReadChunk(ByteLoopback& stream, uint8_t* data, size_t length) { return stream.readBytes(data, length); }
+static size_t ReadChunk(LoopbackStream& stream, uint8_t* data, size_t length)
+{
+    return stream.readAvailable(data, length);
+}
+
+// Messages of range(0) bytes through a buffer of range(1) bytes, written and read back in bulk
+template <typename T>
+static void BM_Chunks(benchmark::State& state)
+{
+    const size_t chunk = state.range(0);
+    T stream(state.range(1));
+    std::vector<uint8_t> in(chunk, 'x'), out(chunk);
+    Stream& s = stream;
+    for (auto _ : state)
+    {
+        s.write(in.data(), chunk);
+        benchmark::DoNotOptimize(ReadChunk(stream, out.data(), chunk));
+    }
+    state.SetBytesProcessed(state.iterations() * chunk);
+}
+
+// One byte per call, as the AsyncLiquidCrystal command queue uses it
+template <typename T>
+static void BM_Bytes(benchmark::State& state)
+{
+    T stream(state.range(1));
+    Stream& s = stream;
+    for (auto _ : state)
+    {
+        for (int i = 0; i < 32; ++i) s.write(uint8_t(i));
+        for (int i = 0; i < 32; ++i) benchmark::DoNotOptimize(s.read());
+    }
+    state.SetBytesProcessed(state.iterations() * 32);
+}
+
+// Looks for a newline that isn't there in a full buffer, wrapped half way
+template <typename T>
+static void BM_Contains(benchmark::State& state)
+{
+    const size_t capacity = state.range(0);
+    T stream(capacity);
+    std::vector<uint8_t> fill(capacity, 'x');
+    stream.write(fill.data(), capacity / 2);
+    std::vector<uint8_t> drain(capacity / 2);
+    ReadChunk(stream, drain.data(), capacity / 2);
+    stream.write(fill.data(), capacity);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(stream.contains('\n'));
+    }
+    state.SetBytesProcessed(state.iterations() * capacity);
+}
+
+static void ChunkArgs(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({"chunk", "capacity"});
+    for (int chunk : {8, 64, 512})
+    {
+        b->Args({chunk, 1024})->Args({chunk, 1000});
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Chunks, ByteLoopback)->Apply(ChunkArgs);
+BENCHMARK_TEMPLATE(BM_Chunks, LoopbackStream)->Apply(ChunkArgs);
+BENCHMARK_TEMPLATE(BM_Bytes, ByteLoopback)->ArgNames({"", "capacity"})->Args({0, 64})->Args({0, 50});
+BENCHMARK_TEMPLATE(BM_Bytes, LoopbackStream)->ArgNames({"", "capacity"})->Args({0, 64})->Args({0, 50});
+BENCHMARK_TEMPLATE(BM_Contains, ByteLoopback)->ArgName("capacity")->Arg(64)->Arg(1000);
+BENCHMARK_TEMPLATE(BM_Contains, LoopbackStream)->ArgName("capacity")->Arg(64)->Arg(1000);
+
+// What it takes to share a LoopbackStream between threads
+struct LockedLoopback
+{
+    LoopbackStream stream;
+    std::mutex lock;
+
+    LockedLoopback(uint16_t size) : stream(size) {}
+
+    size_t write(const uint8_t* data, size_t length)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return stream.write(data, length);
+    }
+
+    size_t readAvailable(uint8_t* data, size_t length)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return stream.readAvailable(data, length);
+    }
+};
+
+// Chunks of range(0) bytes go from the benchmark thread to a reader thread through a 1024 byte buffer. Both sides
+// yield when they can't make progress, which matters on single core hosts. With range(1), SpscStream is used zero
+// copy: the writer fills reserve() spans and the reader sums peekSpan() ones.
+template <typename T>
+static void BM_TwoThreads(benchmark::State& state)
+{
+    const size_t chunk = state.range(0);
+    const bool zeroCopy = state.range(1);
+    T channel(1024);
+    std::vector<uint8_t> data(chunk, 'x');
+    std::atomic<bool> done(false);
+    uint64_t sum = 0;
+
+    std::thread reader([&] {
+        uint8_t buffer[1024];
+        for (;;)
+        {
+            size_t n = zeroCopy ? ReadSpan(channel, sum) : channel.readAvailable(buffer, sizeof(buffer));
+            if (n == 0)
+            {
+                if (done) break;
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for (auto _ : state)
+    {
+        for (size_t sent = 0; sent < chunk;)
+        {
+            size_t n = zeroCopy ? WriteSpan(channel, chunk - sent) : channel.write(data.data() + sent, chunk - sent);
+            if (n == 0) std::this_thread::yield();
+            sent += n;
+        }
+    }
+    done = true;
+    reader.join();
+    benchmark::DoNotOptimize(sum);
+    state.SetBytesProcessed(state.iterations() * chunk);
+}
+
+static size_t ReadSpan(LockedLoopback&, uint64_t&) { return 0; }
+static size_t WriteSpan(LockedLoopback&, size_t) { return 0; }
+
+static size_t ReadSpan(SpscStream& stream, uint64_t& sum)
+{
+    const uint8_t* span;
+    size_t n = stream.peekSpan(span);
+    for (size_t i = 0; i < n; ++i) sum += span[i];
+    stream.consume(n);
+    return n;
+}
+
+static size_t WriteSpan(SpscStream& stream, size_t length)
+{
+    uint8_t* span;
+    size_t n = std::min(stream.reserve(span), length);
+    memset(span, 'x', n);
+    stream.commit(n);
+    return n;
+}
+
+BENCHMARK_TEMPLATE(BM_TwoThreads, LockedLoopback)->ArgNames({"chunk", "zeroCopy"})->Args({1, 0})->Args({64, 0})->Args({512, 0})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_TwoThreads, SpscStream)->ArgNames({"chunk", "zeroCopy"})->Args({1, 0})->Args({64, 0})->Args({512, 0})->Args({512, 1})->UseRealTime();
+
+BENCHMARK_MAIN();
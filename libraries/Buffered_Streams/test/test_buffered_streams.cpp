@@ -0,0 +1,354 @@
+#include <gtest/gtest.h>
+
+#include "../src/PipedStream.h"
+#include "../src/SpscStream.h"
+
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Random writes and reads, one byte and bulk, checked against a deque
+static void RandomTraffic(uint16_t capacity, uint32_t seed)
+{
+    LoopbackStream stream(capacity);
+    std::deque<uint8_t> model;
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(2 * capacity + 3), out(2 * capacity + 3);
+
+    for (int op = 0; op < 20000; ++op)
+    {
+        size_t length = rng() % data.size();
+        switch (rng() % 6)
+        {
+            case 0:
+            {
+                uint8_t v = rng();
+                size_t expected = model.size() < capacity ? 1 : 0;
+                ASSERT_EQ(expected, stream.write(v));
+                if (expected) model.push_back(v);
+                break;
+            }
+            case 1:
+            case 2:
+            {
+                for (size_t i = 0; i < length; ++i) data[i] = rng();
+                size_t expected = std::min(length, capacity - model.size());
+                ASSERT_EQ(expected, stream.write(data.data(), length));
+                model.insert(model.end(), data.begin(), data.begin() + expected);
+                break;
+            }
+            case 3:
+            {
+                int expected = model.empty() ? -1 : model.front();
+                ASSERT_EQ(expected, stream.peek());
+                ASSERT_EQ(expected, stream.read());
+                if (!model.empty()) model.pop_front();
+                break;
+            }
+            case 4:
+            {
+                size_t expected = std::min(length, model.size());
+                ASSERT_EQ(expected, stream.readAvailable(out.data(), length));
+                for (size_t i = 0; i < expected; ++i)
+                {
+                    ASSERT_EQ(model.front(), out[i]);
+                    model.pop_front();
+                }
+                break;
+            }
+            case 5:
+            {
+                char ch = rng() % 16;  // often there, often not
+                bool expected = std::find(model.begin(), model.end(), uint8_t(ch)) != model.end();
+                ASSERT_EQ(expected, stream.contains(ch));
+                break;
+            }
+        }
+        ASSERT_EQ(int(model.size()), stream.available());
+        ASSERT_EQ(int(capacity - model.size()), stream.availableForWrite());
+    }
+}
+
+TEST(BufferedStreams, LoopbackPowerOfTwo)
+{
+    RandomTraffic(64, 1);
+    RandomTraffic(1024, 2);
+}
+
+TEST(BufferedStreams, LoopbackOtherSizes)
+{
+    RandomTraffic(1, 3);
+    RandomTraffic(50, 4);
+    RandomTraffic(1000, 5);
+}
+
+TEST(BufferedStreams, PipedBulk)
+{
+    PipedStreamPair pipe(16);
+    const char message[] = "ping pong ping pong";
+
+    EXPECT_EQ(16u, pipe.first.write((const uint8_t*)message, sizeof(message) - 1));
+    EXPECT_EQ(0u, pipe.first.write('!'));
+    EXPECT_EQ(0, pipe.first.available());
+    EXPECT_EQ(16, pipe.second.available());
+
+    char received[32] = {};
+    EXPECT_EQ(10u, pipe.second.readAvailable(received, 10));
+    EXPECT_EQ(3u, pipe.first.write("ng!"));
+    EXPECT_EQ(9u, pipe.second.readAvailable(received + 10, sizeof(received) - 10));
+    EXPECT_STREQ("ping pong ping png!", received);
+}
+
+TEST(BufferedStreams, LoopbackReadBytesIsStreams)
+{
+    // readAvailable() doesn't hide the readBytes() of Stream, which reads a byte at a time until the timeout
+    LoopbackStream stream(8);
+    stream.print("abcdef");
+
+    char received[8] = {};
+    EXPECT_EQ(2u, stream.readAvailable(received, 2));
+    EXPECT_EQ(4u, stream.readBytes(received + 2, sizeof(received) - 2));
+    EXPECT_STREQ("abcdef", received);
+    EXPECT_EQ(0u, stream.readAvailable(received, sizeof(received)));
+}
+
+TEST(BufferedStreams, LoopbackContainsHighBytes)
+{
+    // Bytes from 0x80 are found too, where the char is negative, including after the data wraps around
+    LoopbackStream stream(8);
+    const uint8_t data[] = {0x41, 0xC3, 0xA9, 0xFF, 0x42};
+
+    for (int round = 0; round < 3; ++round)
+    {
+        ASSERT_EQ(sizeof(data), stream.write(data, sizeof(data)));
+
+        EXPECT_TRUE(stream.contains('A'));
+        EXPECT_TRUE(stream.contains((char)0xC3));
+        EXPECT_TRUE(stream.contains((char)0xA9));
+        EXPECT_TRUE(stream.contains((char)0xFF));
+        EXPECT_FALSE(stream.contains((char)0x80));
+        EXPECT_FALSE(stream.contains((char)0xC2));
+
+        stream.read();
+        stream.read();
+        EXPECT_FALSE(stream.contains((char)0xC3));
+        EXPECT_TRUE(stream.contains((char)0xFF));
+
+        char rest[8];
+        ASSERT_EQ(3u, stream.readAvailable(rest, sizeof(rest)));
+    }
+}
+
+// The same with SpscStream, adding the zero copy calls and clear()
+static void RandomSpscTraffic(uint16_t capacity, uint32_t seed)
+{
+    SpscStream stream(capacity);
+    ASSERT_EQ(capacity, stream.size());
+    std::deque<uint8_t> model;
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(2 * capacity + 3), out(2 * capacity + 3);
+
+    for (int op = 0; op < 20000; ++op)
+    {
+        size_t length = rng() % data.size();
+        switch (rng() % 9)
+        {
+            case 0:
+            {
+                uint8_t v = rng();
+                size_t expected = model.size() < capacity ? 1 : 0;
+                ASSERT_EQ(expected, stream.write(v));
+                if (expected) model.push_back(v);
+                break;
+            }
+            case 1:
+            {
+                for (size_t i = 0; i < length; ++i) data[i] = rng();
+                size_t expected = std::min(length, capacity - model.size());
+                ASSERT_EQ(expected, stream.write(data.data(), length));
+                model.insert(model.end(), data.begin(), data.begin() + expected);
+                break;
+            }
+            case 2:
+            {
+                uint8_t* span;
+                size_t room = stream.reserve(span);
+                ASSERT_LE(room, capacity - model.size());
+                ASSERT_TRUE(room > 0 || model.size() == capacity);
+                size_t n = room ? rng() % (room + 1) : 0;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    span[i] = rng();
+                    model.push_back(span[i]);
+                }
+                stream.commit(n);
+                break;
+            }
+            case 3:
+            {
+                int expected = model.empty() ? -1 : model.front();
+                ASSERT_EQ(expected, stream.peek());
+                ASSERT_EQ(expected, stream.read());
+                if (!model.empty()) model.pop_front();
+                break;
+            }
+            case 4:
+            case 5:
+            {
+                size_t expected = std::min(length, model.size());
+                ASSERT_EQ(expected, stream.readAvailable(out.data(), length));
+                for (size_t i = 0; i < expected; ++i)
+                {
+                    ASSERT_EQ(model.front(), out[i]);
+                    model.pop_front();
+                }
+                break;
+            }
+            case 6:
+            case 7:
+            {
+                const uint8_t* span;
+                size_t stored = stream.peekSpan(span);
+                ASSERT_LE(stored, model.size());
+                ASSERT_TRUE(stored > 0 || model.empty());
+                size_t n = stored ? rng() % (stored + 1) : 0;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    ASSERT_EQ(model.front(), span[i]);
+                    model.pop_front();
+                }
+                stream.consume(n);
+                break;
+            }
+            case 8:
+                if (rng() % 20 == 0)
+                {
+                    stream.clear();
+                    model.clear();
+                }
+                break;
+        }
+        ASSERT_EQ(int(model.size()), stream.available());
+        ASSERT_EQ(int(capacity - model.size()), stream.availableForWrite());
+    }
+}
+
+TEST(BufferedStreams, Spsc)
+{
+    RandomSpscTraffic(1, 6);
+    RandomSpscTraffic(64, 7);
+    RandomSpscTraffic(1024, 8);
+    EXPECT_EQ(64, SpscStream(50).size());
+    EXPECT_EQ(uint16_t(SpscStream::MAX_SIZE), SpscStream(65535).size());
+}
+
+#ifdef WRAP_MALLOC
+// Linked with --wrap=malloc, so that a test can make malloc fail
+static bool mallocFails = false;
+
+extern "C" void *__real_malloc(size_t size);
+
+extern "C" void *__wrap_malloc(size_t size)
+{
+    return mallocFails ? NULL : __real_malloc(size);
+}
+
+TEST(BufferedStreams, SpscOutOfMemory)
+{
+    mallocFails = true;
+    SpscStream stream(64);
+    mallocFails = false;
+
+    // No room: every write and read does nothing
+    uint8_t data[4] = {1, 2, 3, 4}, *span;
+    const uint8_t *peeked;
+    char chunk[4];
+    EXPECT_EQ(0, stream.size());
+    EXPECT_EQ(0, stream.availableForWrite());
+    EXPECT_EQ(0u, stream.write(uint8_t(5)));
+    EXPECT_EQ(0u, stream.write(data, sizeof(data)));
+    EXPECT_EQ(0u, stream.reserve(span));
+    stream.commit(0);
+    EXPECT_EQ(0, stream.available());
+    EXPECT_EQ(-1, stream.read());
+    EXPECT_EQ(-1, stream.peek());
+    EXPECT_EQ(0u, stream.readAvailable(chunk, sizeof(chunk)));
+    EXPECT_EQ(0u, stream.peekSpan(peeked));
+    stream.clear();
+    EXPECT_EQ(0, stream.available());
+}
+#endif
+
+// A writer thread and a reader thread, each mixing its calls, pass a counting sequence through a small buffer
+TEST(BufferedStreams, SpscThreads)
+{
+    const uint32_t total = 1000000;
+    SpscStream stream(256);
+
+    std::thread writer([&] {
+        std::mt19937 rng(9);
+        uint8_t chunk[100];
+        for (uint32_t next = 0; next < total;)
+        {
+            if (stream.availableForWrite() == 0) std::this_thread::yield();  // for single core hosts
+            switch (rng() % 3)
+            {
+                case 0:
+                    next += stream.write(uint8_t(next));
+                    break;
+                case 1:
+                {
+                    size_t n = std::min<size_t>(1 + rng() % 100, total - next);
+                    for (size_t i = 0; i < n; ++i) chunk[i] = uint8_t(next + i);
+                    next += stream.write(chunk, n);
+                    break;
+                }
+                case 2:
+                {
+                    uint8_t* span;
+                    size_t n = std::min<size_t>(stream.reserve(span), total - next);
+                    for (size_t i = 0; i < n; ++i) span[i] = uint8_t(next + i);
+                    stream.commit(n);
+                    next += n;
+                    break;
+                }
+            }
+        }
+    });
+
+    std::mt19937 rng(10);
+    uint8_t chunk[100];
+    uint32_t next = 0;
+    bool ordered = true;
+    while (next < total && ordered)
+    {
+        if (stream.available() == 0) std::this_thread::yield();
+        switch (rng() % 3)
+        {
+            case 0:
+            {
+                int c = stream.read();
+                if (c >= 0) ordered = c == uint8_t(next++);
+                break;
+            }
+            case 1:
+            {
+                size_t n = stream.readAvailable(chunk, 1 + rng() % 100);
+                for (size_t i = 0; i < n; ++i) ordered &= chunk[i] == uint8_t(next++);
+                break;
+            }
+            case 2:
+            {
+                const uint8_t* span;
+                size_t n = stream.peekSpan(span);
+                for (size_t i = 0; i < n; ++i) ordered &= span[i] == uint8_t(next++);
+                stream.consume(n);
+                break;
+            }
+        }
+    }
+    writer.join();
+    EXPECT_TRUE(ordered) << "byte " << next;
+    EXPECT_EQ(0, stream.available());
+}
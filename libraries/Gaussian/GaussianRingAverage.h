@@ -0,0 +1,146 @@
+/*
+ 	GaussianRingAverage.h - A moving average object with Gaussians,
+ 	of a fixed number of samples
+
+ 	Same as GaussianAverage, without the LinkedList: the last N Gaussians
+ 	are kept in a ring sized at compile time, and the fused Gaussian is
+ 	updated as samples come in and go out, so each sample costs the same
+ 	few operations whatever N is, and nothing is allocated.
+
+	For instructions, go to https://github.com/ivanseidel/Gaussian
+
+	Released into the public domain.
+*/
+
+#ifndef GaussianRingAverage_h
+#define GaussianRingAverage_h
+
+#include "Gaussian.h"
+
+/*
+	The sum of Gaussians (see Gaussian::sum) weights each mean by the
+	inverse of its variance:
+
+		1 / variance = w1 + w2 + ... + wn         with wi = 1 / variance_i
+		mean = (w1 * mean1 + ... + wn * meann) / (w1 + ... + wn)
+
+	The total weight and the mean are kept Welford style (the mean is
+	moved towards each new sample by its share of the weight, and away
+	from each evicted one), which stays accurate with float doubles.
+	Rounding errors would still pile up over a long run, so a second
+	total is built from the samples added since the ring last wrapped
+	around: when it wraps, those are exactly the samples in the ring,
+	and that total replaces the running one.
+
+	All variances MUST be greater than 0.
+*/
+template <int N>
+class GaussianRingAverage: public Gaussian
+{
+protected:
+	// Ring of the last N samples, as means and weights (1 / variance)
+	double means[N];
+	double weights[N];
+
+	// Number of samples in the ring, and where the next one goes
+	int count;
+	int next;
+
+	// Total weight and mean of the samples in the ring
+	double weight, fused;
+
+	// Total weight and mean of the samples added since the ring wrapped
+	double freshWeight, freshMean;
+
+	static void include(double &_weight, double &_mean, double w, double m){
+		_weight += w;
+		_mean += w / _weight * (m - _mean);
+	}
+
+	static void exclude(double &_weight, double &_mean, double w, double m){
+		_weight -= w;
+		_mean = _weight > 0 ? _mean - w / _weight * (m - _mean) : 0.0;
+	}
+
+public:
+	/*
+		Creates a new Gaussian Moving Average that
+		keeps track of the N last Gaussians
+	*/
+	GaussianRingAverage(): Gaussian(){
+		clear();
+	}
+
+	/*
+		Forgets every sample
+	*/
+	void clear(){
+		count = next = 0;
+		weight = fused = 0.0;
+		freshWeight = freshMean = 0.0;
+		mean = 0.0;
+		variance = MAX_VARIANCE;
+	}
+
+	/*
+		Adds a new Gaussian to the ring, in place of the oldest one
+		once it is full
+	*/
+	virtual void add(Gaussian _gaus){
+		double w = 1.0 / _gaus.variance;
+
+		include(weight, fused, w, _gaus.mean);
+		include(freshWeight, freshMean, w, _gaus.mean);
+
+		if(count == N)
+			exclude(weight, fused, weights[next], means[next]);
+		else
+			count++;
+
+		means[next] = _gaus.mean;
+		weights[next] = w;
+
+		if(++next == N){
+			next = 0;
+			weight = freshWeight;
+			fused = freshMean;
+			freshWeight = freshMean = 0.0;
+		}
+	}
+
+	/*
+		Adds a new Gaussian to the ring with the overloaded '+='
+	*/
+	virtual void operator+=(Gaussian _gaus){
+		add(_gaus);
+	}
+
+	/*
+		Adds a new Gaussian to the ring with the overloaded '+='
+	*/
+	virtual void operator+=(double _mean){
+		add(Gaussian(_mean));
+	}
+
+	/*
+		Return the average of all current Gaussians. It is always
+		up to date, so this only copies it to mean and variance.
+	*/
+	virtual Gaussian process(){
+		if(count > 0){
+			mean = fused;
+			variance = 1.0 / weight;
+		}
+
+		return *this;
+	}
+
+	/*
+		Number of samples in the ring
+	*/
+	int size(){
+		return count;
+	}
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include <benchmark/benchmark.h>
+
+#include "../GaussianRingAverage.h"
+
+#include <deque>
+
+// A sample added to a moving average of N Gaussians and the average processed, reported per sample
+
+// What GaussianAverage does with its LinkedList: a node allocated per sample and the window summed again to process
+template <int N>
+struct FoldAverage
+{
+    std::deque<Gaussian> gaussians;
+
+    Gaussian operator()(const Gaussian &sample)
+    {
+        while (gaussians.size() >= N)
+        {
+            gaussians.pop_front();
+        }
+
+        gaussians.push_back(sample);
+
+        Gaussian avg = gaussians[0];
+        for (size_t i = 1; i < gaussians.size(); ++i)
+        {
+            avg = avg + gaussians[i];
+        }
+
+        return avg;
+    }
+};
+
+template <int N>
+struct RingAverage
+{
+    GaussianRingAverage<N> average;
+
+    Gaussian operator()(const Gaussian &sample)
+    {
+        average += sample;
+        return average.process();
+    }
+};
+
+template <typename Average>
+void RunAverage(benchmark::State &state)
+{
+    Average average;
+    uint32_t noise = 12345;
+
+    for (auto _ : state)
+    {
+        noise = noise * 1664525u + 1013904223u;
+        Gaussian sample(20.0 + (noise >> 24) * 0.01, 1.0 + (noise & 0xff) * 0.01);
+        benchmark::DoNotOptimize(average(sample).mean);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <int N>
+void BM_FoldAverage(benchmark::State &state)
+{
+    RunAverage<FoldAverage<N>>(state);
+}
+
+template <int N>
+void BM_GaussianRingAverage(benchmark::State &state)
+{
+    RunAverage<RingAverage<N>>(state);
+}
+
+#define BENCHMARK_AVERAGE(N)                    \
+    BENCHMARK_TEMPLATE(BM_FoldAverage, N);       \
+    BENCHMARK_TEMPLATE(BM_GaussianRingAverage, N)
+
+BENCHMARK_AVERAGE(4);
+BENCHMARK_AVERAGE(30);
+BENCHMARK_AVERAGE(200);
+
+BENCHMARK_MAIN();
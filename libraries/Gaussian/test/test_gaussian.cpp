@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include "../GaussianRingAverage.h"
+
+#include <vector>
+
+namespace
+{
+
+// A deterministic stand in for sensor readings and their uncertainty
+struct Readings
+{
+    uint32_t state = 12345;
+
+    float operator()(float low, float high)
+    {
+        state = state * 1664525u + 1013904223u;
+        return low + (high - low) * float(state >> 8) / float(1 << 24);
+    }
+};
+
+// The sum of the last n Gaussians, as GaussianAverage::process works it out
+Gaussian Fold(const std::vector<Gaussian> &history, size_t n)
+{
+    size_t first = history.size() > n ? history.size() - n : 0;
+    Gaussian avg = history[first];
+
+    for (size_t i = first + 1; i < history.size(); ++i)
+    {
+        avg = avg + history[i];
+    }
+
+    return avg;
+}
+
+}  // namespace
+
+TEST(Gaussian, RingAverageMatchesFold)
+{
+    GaussianRingAverage<7> average;
+    Readings readings;
+    std::vector<Gaussian> history;
+
+    EXPECT_EQ(average.size(), 0);
+    EXPECT_EQ(average.process().variance, MAX_VARIANCE);
+
+    for (int k = 0; k < 1000; ++k)
+    {
+        // Mostly similar variances, with now and then a very confident or a very noisy sample
+        float variance = readings(1.0f, 4.0f);
+        if (k % 37 == 0)
+        {
+            variance = 1e-3f;
+        }
+        else if (k % 41 == 0)
+        {
+            variance = 1e4f;
+        }
+
+        Gaussian sample(readings(20.0f, 30.0f), variance);
+        history.push_back(sample);
+        average += sample;
+
+        Gaussian expected = Fold(history, 7);
+        Gaussian processed = average.process();
+        ASSERT_NEAR(processed.mean, expected.mean, 1e-9 * fabs(expected.mean)) << "sample " << k;
+        ASSERT_NEAR(processed.variance, expected.variance, 1e-9 * expected.variance) << "sample " << k;
+        ASSERT_EQ(average.mean, processed.mean);
+    }
+
+    EXPECT_EQ(average.size(), 7);
+}
+
+TEST(Gaussian, RingAverageOfValues)
+{
+    // Plain values all have the default variance, so their average is the arithmetic mean
+    GaussianRingAverage<4> average;
+
+    average += 10.0;
+    average += 20.0;
+    EXPECT_NEAR(average.process().mean, 15.0, 1e-9);
+
+    average += 30.0;
+    average += 40.0;
+    average += 50.0;
+    EXPECT_NEAR(average.process().mean, 35.0, 1e-9);
+    EXPECT_NEAR(average.variance, MAX_VARIANCE / 4.0, 1e-3);
+
+    // The Gaussian arithmetic is still there
+    Gaussian sum = average.process() + Gaussian(35.0, 1.0);
+    EXPECT_NEAR(sum.mean, 35.0, 1e-9);
+
+    average.clear();
+    EXPECT_EQ(average.size(), 0);
+}
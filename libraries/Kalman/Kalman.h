@@ -35,6 +35,13 @@
 
 #include <Arduino.h>
 
+// Messages are kept in flash with F(), where the core provides it
+#ifdef F
+#define KALMAN_F(string_literal) F(string_literal)
+#else
+#define KALMAN_F(string_literal) (string_literal)
+#endif
+
 #define KALMAN_CHECK true
 #define KALMAN_VERBOSE false
 
@@ -42,173 +49,544 @@ using namespace BLA;
 
 /**********    PARTICULAR MATRIX DEFINITION    **********/
 // These matrices require less memory than normal ones.
-// If your matrices are symmetric or triangular, use these ones for Arduino SRAM saving
+// If your F matrix is symmetric, diagonal or triangular, give one of these as MemF template argument of KALMAN
+// for Arduino SRAM saving. They are the packed matrices of BasicLinearAlgebra under their former names.
+
+template<int dim, class ElemT = float> using Symmetric = BLA::SymmetricMatrix<dim,ElemT>;
+template<int dim, class ElemT = float> using Diagonal = BLA::DiagonalMatrix<dim,ElemT>;
+template<int dim, class ElemT = float> using TriangularSup = BLA::PackedUpperTriangularMatrix<dim,ElemT>;
+template<int dim, class ElemT = float> using TriangularInf = BLA::PackedLowerTriangularMatrix<dim,ElemT>;
+
+
+/**********      CLASS DEFINITION      **********/
+
+// MemF is the matrix type used to store F, e.g. Symmetric<Nstate>, Diagonal<Nstate>...
+// MemR is the matrix type used to store R. If your sensors have independent noises, use Diagonal<Nobs>: observations
+// are then processed one at a time without any matrix factorisation, and may also be given to the filter one by one
+// with 'update(i, obs_i)' as they arrive.
+template<int Nstate, int Nobs, int Ncom = 0, class MemF = BLA::Matrix<Nstate,Nstate>, class MemR = BLA::SymmetricMatrix<Nobs> >
+class KALMAN{
+  private:
+    void _update(const BLA::Matrix<Nobs> &obs, const BLA::Matrix<Nstate> &comstate);
+    void _predict(const BLA::Matrix<Nstate> &comstate);
+    template<class RType> bool _correct(const BLA::Matrix<Nobs> &obs, const RType &);
+    bool _correct(const BLA::Matrix<Nobs> &obs, const BLA::DiagonalMatrix<Nobs> &);
+    bool _correctone(int i, float obs);
+    bool _checkx();
+    uint32_t _modelhash();
+    uint32_t _hash; // hash of F, H, Q and R when the steady-state gain was computed
+  public:
+	//INPUT MATRICES
+    MemF F; // time evolution matrix
+    BLA::Matrix<Nobs,Nstate> H; // observation matrix
+    BLA::Matrix<Nstate,Ncom> B; // Command matrix (optional)
+    BLA::SymmetricMatrix<Nstate> Q; // model noise covariance matrix
+    MemR R; // measure noise covariance matrix
+	//OUTPUT MATRICES
+    BLA::SymmetricMatrix<Nstate> P; // posterior covariance (do not modify, except to init!)
+    BLA::Matrix<Nstate> x; // state vector (do not modify, except to init!)
+
+    int status; // 0 if the last update of the Kalman filter computed correctly
+
+    // STEADY STATE (for constant F, H, Q and R)
+    BLA::Matrix<Nstate,Nobs> Kss; // steady-state Kalman gain (do not modify, use 'setgain')
+    bool steady; // true while updates use 'Kss' (do not modify)
+
+    // COMPUTE THE STEADY-STATE GAIN by iterating the covariance update until the gain changes by less than tol.
+    // Following updates then only cost x = F*x + Kss*(obs - H*F*x), until F, H, Q or R are modified
+    bool begin(int maxiter = 1000, float tol = 1e-6);
+
+    // LOAD A STEADY-STATE GAIN computed offline (e.g. on your computer)
+    void setgain(const BLA::Matrix<Nstate,Nobs> &gain);
+
+    // UPDATE FILTER WITH OBSERVATION
+    void update(const BLA::Matrix<Nobs> &obs);
+
+    // UPDATE FILTER WITH OBSERVATION and COMMAND
+    void update(const BLA::Matrix<Nobs> &obs, const BLA::Matrix<Ncom> &com);
+
+    // ASYNCHRONOUS UPDATES (only when R is Diagonal)
+    // Call 'predict' at each time step, then 'update(i, obs_i)' whenever the i-th observation is available
+    void predict();
+    void predict(const BLA::Matrix<Ncom> &com);
+    void update(int i, float obs_i);
 
-// Symmetric (i=row*cols+col)
-template<int dim, class ElemT> struct Symmetric{
-  mutable ElemT m[dim*(dim+1)/2];
-  typedef ElemT elem_t;
-  ElemT &operator()(int row, int col) const{
-    static ElemT dummy;
-    if(col < dim && row < dim){
-      if(col < row){ // swap row and col
-        ElemT temp = row;
-        row = col;
-        col = temp;
+    // CONSTRUCTOR
+  	KALMAN<Nstate,Nobs,Ncom,MemF,MemR>();
+
+    // GETTER on X (copy vector to avoid eventual user modifications)
+    BLA::Matrix<Nstate> getxcopy();
+
+};
+
+/**********      PRIVATE IMPLEMENTATION of UPDATE      **********/
+
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+void KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::_update(const BLA::Matrix<Nobs> &obs, const BLA::Matrix<Nstate> &comstate){
+  this->status = 0;
+  if(KALMAN_CHECK){
+    for(int i=0;i<Nobs;i++){
+      if(isnan(obs(i)) || isinf(obs(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: observation has nan or inf values"));}
+        status = 1;
+        return;
       }
-      return m[(2*dim-row+1)*row/2+col-row];
-    }else
-      return (dummy = 0);
+    }
+  }
+  if(this->steady){
+    if(_modelhash() == this->_hash){
+      this->x = this->F * this->x + comstate;
+      this->x += this->Kss * (obs - this->H * this->x);
+      if(!_checkx()){
+        status = 1;
+      }
+      return;
+    }
+    if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:INFO: model changed, back to full update"));}
+    this->steady = false;
+  }
+  // UPDATE
+  _predict(comstate);
+  // ESTIMATION
+  if(!_correct(obs, this->R)){
+    if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: S matrix is not positive definite. Try to reset P matrix."));}
+    status = 1;
+    this->P.Fill(0.0); // try to reset P. Better strategy?
+    return;
+  }
+  if(!_checkx()){
+    status = 1;
   }
 };
 
-// SkewSymmetric (i=row*cols+col)
-template<int dim, class ElemT> struct SkewSymmetric{
-  mutable ElemT m[dim*(dim+1)/2];
-  typedef ElemT elem_t;
-  ElemT &operator()(int row, int col) const{
-    static ElemT dummy;
-    if(col < dim && row < dim && row!=col){
-		if(col < row){
-			return -m[(2*dim-col+1)*col/2+row-col];
-		}else{
-			return m[(2*dim-row+1)*row/2+col-row];
-		}
-    }else{
-      return (dummy = 0);
-	}
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+void KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::_predict(const BLA::Matrix<Nstate> &comstate){
+  this->x = this->F * this->x + comstate;
+  this->P = this->F * this->P * (~ this->F) + this->Q;
+};
+
+/**********      ESTIMATION with FULL R      **********/
+
+// Computes the transposed gain Kt of the observation H with noise R and updates P accordingly.
+// Shared by KALMAN and KALMAN_EKF, which gives it the Jacobian of its observation function as H
+namespace kalman_detail{
+template<int Nstate, int Nobs, class HType, class RType>
+bool kalman_gain(BLA::SymmetricMatrix<Nstate> &P, const HType &H, const RType &R, BLA::Matrix<Nobs,Nstate> &Kt){
+  // S = H*P*H' + R is symmetric positive definite, so rather than inverting it the gain comes from its Cholesky
+  // factor: K' = S^{-1}*(H*P), which is solved one column at a time
+  BLA::Matrix<Nobs,Nstate> HP = H * P;
+  BLA::SymmetricMatrix<Nobs> S = HP * (~ H) + R;
+  auto chol = CholeskyDecompose(S); // factorise inplace (lower triangle of S <- L)
+  if(!chol.positive_definite){
+    return false;
   }
+  Kt = CholeskySolve(chol, HP);
+  // Joseph form P = (I-K*H)*P*(I-K*H)' + K*R*K' keeps P symmetric positive definite despite rounding errors.
+  // With M = (I-K*H)*P = P - K*(H*P) it is worked out as M - (M*H')*K' + K*R*K', which avoids any Nstate^3 product
+  BLA::Matrix<Nstate,Nstate> M = P - (~Kt) * HP;
+  P = M - (M * (~ H)) * Kt + (~Kt) * R * Kt;
+  return true;
 };
+} // namespace kalman_detail
 
-// Triangular sup (i=row*cols+col)
-template<int dim, class ElemT> struct TriangularSup{
-  mutable ElemT m[dim*(dim+1)/2];
-  typedef ElemT elem_t;
-  ElemT &operator()(int row, int col) const{
-    static ElemT dummy;
-    if(col < dim && row < dim && col>=row){
-      return m[(2*dim-row+1)*row/2+col-row];
-    }else
-      return (dummy = 0);
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+template <class RType>
+bool KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::_correct(const BLA::Matrix<Nobs> &obs, const RType &){
+  BLA::Matrix<Nobs,Nstate> Kt; // transposed Kalman gain matrix
+  if(!kalman_detail::kalman_gain(this->P, this->H, this->R, Kt)){
+    return false;
   }
+  this->x += (~Kt)*(obs - this->H * this->x); // K*y
+  return true;
 };
 
-// Triangular inf (i=row*cols+col)
-template<int dim, class ElemT> struct TriangularInf{
-  mutable ElemT m[dim*(dim+1)/2];
-  typedef ElemT elem_t;
-  ElemT &operator()(int row, int col) const{
-    static ElemT dummy;
-    if(col < dim && row < dim && row>=col){
-      return m[(2*dim-col+1)*col/2+row-col];
-    }else
-      return (dummy = 0);
+/**********      ESTIMATION with DIAGONAL R      **********/
+
+// Independent noises: observations are processed one after the other, each as a scalar update
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+bool KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::_correct(const BLA::Matrix<Nobs> &obs, const BLA::DiagonalMatrix<Nobs> &){
+  for(int i=0;i<Nobs;i++){
+    if(!_correctone(i, obs(i))){
+      return false;
+    }
   }
+  return true;
 };
 
-// Diagonal template comes from Tom Stewart (BasicLinearAlgebra)
-template<int dim, class ElemT> struct Diagonal{
-    mutable ElemT m[dim];
-    // The only requirement on this class is that it implement the () operator like so:
-    typedef ElemT elem_t;
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+bool KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::_correctone(int i, float obs){
+  // With h the i-th row of H, S = h*P*h' + R(i,i) is a scalar and K = P*h'/S a vector
+  BLA::Matrix<Nstate> Ph;
+  float s = this->R(i,i);
+  float y = obs;
+  for(int j=0;j<Nstate;j++){
+    Ph(j) = 0.0;
+    for(int k=0;k<Nstate;k++){
+      Ph(j) += this->P(j,k) * this->H(i,k);
+    }
+    s += this->H(i,j) * Ph(j);
+    y -= this->H(i,j) * this->x(j);
+  }
+  if(!(s > 0.0)){
+    return false;
+  }
+  BLA::Matrix<Nstate> K = Ph * (1.0f / s);
+  this->x += K * y;
+  // Joseph form, which for a scalar observation reduces to P - K*(P*h')' - (P*h')*K' + S*K*K'
+  for(int j=0;j<Nstate;j++){
+    for(int k=0;k<=j;k++){
+      this->P(j,k) += s * K(j) * K(k) - K(j) * Ph(k) - Ph(j) * K(k);
+    }
+  }
+  return true;
+};
 
-    ElemT &operator()(int row, int col) const
-    {
-        static ElemT dummy;
-        // If it's on the diagonal and it's not larger than the matrix dimensions then return the element
-        if(row == col && row < dim)
-            return m[row];
-        else
-            return (dummy = 0);
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+bool KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::_checkx(){
+  if(KALMAN_CHECK){
+    for(int i=0;i<Nstate;i++){
+      if(isnan(this->x(i)) || isinf(this->x(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: estimated vector has nan or inf values"));}
+        return false;
+      }
     }
+  }
+  return true;
 };
 
 
+/**********      UPDATE with OBS & COM      **********/
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+void KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::update(const BLA::Matrix<Nobs> &obs, const BLA::Matrix<Ncom> &com){
+  if(KALMAN_CHECK){
+    for(int i=0;i<Ncom;i++){
+      if(isnan(com(i)) || isinf(com(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: command has nan or inf values"));}
+        status = 1;
+        return;
+      }
+    }
+  }
+  _update(obs,this->B *com);
+};
 
-/**********      CLASS DEFINITION      **********/
+/**********      UPDATE with OBS      **********/
 
-// Last arg of template allows to eventually define Symmetric, AntiSymmetric, TriangularSup or TriangularInf matrices for memory saving
-template<int Nstate, int Nobs, int Ncom = 0, class MemF = Array<Nstate,Nstate,float> >
-class KALMAN{
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+void KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::update(const BLA::Matrix<Nobs> &obs){
+  _update(obs,BLA::Zeros<Nstate>());
+};
+
+/**********      STEADY STATE      **********/
+
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+bool KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::begin(int maxiter, float tol){
+  this->steady = false;
+  this->status = 0;
+  BLA::Matrix<Nobs,Nstate> Kt;
+  BLA::Matrix<Nobs,Nstate> Kprev;
+  Kprev.Fill(0.0);
+  for(int iter=0;iter<maxiter;iter++){
+    // Riccati recursion: the covariance update of the filter without any observation
+    this->P = this->F * this->P * (~ this->F) + this->Q;
+    if(!kalman_detail::kalman_gain(this->P, this->H, this->R, Kt)){
+      if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: S matrix is not positive definite. Try to reset P matrix."));}
+      status = 1;
+      return false;
+    }
+    float change = 0.0;
+    float largest = 0.0;
+    for(int i=0;i<Nobs;i++){
+      for(int j=0;j<Nstate;j++){
+        float diff = fabs(Kt(i,j) - Kprev(i,j));
+        float gain = fabs(Kt(i,j));
+        if(diff > change){change = diff;}
+        if(gain > largest){largest = gain;}
+      }
+    }
+    if(iter > 0 && change <= tol * largest){
+      setgain(~Kt);
+      return true;
+    }
+    Kprev = Kt;
+  }
+  if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: steady-state gain did not converge"));}
+  status = 1;
+  return false;
+};
+
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+void KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::setgain(const BLA::Matrix<Nstate,Nobs> &gain){
+  this->Kss = gain;
+  this->_hash = _modelhash();
+  this->steady = true;
+};
+
+// Hash of the memory of the model matrices, to notice when they are modified. It is worked out word by word with
+// h = 31*h + word, which costs far less than the update it guards even on 8-bit boards
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+uint32_t KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::_modelhash(){
+  const void *mats[4] = {this->F.storage, this->H.storage, this->Q.storage, this->R.storage};
+  const size_t sizes[4] = {sizeof(this->F.storage), sizeof(this->H.storage), sizeof(this->Q.storage), sizeof(this->R.storage)};
+  uint32_t hash = 0;
+  for(int m=0;m<4;m++){
+    const uint8_t *bytes = (const uint8_t *)mats[m];
+    for(size_t i=0;i+sizeof(uint32_t)<=sizes[m];i+=sizeof(uint32_t)){
+      uint32_t word;
+      memcpy(&word, bytes + i, sizeof(uint32_t));
+      hash = (hash << 5) - hash + word;
+    }
+  }
+  return hash;
+};
+
+/**********      ASYNCHRONOUS PREDICTION      **********/
+
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+void KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::predict(){
+  this->status = 0;
+  _predict(BLA::Zeros<Nstate>());
+};
+
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+void KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::predict(const BLA::Matrix<Ncom> &com){
+  this->status = 0;
+  if(KALMAN_CHECK){
+    for(int i=0;i<Ncom;i++){
+      if(isnan(com(i)) || isinf(com(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: command has nan or inf values"));}
+        status = 1;
+        return;
+      }
+    }
+  }
+  _predict(this->B * com);
+};
+
+/**********      ASYNCHRONOUS UPDATE with ONE OBS      **********/
+
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+void KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::update(int i, float obs_i){
+  static_assert(IsSame<MemR, BLA::DiagonalMatrix<Nobs> >::value, "KALMAN: single observations need a Diagonal R");
+  this->status = 0;
+  if(KALMAN_CHECK){
+    if(i < 0 || i >= Nobs || isnan(obs_i) || isinf(obs_i)){
+      if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: observation has nan or inf values"));}
+      status = 1;
+      return;
+    }
+  }
+  if(!_correctone(i, obs_i)){
+    if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: S matrix is not positive definite. Try to reset P matrix."));}
+    status = 1;
+    this->P.Fill(0.0); // try to reset P. Better strategy?
+    return;
+  }
+  if(!_checkx()){
+    status = 1;
+  }
+};
+
+/**********      CONSTRUCTOR      **********/
+
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::KALMAN(){
+  if(KALMAN_VERBOSE){
+    Serial.println(KALMAN_F("KALMAN:INFO: Initialize filter"));
+  }
+  this->P.Fill(0.0);
+  this->x.Fill(0.0);
+  this->status = 0;
+  this->steady = false;
+};
+
+/**********      GETXCOPY      **********/
+
+template <int Nstate, int Nobs, int Ncom, class MemF, class MemR>
+BLA::Matrix<Nstate> KALMAN<Nstate,Nobs,Ncom,MemF,MemR>::getxcopy(){
+  BLA::Matrix<Nstate> out;
+  for(int i=0;i<Nstate;i++){
+    out(i) = this->x(i);
+  }
+  return out;
+};
+
+
+/**********      UD FACTORIZED FILTER      **********/
+
+// Same filter with the covariance kept as P = U*D*U', where U is unit upper triangular and D diagonal (Bierman-Thornton).
+// P stays symmetric positive definite by construction, so it is numerically stable in float where the plain
+// covariance update would need double. Noises must be independent: Q and R are diagonal.
+// Initialize the covariance with 'setP' and read it back with 'getP'.
+template<int Nstate, int Nobs, int Ncom = 0, class MemF = BLA::Matrix<Nstate,Nstate> >
+class KALMAN_UD{
   private:
-    void _update(BLA::Matrix<Nobs> obs, BLA::Matrix<Nstate> comstate);
-    BLA::Identity<Nstate,Nstate> Id; // Identity matrix
+    void _update(const BLA::Matrix<Nobs> &obs, const BLA::Matrix<Nstate> &comstate);
+    void _predict(const BLA::Matrix<Nstate> &comstate);
+    bool _correctone(int i, float obs);
+    bool _checkx();
   public:
-	//INPUT MATRICES			
-    BLA::Matrix<Nstate,Nstate,MemF> F; // time evolution matrix
+	//INPUT MATRICES
+    MemF F; // time evolution matrix
     BLA::Matrix<Nobs,Nstate> H; // observation matrix
     BLA::Matrix<Nstate,Ncom> B; // Command matrix (optional)
-    BLA::Matrix<Nstate,Nstate, Symmetric<Nstate,float> > Q; // model noise covariance matrix
-    BLA::Matrix<Nobs,Nobs, Symmetric<Nobs,float> > R; // measure noise covariance matrix
+    BLA::DiagonalMatrix<Nstate> Q; // model noise covariance matrix
+    BLA::DiagonalMatrix<Nobs> R; // measure noise covariance matrix
 	//OUTPUT MATRICES
-    BLA::Matrix<Nstate,Nstate, Symmetric<Nstate,float> > P; // posterior covariance (do not modify, except to init!)
+    BLA::PackedUpperTriangularMatrix<Nstate> U; // unit upper triangular factor of P (do not modify, use 'setP')
+    BLA::DiagonalMatrix<Nstate> D; // diagonal factor of P (do not modify, use 'setP')
     BLA::Matrix<Nstate> x; // state vector (do not modify, except to init!)
 
-    int status; // 0 if Kalman filter computed correctly
+    int status; // 0 if the last update of the Kalman filter computed correctly
 
     // UPDATE FILTER WITH OBSERVATION
-    void update(BLA::Matrix<Nobs> obs);
+    void update(const BLA::Matrix<Nobs> &obs);
 
     // UPDATE FILTER WITH OBSERVATION and COMMAND
-    void update(BLA::Matrix<Nobs> obs, BLA::Matrix<Ncom> com);
+    void update(const BLA::Matrix<Nobs> &obs, const BLA::Matrix<Ncom> &com);
+
+    // ASYNCHRONOUS UPDATES
+    void predict();
+    void predict(const BLA::Matrix<Ncom> &com);
+    void update(int i, float obs_i);
+
+    // SET and GET the covariance P = U*D*U'
+    void setP(const BLA::SymmetricMatrix<Nstate> &P);
+    BLA::SymmetricMatrix<Nstate> getP();
 
     // CONSTRUCTOR
-  	KALMAN<Nstate,Nobs,Ncom,MemF>();
+  	KALMAN_UD<Nstate,Nobs,Ncom,MemF>();
 
     // GETTER on X (copy vector to avoid eventual user modifications)
     BLA::Matrix<Nstate> getxcopy();
 
 };
 
-/**********      PRIVATE IMPLEMENTATION of UPDATE      **********/
+/**********      UD TIME UPDATE      **********/
+
+// Thornton's modified weighted Gram-Schmidt: the rows of W = [F*U, I] are orthogonalised with respect to the weights
+// diag(D, Q), which gives the factors of F*P*F' + Q without ever forming it
+template <int Nstate, int Nobs, int Ncom, class MemF>
+void KALMAN_UD<Nstate,Nobs,Ncom,MemF>::_predict(const BLA::Matrix<Nstate> &comstate){
+  this->x = this->F * this->x + comstate;
+  BLA::Matrix<Nstate,Nstate> FU = this->F * this->U;
+  BLA::Matrix<Nstate,Nstate> G = BLA::Eye<Nstate,Nstate>();
+  BLA::DiagonalMatrix<Nstate> Dnew;
+  for(int i=Nstate-1;i>=0;i--){
+    float sigma = 0.0;
+    for(int k=0;k<Nstate;k++){
+      sigma += FU(i,k) * FU(i,k) * this->D(k,k) + G(i,k) * G(i,k) * this->Q(k,k);
+    }
+    Dnew(i,i) = sigma;
+    this->U(i,i) = 1.0;
+    for(int j=0;j<i;j++){
+      float u = 0.0;
+      if(sigma > 0.0){
+        for(int k=0;k<Nstate;k++){
+          u += FU(i,k) * this->D(k,k) * FU(j,k) + G(i,k) * this->Q(k,k) * G(j,k);
+        }
+        u /= sigma;
+      }
+      this->U(j,i) = u;
+      for(int k=0;k<Nstate;k++){
+        FU(j,k) -= u * FU(i,k);
+        G(j,k) -= u * G(i,k);
+      }
+    }
+  }
+  this->D = Dnew;
+};
+
+/**********      UD MEASUREMENT UPDATE      **********/
+
+// Bierman's update for the i-th observation on its own, with h the i-th row of H
+template <int Nstate, int Nobs, int Ncom, class MemF>
+bool KALMAN_UD<Nstate,Nobs,Ncom,MemF>::_correctone(int i, float obs){
+  BLA::Matrix<Nstate> a; // U'*h'
+  BLA::Matrix<Nstate> b; // D*U'*h', becomes the unnormalised gain
+  float y = obs;
+  for(int j=0;j<Nstate;j++){
+    a(j) = this->H(i,j);
+    for(int k=0;k<j;k++){
+      a(j) += this->U(k,j) * this->H(i,k);
+    }
+    b(j) = this->D(j,j) * a(j);
+    y -= this->H(i,j) * this->x(j);
+  }
+  float alpha = this->R(i,i); // innovation variance, built up one state at a time
+  if(!(alpha > 0.0)){
+    return false;
+  }
+  float gamma = 1.0 / alpha;
+  for(int j=0;j<Nstate;j++){
+    float beta = alpha;
+    alpha += a(j) * b(j);
+    float lambda = -a(j) * gamma;
+    gamma = 1.0 / alpha;
+    this->D(j,j) *= beta * gamma;
+    for(int k=0;k<j;k++){
+      beta = this->U(k,j);
+      this->U(k,j) = beta + b(k) * lambda;
+      b(k) += b(j) * beta;
+    }
+  }
+  this->x += b * (y * gamma); // K*y with K = b/alpha
+  return true;
+};
 
 template <int Nstate, int Nobs, int Ncom, class MemF>
-void KALMAN<Nstate,Nobs,Ncom,MemF>::_update(BLA::Matrix<Nobs> obs, BLA::Matrix<Nstate> comstate){
+bool KALMAN_UD<Nstate,Nobs,Ncom,MemF>::_checkx(){
+  if(KALMAN_CHECK){
+    for(int i=0;i<Nstate;i++){
+      if(isnan(this->x(i)) || isinf(this->x(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: estimated vector has nan or inf values"));}
+        return false;
+      }
+    }
+  }
+  return true;
+};
+
+/**********      UD UPDATE with OBS      **********/
+
+template <int Nstate, int Nobs, int Ncom, class MemF>
+void KALMAN_UD<Nstate,Nobs,Ncom,MemF>::_update(const BLA::Matrix<Nobs> &obs, const BLA::Matrix<Nstate> &comstate){
+  this->status = 0;
   if(KALMAN_CHECK){
     for(int i=0;i<Nobs;i++){
       if(isnan(obs(i)) || isinf(obs(i))){
-        if(KALMAN_VERBOSE){Serial.println(F("KALMAN:ERROR: observation has nan or inf values"));}
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: observation has nan or inf values"));}
         status = 1;
         return;
       }
     }
   }
-  BLA::Matrix<Nobs,Nobs> S;
-  BLA::Matrix<Nstate,Nobs> K; // Kalman gain matrix
-  // UPDATE
-  this->x = this->F * this->x + comstate;
-  this->P = this->F * this->P * (~ this->F) + this->Q;
-  // ESTIMATION
-  S = this->H * this->P * (~ this->H) + this->R;
-  bool is_nonsingular = Invert(S); // inverse inplace (S <- S^{-1})
-  K = P*(~H)*S;
-  if(is_nonsingular){
-    this->x += K*(obs - this->H * this->x); // K*y
-    this->P = (this->Id - K * this->H)* this->P;
-    if(KALMAN_CHECK){
-      for(int i=0;i<Nstate;i++){
-        if(isnan(this->x(i)) || isinf(this->x(i))){
-          if(KALMAN_VERBOSE){Serial.println(F("KALMAN:ERROR: estimated vector has nan or inf values"));}
-          status = 1;
-          return;
-        }
-      }
+  _predict(comstate);
+  for(int i=0;i<Nobs;i++){
+    if(!_correctone(i, obs(i))){
+      if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: R must be positive"));}
+      status = 1;
+      return;
     }
-  }else{
-    if(KALMAN_VERBOSE){Serial.println(F("KALMAN:ERROR: could not invert S matrix. Try to reset P matrix."));}
-    this->P.Fill(0.0); // try to reset P. Better strategy?
-    //K.Fill(0.0);
+  }
+  if(!_checkx()){
+    status = 1;
   }
 };
 
+template <int Nstate, int Nobs, int Ncom, class MemF>
+void KALMAN_UD<Nstate,Nobs,Ncom,MemF>::update(const BLA::Matrix<Nobs> &obs){
+  _update(obs,BLA::Zeros<Nstate>());
+};
+
+/**********      UD UPDATE with OBS & COM      **********/
 
-/**********      UPDATE with OBS & COM      **********/
 template <int Nstate, int Nobs, int Ncom, class MemF>
-void KALMAN<Nstate,Nobs,Ncom,MemF>::update(BLA::Matrix<Nobs> obs, BLA::Matrix<Ncom> com){
+void KALMAN_UD<Nstate,Nobs,Ncom,MemF>::update(const BLA::Matrix<Nobs> &obs, const BLA::Matrix<Ncom> &com){
   if(KALMAN_CHECK){
     for(int i=0;i<Ncom;i++){
       if(isnan(com(i)) || isinf(com(i))){
-        if(KALMAN_VERBOSE){Serial.println(F("KALMAN:ERROR: command has nan or inf values"));}
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: command has nan or inf values"));}
         status = 1;
         return;
       }
@@ -217,32 +595,469 @@ void KALMAN<Nstate,Nobs,Ncom,MemF>::update(BLA::Matrix<Nobs> obs, BLA::Matrix<Nc
   _update(obs,this->B *com);
 };
 
-/**********      UPDATE with OBS      **********/
+/**********      UD ASYNCHRONOUS UPDATES      **********/
 
 template <int Nstate, int Nobs, int Ncom, class MemF>
-void KALMAN<Nstate,Nobs,Ncom,MemF>::update(BLA::Matrix<Nobs> obs){
-	BLA::Zeros<Nstate> NULLCOMSTATE;
-  _update(obs,NULLCOMSTATE);
+void KALMAN_UD<Nstate,Nobs,Ncom,MemF>::predict(){
+  this->status = 0;
+  _predict(BLA::Zeros<Nstate>());
 };
 
-/**********      CONSTRUCTOR      **********/
+template <int Nstate, int Nobs, int Ncom, class MemF>
+void KALMAN_UD<Nstate,Nobs,Ncom,MemF>::predict(const BLA::Matrix<Ncom> &com){
+  this->status = 0;
+  if(KALMAN_CHECK){
+    for(int i=0;i<Ncom;i++){
+      if(isnan(com(i)) || isinf(com(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: command has nan or inf values"));}
+        status = 1;
+        return;
+      }
+    }
+  }
+  _predict(this->B * com);
+};
 
 template <int Nstate, int Nobs, int Ncom, class MemF>
-KALMAN<Nstate,Nobs,Ncom,MemF>::KALMAN(){
+void KALMAN_UD<Nstate,Nobs,Ncom,MemF>::update(int i, float obs_i){
+  this->status = 0;
+  if(KALMAN_CHECK){
+    if(i < 0 || i >= Nobs || isnan(obs_i) || isinf(obs_i)){
+      if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: observation has nan or inf values"));}
+      status = 1;
+      return;
+    }
+  }
+  if(!_correctone(i, obs_i)){
+    if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: R must be positive"));}
+    status = 1;
+    return;
+  }
+  if(!_checkx()){
+    status = 1;
+  }
+};
+
+/**********      UD COVARIANCE      **********/
+
+// Factorises P = U*D*U' from the last row and column up
+template <int Nstate, int Nobs, int Ncom, class MemF>
+void KALMAN_UD<Nstate,Nobs,Ncom,MemF>::setP(const BLA::SymmetricMatrix<Nstate> &P){
+  this->status = 0;
+  for(int j=Nstate-1;j>=0;j--){
+    float d = P(j,j);
+    for(int k=j+1;k<Nstate;k++){
+      d -= this->D(k,k) * this->U(j,k) * this->U(j,k);
+    }
+    if(d < 0.0){
+      if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: P is not positive semi-definite"));}
+      status = 1;
+      d = 0.0;
+    }
+    this->D(j,j) = d;
+    this->U(j,j) = 1.0;
+    for(int i=0;i<j;i++){
+      float u = P(i,j);
+      for(int k=j+1;k<Nstate;k++){
+        u -= this->D(k,k) * this->U(i,k) * this->U(j,k);
+      }
+      this->U(i,j) = d > 0.0 ? u / d : 0.0;
+    }
+  }
+};
+
+template <int Nstate, int Nobs, int Ncom, class MemF>
+BLA::SymmetricMatrix<Nstate> KALMAN_UD<Nstate,Nobs,Ncom,MemF>::getP(){
+  BLA::SymmetricMatrix<Nstate> P = this->U * this->D * (~ this->U);
+  return P;
+};
+
+/**********      UD CONSTRUCTOR      **********/
+
+template <int Nstate, int Nobs, int Ncom, class MemF>
+KALMAN_UD<Nstate,Nobs,Ncom,MemF>::KALMAN_UD(){
   if(KALMAN_VERBOSE){
-    Serial.println(F("KALMAN:INFO: Initialize filter"));
-    if((Nstate<=1)||(Nobs<=1)){
-      Serial.println(F("KALMAN:ERROR: 'Nstate' and 'Nobs' must be > 1"));
+    Serial.println(KALMAN_F("KALMAN:INFO: Initialize filter"));
+  }
+  this->U = BLA::Eye<Nstate,Nstate>();
+  this->D.Fill(0.0);
+  this->x.Fill(0.0);
+  this->status = 0;
+};
+
+/**********      UD GETXCOPY      **********/
+
+template <int Nstate, int Nobs, int Ncom, class MemF>
+BLA::Matrix<Nstate> KALMAN_UD<Nstate,Nobs,Ncom,MemF>::getxcopy(){
+  BLA::Matrix<Nstate> out;
+  for(int i=0;i<Nstate;i++){
+    out(i) = this->x(i);
+  }
+  return out;
+};
+
+
+/**********      NONLINEAR MODELS      **********/
+
+// Evolution function x_k = f(x_{k-1}) or observation function y_k = h(x_k) of the nonlinear filters below.
+// Derive from it and implement 'operator()'. Commands are members of your functor that you set before each update.
+// Override 'jacobian' with the analytic derivative if you know it, otherwise it is worked out by finite differences.
+template<int Inputs, int Outputs>
+struct KALMAN_FUNCTOR : public BLA::MatrixFunctor<Inputs,Outputs,float>{
+  virtual BLA::Matrix<Outputs,Inputs> jacobian(const BLA::Matrix<Inputs> &x) const {
+    // the step grows with x, since in float a fixed step would vanish next to e.g. a position in meters
+    float scale = 1.0;
+    for(int i=0;i<Inputs;i++){
+      if(fabs(x(i)) > scale){scale = fabs(x(i));}
     }
+    return BLA::Jacobian<Inputs,Outputs>(*this, x, 1e-3f * scale);
   }
+};
+
+
+/**********      EXTENDED KALMAN FILTER      **********/
+
+// Kalman filter for the nonlinear problem
+//    x_k = f(x_{k-1}) + q_k   (evolution model)
+//    y_k = h(x_k) + r_k       (measure)
+// linearised around the current estimate with the Jacobians of f and h.
+// The functors are kept by reference, so they must live as long as the filter.
+template<int Nstate, int Nobs>
+class KALMAN_EKF{
+  private:
+    bool _checkx();
+  public:
+	//INPUT MODEL
+    const KALMAN_FUNCTOR<Nstate,Nstate> &f; // evolution function
+    const KALMAN_FUNCTOR<Nstate,Nobs> &h; // observation function
+    BLA::SymmetricMatrix<Nstate> Q; // model noise covariance matrix
+    BLA::SymmetricMatrix<Nobs> R; // measure noise covariance matrix
+	//OUTPUT MATRICES
+    BLA::SymmetricMatrix<Nstate> P; // posterior covariance (do not modify, except to init!)
+    BLA::Matrix<Nstate> x; // state vector (do not modify, except to init!)
+
+    int status; // 0 if the last update of the Kalman filter computed correctly
+
+    // UPDATE FILTER WITH OBSERVATION (predict then correct)
+    void update(const BLA::Matrix<Nobs> &obs);
+
+    // ASYNCHRONOUS UPDATES
+    // Call 'predict' at each time step (e.g. at the IMU rate), then 'correct' whenever an observation is available
+    void predict();
+    void correct(const BLA::Matrix<Nobs> &obs);
+
+    // CONSTRUCTOR
+    KALMAN_EKF<Nstate,Nobs>(const KALMAN_FUNCTOR<Nstate,Nstate> &f, const KALMAN_FUNCTOR<Nstate,Nobs> &h);
+
+    // GETTER on X (copy vector to avoid eventual user modifications)
+    BLA::Matrix<Nstate> getxcopy();
+
+};
+
+template <int Nstate, int Nobs>
+void KALMAN_EKF<Nstate,Nobs>::update(const BLA::Matrix<Nobs> &obs){
+  predict();
+  if(this->status == 0){
+    correct(obs);
+  }
+};
+
+template <int Nstate, int Nobs>
+void KALMAN_EKF<Nstate,Nobs>::predict(){
+  this->status = 0;
+  BLA::Matrix<Nstate,Nstate> Fj = this->f.jacobian(this->x);
+  this->x = this->f(this->x);
+  this->P = Fj * this->P * (~Fj) + this->Q;
+  if(!_checkx()){
+    status = 1;
+  }
+};
+
+template <int Nstate, int Nobs>
+void KALMAN_EKF<Nstate,Nobs>::correct(const BLA::Matrix<Nobs> &obs){
+  this->status = 0;
+  if(KALMAN_CHECK){
+    for(int i=0;i<Nobs;i++){
+      if(isnan(obs(i)) || isinf(obs(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: observation has nan or inf values"));}
+        status = 1;
+        return;
+      }
+    }
+  }
+  BLA::Matrix<Nobs,Nstate> Hj = this->h.jacobian(this->x);
+  BLA::Matrix<Nobs> y = obs - this->h(this->x);
+  BLA::Matrix<Nobs,Nstate> Kt; // transposed Kalman gain matrix
+  if(!kalman_detail::kalman_gain(this->P, Hj, this->R, Kt)){
+    if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: S matrix is not positive definite. Try to reset P matrix."));}
+    status = 1;
+    this->P.Fill(0.0); // try to reset P. Better strategy?
+    return;
+  }
+  this->x += (~Kt) * y;
+  if(!_checkx()){
+    status = 1;
+  }
+};
+
+template <int Nstate, int Nobs>
+bool KALMAN_EKF<Nstate,Nobs>::_checkx(){
+  if(KALMAN_CHECK){
+    for(int i=0;i<Nstate;i++){
+      if(isnan(this->x(i)) || isinf(this->x(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: estimated vector has nan or inf values"));}
+        return false;
+      }
+    }
+  }
+  return true;
+};
+
+template <int Nstate, int Nobs>
+KALMAN_EKF<Nstate,Nobs>::KALMAN_EKF(const KALMAN_FUNCTOR<Nstate,Nstate> &f, const KALMAN_FUNCTOR<Nstate,Nobs> &h) : f(f), h(h){
+  if(KALMAN_VERBOSE){
+    Serial.println(KALMAN_F("KALMAN:INFO: Initialize filter"));
+  }
+  this->Q.Fill(0.0);
+  this->R.Fill(0.0);
   this->P.Fill(0.0);
   this->x.Fill(0.0);
+  this->status = 0;
 };
 
-/**********      GETXCOPY      **********/
+template <int Nstate, int Nobs>
+BLA::Matrix<Nstate> KALMAN_EKF<Nstate,Nobs>::getxcopy(){
+  BLA::Matrix<Nstate> out;
+  for(int i=0;i<Nstate;i++){
+    out(i) = this->x(i);
+  }
+  return out;
+};
 
-template <int Nstate, int Nobs, int Ncom, class MemF>
-BLA::Matrix<Nstate> KALMAN<Nstate,Nobs,Ncom,MemF>::getxcopy(){
+
+/**********      UNSCENTED KALMAN FILTER      **********/
+
+// Same nonlinear problem, where the mean and covariance are carried through f and h by 2*Nstate+1 sigma points
+// x +/- columns of sqrt((Nstate+lambda)*P) rather than by Jacobians, with lambda = alpha^2*(Nstate+kappa) - Nstate.
+// P must be positive definite. The functors are kept by reference, so they must live as long as the filter.
+template<int Nstate, int Nobs>
+class KALMAN_UKF{
+  private:
+    bool _sigmapoints();
+    float _weight(int s, bool covariance);
+    bool _checkx();
+  public:
+	//INPUT MODEL
+    const KALMAN_FUNCTOR<Nstate,Nstate> &f; // evolution function
+    const KALMAN_FUNCTOR<Nstate,Nobs> &h; // observation function
+    BLA::SymmetricMatrix<Nstate> Q; // model noise covariance matrix
+    BLA::SymmetricMatrix<Nobs> R; // measure noise covariance matrix
+    float alpha, beta, kappa; // spread of the sigma points (default 1, 2, 0: all weights positive, safest in float)
+	//OUTPUT MATRICES
+    BLA::SymmetricMatrix<Nstate> P; // posterior covariance (do not modify, except to init!)
+    BLA::Matrix<Nstate> x; // state vector (do not modify, except to init!)
+    BLA::Matrix<2*Nstate+1,Nstate> X; // sigma points, one per row
+    BLA::Matrix<2*Nstate+1,Nobs> Z; // their observations, one per row
+
+    int status; // 0 if the last update of the Kalman filter computed correctly
+
+    // UPDATE FILTER WITH OBSERVATION (predict then correct)
+    void update(const BLA::Matrix<Nobs> &obs);
+
+    // ASYNCHRONOUS UPDATES
+    // Call 'predict' at each time step (e.g. at the IMU rate), then 'correct' whenever an observation is available
+    void predict();
+    void correct(const BLA::Matrix<Nobs> &obs);
+
+    // CONSTRUCTOR
+    KALMAN_UKF<Nstate,Nobs>(const KALMAN_FUNCTOR<Nstate,Nstate> &f, const KALMAN_FUNCTOR<Nstate,Nobs> &h);
+
+    // GETTER on X (copy vector to avoid eventual user modifications)
+    BLA::Matrix<Nstate> getxcopy();
+
+};
+
+/**********      UKF SIGMA POINTS      **********/
+
+// A single Cholesky factorisation L*L' = (Nstate+lambda)*P gives all the sigma points x, x + L(:,j) and x - L(:,j)
+template <int Nstate, int Nobs>
+bool KALMAN_UKF<Nstate,Nobs>::_sigmapoints(){
+  float lambda = this->alpha * this->alpha * (Nstate + this->kappa) - Nstate;
+  BLA::SymmetricMatrix<Nstate> A = this->P * (Nstate + lambda);
+  auto chol = CholeskyDecompose(A); // factorise inplace (lower triangle of A <- L)
+  if(!chol.positive_definite){
+    return false;
+  }
+  for(int k=0;k<Nstate;k++){
+    this->X(0,k) = this->x(k);
+  }
+  for(int j=0;j<Nstate;j++){
+    for(int k=0;k<Nstate;k++){
+      this->X(1+j,k) = this->x(k) + chol.L(k,j);
+      this->X(1+Nstate+j,k) = this->x(k) - chol.L(k,j);
+    }
+  }
+  return true;
+};
+
+// Weight of the s-th sigma point in the mean, or in the covariance
+template <int Nstate, int Nobs>
+float KALMAN_UKF<Nstate,Nobs>::_weight(int s, bool covariance){
+  float lambda = this->alpha * this->alpha * (Nstate + this->kappa) - Nstate;
+  if(s > 0){
+    return 0.5 / (Nstate + lambda);
+  }
+  float w = lambda / (Nstate + lambda);
+  if(covariance){
+    w += 1.0 - this->alpha * this->alpha + this->beta;
+  }
+  return w;
+};
+
+/**********      UKF UPDATES      **********/
+
+template <int Nstate, int Nobs>
+void KALMAN_UKF<Nstate,Nobs>::update(const BLA::Matrix<Nobs> &obs){
+  predict();
+  if(this->status == 0){
+    correct(obs);
+  }
+};
+
+template <int Nstate, int Nobs>
+void KALMAN_UKF<Nstate,Nobs>::predict(){
+  this->status = 0;
+  if(!_sigmapoints()){
+    if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: P matrix is not positive definite"));}
+    status = 1;
+    return;
+  }
+  BLA::Matrix<Nstate> xs;
+  this->x.Fill(0.0);
+  for(int s=0;s<2*Nstate+1;s++){
+    for(int k=0;k<Nstate;k++){
+      xs(k) = this->X(s,k);
+    }
+    xs = this->f(xs);
+    for(int k=0;k<Nstate;k++){
+      this->X(s,k) = xs(k);
+    }
+    this->x += xs * _weight(s, false);
+  }
+  // P = sum of w*(X_s - x)*(X_s - x)' + Q, on the lower triangle only
+  this->P = this->Q;
+  for(int s=0;s<2*Nstate+1;s++){
+    float w = _weight(s, true);
+    for(int j=0;j<Nstate;j++){
+      xs(j) = this->X(s,j) - this->x(j);
+      for(int k=0;k<=j;k++){
+        this->P(j,k) += w * xs(j) * xs(k);
+      }
+    }
+  }
+  if(!_checkx()){
+    status = 1;
+  }
+};
+
+template <int Nstate, int Nobs>
+void KALMAN_UKF<Nstate,Nobs>::correct(const BLA::Matrix<Nobs> &obs){
+  this->status = 0;
+  if(KALMAN_CHECK){
+    for(int i=0;i<Nobs;i++){
+      if(isnan(obs(i)) || isinf(obs(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: observation has nan or inf values"));}
+        status = 1;
+        return;
+      }
+    }
+  }
+  // new sigma points around the prediction, so that they account for Q
+  if(!_sigmapoints()){
+    if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: P matrix is not positive definite"));}
+    status = 1;
+    return;
+  }
+  BLA::Matrix<Nstate> xs;
+  BLA::Matrix<Nobs> zs;
+  BLA::Matrix<Nobs> zm; // predicted observation
+  zm.Fill(0.0);
+  for(int s=0;s<2*Nstate+1;s++){
+    for(int k=0;k<Nstate;k++){
+      xs(k) = this->X(s,k);
+    }
+    zs = this->h(xs);
+    for(int i=0;i<Nobs;i++){
+      this->Z(s,i) = zs(i);
+    }
+    zm += zs * _weight(s, false);
+  }
+  // innovation covariance S and cross covariance Pxz
+  BLA::SymmetricMatrix<Nobs> S = this->R;
+  BLA::Matrix<Nstate,Nobs> Pxz;
+  Pxz.Fill(0.0);
+  for(int s=0;s<2*Nstate+1;s++){
+    float w = _weight(s, true);
+    for(int i=0;i<Nobs;i++){
+      zs(i) = this->Z(s,i) - zm(i);
+      for(int k=0;k<=i;k++){
+        S(i,k) += w * zs(i) * zs(k);
+      }
+    }
+    for(int j=0;j<Nstate;j++){
+      float dx = w * (this->X(s,j) - this->x(j));
+      for(int i=0;i<Nobs;i++){
+        Pxz(j,i) += dx * zs(i);
+      }
+    }
+  }
+  // K' = S^{-1}*Pxz' from the Cholesky factor of S, then P = P - K*S*K' = P - Pxz*K'
+  auto chol = CholeskyDecompose(S);
+  if(!chol.positive_definite){
+    if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: S matrix is not positive definite. Try to reset P matrix."));}
+    status = 1;
+    return;
+  }
+  BLA::Matrix<Nobs,Nstate> Kt = CholeskySolve(chol, ~Pxz);
+  this->x += (~Kt) * (obs - zm);
+  this->P = this->P - Pxz * Kt;
+  if(!_checkx()){
+    status = 1;
+  }
+};
+
+template <int Nstate, int Nobs>
+bool KALMAN_UKF<Nstate,Nobs>::_checkx(){
+  if(KALMAN_CHECK){
+    for(int i=0;i<Nstate;i++){
+      if(isnan(this->x(i)) || isinf(this->x(i))){
+        if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: estimated vector has nan or inf values"));}
+        return false;
+      }
+    }
+  }
+  return true;
+};
+
+/**********      UKF CONSTRUCTOR      **********/
+
+template <int Nstate, int Nobs>
+KALMAN_UKF<Nstate,Nobs>::KALMAN_UKF(const KALMAN_FUNCTOR<Nstate,Nstate> &f, const KALMAN_FUNCTOR<Nstate,Nobs> &h) : f(f), h(h){
+  if(KALMAN_VERBOSE){
+    Serial.println(KALMAN_F("KALMAN:INFO: Initialize filter"));
+  }
+  this->alpha = 1.0;
+  this->beta = 2.0;
+  this->kappa = 0.0;
+  this->Q.Fill(0.0);
+  this->R.Fill(0.0);
+  this->P.Fill(0.0);
+  this->x.Fill(0.0);
+  this->status = 0;
+};
+
+template <int Nstate, int Nobs>
+BLA::Matrix<Nstate> KALMAN_UKF<Nstate,Nobs>::getxcopy(){
   BLA::Matrix<Nstate> out;
   for(int i=0;i<Nstate;i++){
     out(i) = this->x(i);
@@ -0,0 +1,172 @@
+/*
+ * Fusion of a GPS and an accelerometer, e.g. TinyGPSPlus and ADXL345_WE, into a position and velocity at the
+ * accelerometer rate.
+ *
+ * Each horizontal axis of the local East-North frame has its own constant acceleration Kalman filter
+ *    x = [position, velocity, acceleration]
+ * observing the position from the GPS fixes and the acceleration from the accelerometer, whose samples are rotated
+ * from the sensor frame to East-North with the direction of the velocity.
+ * The sensor is assumed level, with its x axis pointing forward and its y axis to the left.
+ *
+ * Each accelerometer sample costs two 3x3 predictions and two scalar corrections, without any allocation.
+ *
+ * License:
+ *  See the LICENSE file
+ *
+ */
+
+#ifndef KalmanGpsImu_h
+#define KalmanGpsImu_h
+
+#include "Kalman.h"
+
+#define KALMAN_GRAVITY 9.80665
+#define KALMAN_METERS_PER_DEGREE 111226.3 // on a sphere of radius 6372795 m, as TinyGPSPlus::distanceBetween
+
+/**********      CLASS DEFINITION      **********/
+
+class KALMAN_GPS_IMU{
+  private:
+    int64_t _lat0, _lng0; // origin of the local frame (billionths of degrees)
+    float _coslat0;
+    template<class Degrees> static int64_t _billionths(const Degrees &deg);
+  public:
+    // FILTERS of the East and North axes (observations: 0 = GPS position, 1 = accelerometer)
+    KALMAN<3,2,0,BLA::Matrix<3,3>,BLA::DiagonalMatrix<2> > east;
+    KALMAN<3,2,0,BLA::Matrix<3,3>,BLA::DiagonalMatrix<2> > north;
+
+    float cosheading, sinheading; // direction of the sensor x axis in the local frame
+    bool headingknown; // false until the speed exceeds 'minspeed', the accelerometer is ignored until then
+    float minspeed; // speed above which the velocity gives the heading (m/s)
+    bool valid; // true once a first fix set the origin of the local frame
+    int status; // 0 if the last update computed correctly
+
+    // CONSTRUCTOR
+    // dt: accelerometer sampling period (s), gps: GPS position noise (m), accel: accelerometer noise (m/s^2),
+    // jerk: how fast the acceleration of the vehicle changes (m/s^3)
+    KALMAN_GPS_IMU(float dt, float gps = 2.5, float accel = 0.5, float jerk = 1.0);
+
+    // ACCELEROMETER SAMPLE in g (e.g. ADXL345_WE::getGValues()), at each sampling period
+    template<class GValues> void updateimu(const GValues &g);
+    void updateimu(float ax, float ay); // in m/s^2, sensor frame
+
+    // GPS FIX (e.g. TinyGPSPlus::location), returns true if the location had a new fix
+    template<class Location> bool updategps(Location &location);
+    void updategps(float e, float n); // in m, local frame
+
+    // OUTPUTS in the local frame (m and m/s)
+    BLA::Matrix<2> getposition();
+    BLA::Matrix<2> getvelocity();
+};
+
+/**********      CONSTRUCTOR      **********/
+
+inline KALMAN_GPS_IMU::KALMAN_GPS_IMU(float dt, float gps, float accel, float jerk){
+  // Process noise of a white jerk of density jerk^2 integrated over dt
+  float q = jerk * jerk;
+  float dt2 = dt * dt;
+  float dt3 = dt2 * dt;
+  BLA::Matrix<3,3> F = {1.0f, dt, 0.5f * dt2, 0.0f, 1.0f, dt, 0.0f, 0.0f, 1.0f};
+  BLA::SymmetricMatrix<3> Q = {q * dt3 * dt2 / 20, q * dt2 * dt2 / 8, q * dt3 / 6,
+                               q * dt2 * dt2 / 8,  q * dt3 / 3,       q * dt2 / 2,
+                               q * dt3 / 6,        q * dt2 / 2,       q * dt};
+  BLA::Matrix<2,3> H = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+  BLA::DiagonalMatrix<2> R = {gps * gps, 0.0f, 0.0f, accel * accel};
+  BLA::SymmetricMatrix<3> P = {gps * gps, 0.0f, 0.0f, 0.0f, 100.0f, 0.0f, 0.0f, 0.0f, 10.0f};
+  this->east.F = this->north.F = F;
+  this->east.Q = this->north.Q = Q;
+  this->east.H = this->north.H = H;
+  this->east.R = this->north.R = R;
+  this->east.P = this->north.P = P;
+  this->cosheading = 1.0;
+  this->sinheading = 0.0;
+  this->headingknown = false;
+  this->minspeed = 1.0;
+  this->valid = false;
+  this->status = 0;
+};
+
+/**********      ACCELEROMETER      **********/
+
+template<class GValues>
+void KALMAN_GPS_IMU::updateimu(const GValues &g){
+  updateimu(g.x * KALMAN_GRAVITY, g.y * KALMAN_GRAVITY);
+};
+
+inline void KALMAN_GPS_IMU::updateimu(float ax, float ay){
+  this->status = 0;
+  if(!this->valid){
+    return; // nothing to integrate from before the first fix
+  }
+  this->east.predict();
+  this->north.predict();
+  // direction of motion, from the velocity once it is large enough to be meaningful
+  float ve = this->east.x(1);
+  float vn = this->north.x(1);
+  float speed = sqrt(ve * ve + vn * vn);
+  if(speed > this->minspeed){
+    this->cosheading = ve / speed;
+    this->sinheading = vn / speed;
+    this->headingknown = true;
+  }
+  if(this->headingknown){
+    this->east.update(1, this->cosheading * ax - this->sinheading * ay);
+    this->north.update(1, this->sinheading * ax + this->cosheading * ay);
+  }
+  this->status = this->east.status | this->north.status;
+};
+
+/**********      GPS      **********/
+
+// Signed billionths of degrees of a TinyGPSPlus RawDegrees, which keeps the full precision of the fix on boards where
+// double is float
+template<class Degrees>
+int64_t KALMAN_GPS_IMU::_billionths(const Degrees &deg){
+  int64_t value = (int64_t)deg.deg * 1000000000LL + deg.billionths;
+  return deg.negative ? -value : value;
+};
+
+template<class Location>
+bool KALMAN_GPS_IMU::updategps(Location &location){
+  if(!location.isValid() || !location.isUpdated()){
+    return false;
+  }
+  int64_t lat = _billionths(location.rawLat());
+  int64_t lng = _billionths(location.rawLng());
+  if(!this->valid){
+    this->_lat0 = lat;
+    this->_lng0 = lng;
+    this->_coslat0 = cos(lat * 1e-9 * M_PI / 180.0);
+  }
+  float n = (float)(lat - this->_lat0) * (float)(1e-9 * KALMAN_METERS_PER_DEGREE);
+  float e = (float)(lng - this->_lng0) * (float)(1e-9 * KALMAN_METERS_PER_DEGREE) * this->_coslat0;
+  updategps(e, n);
+  return true;
+};
+
+inline void KALMAN_GPS_IMU::updategps(float e, float n){
+  this->status = 0;
+  if(!this->valid){
+    this->east.x(0) = e;
+    this->north.x(0) = n;
+    this->valid = true;
+    return;
+  }
+  this->east.update(0, e);
+  this->north.update(0, n);
+  this->status = this->east.status | this->north.status;
+};
+
+/**********      OUTPUTS      **********/
+
+inline BLA::Matrix<2> KALMAN_GPS_IMU::getposition(){
+  BLA::Matrix<2> out = {this->east.x(0), this->north.x(0)};
+  return out;
+};
+
+inline BLA::Matrix<2> KALMAN_GPS_IMU::getvelocity(){
+  BLA::Matrix<2> out = {this->east.x(1), this->north.x(1)};
+  return out;
+};
+
+#endif
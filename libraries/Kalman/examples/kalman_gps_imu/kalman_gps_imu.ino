@@ -0,0 +1,49 @@
+/* 
+ * Position and velocity of a vehicle at 100 Hz, from a 1 Hz GPS (TinyGPSPlus)
+ * and an ADXL345 accelerometer (ADXL345_WE).
+ * The ADXL345 is mounted level, x axis forward and y axis to the left.
+ * 
+ * Revision:
+ *  19 Oct 2026 - Creation
+ */
+
+#include <Wire.h>
+#include <ADXL345_WE.h>
+#include <TinyGPS++.h>
+#include <KalmanGpsImu.h>
+
+#define DT 0.01 // accelerometer sampling period (s)
+
+ADXL345_WE acc = ADXL345_WE(0x53);
+TinyGPSPlus gps;
+KALMAN_GPS_IMU fusion(DT); // default noises: GPS 2.5 m, accelerometer 0.5 m/s^2
+
+unsigned long last = 0;
+
+void setup() {
+  Serial.begin(115200);
+  Serial2.begin(9600); // GPS
+  Wire.begin();
+  if(!acc.init()){
+    Serial.println("ADXL345 not connected!");
+  }
+  acc.setDataRate(ADXL345_DATA_RATE_100);
+  acc.setRange(ADXL345_RANGE_4G);
+}
+
+void loop() {
+  while(Serial2.available() > 0){
+    gps.encode(Serial2.read());
+  }
+  fusion.updategps(gps.location); // does nothing without a new fix
+
+  if(micros() - last >= DT * 1e6){
+    last += DT * 1e6;
+    fusion.updateimu(acc.getGValues());
+    if(fusion.valid){
+      BLA::Matrix<2> position = fusion.getposition(); // m East and North of the first fix
+      Serial.print(position(0)); Serial.print(" ");
+      Serial.println(position(1));
+    }
+  }
+}
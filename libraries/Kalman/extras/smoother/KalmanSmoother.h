@@ -0,0 +1,266 @@
+/*
+ * Rauch-Tung-Striebel smoother for the KALMAN filter, to refine logged tracks on a computer (POSIX only, not for Arduino).
+ *
+ * The forward pass is the KALMAN filter itself: after each update, 'push' stores the filtered state x_k, its
+ * covariance P_k and the F_k, Q_k that led to them. 'smooth' then goes backward and replaces each record with
+ *    x_k <- x_k + C_k*(x_{k+1} - F_{k+1}*x_k)
+ *    P_k <- P_k + C_k*(P_{k+1} - P_{k+1|k})*C_k'   with  C_k = P_k*F_{k+1}'*P_{k+1|k}^{-1}
+ * where P_{k+1|k} = F_{k+1}*P_k*F_{k+1}' + Q_{k+1} is worked out again rather than stored.
+ * Commands are not supported, and the filter must not be in steady-state mode (its P is not updated then).
+ *
+ * Records are kept in an unlinked temporary file which is memory mapped one window at a time, so the memory used
+ * does not depend on the length of the log.
+ *
+ * License:
+ *  See the LICENSE file
+ *
+ */
+
+#ifndef KalmanSmoother_h
+#define KalmanSmoother_h
+
+#include "../../Kalman.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**********      CLASS DEFINITION      **********/
+
+template<int Nstate>
+class KALMAN_RTS{
+  private:
+    struct Record{
+      float x[Nstate];
+      float P[Nstate*(Nstate+1)/2];
+      float F[Nstate*Nstate];
+      float Q[Nstate*(Nstate+1)/2];
+    };
+    int _fd;
+    long _count; // number of records
+    long _window; // records per mapped window
+    long _first; // first record of the mapped window, -1 if none
+    long _capacity; // records the file can hold
+    Record *_map;
+    Record *_record(long k);
+    void _unmap();
+  public:
+    int status; // 0 if the last operation computed correctly
+
+    // CONSTRUCTOR, with the temporary file in 'dir' and windows of at least 'window' records
+    KALMAN_RTS<Nstate>(const char *dir = "/tmp", long window = 4096);
+    ~KALMAN_RTS<Nstate>();
+
+    // FORWARD PASS: store the filtered state after each update of the filter
+    bool push(const BLA::Matrix<Nstate> &x, const BLA::SymmetricMatrix<Nstate> &P,
+              const BLA::Matrix<Nstate,Nstate> &F, const BLA::SymmetricMatrix<Nstate> &Q);
+    template<int Nobs, int Ncom, class MemF, class MemR>
+    bool push(const KALMAN<Nstate,Nobs,Ncom,MemF,MemR> &K);
+
+    // BACKWARD PASS: replaces every record with its smoothed state
+    bool smooth();
+
+    // RECORDS
+    long size();
+    bool get(long k, BLA::Matrix<Nstate> &x, BLA::SymmetricMatrix<Nstate> &P); // false if there's no record k
+};
+
+/**********      RECORD FILE      **********/
+
+template<int Nstate>
+KALMAN_RTS<Nstate>::KALMAN_RTS(const char *dir, long window){
+  this->_count = 0;
+  this->_first = -1;
+  this->_capacity = 0;
+  this->_map = NULL;
+  this->status = 0;
+  // windows are a whole number of pages, so that each one can be mapped on its own
+  long page = sysconf(_SC_PAGESIZE);
+  long step = page;
+  while(step % sizeof(Record) != 0){
+    step += page;
+  }
+  step /= sizeof(Record);
+  this->_window = (window + step - 1) / step * step;
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/kalman_rts_XXXXXX", dir);
+  this->_fd = mkstemp(path);
+  if(this->_fd < 0){
+    this->status = 1;
+    return;
+  }
+  unlink(path); // the file is removed when closed
+};
+
+template<int Nstate>
+KALMAN_RTS<Nstate>::~KALMAN_RTS(){
+  _unmap();
+  if(this->_fd >= 0){
+    close(this->_fd);
+  }
+};
+
+template<int Nstate>
+void KALMAN_RTS<Nstate>::_unmap(){
+  if(this->_map != NULL){
+    munmap(this->_map, this->_window * sizeof(Record));
+    this->_map = NULL;
+    this->_first = -1;
+  }
+};
+
+// Maps the window holding record k, growing the file when k is past its end
+template<int Nstate>
+typename KALMAN_RTS<Nstate>::Record *KALMAN_RTS<Nstate>::_record(long k){
+  long first = k - k % this->_window;
+  if(first != this->_first){
+    _unmap();
+    if(first + this->_window > this->_capacity){
+      this->_capacity = first + this->_window;
+      if(ftruncate(this->_fd, this->_capacity * sizeof(Record)) != 0){
+        return NULL;
+      }
+    }
+    void *map = mmap(NULL, this->_window * sizeof(Record), PROT_READ | PROT_WRITE, MAP_SHARED, this->_fd, first * sizeof(Record));
+    if(map == MAP_FAILED){
+      return NULL;
+    }
+    this->_map = (Record *)map;
+    this->_first = first;
+  }
+  return this->_map + (k - first);
+};
+
+/**********      FORWARD PASS      **********/
+
+template<int Nstate>
+bool KALMAN_RTS<Nstate>::push(const BLA::Matrix<Nstate> &x, const BLA::SymmetricMatrix<Nstate> &P,
+                              const BLA::Matrix<Nstate,Nstate> &F, const BLA::SymmetricMatrix<Nstate> &Q){
+  this->status = 0;
+  Record *r = (this->_fd >= 0) ? _record(this->_count) : NULL;
+  if(r == NULL){
+    this->status = 1;
+    return false;
+  }
+  memcpy(r->x, x.storage, sizeof(r->x));
+  memcpy(r->P, P.storage, sizeof(r->P));
+  memcpy(r->F, F.storage, sizeof(r->F));
+  memcpy(r->Q, Q.storage, sizeof(r->Q));
+  this->_count++;
+  return true;
+};
+
+template<int Nstate>
+template<int Nobs, int Ncom, class MemF, class MemR>
+bool KALMAN_RTS<Nstate>::push(const KALMAN<Nstate,Nobs,Ncom,MemF,MemR> &K){
+  BLA::Matrix<Nstate,Nstate> F = K.F;
+  return push(K.x, K.P, F, K.Q);
+};
+
+/**********      BACKWARD PASS      **********/
+
+template<int Nstate>
+bool KALMAN_RTS<Nstate>::smooth(){
+  this->status = 0;
+  if(this->_count < 2){
+    return true;
+  }
+  // smoothed state of the record after the current one, and the model that led to it
+  BLA::Matrix<Nstate> xs;
+  BLA::SymmetricMatrix<Nstate> Ps;
+  BLA::Matrix<Nstate,Nstate> F;
+  BLA::SymmetricMatrix<Nstate> Q;
+  Record *r = _record(this->_count - 1);
+  if(r == NULL){
+    this->status = 1;
+    return false;
+  }
+  memcpy(xs.storage, r->x, sizeof(r->x));
+  memcpy(Ps.storage, r->P, sizeof(r->P));
+  memcpy(F.storage, r->F, sizeof(r->F));
+  memcpy(Q.storage, r->Q, sizeof(r->Q));
+  for(long k=this->_count-2;k>=0;k--){
+    r = _record(k);
+    if(r == NULL){
+      this->status = 1;
+      return false;
+    }
+    BLA::Matrix<Nstate> x;
+    BLA::SymmetricMatrix<Nstate> P;
+    memcpy(x.storage, r->x, sizeof(r->x));
+    memcpy(P.storage, r->P, sizeof(r->P));
+    // C' = P_{k+1|k}^{-1}*(F*P) from the Cholesky factor of the prediction covariance
+    BLA::Matrix<Nstate,Nstate> FP = F * P;
+    BLA::SymmetricMatrix<Nstate> Pp = FP * (~F) + Q;
+    BLA::SymmetricMatrix<Nstate> dP = Ps - Pp;
+    auto chol = CholeskyDecompose(Pp);
+    if(!chol.positive_definite){
+      if(KALMAN_VERBOSE){Serial.println(KALMAN_F("KALMAN:ERROR: predicted P matrix is not positive definite"));}
+      this->status = 1;
+      return false;
+    }
+    BLA::Matrix<Nstate,Nstate> Ct = CholeskySolve(chol, FP);
+    xs = x + (~Ct) * (xs - F * x);
+    Ps = P + (~Ct) * dP * Ct;
+    memcpy(r->x, xs.storage, sizeof(r->x));
+    memcpy(r->P, Ps.storage, sizeof(r->P));
+    memcpy(F.storage, r->F, sizeof(r->F));
+    memcpy(Q.storage, r->Q, sizeof(r->Q));
+  }
+  return true;
+};
+
+/**********      RECORDS      **********/
+
+template<int Nstate>
+long KALMAN_RTS<Nstate>::size(){
+  return this->_count;
+};
+
+template<int Nstate>
+bool KALMAN_RTS<Nstate>::get(long k, BLA::Matrix<Nstate> &x, BLA::SymmetricMatrix<Nstate> &P){
+  this->status = 0;
+  Record *r = (k >= 0 && k < this->_count) ? _record(k) : NULL;
+  if(r == NULL){
+    this->status = 1;
+    return false;
+  }
+  memcpy(x.storage, r->x, sizeof(r->x));
+  memcpy(P.storage, r->P, sizeof(r->P));
+  return true;
+};
+
+
+/**********      PARALLEL LOGS      **********/
+
+// Runs job(i) for i = 0 .. jobs-1 on 'threads' threads (all cores if 0), e.g. one log per job with its own KALMAN_RTS
+template<class Job>
+void kalman_parallel(int jobs, int threads, Job job){
+  if(threads <= 0){
+    threads = std::max(1u, std::thread::hardware_concurrency()); // 0 if it can't tell
+  }
+  if(threads > jobs){
+    threads = jobs;
+  }
+  std::atomic<int> next(0);
+  std::vector<std::thread> workers;
+  for(int t=0;t<threads;t++){
+    workers.emplace_back([&](){
+      for(int i=next++;i<jobs;i=next++){
+        job(i);
+      }
+    });
+  }
+  for(size_t t=0;t<workers.size();t++){
+    workers[t].join();
+  }
+};
+
+#endif
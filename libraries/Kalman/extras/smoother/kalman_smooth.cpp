@@ -0,0 +1,168 @@
+/*
+ * Smooths the GPS logs written on the SD card ("Latitude,Longitude,Time" lines with the time as hh:mm:ss).
+ *
+ *    kalman_smooth [-j threads] [-g gps_noise_m] [-a acceleration_noise_m/s2] log.txt ...
+ *
+ * Each log is filtered forward with a constant velocity KALMAN, smoothed backward by KALMAN_RTS and written next to
+ * it as log.txt.smooth.csv ("Latitude,Longitude,Time,SpeedEast,SpeedNorth"). Logs are processed in parallel.
+ *
+ * Build on a computer with the Arduino core stubs of the host tests in /test, e.g.
+ *    g++ -O2 -std=c++11 -pthread -I ../../../../test/stubs -I ../../../BasicLinearAlgebra kalman_smooth.cpp -o kalman_smooth
+ *
+ * License:
+ *  See the LICENSE file
+ *
+ */
+
+#include "KalmanSmoother.h"
+
+#include <math.h>
+#include <string>
+
+#define METERS_PER_DEGREE 111226.3 // as KALMAN_METERS_PER_DEGREE
+
+struct Options{
+  float gps = 5.0; // m
+  float accel = 1.0; // m/s^2
+};
+
+// Reads the fixes of a log, returns false if the file can't be read
+static bool readlog(const char *path, std::vector<double> &lat, std::vector<double> &lng, std::vector<std::string> &time,
+                    std::vector<double> &seconds){
+  FILE *file = fopen(path, "r");
+  if(file == NULL){
+    return false;
+  }
+  char line[256];
+  while(fgets(line, sizeof(line), file) != NULL){
+    double la, lo;
+    int h, m, s;
+    char text[32];
+    if(sscanf(line, "%lf,%lf,%31s", &la, &lo, text) != 3 || sscanf(text, "%d:%d:%d", &h, &m, &s) != 3){
+      continue; // header or damaged line
+    }
+    double t = h * 3600.0 + m * 60.0 + s;
+    if(!seconds.empty()){
+      while(t < seconds.back()){
+        t += 86400.0; // past midnight
+      }
+      if(t == seconds.back()){
+        continue; // same fix twice
+      }
+    }
+    lat.push_back(la);
+    lng.push_back(lo);
+    time.push_back(text);
+    seconds.push_back(t);
+  }
+  fclose(file);
+  return true;
+}
+
+// Filters, smooths and writes one log, returns the number of fixes or -1
+static long smoothlog(const char *path, const Options &options){
+  std::vector<double> lat, lng, seconds;
+  std::vector<std::string> time;
+  if(!readlog(path, lat, lng, time, seconds)){
+    return -1;
+  }
+  if(lat.empty()){
+    return 0;
+  }
+  // local East-North frame around the first fix, in double until the small differences are taken
+  double coslat0 = cos(lat[0] * M_PI / 180.0);
+  KALMAN<4,2> K; // state (east, north, speed east, speed north)
+  K.F = BLA::Eye<4,4>(); // with the time since the last fix set at each step
+  K.H = {1.0, 0.0, 0.0, 0.0,
+         0.0, 1.0, 0.0, 0.0};
+  K.R = {options.gps * options.gps, 0.0,
+         0.0, options.gps * options.gps};
+  K.P = {options.gps * options.gps, 0.0, 0.0, 0.0,
+         0.0, options.gps * options.gps, 0.0, 0.0,
+         0.0, 0.0, 100.0, 0.0,
+         0.0, 0.0, 0.0, 100.0};
+  KALMAN_RTS<4> rts;
+  float q = options.accel * options.accel;
+  for(size_t k=0;k<lat.size();k++){
+    float dt = k > 0 ? seconds[k] - seconds[k-1] : 0.0;
+    K.F(0,2) = dt;
+    K.F(1,3) = dt;
+    // white acceleration integrated over dt
+    K.Q = {q*dt*dt*dt/3, 0.0, q*dt*dt/2, 0.0,
+           0.0, q*dt*dt*dt/3, 0.0, q*dt*dt/2,
+           q*dt*dt/2, 0.0, q*dt, 0.0,
+           0.0, q*dt*dt/2, 0.0, q*dt};
+    BLA::Matrix<2> obs = {(float)((lng[k] - lng[0]) * METERS_PER_DEGREE * coslat0),
+                          (float)((lat[k] - lat[0]) * METERS_PER_DEGREE)};
+    if(k == 0){
+      K.x = {obs(0), obs(1), 0.0, 0.0};
+    }
+    else{
+      K.update(obs);
+    }
+    if(!rts.push(K)){
+      return -1;
+    }
+  }
+  if(!rts.smooth()){
+    return -1;
+  }
+  std::string out = std::string(path) + ".smooth.csv";
+  FILE *file = fopen(out.c_str(), "w");
+  if(file == NULL){
+    return -1;
+  }
+  fprintf(file, "Latitude,Longitude,Time,SpeedEast,SpeedNorth\n");
+  BLA::Matrix<4> x;
+  BLA::SymmetricMatrix<4> P;
+  for(long k=0;k<rts.size();k++){
+    if(!rts.get(k, x, P)){
+      fclose(file);
+      return -1;
+    }
+    fprintf(file, "%.7f,%.7f,%s,%.2f,%.2f\n", lat[0] + x(1) / METERS_PER_DEGREE,
+            lng[0] + x(0) / (METERS_PER_DEGREE * coslat0), time[k].c_str(), x(2), x(3));
+  }
+  fclose(file);
+  return rts.size();
+}
+
+int main(int argc, char **argv){
+  Options options;
+  int threads = 0;
+  std::vector<const char *> logs;
+  for(int i=1;i<argc;i++){
+    std::string arg = argv[i];
+    if(arg == "-j" && i + 1 < argc){
+      threads = atoi(argv[++i]);
+    }
+    else if(arg == "-g" && i + 1 < argc){
+      options.gps = atof(argv[++i]);
+    }
+    else if(arg == "-a" && i + 1 < argc){
+      options.accel = atof(argv[++i]);
+    }
+    else{
+      logs.push_back(argv[i]);
+    }
+  }
+  if(logs.empty()){
+    fprintf(stderr, "usage: kalman_smooth [-j threads] [-g gps_noise_m] [-a acceleration_noise_m/s2] log.txt ...\n");
+    return 2;
+  }
+  std::vector<long> fixes(logs.size());
+  kalman_parallel(logs.size(), threads, [&](int i){
+    fixes[i] = smoothlog(logs[i], options);
+  });
+  int failed = 0;
+  for(size_t i=0;i<logs.size();i++){
+    if(fixes[i] < 0){
+      fprintf(stderr, "%s: failed\n", logs[i]);
+      failed++;
+    }
+    else{
+      printf("%s: %ld fixes\n", logs[i], fixes[i]);
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+#include <benchmark/benchmark.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../Kalman.h"
+#include "../KalmanGpsImu.h"
+
+// A constant velocity model for Nstate / 2 axes (plus a bias state if Nstate is odd) where the first Nobs states are
+// measured directly
+template <int Nstate, int Nobs, typename FType, typename HType, typename QType, typename RType>
+void FillModel(FType &evolution, HType &H, QType &Q, RType &R)
+{
+    for (int i = 0; i < Nstate; ++i)
+    {
+        for (int j = 0; j < Nstate; ++j)
+        {
+            evolution(i, j) = (i == j) + 0.01f * (j == i + 1 && i % 2 == 0);
+            Q(i, j) = (i == j) * 1e-4f;
+        }
+    }
+
+    for (int i = 0; i < Nobs; ++i)
+    {
+        for (int j = 0; j < Nstate; ++j)
+        {
+            H(i, j) = (i == j);
+        }
+
+        for (int j = 0; j < Nobs; ++j)
+        {
+            R(i, j) = (i == j) * 0.1f;
+        }
+    }
+}
+
+// The update as it was done before: an explicit inverse of S and P = (I - K * H) * P, all with dense matrices
+template <int Nstate, int Nobs>
+struct InverseKalman
+{
+    Matrix<Nstate, Nstate> F, Q, P;
+    Matrix<Nobs, Nstate> H;
+    Matrix<Nobs, Nobs> R;
+    Matrix<Nstate> x;
+
+    InverseKalman()
+    {
+        FillModel<Nstate, Nobs>(F, H, Q, R);
+        P = Eye<Nstate, Nstate>();
+        x.Fill(0.0f);
+    }
+
+    __attribute__((noinline)) void update(const Matrix<Nobs> &obs)
+    {
+        x = F * x;
+        P = F * P * ~F + Q;
+        Matrix<Nobs, Nobs> S = H * P * ~H + R;
+        Invert(S);
+        Matrix<Nstate, Nobs> K = P * ~H * S;
+        x += K * (obs - H * x);
+        P = (Eye<Nstate, Nstate>() - K * H) * P;
+    }
+};
+
+template <int Nstate, int Nobs>
+struct CholeskyKalman
+{
+    KALMAN<Nstate, Nobs> K;
+
+    CholeskyKalman()
+    {
+        FillModel<Nstate, Nobs>(K.F, K.H, K.Q, K.R);
+        K.P = Eye<Nstate, Nstate>();
+    }
+
+    __attribute__((noinline)) void update(const Matrix<Nobs> &obs) { K.update(obs); }
+};
+
+// The same filter with independent observation noises, which it processes one at a time
+template <int Nstate, int Nobs>
+struct SequentialKalman
+{
+    KALMAN<Nstate, Nobs, 0, Matrix<Nstate, Nstate>, Diagonal<Nobs>> K;
+
+    SequentialKalman()
+    {
+        FillModel<Nstate, Nobs>(K.F, K.H, K.Q, K.R);
+        K.P = Eye<Nstate, Nstate>();
+    }
+
+    __attribute__((noinline)) void update(const Matrix<Nobs> &obs) { K.update(obs); }
+};
+
+// The same filter after working out its steady-state gain, so that each update is x = F*x + K*(obs - H*F*x)
+template <int Nstate, int Nobs>
+struct SteadyKalman
+{
+    KALMAN<Nstate, Nobs> K;
+
+    SteadyKalman()
+    {
+        FillModel<Nstate, Nobs>(K.F, K.H, K.Q, K.R);
+        K.P = Eye<Nstate, Nstate>();
+        K.begin();
+    }
+
+    __attribute__((noinline)) void update(const Matrix<Nobs> &obs) { K.update(obs); }
+};
+
+// The UD factorised filter on the same model
+template <int Nstate, int Nobs>
+struct UDKalman
+{
+    KALMAN_UD<Nstate, Nobs> K;
+
+    UDKalman()
+    {
+        FillModel<Nstate, Nobs>(K.F, K.H, K.Q, K.R);
+        K.setP(Eye<Nstate, Nstate>());
+    }
+
+    __attribute__((noinline)) void update(const Matrix<Nobs> &obs) { K.update(obs); }
+};
+
+// Timestamp counter ticks, which on the host are close to CPU cycles
+inline uint64_t Ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+template <typename Filter, int Nobs>
+void RunFilter(benchmark::State &state)
+{
+    Filter filter;
+    Matrix<Nobs> obs;
+    int step = 0;
+    uint64_t start = Ticks();
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < Nobs; ++i)
+        {
+            obs(i) = float((step + i) % 7) * 0.1f;
+        }
+
+        filter.update(obs);
+        benchmark::DoNotOptimize(filter);
+        ++step;
+    }
+
+    state.counters["cycles"] = benchmark::Counter(double(Ticks() - start), benchmark::Counter::kAvgIterations);
+    state.counters["filter_bytes"] = sizeof(filter);
+}
+
+template <int Nstate, int Nobs>
+void BM_KalmanInverse(benchmark::State &state)
+{
+    RunFilter<InverseKalman<Nstate, Nobs>, Nobs>(state);
+}
+
+template <int Nstate, int Nobs>
+void BM_KalmanCholesky(benchmark::State &state)
+{
+    RunFilter<CholeskyKalman<Nstate, Nobs>, Nobs>(state);
+}
+
+template <int Nstate, int Nobs>
+void BM_KalmanSequential(benchmark::State &state)
+{
+    RunFilter<SequentialKalman<Nstate, Nobs>, Nobs>(state);
+}
+
+template <int Nstate, int Nobs>
+void BM_KalmanSteady(benchmark::State &state)
+{
+    RunFilter<SteadyKalman<Nstate, Nobs>, Nobs>(state);
+}
+
+template <int Nstate, int Nobs>
+void BM_KalmanUD(benchmark::State &state)
+{
+    RunFilter<UDKalman<Nstate, Nobs>, Nobs>(state);
+}
+
+// One predict and correct step for state sizes 2 to 9
+#define BENCHMARK_KALMAN(Nstate, Nobs)                     \
+    BENCHMARK_TEMPLATE(BM_KalmanInverse, Nstate, Nobs);    \
+    BENCHMARK_TEMPLATE(BM_KalmanCholesky, Nstate, Nobs);   \
+    BENCHMARK_TEMPLATE(BM_KalmanSequential, Nstate, Nobs); \
+    BENCHMARK_TEMPLATE(BM_KalmanSteady, Nstate, Nobs);     \
+    BENCHMARK_TEMPLATE(BM_KalmanUD, Nstate, Nobs)
+
+BENCHMARK_KALMAN(2, 1);
+BENCHMARK_KALMAN(2, 2);
+BENCHMARK_KALMAN(3, 2);
+BENCHMARK_KALMAN(4, 2);
+BENCHMARK_KALMAN(5, 3);
+BENCHMARK_KALMAN(6, 3);
+BENCHMARK_KALMAN(7, 4);
+BENCHMARK_KALMAN(8, 4);
+BENCHMARK_KALMAN(9, 3);
+BENCHMARK_KALMAN(9, 9);
+
+// Dead reckoning with state (east, north, heading, speed) and a GPS position, at the IMU rate
+struct Unicycle : public KALMAN_FUNCTOR<4, 4>
+{
+    float dt = 0.01f;
+    bool analytic = true;
+
+    Matrix<4> operator()(const Matrix<4> &x) const override
+    {
+        return {x(0) + dt * x(3) * cos(x(2)), x(1) + dt * x(3) * sin(x(2)), x(2) + dt * 0.2f, x(3)};
+    }
+
+    Matrix<4, 4> jacobian(const Matrix<4> &x) const override
+    {
+        if (!analytic)
+        {
+            return KALMAN_FUNCTOR<4, 4>::jacobian(x);
+        }
+
+        return {1.0f, 0.0f, -dt * x(3) * sin(x(2)), dt * cos(x(2)),
+                0.0f, 1.0f, dt * x(3) * cos(x(2)),  dt * sin(x(2)),
+                0.0f, 0.0f, 1.0f,                    0.0f,
+                0.0f, 0.0f, 0.0f,                    1.0f};
+    }
+};
+
+struct Position : public KALMAN_FUNCTOR<4, 2>
+{
+    Matrix<2> operator()(const Matrix<4> &x) const override { return {x(0), x(1)}; }
+
+    Matrix<2, 4> jacobian(const Matrix<4> &) const override { return {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f}; }
+};
+
+template <typename Filter>
+void RunNonlinear(benchmark::State &state, bool analytic)
+{
+    Unicycle f;
+    Position h;
+    f.analytic = analytic;
+
+    Filter filter(f, h);
+    filter.x = {10.0f, 0.0f, 1.5f, 2.0f};
+    filter.P = Eye<4, 4>();
+    filter.Q = Eye<4, 4>() * 1e-4f;
+    filter.R = Eye<2, 2>() * 0.1f;
+
+    Matrix<2> obs;
+    int step = 0;
+    uint64_t start = Ticks();
+
+    for (auto _ : state)
+    {
+        obs(0) = filter.x(0) + float(step % 7) * 0.01f;
+        obs(1) = filter.x(1) - float(step % 5) * 0.01f;
+
+        filter.update(obs);
+        benchmark::DoNotOptimize(filter);
+        ++step;
+    }
+
+    state.counters["cycles"] = benchmark::Counter(double(Ticks() - start), benchmark::Counter::kAvgIterations);
+    state.counters["filter_bytes"] = sizeof(filter);
+}
+
+void BM_EKFAnalytic(benchmark::State &state) { RunNonlinear<KALMAN_EKF<4, 2>>(state, true); }
+
+void BM_EKFNumerical(benchmark::State &state) { RunNonlinear<KALMAN_EKF<4, 2>>(state, false); }
+
+void BM_UKF(benchmark::State &state) { RunNonlinear<KALMAN_UKF<4, 2>>(state, true); }
+
+// One predict and correct step of the dead reckoning model
+BENCHMARK(BM_EKFAnalytic);
+BENCHMARK(BM_EKFNumerical);
+BENCHMARK(BM_UKF);
+
+// One accelerometer sample of the GPS and accelerometer fusion, with a fix every 100 samples
+void BM_GpsImu(benchmark::State &state)
+{
+    KALMAN_GPS_IMU fusion(0.01f);
+    int step = 0;
+    uint64_t start = Ticks();
+
+    for (auto _ : state)
+    {
+        if (step % 100 == 0)
+        {
+            fusion.updategps(0.15f * step, 0.05f * step);
+        }
+
+        fusion.updateimu(0.1f * float(step % 5), 0.02f);
+        benchmark::DoNotOptimize(fusion);
+        ++step;
+    }
+
+    state.counters["cycles"] = benchmark::Counter(double(Ticks() - start), benchmark::Counter::kAvgIterations);
+    state.counters["filter_bytes"] = sizeof(fusion);
+}
+
+BENCHMARK(BM_GpsImu);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+
+#include "../extras/smoother/KalmanSmoother.h"
+
+#include <chrono>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Filters and smooths a synthetic log of the given number of fixes with the constant velocity model of kalman_smooth
+void SmoothLog(long fixes)
+{
+    KALMAN<4, 2> K;
+    const float dt = 1.0f;
+    K.F = {1.0f, 0.0f, dt, 0.0f, 0.0f, 1.0f, 0.0f, dt, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    K.Q = {0.33f, 0.0f, 0.5f, 0.0f, 0.0f, 0.33f, 0.0f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.0f, 1.0f};
+    K.H = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+    K.R = {25.0f, 0.0f, 0.0f, 25.0f};
+    K.P = Eye<4, 4>() * 100.0f;
+
+    KALMAN_RTS<4> rts;
+
+    for (long k = 0; k < fixes; ++k)
+    {
+        Matrix<2> obs = {10.0f * k + float(k % 7), 5.0f * k - float(k % 5)};
+        K.update(obs);
+        rts.push(K);
+    }
+
+    rts.smooth();
+    benchmark::DoNotOptimize(rts);
+}
+
+// Each run is done in a child process so that its peak resident memory is its own
+void BM_RTSSmoother(benchmark::State &state)
+{
+    const long fixes = state.range(0);
+    long peak_kb = 0;
+
+    for (auto _ : state)
+    {
+        int pipe_fds[2];
+        if (pipe(pipe_fds) != 0)
+        {
+            state.SkipWithError("pipe failed");
+            return;
+        }
+
+        pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            auto start = std::chrono::steady_clock::now();
+            SmoothLog(fixes);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ssize_t written = write(pipe_fds[1], &seconds, sizeof(seconds));
+            _exit(written == sizeof(seconds) ? 0 : 1);
+        }
+
+        double seconds = 0.0;
+        ssize_t got = read(pipe_fds[0], &seconds, sizeof(seconds));
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+
+        int status;
+        struct rusage usage;
+        wait4(pid, &status, 0, &usage);
+
+        if (got != sizeof(seconds) || status != 0)
+        {
+            state.SkipWithError("child failed");
+            return;
+        }
+
+        state.SetIterationTime(seconds);
+        peak_kb = std::max(peak_kb, long(usage.ru_maxrss));
+    }
+
+    state.counters["fixes_per_second"] = benchmark::Counter(double(fixes), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["peak_rss_kb"] = peak_kb;
+}
+
+// Several logs of 10^5 fixes, one per thread
+void BM_RTSParallel(benchmark::State &state)
+{
+    const int threads = state.range(0);
+    const int logs = 8;
+    const long fixes = 100000;
+
+    for (auto _ : state)
+    {
+        kalman_parallel(logs, threads, [&](int) { SmoothLog(fixes); });
+    }
+
+    state.counters["fixes_per_second"] =
+        benchmark::Counter(double(logs * fixes), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+BENCHMARK(BM_RTSSmoother)->RangeMultiplier(10)->Range(1000, 10000000)->UseManualTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RTSParallel)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
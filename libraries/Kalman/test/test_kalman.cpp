@@ -0,0 +1,979 @@
+#include <gtest/gtest.h>
+
+#include "../Kalman.h"
+#include "../KalmanGpsImu.h"
+#include "../extras/smoother/KalmanSmoother.h"
+
+namespace
+{
+
+// A deterministic stand in for sensor noise, uniform in [-1, 1)
+struct Noise
+{
+    uint32_t state = 12345;
+
+    float operator()()
+    {
+        state = state * 1664525u + 1013904223u;
+        return float(state >> 8) / float(1 << 23) - 1.0f;
+    }
+};
+
+// The textbook filter in double precision with an explicit inverse of S, to check the float one against
+template <int Nstate, int Nobs>
+struct ReferenceKalman
+{
+    Matrix<Nstate, Nstate, double> F, Q, P;
+    Matrix<Nobs, Nstate, double> H;
+    Matrix<Nobs, Nobs, double> R;
+    Matrix<Nstate, 1, double> x;
+
+    void update(const Matrix<Nobs, 1, double> &obs)
+    {
+        x = F * x;
+        P = F * P * ~F + Q;
+        Matrix<Nobs, Nobs, double> S = H * P * ~H + R;
+        Matrix<Nstate, Nobs, double> K = P * ~H * Inverse(S);
+        x += K * (obs - H * x);
+        P = (Eye<Nstate, Nstate, double>() - K * H) * P;
+    }
+};
+
+template <int Rows, int Cols, typename MatType>
+Matrix<Rows, Cols, double> ToDouble(const MatType &mat)
+{
+    Matrix<Rows, Cols, double> out;
+
+    for (int i = 0; i < Rows; ++i)
+    {
+        for (int j = 0; j < Cols; ++j)
+        {
+            out(i, j) = mat(i, j);
+        }
+    }
+
+    return out;
+}
+
+}  // namespace
+
+TEST(Kalman, MatchesReference)
+{
+    // Position, speed and acceleration observed by a position sensor and an accelerometer
+    const float dt = 0.01f;
+
+    KALMAN<3, 2> K;
+    K.F = {1.0f, dt, dt * dt / 2, 0.0f, 1.0f, dt, 0.0f, 0.0f, 1.0f};
+    K.H = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    K.R = {0.09f, 0.0f, 0.0f, 25.0f};
+    K.Q = {0.01f, 0.0f, 0.0f, 0.0f, 0.01f, 0.0f, 0.0f, 0.0f, 0.64f};
+    K.P = Eye<3, 3>();
+
+    ReferenceKalman<3, 2> ref;
+    ref.F = ToDouble<3, 3>(K.F);
+    ref.H = ToDouble<2, 3>(K.H);
+    ref.R = ToDouble<2, 2>(K.R);
+    ref.Q = ToDouble<3, 3>(K.Q);
+    ref.P = ToDouble<3, 3>(K.P);
+    ref.x.Fill(0.0);
+
+    Noise noise;
+
+    for (int step = 0; step < 1000; ++step)
+    {
+        float t = step * dt;
+        Matrix<2> obs = {sin(t) + 0.3f * noise(), -sin(t) + 5.0f * noise()};
+
+        K.update(obs);
+        ref.update(ToDouble<2, 1>(obs));
+
+        ASSERT_EQ(K.status, 0);
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_NEAR(K.x(i), ref.x(i), 1e-3);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_NEAR(K.P(i, j), ref.P(i, j), 1e-5);
+        }
+    }
+}
+
+TEST(Kalman, PackedEvolutionMatrix)
+{
+    KALMAN<2, 2> dense;
+    KALMAN<2, 2, 0, Diagonal<2>> diagonal;
+
+    dense.F = {0.9f, 0.0f, 0.0f, 0.8f};
+    diagonal.F = {0.9f, 0.0f, 0.0f, 0.8f};
+    dense.H = diagonal.H = {1.0f, 0.5f, 0.0f, 1.0f};
+    dense.R = diagonal.R = {0.1f, 0.0f, 0.0f, 0.2f};
+    dense.Q = diagonal.Q = {0.01f, 0.005f, 0.005f, 0.02f};
+
+    for (int step = 0; step < 20; ++step)
+    {
+        Matrix<2> obs = {float(step % 3), 1.0f};
+        dense.update(obs);
+        diagonal.update(obs);
+    }
+
+    EXPECT_LT(sizeof(diagonal.F), sizeof(dense.F));
+
+    for (int i = 0; i < 2; ++i)
+    {
+        EXPECT_FLOAT_EQ(diagonal.x(i), dense.x(i));
+
+        for (int j = 0; j < 2; ++j)
+        {
+            EXPECT_FLOAT_EQ(diagonal.P(i, j), dense.P(i, j));
+        }
+    }
+}
+
+TEST(Kalman, Command)
+{
+    // A cart pushed by a known acceleration and observed through its position only
+    KALMAN<2, 1, 1> K;
+    K.F = {1.0f, 0.1f, 0.0f, 1.0f};
+    K.B = {0.005f, 0.1f};
+    K.H = {1.0f, 0.0f};
+    K.R = {0.01f};
+    K.Q = {1e-6f, 0.0f, 0.0f, 1e-6f};
+    K.P = Eye<2, 2>();
+
+    Matrix<2> state = {0.0f, 0.0f};
+    Matrix<1> com = {1.0f};
+
+    for (int step = 0; step < 200; ++step)
+    {
+        state = K.F * state + K.B * com;
+        K.update(K.H * state, com);
+    }
+
+    EXPECT_EQ(K.status, 0);
+    EXPECT_NEAR(K.x(0), state(0), 1e-2 * state(0));
+    EXPECT_NEAR(K.x(1), state(1), 1e-2 * state(1));
+}
+
+TEST(Kalman, Errors)
+{
+    KALMAN<2, 2> K;
+    K.F = Eye<2, 2>();
+    K.H = Eye<2, 2>();
+    K.Q.Fill(0.0f);
+    K.R = {0.1f, 0.0f, 0.0f, 0.1f};
+    K.x = {1.0f, 2.0f};
+
+    // Bad observations are skipped
+    K.update({NAN, 0.0f});
+    EXPECT_EQ(K.status, 1);
+    EXPECT_FLOAT_EQ(K.x(0), 1.0f);
+    EXPECT_FLOAT_EQ(K.x(1), 2.0f);
+
+    K.update({1.0f, 2.0f});
+    EXPECT_EQ(K.status, 0);
+
+    // With no uncertainty at all S can't be factorised
+    K.R.Fill(0.0f);
+    K.update({1.0f, 2.0f});
+    EXPECT_EQ(K.status, 1);
+}
+
+TEST(Kalman, SequentialObservations)
+{
+    // Independent sensors: processing the observations one at a time gives the same result as all at once
+    const float dt = 0.01f;
+
+    KALMAN<3, 2> batch;
+    KALMAN<3, 2, 0, Matrix<3, 3>, Diagonal<2>> sequential;
+
+    batch.F = sequential.F = {1.0f, dt, dt * dt / 2, 0.0f, 1.0f, dt, 0.0f, 0.0f, 1.0f};
+    batch.H = sequential.H = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    batch.R = sequential.R = {0.09f, 0.0f, 0.0f, 25.0f};
+    batch.Q = sequential.Q = {0.01f, 0.0f, 0.0f, 0.0f, 0.01f, 0.0f, 0.0f, 0.0f, 0.64f};
+    batch.P = sequential.P = Eye<3, 3>();
+
+    Noise noise;
+
+    for (int step = 0; step < 1000; ++step)
+    {
+        float t = step * dt;
+        Matrix<2> obs = {sin(t) + 0.3f * noise(), -sin(t) + 5.0f * noise()};
+
+        batch.update(obs);
+        sequential.update(obs);
+
+        ASSERT_EQ(sequential.status, 0);
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_NEAR(sequential.x(i), batch.x(i), 1e-4);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_NEAR(sequential.P(i, j), batch.P(i, j), 1e-5);
+        }
+    }
+}
+
+TEST(Kalman, AsynchronousObservations)
+{
+    // A position sensor at a tenth of the rate of the accelerometer
+    const float dt = 0.01f;
+
+    KALMAN<3, 2, 0, Matrix<3, 3>, Diagonal<2>> K;
+    K.F = {1.0f, dt, dt * dt / 2, 0.0f, 1.0f, dt, 0.0f, 0.0f, 1.0f};
+    K.H = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    K.R = {0.01f, 0.0f, 0.0f, 0.01f};
+    K.Q = {1e-6f, 0.0f, 0.0f, 0.0f, 1e-6f, 0.0f, 0.0f, 0.0f, 1e-2f};
+    K.P = Eye<3, 3>();
+
+    // Starts at rest at x = 1 with a constant acceleration of 2
+    for (int step = 1; step <= 500; ++step)
+    {
+        float t = step * dt;
+
+        K.predict();
+        EXPECT_EQ(K.status, 0);
+
+        K.update(1, 2.0f);
+        EXPECT_EQ(K.status, 0);
+
+        if (step % 10 == 0)
+        {
+            K.update(0, 1.0f + t * t);
+            EXPECT_EQ(K.status, 0);
+        }
+    }
+
+    EXPECT_NEAR(K.x(0), 26.0f, 0.1f);
+    EXPECT_NEAR(K.x(1), 10.0f, 0.1f);
+    EXPECT_NEAR(K.x(2), 2.0f, 0.01f);
+
+    // The observation index is checked along with its value
+    K.update(2, 0.0f);
+    EXPECT_EQ(K.status, 1);
+    K.update(0, NAN);
+    EXPECT_EQ(K.status, 1);
+}
+
+TEST(Kalman, SteadyState)
+{
+    const float dt = 0.01f;
+
+    KALMAN<3, 2> full, steady;
+    full.F = steady.F = {1.0f, dt, dt * dt / 2, 0.0f, 1.0f, dt, 0.0f, 0.0f, 1.0f};
+    full.H = steady.H = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    full.R = steady.R = {0.09f, 0.0f, 0.0f, 25.0f};
+    full.Q = steady.Q = {0.01f, 0.0f, 0.0f, 0.0f, 0.01f, 0.0f, 0.0f, 0.0f, 0.64f};
+    full.P = steady.P = Eye<3, 3>();
+
+    ASSERT_TRUE(steady.begin());
+    EXPECT_TRUE(steady.steady);
+    EXPECT_EQ(steady.status, 0);
+
+    Noise noise;
+
+    for (int step = 0; step < 2000; ++step)
+    {
+        float t = step * dt;
+        Matrix<2> obs = {sin(t) + 0.3f * noise(), -sin(t) + 5.0f * noise()};
+
+        Matrix<3> predicted = steady.F * steady.x;
+        Matrix<3> expected = predicted + steady.Kss * (obs - steady.H * predicted);
+
+        full.update(obs);
+        steady.update(obs);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            ASSERT_FLOAT_EQ(steady.x(i), expected(i));
+        }
+    }
+
+    // Once the full filter has converged the two agree, up to the tolerance on the gain
+    EXPECT_TRUE(steady.steady);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_NEAR(steady.x(i), full.x(i), 1e-4);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_NEAR(steady.P(i, j), full.P(i, j), 1e-4);
+        }
+    }
+
+    // Changing the model goes back to the full update
+    steady.Q(2, 2) = 0.5f;
+    full.Q(2, 2) = 0.5f;
+
+    steady.update({0.5f, 0.1f});
+    full.update({0.5f, 0.1f});
+
+    EXPECT_FALSE(steady.steady);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_NEAR(steady.x(i), full.x(i), 1e-4);
+    }
+}
+
+TEST(Kalman, OfflineGain)
+{
+    KALMAN<2, 1> K;
+    K.F = {1.0f, 0.1f, 0.0f, 1.0f};
+    K.H = {1.0f, 0.0f};
+    K.R = {0.01f};
+    K.Q = {1e-4f, 0.0f, 0.0f, 1e-4f};
+    K.x = {1.0f, 1.0f};
+
+    K.setgain({0.5f, 0.25f});
+    EXPECT_TRUE(K.steady);
+
+    // x = F * x + K * (obs - H * F * x) with F * x = [1.1, 1]
+    K.update({2.1f});
+    EXPECT_FLOAT_EQ(K.x(0), 1.6f);
+    EXPECT_FLOAT_EQ(K.x(1), 1.25f);
+
+    K.H(0, 1) = 0.5f;
+    K.update({2.1f});
+    EXPECT_FALSE(K.steady);
+}
+
+TEST(Kalman, UDCovariance)
+{
+    KALMAN_UD<3, 1> K;
+
+    SymmetricMatrix<3> P = {4.0f, 1.0f, 0.5f, 1.0f, 3.0f, -0.2f, 0.5f, -0.2f, 2.0f};
+    K.setP(P);
+    EXPECT_EQ(K.status, 0);
+
+    SymmetricMatrix<3> UDUt = K.getP();
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_FLOAT_EQ(K.U(i, i), 1.0f);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_NEAR(UDUt(i, j), P(i, j), 1e-6);
+        }
+    }
+
+    EXPECT_LT(sizeof(K.U) + sizeof(K.D), 2 * sizeof(Matrix<3, 3>));
+}
+
+TEST(Kalman, UDMatchesKalman)
+{
+    const float dt = 0.01f;
+
+    KALMAN<3, 2, 0, Matrix<3, 3>, Diagonal<2>> K;
+    KALMAN_UD<3, 2> UD;
+
+    K.F = UD.F = {1.0f, dt, dt * dt / 2, 0.0f, 1.0f, dt, 0.0f, 0.0f, 1.0f};
+    K.H = UD.H = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    K.R = UD.R = {0.09f, 0.0f, 0.0f, 25.0f};
+    K.Q = UD.Q = {0.01f, 0.0f, 0.0f, 0.0f, 0.01f, 0.0f, 0.0f, 0.0f, 0.64f};
+    K.P = Eye<3, 3>();
+    UD.setP(K.P);
+
+    Noise noise;
+
+    for (int step = 0; step < 1000; ++step)
+    {
+        float t = step * dt;
+        Matrix<2> obs = {sin(t) + 0.3f * noise(), -sin(t) + 5.0f * noise()};
+
+        K.update(obs);
+        UD.update(obs);
+
+        ASSERT_EQ(UD.status, 0);
+    }
+
+    SymmetricMatrix<3> P = UD.getP();
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_NEAR(UD.x(i), K.x(i), 1e-4);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_NEAR(P(i, j), K.P(i, j), 1e-5);
+        }
+    }
+
+    // Observations one at a time, with a command
+    KALMAN_UD<2, 1, 1> cart;
+    cart.F = {1.0f, 0.1f, 0.0f, 1.0f};
+    cart.B = {0.005f, 0.1f};
+    cart.H = {1.0f, 0.0f};
+    cart.R = {0.01f};
+    cart.Q = {1e-6f, 0.0f, 0.0f, 1e-6f};
+    cart.setP(Eye<2, 2>());
+
+    Matrix<2> state = {0.0f, 0.0f};
+    Matrix<1> com = {1.0f};
+
+    for (int step = 0; step < 200; ++step)
+    {
+        state = cart.F * state + cart.B * com;
+        cart.predict(com);
+        cart.update(0, state(0));
+    }
+
+    EXPECT_EQ(cart.status, 0);
+    EXPECT_NEAR(cart.x(0), state(0), 1e-2 * state(0));
+    EXPECT_NEAR(cart.x(1), state(1), 1e-2 * state(1));
+}
+
+// The default suite runs a shorter UDLongRun, the KALMAN_LONG_TESTS build option adds the 10^7 steps one
+#ifndef KALMAN_LONG_RUN_STEPS
+#define KALMAN_LONG_RUN_STEPS 100000
+#endif
+
+TEST(Kalman, UDLongRun)
+{
+    // A very precise position sensor on a slowly varying system that starts out with a large uncertainty, which makes
+    // P badly conditioned: the covariance update of KALMAN loses positive definiteness in float within a few steps.
+    // Run for a long time against the textbook filter in double.
+    const float dt = 0.001f;
+    const long steps = KALMAN_LONG_RUN_STEPS;
+
+    KALMAN_UD<2, 1> UD;
+    UD.F = {0.9999f, dt, 0.0f, 0.999f};
+    UD.H = {1.0f, 0.0f};
+    UD.R = {1e-10f};
+    UD.Q = {0.0f, 0.0f, 0.0f, 1e-12f};
+    UD.setP(Eye<2, 2>() * 1e6f);
+
+    ReferenceKalman<2, 1> ref;
+    ref.F = ToDouble<2, 2>(UD.F);
+    ref.H = ToDouble<1, 2>(UD.H);
+    ref.R = ToDouble<1, 1>(UD.R);
+    ref.Q = ToDouble<2, 2>(UD.Q);
+    ref.P = Eye<2, 2, double>() * 1e6;
+    ref.x.Fill(0.0);
+
+    Noise noise;
+    Matrix<2, 1, double> state = {0.0, 0.0};
+    float smallest_d = 1.0f;
+
+    for (long step = 0; step < steps; ++step)
+    {
+        state = ref.F * state;
+        state(1) += 1e-6 * noise();
+
+        Matrix<1> obs = {float(state(0)) + 1e-5f * noise()};
+
+        UD.update(obs);
+        ref.update(ToDouble<1, 1>(obs));
+
+        smallest_d = std::min(smallest_d, std::min<float>(UD.D(0, 0), UD.D(1, 1)));
+
+        if (UD.status != 0)
+        {
+            FAIL() << "status flipped at step " << step;
+        }
+    }
+
+    EXPECT_GT(smallest_d, 0.0f);
+
+    SymmetricMatrix<2> P = UD.getP();
+
+    for (int i = 0; i < 2; ++i)
+    {
+        EXPECT_NEAR(UD.x(i), ref.x(i), 1e-3 * fabs(ref.x(i)));
+
+        for (int j = 0; j < 2; ++j)
+        {
+            EXPECT_NEAR(P(i, j), ref.P(i, j), 1e-3 * fabs(ref.P(i, j)));
+        }
+    }
+}
+
+namespace
+{
+
+// x -> A*x, with its analytic Jacobian or without to fall back on finite differences
+template <int Inputs, int Outputs>
+struct LinearFunction : public KALMAN_FUNCTOR<Inputs, Outputs>
+{
+    Matrix<Outputs, Inputs> A;
+    bool analytic = true;
+
+    Matrix<Outputs> operator()(const Matrix<Inputs> &x) const override { return A * x; }
+
+    Matrix<Outputs, Inputs> jacobian(const Matrix<Inputs> &x) const override
+    {
+        return analytic ? A : KALMAN_FUNCTOR<Inputs, Outputs>::jacobian(x);
+    }
+};
+
+// Dead reckoning of a vehicle with state (east, north, heading, speed), driven by a yaw rate and an acceleration
+struct Unicycle : public KALMAN_FUNCTOR<4, 4>
+{
+    float dt = 0.01f;
+    float yaw_rate = 0.0f;
+    float accel = 0.0f;
+    bool analytic = true;
+
+    Matrix<4> operator()(const Matrix<4> &x) const override
+    {
+        return {x(0) + dt * x(3) * cos(x(2)), x(1) + dt * x(3) * sin(x(2)), x(2) + dt * yaw_rate, x(3) + dt * accel};
+    }
+
+    Matrix<4, 4> jacobian(const Matrix<4> &x) const override
+    {
+        if (!analytic)
+        {
+            return KALMAN_FUNCTOR<4, 4>::jacobian(x);
+        }
+
+        return {1.0f, 0.0f, -dt * x(3) * sin(x(2)), dt * cos(x(2)),
+                0.0f, 1.0f, dt * x(3) * cos(x(2)),  dt * sin(x(2)),
+                0.0f, 0.0f, 1.0f,                    0.0f,
+                0.0f, 0.0f, 0.0f,                    1.0f};
+    }
+};
+
+// Range and bearing to a beacon at the origin
+struct RangeBearing : public KALMAN_FUNCTOR<4, 2>
+{
+    Matrix<2> operator()(const Matrix<4> &x) const override
+    {
+        return {sqrt(x(0) * x(0) + x(1) * x(1)), atan2(x(1), x(0))};
+    }
+};
+
+}  // namespace
+
+TEST(Kalman, EKFLinearMatchesKalman)
+{
+    // On a linear model the extended filters are the plain one. Numerical Jacobians are forward differences in float,
+    // which are only good to about 1e-4 and so cost the covariance a few digits
+    const float dt = 0.01f;
+
+    KALMAN<3, 2> K;
+    K.F = {1.0f, dt, dt * dt / 2, 0.0f, 1.0f, dt, 0.0f, 0.0f, 1.0f};
+    K.H = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    K.R = {0.09f, 0.0f, 0.0f, 25.0f};
+    K.Q = {0.01f, 0.0f, 0.0f, 0.0f, 0.01f, 0.0f, 0.0f, 0.0f, 0.64f};
+    K.P = Eye<3, 3>();
+
+    LinearFunction<3, 3> f;
+    LinearFunction<3, 2> h;
+    f.A = K.F;
+    h.A = K.H;
+
+    LinearFunction<3, 3> f_numerical = f;
+    LinearFunction<3, 2> h_numerical = h;
+    f_numerical.analytic = h_numerical.analytic = false;
+
+    KALMAN_EKF<3, 2> analytic(f, h);
+    KALMAN_EKF<3, 2> numerical(f_numerical, h_numerical);
+    KALMAN_UKF<3, 2> unscented(f, h);
+
+    analytic.Q = numerical.Q = unscented.Q = K.Q;
+    analytic.R = numerical.R = unscented.R = K.R;
+    analytic.P = numerical.P = unscented.P = K.P;
+
+    Noise noise;
+
+    for (int step = 0; step < 1000; ++step)
+    {
+        float t = step * dt;
+        Matrix<2> obs = {sin(t) + 0.3f * noise(), -sin(t) + 5.0f * noise()};
+
+        K.update(obs);
+        analytic.update(obs);
+        numerical.update(obs);
+        unscented.update(obs);
+
+        ASSERT_EQ(analytic.status, 0);
+        ASSERT_EQ(numerical.status, 0);
+        ASSERT_EQ(unscented.status, 0);
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_NEAR(analytic.x(i), K.x(i), 1e-4);
+        EXPECT_NEAR(numerical.x(i), K.x(i), 1e-2);
+        EXPECT_NEAR(unscented.x(i), K.x(i), 1e-3);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            EXPECT_NEAR(analytic.P(i, j), K.P(i, j), 1e-6);
+            EXPECT_NEAR(numerical.P(i, j), K.P(i, j), 2e-2 * fabs(K.P(i, j)) + 1e-5);
+            EXPECT_NEAR(unscented.P(i, j), K.P(i, j), 1e-5);
+        }
+    }
+}
+
+TEST(Kalman, NonlinearTracking)
+{
+    // A vehicle driving in circles, predicted at the IMU rate and corrected by a range and bearing every 10 steps
+    Unicycle f;
+    Unicycle f_numerical;
+    f_numerical.analytic = false;
+    RangeBearing h;
+
+    KALMAN_EKF<4, 2> analytic(f, h);
+    KALMAN_EKF<4, 2> numerical(f_numerical, h);
+    KALMAN_UKF<4, 2> unscented(f, h);
+
+    Matrix<4> state = {10.0f, 0.0f, 1.5708f, 2.0f};
+    Matrix<4> start = {9.0f, 1.0f, 1.3f, 1.5f};
+
+    analytic.x = numerical.x = unscented.x = start;
+    analytic.P = numerical.P = unscented.P = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                              0.0f, 0.0f, 0.1f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f};
+    analytic.Q = numerical.Q = unscented.Q = {1e-6f, 0.0f, 0.0f, 0.0f, 0.0f, 1e-6f, 0.0f, 0.0f,
+                                              0.0f,  0.0f, 1e-6f, 0.0f, 0.0f, 0.0f, 0.0f, 1e-5f};
+    analytic.R = numerical.R = unscented.R = {0.01f, 0.0f, 0.0f, 1e-4f};
+
+    Noise noise;
+
+    for (int step = 0; step < 3000; ++step)
+    {
+        f.yaw_rate = f_numerical.yaw_rate = 0.2f;
+        state = f(state);
+
+        analytic.predict();
+        numerical.predict();
+        unscented.predict();
+
+        if (step % 10 == 9)
+        {
+            Matrix<2> obs = h(state);
+            obs(0) += 0.1f * noise();
+            obs(1) += 0.01f * noise();
+
+            analytic.correct(obs);
+            numerical.correct(obs);
+            unscented.correct(obs);
+        }
+
+        ASSERT_EQ(analytic.status, 0);
+        ASSERT_EQ(numerical.status, 0);
+        ASSERT_EQ(unscented.status, 0);
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_NEAR(analytic.x(i), state(i), 0.1);
+        EXPECT_NEAR(numerical.x(i), analytic.x(i), 1e-2);
+        EXPECT_NEAR(unscented.x(i), state(i), 0.1);
+    }
+}
+
+namespace
+{
+
+// What the fusion reads from TinyGPSPlus and ADXL345_WE
+struct GValues
+{
+    float x, y, z;
+};
+
+struct Degrees
+{
+    uint16_t deg;
+    uint32_t billionths;
+    bool negative;
+};
+
+struct Location
+{
+    Degrees lat, lng;
+    bool updated = false;
+
+    bool isValid() const { return true; }
+    bool isUpdated() const { return updated; }
+    const Degrees &rawLat() { updated = false; return lat; }
+    const Degrees &rawLng() { return lng; }
+};
+
+Degrees ToDegrees(double degrees)
+{
+    Degrees out;
+    out.negative = degrees < 0.0;
+    degrees = fabs(degrees);
+    out.deg = uint16_t(degrees);
+    out.billionths = uint32_t((degrees - out.deg) * 1e9 + 0.5);
+    return out;
+}
+
+}  // namespace
+
+TEST(Kalman, GpsImuDrive)
+{
+    // A drive through Hanoi: it speeds up to 15 m/s, goes through a long bend and brakes, sampled by the accelerometer
+    // at 100 Hz and the GPS at 1 Hz. Between fixes the fused position should beat the last fix by far.
+    const double lat0 = 21.0285, lng0 = 105.8542;
+    const float dt = 0.01f;
+    const double meters_per_degree = KALMAN_METERS_PER_DEGREE;
+
+    KALMAN_GPS_IMU fusion(dt, 2.5f, 0.3f, 2.0f);
+    Noise noise;
+    Location location;
+
+    double e = 0.0, n = 0.0, heading = 0.3, speed = 0.0;
+    double fix_e = 0.0, fix_n = 0.0;
+    double fused_error = 0.0, fix_error = 0.0;
+    int samples = 0;
+
+    for (int step = 0; step < 12000; ++step)
+    {
+        double t = step * dt;
+        double accel = t < 10.0 ? 1.5 : (t > 100.0 ? -1.4 : 0.0);
+        double yaw_rate = (t > 40.0 && t < 70.0) ? 0.05 : 0.0;
+
+        speed = std::max(0.0, speed + accel * dt);
+        heading += yaw_rate * dt;
+        e += speed * cos(heading) * dt;
+        n += speed * sin(heading) * dt;
+
+        // forward and leftward accelerations in the sensor frame, with noise
+        GValues g = {float((speed > 0.0 ? accel : 0.0) / KALMAN_GRAVITY) + 0.01f * noise(),
+                     float(speed * yaw_rate / KALMAN_GRAVITY) + 0.01f * noise(), 1.0f};
+        fusion.updateimu(g);
+        ASSERT_EQ(fusion.status, 0);
+
+        if (step % 100 == 0)
+        {
+            fix_e = e + 2.5 * noise();
+            fix_n = n + 2.5 * noise();
+            location.lat = ToDegrees(lat0 + fix_n / meters_per_degree);
+            location.lng = ToDegrees(lng0 + fix_e / (meters_per_degree * cos(lat0 * M_PI / 180.0)));
+            location.updated = true;
+
+            EXPECT_TRUE(fusion.updategps(location));
+            EXPECT_FALSE(fusion.updategps(location));
+            ASSERT_EQ(fusion.status, 0);
+        }
+
+        // skip the start, before the heading and the filter settled
+        if (t > 20.0)
+        {
+            Matrix<2> position = fusion.getposition();
+            fused_error += pow(position(0) - e, 2) + pow(position(1) - n, 2);
+            fix_error += pow(fix_e - e, 2) + pow(fix_n - n, 2);
+            ++samples;
+        }
+    }
+
+    fused_error = sqrt(fused_error / samples);
+    fix_error = sqrt(fix_error / samples);
+
+    EXPECT_TRUE(fusion.headingknown);
+    EXPECT_LT(fused_error, 2.0);
+    EXPECT_LT(fused_error, 0.5 * fix_error);
+
+    Matrix<2> velocity = fusion.getvelocity();
+    EXPECT_NEAR(velocity(0), speed * cos(heading), 0.5);
+    EXPECT_NEAR(velocity(1), speed * sin(heading), 0.5);
+}
+
+TEST(Kalman, RTSSmoother)
+{
+    // The smoother against the textbook one in double, over more records than one mapped window holds
+    const float dt = 0.01f;
+    const int steps = 1000;
+
+    KALMAN<3, 2> K;
+    K.F = {1.0f, dt, dt * dt / 2, 0.0f, 1.0f, dt, 0.0f, 0.0f, 1.0f};
+    K.H = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    K.R = {0.09f, 0.0f, 0.0f, 25.0f};
+    K.Q = {0.01f, 0.0f, 0.0f, 0.0f, 0.01f, 0.0f, 0.0f, 0.0f, 0.64f};
+    K.P = Eye<3, 3>();
+
+    ReferenceKalman<3, 2> ref;
+    ref.F = ToDouble<3, 3>(K.F);
+    ref.H = ToDouble<2, 3>(K.H);
+    ref.R = ToDouble<2, 2>(K.R);
+    ref.Q = ToDouble<3, 3>(K.Q);
+    ref.P = ToDouble<3, 3>(K.P);
+    ref.x.Fill(0.0);
+
+    KALMAN_RTS<3> rts("/tmp", 1);
+    ASSERT_EQ(rts.status, 0);
+
+    std::vector<Matrix<3, 1, double>> xs;
+    std::vector<Matrix<3, 3, double>> Ps;
+    Noise noise;
+
+    for (int step = 0; step < steps; ++step)
+    {
+        float t = step * dt;
+        Matrix<2> obs = {sin(t) + 0.3f * noise(), -sin(t) + 5.0f * noise()};
+
+        K.update(obs);
+        ref.update(ToDouble<2, 1>(obs));
+        ASSERT_TRUE(rts.push(K));
+
+        xs.push_back(ref.x);
+        Ps.push_back(ref.P);
+    }
+
+    ASSERT_EQ(rts.size(), steps);
+    ASSERT_TRUE(rts.smooth());
+
+    for (int k = steps - 2; k >= 0; --k)
+    {
+        Matrix<3, 3, double> Pp = ref.F * Ps[k] * ~ref.F + ref.Q;
+        Matrix<3, 3, double> C = Ps[k] * ~ref.F * Inverse(Pp);
+        xs[k] += C * (xs[k + 1] - ref.F * xs[k]);
+        Ps[k] += C * (Ps[k + 1] - Pp) * ~C;
+    }
+
+    Matrix<3> x;
+    SymmetricMatrix<3> P;
+
+    for (int k = 0; k < steps; k += 37)
+    {
+        rts.get(k, x, P);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            EXPECT_NEAR(x(i), xs[k](i), 1e-3) << "record " << k;
+
+            for (int j = 0; j < 3; ++j)
+            {
+                EXPECT_NEAR(P(i, j), Ps[k](i, j), 1e-4 + 1e-3 * fabs(Ps[k](i, j))) << "record " << k;
+            }
+        }
+    }
+
+    // smoothing uses the observations after each record, so its covariance is smaller than the filtered one
+    rts.get(steps / 2, x, P);
+    EXPECT_LT(P(0, 0), K.P(0, 0));
+}
+
+TEST(Kalman, RTSTimeVaryingModel)
+{
+    // Fixes at irregular times, so F changes at each step and is set element by element
+    const int steps = 300;
+
+    KALMAN<2, 1> K;
+    K.F = Eye<2, 2>();
+    K.H = {1.0f, 0.0f};
+    K.R = {4.0f};
+    K.Q = {0.01f, 0.0f, 0.0f, 0.01f};
+    K.P = Eye<2, 2>() * 100.0f;
+
+    ReferenceKalman<2, 1> ref;
+    ref.H = ToDouble<1, 2>(K.H);
+    ref.R = ToDouble<1, 1>(K.R);
+    ref.Q = ToDouble<2, 2>(K.Q);
+    ref.P = ToDouble<2, 2>(K.P);
+    ref.x.Fill(0.0);
+
+    KALMAN_RTS<2> rts;
+    ASSERT_EQ(rts.status, 0);
+
+    std::vector<Matrix<2, 1, double>> xs;
+    std::vector<Matrix<2, 2, double>> Ps;
+    std::vector<double> dts;
+    Noise noise;
+    float t = 0.0f;
+
+    for (int step = 0; step < steps; ++step)
+    {
+        float dt = 0.5f + 0.4f * noise();
+        t += dt;
+        K.F(0, 1) = dt;
+        ref.F = ToDouble<2, 2>(K.F);
+
+        Matrix<1> obs = {3.0f * t + 2.0f * noise()};
+        K.update(obs);
+        ref.update(ToDouble<1, 1>(obs));
+        ASSERT_TRUE(rts.push(K));
+
+        xs.push_back(ref.x);
+        Ps.push_back(ref.P);
+        dts.push_back(dt);
+    }
+
+    ASSERT_TRUE(rts.smooth());
+
+    for (int k = steps - 2; k >= 0; --k)
+    {
+        Matrix<2, 2, double> F = {1.0, dts[k + 1], 0.0, 1.0};
+        Matrix<2, 2, double> Pp = F * Ps[k] * ~F + ref.Q;
+        Matrix<2, 2, double> C = Ps[k] * ~F * Inverse(Pp);
+        xs[k] += C * (xs[k + 1] - F * xs[k]);
+        Ps[k] += C * (Ps[k + 1] - Pp) * ~C;
+    }
+
+    Matrix<2> x;
+    SymmetricMatrix<2> P;
+
+    for (int k = 0; k < steps; k += 13)
+    {
+        rts.get(k, x, P);
+        EXPECT_NEAR(x(0), xs[k](0), 1e-3 + 1e-5 * fabs(xs[k](0))) << "record " << k;
+        EXPECT_NEAR(x(1), xs[k](1), 1e-3) << "record " << k;
+    }
+
+    // There's no record before the first one or after the last
+    EXPECT_FALSE(rts.get(-1, x, P));
+    EXPECT_EQ(rts.status, 1);
+    EXPECT_FALSE(rts.get(steps, x, P));
+    EXPECT_TRUE(rts.get(steps - 1, x, P));
+    EXPECT_EQ(rts.status, 0);
+}
+
+TEST(Kalman, RTSParallel)
+{
+    // One smoother per log, on several threads
+    const int logs = 6;
+    std::vector<float> last(logs);
+    std::vector<float> first(logs);
+
+    kalman_parallel(logs, 3, [&](int i) {
+        KALMAN<2, 1> K;
+        K.F = {1.0f, 1.0f, 0.0f, 1.0f};
+        K.H = {1.0f, 0.0f};
+        K.R = {1.0f};
+        K.Q = {0.01f, 0.0f, 0.0f, 0.01f};
+        K.P = Eye<2, 2>() * 100.0f;
+
+        KALMAN_RTS<2> rts;
+
+        for (int step = 0; step < 500; ++step)
+        {
+            Matrix<1> obs = {float(i * step)};
+            K.update(obs);
+            rts.push(K);
+        }
+
+        rts.smooth();
+        Matrix<2> x;
+        SymmetricMatrix<2> P;
+        rts.get(0, x, P);
+        first[i] = x(1);
+        rts.get(499, x, P);
+        last[i] = x(1);
+    });
+
+    for (int i = 0; i < logs; ++i)
+    {
+        // the speed of each log, known from the start once smoothed
+        EXPECT_NEAR(first[i], float(i), 1e-2);
+        EXPECT_NEAR(last[i], float(i), 1e-2);
+    }
+}
+
+TEST(Kalman, ParallelAllCores)
+{
+    // No thread count means one per core, and at least one when the number of cores isn't known
+    std::vector<int> runs(20, 0);
+
+    kalman_parallel(20, 0, [&](int i) { runs[i]++; });
+
+    EXPECT_EQ(runs, std::vector<int>(20, 1));
+}
@@ -0,0 +1,452 @@
+/******************************************************************
+  @file       ReefwingDSP.h
+  @brief      Biquad (IIR) cascades and FIR filters, in float and
+              Q15, with coefficients designed at compile time.
+  @author     David Such
+  @copyright  Please see the accompanying LICENSE.txt file.
+
+  Code:        David Such
+  Version:     2.3.0
+  Date:        19/10/26
+
+  2.3.0 Biquad & FIR Filters        19/10/26
+
+  Credits - Biquad designs are from the Audio EQ Cookbook by
+            Robert Bristow-Johnson
+            (https://www.w3.org/TR/audio-eq-cookbook/)
+
+******************************************************************/
+
+#ifndef ReefwingDSP_h
+#define ReefwingDSP_h
+
+#include "Arduino.h"
+#include <string.h>
+
+//  The dual 16 bit multiply accumulate intrinsic of Cortex-M4/M7
+#if defined(__ARM_FEATURE_DSP) && defined(__GNUC__) && __GNUC__ >= 10
+#define REEFWING_DSP_SMLAD 1
+#include <arm_acle.h>
+#endif
+
+/******************************************************************
+ *
+ * Compile Time Design -
+ *
+ ******************************************************************/
+
+//  constexpr stand ins for sin() and cos(), which are only meant to
+//  be evaluated by the compiler: a range reduction to [-pi, pi]
+//  then a Taylor series.
+constexpr double DSP_PI = 3.14159265358979323846;
+
+constexpr double dspWrap(double x) {
+  return x - 2.0 * DSP_PI * (double)(long long)(x / (2.0 * DSP_PI));
+}
+
+constexpr double dspWrapPi(double x) {
+  return x > DSP_PI ? x - 2.0 * DSP_PI : (x < -DSP_PI ? x + 2.0 * DSP_PI : x);
+}
+
+constexpr double dspSinSeries(double x2, double term, double sum, int k) {
+  return k > 41 ? sum : dspSinSeries(x2, -term * x2 / ((k + 1) * (k + 2)), sum + term, k + 2);
+}
+
+constexpr double dspSinReduced(double x) {
+  return dspSinSeries(x * x, x, 0.0, 1);
+}
+
+constexpr double dspSin(double x) { return dspSinReduced(dspWrapPi(dspWrap(x))); }
+constexpr double dspCos(double x) { return dspSin(x + 0.5 * DSP_PI); }
+
+//  Second order section y = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2) x
+struct BiquadCoefficients {
+  float b0, b1, b2, a1, a2;
+};
+
+constexpr BiquadCoefficients biquadNormalise(double b0, double b1, double b2, double a0, double a1, double a2) {
+  return BiquadCoefficients{(float)(b0 / a0), (float)(b1 / a0), (float)(b2 / a0), (float)(a1 / a0), (float)(a2 / a0)};
+}
+
+//  Audio EQ Cookbook filters, from cos(w0) and alpha = sin(w0) / 2Q
+constexpr BiquadCoefficients lowPassRBJ(double c, double alpha) {
+  return biquadNormalise((1.0 - c) / 2.0, 1.0 - c, (1.0 - c) / 2.0, 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+}
+
+constexpr BiquadCoefficients highPassRBJ(double c, double alpha) {
+  return biquadNormalise((1.0 + c) / 2.0, -(1.0 + c), (1.0 + c) / 2.0, 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+}
+
+constexpr BiquadCoefficients bandPassRBJ(double c, double alpha) {
+  return biquadNormalise(alpha, 0.0, -alpha, 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+}
+
+constexpr BiquadCoefficients notchRBJ(double c, double alpha) {
+  return biquadNormalise(1.0, -2.0 * c, 1.0, 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+}
+
+constexpr double biquadW0(double frequency, double sampleRate) {
+  return 2.0 * DSP_PI * frequency / sampleRate;
+}
+
+//  Second order low pass, high pass, band pass (0 dB peak) and notch
+//  filters. The frequencies are in Hz and must be below sampleRate / 2.
+//  The default Q gives a Butterworth (maximally flat) response.
+constexpr BiquadCoefficients lowPassBiquad(double cutoff, double sampleRate, double q = 0.70710678118654752) {
+  return lowPassRBJ(dspCos(biquadW0(cutoff, sampleRate)), dspSin(biquadW0(cutoff, sampleRate)) / (2.0 * q));
+}
+
+constexpr BiquadCoefficients highPassBiquad(double cutoff, double sampleRate, double q = 0.70710678118654752) {
+  return highPassRBJ(dspCos(biquadW0(cutoff, sampleRate)), dspSin(biquadW0(cutoff, sampleRate)) / (2.0 * q));
+}
+
+constexpr BiquadCoefficients bandPassBiquad(double centre, double sampleRate, double q) {
+  return bandPassRBJ(dspCos(biquadW0(centre, sampleRate)), dspSin(biquadW0(centre, sampleRate)) / (2.0 * q));
+}
+
+//  e.g. notchBiquad(50, 1000, 5) removes 50 Hz mains hum over a 10 Hz
+//  wide band from readings taken at 1 kHz.
+constexpr BiquadCoefficients notchBiquad(double centre, double sampleRate, double q) {
+  return notchRBJ(dspCos(biquadW0(centre, sampleRate)), dspSin(biquadW0(centre, sampleRate)) / (2.0 * q));
+}
+
+//  Section (0 to order / 2 - 1) of a Butterworth filter of even order,
+//  i.e. the cookbook filter with the Q of that pair of poles.
+constexpr double butterworthQ(int order, int section) {
+  return 1.0 / (2.0 * dspSin((2 * section + 1) * DSP_PI / (2 * order)));
+}
+
+constexpr BiquadCoefficients butterworthLowPass(double cutoff, double sampleRate, int order, int section) {
+  return lowPassBiquad(cutoff, sampleRate, butterworthQ(order, section));
+}
+
+constexpr BiquadCoefficients butterworthHighPass(double cutoff, double sampleRate, int order, int section) {
+  return highPassBiquad(cutoff, sampleRate, butterworthQ(order, section));
+}
+
+//  Low pass FIR filter: a sinc windowed by a Hamming window, scaled
+//  for a gain of 1 at DC. Tap n of taps.
+constexpr double firSinc(double fc, double m) {
+  return m == 0.0 ? 2.0 * fc : dspSin(2.0 * DSP_PI * fc * m) / (DSP_PI * m);
+}
+
+constexpr double firLowPassRaw(double fc, int taps, int n) {
+  return firSinc(fc, n - (taps - 1) / 2.0) *
+         (taps > 1 ? 0.54 - 0.46 * dspCos(2.0 * DSP_PI * n / (taps - 1)) : 1.0);
+}
+
+constexpr double firLowPassSum(double fc, int taps, int n) {
+  return n == taps ? 0.0 : firLowPassRaw(fc, taps, n) + firLowPassSum(fc, taps, n + 1);
+}
+
+constexpr float firLowPassTap(double cutoff, double sampleRate, int taps, int n) {
+  return (float)(firLowPassRaw(cutoff / sampleRate, taps, n) / firLowPassSum(cutoff / sampleRate, taps, 0));
+}
+
+//  All the taps of a low pass FIR filter, e.g.
+//    constexpr FirCoefficients<31> taps = firLowPass<31>(5.0, 100.0);
+template <uint8_t Taps>
+struct FirCoefficients {
+  float h[Taps];
+};
+
+template <int... I>
+struct DspIndices {};
+
+template <int N, int... I>
+struct DspMakeIndices : DspMakeIndices<N - 1, N - 1, I...> {};
+
+template <int... I>
+struct DspMakeIndices<0, I...> {
+  typedef DspIndices<I...> type;
+};
+
+template <uint8_t Taps, int... I>
+constexpr FirCoefficients<Taps> firLowPass(double cutoff, double sampleRate, DspIndices<I...>) {
+  return FirCoefficients<Taps>{{firLowPassTap(cutoff, sampleRate, Taps, I)...}};
+}
+
+template <uint8_t Taps>
+constexpr FirCoefficients<Taps> firLowPass(double cutoff, double sampleRate) {
+  return firLowPass<Taps>(cutoff, sampleRate, typename DspMakeIndices<Taps>::type());
+}
+
+/******************************************************************
+ *
+ * Fixed Point Helpers -
+ *
+ ******************************************************************/
+
+//  Q15 is a 16 bit integer standing for value / 32768 (-1 to 1), Q14
+//  (used for the biquad coefficients, which reach 2) is value / 16384.
+inline int16_t toQ15(float x) {
+  x *= 32768.0f;
+  return x >= 32767.0f ? 32767 : (x <= -32768.0f ? -32768 : (int16_t)(x + (x >= 0 ? 0.5f : -0.5f)));
+}
+
+inline int16_t toQ14(float x) {
+  return toQ15(0.5f * x);
+}
+
+inline int16_t saturateQ15(int32_t x) {
+  return x > 32767 ? 32767 : (x < -32768 ? -32768 : (int16_t)x);
+}
+
+/******************************************************************
+ *
+ * Biquad Cascade Class Definition -
+ *
+ ******************************************************************/
+
+//  Sections in series, each in direct form II transposed:
+//    y = b0 x + s1,  s1 = b1 x - a1 y + s2,  s2 = b2 x - a2 y
+//  The block process() works on local copies of the coefficients and
+//  states, which the compiler can keep in registers over the buffer.
+//  The recursion runs sample after sample, so there is no SIMD here,
+//  but the sections of consecutive samples overlap on superscalar
+//  CPUs. Input and output buffers may be the same.
+template <uint8_t Sections>
+class BiquadCascade {
+  public:
+    BiquadCascade(const BiquadCoefficients (&sections)[Sections]) {
+      memcpy(c, sections, sizeof(c));
+      reset();
+    }
+
+    void reset() {
+      memset(s, 0, sizeof(s));
+    }
+
+    float operator()(float input) {
+      for (uint8_t k = 0; k < Sections; k++) {
+        float y = c[k].b0 * input + s[k][0];
+        s[k][0] = c[k].b1 * input - c[k].a1 * y + s[k][1];
+        s[k][1] = c[k].b2 * input - c[k].a2 * y;
+        input = y;
+      }
+      return input;
+    }
+
+    void process(const float *input, float *output, size_t n) {
+      BiquadCoefficients ck[Sections];
+      float sk[Sections][2];
+      memcpy(ck, c, sizeof(ck));
+      memcpy(sk, s, sizeof(sk));
+      for (size_t i = 0; i < n; i++) {
+        float x = input[i];
+        for (uint8_t k = 0; k < Sections; k++) {
+          float y = ck[k].b0 * x + sk[k][0];
+          sk[k][0] = ck[k].b1 * x - ck[k].a1 * y + sk[k][1];
+          sk[k][1] = ck[k].b2 * x - ck[k].a2 * y;
+          x = y;
+        }
+        output[i] = x;
+      }
+      memcpy(s, sk, sizeof(s));
+    }
+
+  private:
+    BiquadCoefficients c[Sections];
+    float s[Sections][2];
+};
+
+//  The same cascade on Q15 samples with Q14 coefficients. Transposed
+//  states would need more than 16 bits, so each section is computed in
+//  direct form I with a 32 bit accumulator (as CMSIS-DSP does): the
+//  sum may wrap around in between as long as the output fits. Keep
+//  cutoffs above about sampleRate / 100, where Q14 coefficients still
+//  place the poles accurately.
+template <uint8_t Sections>
+class BiquadCascadeQ15 {
+  public:
+    BiquadCascadeQ15(const BiquadCoefficients (&sections)[Sections]) {
+      for (uint8_t k = 0; k < Sections; k++) {
+        c[k][0] = toQ14(sections[k].b0);
+        c[k][1] = toQ14(sections[k].b1);
+        c[k][2] = toQ14(sections[k].b2);
+        c[k][3] = toQ14(sections[k].a1);
+        c[k][4] = toQ14(sections[k].a2);
+      }
+      reset();
+    }
+
+    void reset() {
+      memset(s, 0, sizeof(s));
+    }
+
+    int16_t operator()(int16_t input) {
+      for (uint8_t k = 0; k < Sections; k++) {
+        input = section(c[k], s[k], input);
+      }
+      return input;
+    }
+
+    void process(const int16_t *input, int16_t *output, size_t n) {
+      int16_t ck[Sections][5];
+      int16_t sk[Sections][4];
+      memcpy(ck, c, sizeof(ck));
+      memcpy(sk, s, sizeof(sk));
+      for (size_t i = 0; i < n; i++) {
+        int16_t x = input[i];
+        for (uint8_t k = 0; k < Sections; k++) {
+          x = section(ck[k], sk[k], x);
+        }
+        output[i] = x;
+      }
+      memcpy(s, sk, sizeof(s));
+    }
+
+  private:
+    //  State: x[n-1], x[n-2], y[n-1], y[n-2]
+    static int16_t section(const int16_t *ck, int16_t *sk, int16_t x) {
+      uint32_t acc = (uint32_t)((int32_t)ck[0] * x) + (uint32_t)((int32_t)ck[1] * sk[0]) +
+                     (uint32_t)((int32_t)ck[2] * sk[1]) - (uint32_t)((int32_t)ck[3] * sk[2]) -
+                     (uint32_t)((int32_t)ck[4] * sk[3]);
+      int16_t y = saturateQ15((int32_t)(acc + (1UL << 13)) >> 14);
+      sk[1] = sk[0];
+      sk[0] = x;
+      sk[3] = sk[2];
+      sk[2] = y;
+      return y;
+    }
+
+    int16_t c[Sections][5];
+    int16_t s[Sections][4];
+};
+
+/******************************************************************
+ *
+ * FIR Class Definition -
+ *
+ ******************************************************************/
+
+//  Dot products of the FIR filters, written so that the compiler can
+//  use SIMD registers: GCC vector extensions for float (SSE or NEON on
+//  a host, plain registers elsewhere) with two accumulators to hide
+//  the add latency, a loop the vectoriser recognises for Q15, and the
+//  dual 16 bit multiply accumulate of Cortex-M4/M7 when available.
+#if defined(__GNUC__) && !defined(__AVR__)
+typedef float DspFloat4 __attribute__((vector_size(16)));
+
+inline float dspDot(const float *a, const float *b, uint8_t n) {
+  DspFloat4 acc0 = {0.0f, 0.0f, 0.0f, 0.0f}, acc1 = acc0;
+  uint8_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    DspFloat4 va0, vb0, va1, vb1;
+    memcpy(&va0, a + i, sizeof(va0));
+    memcpy(&vb0, b + i, sizeof(vb0));
+    memcpy(&va1, a + i + 4, sizeof(va1));
+    memcpy(&vb1, b + i + 4, sizeof(vb1));
+    acc0 += va0 * vb0;
+    acc1 += va1 * vb1;
+  }
+  if (i + 4 <= n) {
+    DspFloat4 va, vb;
+    memcpy(&va, a + i, sizeof(va));
+    memcpy(&vb, b + i, sizeof(vb));
+    acc0 += va * vb;
+    i += 4;
+  }
+  acc0 += acc1;
+  float sum = (acc0[0] + acc0[1]) + (acc0[2] + acc0[3]);
+  for (; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+#else
+inline float dspDot(const float *a, const float *b, uint8_t n) {
+  float sum = 0.0f;
+  for (uint8_t i = 0; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+#endif
+
+//  Sum of a[i] * b[i] in Q30, wrapping around like the biquad sums
+inline uint32_t dspDotQ15(const int16_t *a, const int16_t *b, uint8_t n) {
+  uint32_t acc = 0;
+  uint8_t i = 0;
+#if REEFWING_DSP_SMLAD
+  for (; i + 2 <= n; i += 2) {
+    int16x2_t va, vb;
+    memcpy(&va, a + i, sizeof(va));
+    memcpy(&vb, b + i, sizeof(vb));
+    acc = (uint32_t)__smlad(va, vb, (int32_t)acc);
+  }
+#endif
+  for (; i < n; i++)
+    acc += (uint32_t)((int32_t)a[i] * b[i]);
+  return acc;
+}
+
+//  y = h[0] x[n] + h[1] x[n-1] + ... + h[Taps-1] x[n-Taps+1]
+//  Each sample is stored twice, Taps apart, so that the last Taps
+//  samples are always contiguous, newest first, for the dot product.
+template <uint8_t Taps>
+class FIR {
+  public:
+    FIR(const float (&coefficients)[Taps]) {
+      memcpy(h, coefficients, sizeof(h));
+      reset();
+    }
+
+    FIR(const FirCoefficients<Taps> &coefficients) : FIR(coefficients.h) {}
+
+    void reset() {
+      memset(x, 0, sizeof(x));
+      pos = 0;
+    }
+
+    float operator()(float input) {
+      pos = pos == 0 ? Taps - 1 : pos - 1;
+      x[pos] = x[pos + Taps] = input;
+      return dspDot(h, x + pos, Taps);
+    }
+
+    void process(const float *input, float *output, size_t n) {
+      for (size_t i = 0; i < n; i++)
+        output[i] = (*this)(input[i]);
+    }
+
+  private:
+    float h[Taps];
+    float x[2 * Taps];
+    uint8_t pos;
+};
+
+//  The same filter on Q15 samples with Q15 coefficients, so the taps
+//  must be within [-1, 1).
+template <uint8_t Taps>
+class FIRQ15 {
+  public:
+    FIRQ15(const float (&coefficients)[Taps]) {
+      for (uint8_t k = 0; k < Taps; k++)
+        h[k] = toQ15(coefficients[k]);
+      reset();
+    }
+
+    FIRQ15(const FirCoefficients<Taps> &coefficients) : FIRQ15(coefficients.h) {}
+
+    void reset() {
+      memset(x, 0, sizeof(x));
+      pos = 0;
+    }
+
+    int16_t operator()(int16_t input) {
+      pos = pos == 0 ? Taps - 1 : pos - 1;
+      x[pos] = x[pos + Taps] = input;
+      return saturateQ15((int32_t)(dspDotQ15(h, x + pos, Taps) + (1UL << 14)) >> 15);
+    }
+
+    void process(const int16_t *input, int16_t *output, size_t n) {
+      for (size_t i = 0; i < n; i++)
+        output[i] = (*this)(input[i]);
+    }
+
+  private:
+    int16_t h[Taps];
+    int16_t x[2 * Taps];
+    uint8_t pos;
+};
+
+#endif
@@ -5,14 +5,18 @@
   @copyright  Please see the accompanying LICENSE.txt file.
 
   Code:        David Such
-  Version:     2.0.0
-  Date:        15/12/22
+  Version:     2.4.0
+  Date:        19/10/26
 
   1.0.0 Original Release.           14/02/22
   1.0.1 Fixed Guassian defn.        20/02/22
   1.0.2 Fixed #define               24/02/22
   1.1.0 Added Madgwick & Mahony     04/03/22
   2.0.0 Changed Repo and Branding   15/12/22
+  2.1.0 Float Madgwick & Mahony     19/10/26
+  2.2.0 Sliding Median & Min/Max    19/10/26
+  2.3.0 Biquad & FIR Filters        19/10/26
+  2.4.0 Seedable Signal Generator   19/10/26
 
   Credits - SMA and EMA filter code is extracted from the 
             Arduino-Filters Library by Pieter Pas
@@ -22,6 +26,8 @@
           - Pink Noise Algorithm (http://www.ridgerat-tech.us/pink/pinkalg.htm)
           - Quaternion conversion to Euler Angles
             (https://en.wikipedia.org/wiki/Conversion_between_quaternions_and_Euler_angles)
+          - Madgwick & Mahony AHRS from the reference implementations
+            by Sebastian Madgwick (https://x-io.co.uk/open-source-imu-and-ahrs-algorithms/)
 
 ******************************************************************/
 
@@ -36,33 +42,37 @@
  ******************************************************************/
 
 Quaternion::Quaternion() {
-  q0 = q1 = q2 = q3 = 0.0;
-  yaw = pitch = roll = 0.0;
+  q0 = 1.0;
+  q1 = q2 = q3 = 0.0;
+  eulerAngles.yaw = eulerAngles.pitch = eulerAngles.roll = 0.0;
+  setDeltaT(_deltaT);
 }
 
-Quaternion::Quaternion(double w, double x, double y, double z) {
+Quaternion::Quaternion(float w, float x, float y, float z) {
   q0 = w;
   q1 = x;
   q2 = y;
   q3 = z;
+  setDeltaT(_deltaT);
 }
 
-Quaternion::Quaternion(double yaw, double pitch, double roll) {
+Quaternion::Quaternion(float yaw, float pitch, float roll) {
   //  Converts Euler Angles,  yaw (Z), pitch (Y), and roll (X) in radians
   //  to a unit quaternion.
   //  ref: https://en.wikipedia.org/wiki/Conversion_between_quaternions_and_Euler_angles
 
-  double cy = cos(yaw * 0.5);
-  double sy = sin(yaw * 0.5);
-  double cp = cos(pitch * 0.5);
-  double sp = sin(pitch * 0.5);
-  double cr = cos(roll * 0.5);
-  double sr = sin(roll * 0.5);
+  float cy = cos(yaw * 0.5f);
+  float sy = sin(yaw * 0.5f);
+  float cp = cos(pitch * 0.5f);
+  float sp = sin(pitch * 0.5f);
+  float cr = cos(roll * 0.5f);
+  float sr = sin(roll * 0.5f);
 
   q0 = cr * cp * cy + sr * sp * sy;
   q1 = sr * cp * cy - cr * sp * sy;
   q2 = cr * sp * cy + sr * cp * sy;
   q3 = cr * cp * sy - sr * sp * cy;
+  setDeltaT(_deltaT);
 }
 
 EulerAngles Quaternion::toEulerAngels() {
@@ -72,28 +82,369 @@ EulerAngles Quaternion::toEulerAngels() {
   EulerAngles angles;
 
   // roll (x-axis rotation)
-  double sinr_cosp = 2 * (q0 * q1 + q2 * q3);
-  double cosr_cosp = 1 - 2 * (q1 * q1 + q2 * q2);
+  float sinr_cosp = 2 * (q0 * q1 + q2 * q3);
+  float cosr_cosp = 1 - 2 * (q1 * q1 + q2 * q2);
 
   angles.roll = atan2(sinr_cosp, cosr_cosp);
 
   // pitch (y-axis rotation)
-  double sinp = 2 * (q0 * q2 - q3 * q1);
+  float sinp = 2 * (q0 * q2 - q3 * q1);
 
-  if (abs(sinp) >= 1)
+  if (fabs(sinp) >= 1)
       angles.pitch = copysign(M_PI / 2, sinp); // use 90 degrees if out of range
   else
       angles.pitch = asin(sinp);
 
   // yaw (z-axis rotation)
-  double siny_cosp = 2 * (q0 * q3 + q1 * q2);
-  double cosy_cosp = 1 - 2 * (q2 * q2 + q3 * q3);
+  float siny_cosp = 2 * (q0 * q3 + q1 * q2);
+  float cosy_cosp = 1 - 2 * (q2 * q2 + q3 * q3);
 
   angles.yaw = atan2(siny_cosp, cosy_cosp);
 
   return angles;
 }
 
+/******************************************************************
+ * 
+ *  Quaternion - AHRS Settings
+ * 
+ ******************************************************************/
+
+void Quaternion::setDeltaT(float deltaT) {
+  //  Hoists the products of the gains and the sample time used by
+  //  the fixed sample time updates.
+  _deltaT = deltaT;
+  _halfDt = 0.5f * deltaT;
+  _betaDt = _beta * deltaT;
+  _twoKiDt = _twoKi * deltaT;
+}
+
+void Quaternion::setBeta(float beta) {
+  _beta = beta;
+  setDeltaT(_deltaT);
+}
+
+void Quaternion::setKp(float kp) {
+  _twoKp = 2.0f * kp;
+}
+
+void Quaternion::setKi(float ki) {
+  _twoKi = 2.0f * ki;
+  setDeltaT(_deltaT);
+}
+
+void Quaternion::reset() {
+  //  Back to the identity rotation, with no Mahony integral feedback.
+  q0 = 1.0f;
+  q1 = q2 = q3 = 0.0f;
+  _integralFBx = _integralFBy = _integralFBz = 0.0f;
+}
+
+void Quaternion::rotate(float gx, float gy, float gz, float halfDt) {
+  //  q += 0.5 * q x (0, gx, gy, gz) * dt
+  gx *= halfDt;
+  gy *= halfDt;
+  gz *= halfDt;
+
+  float qa = q0, qb = q1, qc = q2;
+
+  q0 += (-qb * gx - qc * gy - q3 * gz);
+  q1 += (qa * gx + qc * gz - q3 * gy);
+  q2 += (qa * gy - qb * gz + q3 * gx);
+  q3 += (qa * gz + qb * gy - qc * gx);
+}
+
+void Quaternion::normalise() {
+  float recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+
+  q0 *= recipNorm;
+  q1 *= recipNorm;
+  q2 *= recipNorm;
+  q3 *= recipNorm;
+}
+
+/******************************************************************
+ * 
+ *  Quaternion - Madgwick AHRS
+ * 
+ ******************************************************************/
+
+void Quaternion::madgwickUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz) {
+  madgwickKernel(ax, ay, az, gx, gy, gz, mx, my, mz, _halfDt, _betaDt);
+}
+
+void Quaternion::madgwickUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz, float deltaT) {
+  madgwickKernel(ax, ay, az, gx, gy, gz, mx, my, mz, 0.5f * deltaT, _beta * deltaT);
+}
+
+void Quaternion::madgwickUpdate(float ax, float ay, float az, float gx, float gy, float gz) {
+  madgwickKernel(ax, ay, az, gx, gy, gz, _halfDt, _betaDt);
+}
+
+void Quaternion::madgwickUpdate(float ax, float ay, float az, float gx, float gy, float gz, float deltaT) {
+  madgwickKernel(ax, ay, az, gx, gy, gz, 0.5f * deltaT, _beta * deltaT);
+}
+
+void Quaternion::madgwickKernel(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz, float halfDt, float betaDt) {
+  //  Gradient descent step towards the orientation that maps gravity
+  //  and the earth magnetic field onto the accelerometer and
+  //  magnetometer readings, added to the gyroscope integration.
+
+  //  Use the 6-DOF algorithm if the magnetometer measurement is invalid
+  //  (avoids NaN in magnetometer normalisation).
+  if ((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f)) {
+    madgwickKernel(ax, ay, az, gx, gy, gz, halfDt, betaDt);
+    return;
+  }
+
+  float qa = q0, qb = q1, qc = q2, qd = q3;
+
+  rotate(gx, gy, gz, halfDt);
+
+  //  Compute feedback only if the accelerometer measurement is valid
+  //  (avoids NaN in accelerometer normalisation).
+  if (!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+    float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+
+    recipNorm = invSqrt(mx * mx + my * my + mz * mz);
+    mx *= recipNorm;
+    my *= recipNorm;
+    mz *= recipNorm;
+
+    //  Auxiliary variables to avoid repeated arithmetic
+    float _2q0mx = 2.0f * qa * mx;
+    float _2q0my = 2.0f * qa * my;
+    float _2q0mz = 2.0f * qa * mz;
+    float _2q1mx = 2.0f * qb * mx;
+    float _2q0 = 2.0f * qa;
+    float _2q1 = 2.0f * qb;
+    float _2q2 = 2.0f * qc;
+    float _2q3 = 2.0f * qd;
+    float _2q0q2 = 2.0f * qa * qc;
+    float _2q2q3 = 2.0f * qc * qd;
+    float q0q0 = qa * qa;
+    float q0q1 = qa * qb;
+    float q0q2 = qa * qc;
+    float q0q3 = qa * qd;
+    float q1q1 = qb * qb;
+    float q1q2 = qb * qc;
+    float q1q3 = qb * qd;
+    float q2q2 = qc * qc;
+    float q2q3 = qc * qd;
+    float q3q3 = qd * qd;
+
+    //  Reference direction of Earth's magnetic field
+    float hx = mx * q0q0 - _2q0my * qd + _2q0mz * qc + mx * q1q1 + _2q1 * my * qc + _2q1 * mz * qd - mx * q2q2 - mx * q3q3;
+    float hy = _2q0mx * qd + my * q0q0 - _2q0mz * qb + _2q1mx * qc - my * q1q1 + my * q2q2 + _2q2 * mz * qd - my * q3q3;
+    float _2bx = sqrtf(hx * hx + hy * hy);
+    float _2bz = -_2q0mx * qc + _2q0my * qb + mz * q0q0 + _2q1mx * qd - mz * q1q1 + _2q2 * my * qd - mz * q2q2 + mz * q3q3;
+    float _4bx = 2.0f * _2bx;
+    float _4bz = 2.0f * _2bz;
+
+    //  Gradient of the objective function
+    float fx = 2.0f * q1q3 - _2q0q2 - ax;
+    float fy = 2.0f * q0q1 + _2q2q3 - ay;
+    float fz = 1.0f - 2.0f * q1q1 - 2.0f * q2q2 - az;
+    float bx = _2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx;
+    float by = _2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my;
+    float bz = _2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz;
+
+    float s0 = -_2q2 * fx + _2q1 * fy - _2bz * qc * bx + (-_2bx * qd + _2bz * qb) * by + _2bx * qc * bz;
+    float s1 = _2q3 * fx + _2q0 * fy - 4.0f * qb * fz + _2bz * qd * bx + (_2bx * qc + _2bz * qa) * by + (_2bx * qd - _4bz * qb) * bz;
+    float s2 = -_2q0 * fx + _2q3 * fy - 4.0f * qc * fz + (-_4bx * qc - _2bz * qa) * bx + (_2bx * qb + _2bz * qd) * by + (_2bx * qa - _4bz * qc) * bz;
+    float s3 = _2q1 * fx + _2q2 * fy + (-_4bx * qd + _2bz * qb) * bx + (-_2bx * qa + _2bz * qc) * by + _2bx * qb * bz;
+
+    //  Normalise the step magnitude and apply it, there is no step
+    //  when the estimate already fits the measurements exactly
+    float sNormSq = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+    if (sNormSq > 0.0f) {
+      recipNorm = betaDt * invSqrt(sNormSq);
+      q0 -= recipNorm * s0;
+      q1 -= recipNorm * s1;
+      q2 -= recipNorm * s2;
+      q3 -= recipNorm * s3;
+    }
+  }
+
+  normalise();
+}
+
+void Quaternion::madgwickKernel(float ax, float ay, float az, float gx, float gy, float gz, float halfDt, float betaDt) {
+  //  6-DOF version, for setups without a magnetometer: yaw then 
+  //  only comes from the gyroscope.
+  float qa = q0, qb = q1, qc = q2, qd = q3;
+
+  rotate(gx, gy, gz, halfDt);
+
+  if (!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+    float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+
+    //  Auxiliary variables to avoid repeated arithmetic
+    float _2q0 = 2.0f * qa;
+    float _2q1 = 2.0f * qb;
+    float _2q2 = 2.0f * qc;
+    float _2q3 = 2.0f * qd;
+    float _4q0 = 4.0f * qa;
+    float _4q1 = 4.0f * qb;
+    float _4q2 = 4.0f * qc;
+    float _8q1 = 8.0f * qb;
+    float _8q2 = 8.0f * qc;
+    float q0q0 = qa * qa;
+    float q1q1 = qb * qb;
+    float q2q2 = qc * qc;
+    float q3q3 = qd * qd;
+
+    //  Gradient of the objective function
+    float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+    float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * qb - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+    float s2 = 4.0f * q0q0 * qc + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+    float s3 = 4.0f * q1q1 * qd - _2q1 * ax + 4.0f * q2q2 * qd - _2q2 * ay;
+
+    float sNormSq = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+    if (sNormSq > 0.0f) {
+      recipNorm = betaDt * invSqrt(sNormSq);
+      q0 -= recipNorm * s0;
+      q1 -= recipNorm * s1;
+      q2 -= recipNorm * s2;
+      q3 -= recipNorm * s3;
+    }
+  }
+
+  normalise();
+}
+
+/******************************************************************
+ * 
+ *  Quaternion - Mahony AHRS
+ * 
+ ******************************************************************/
+
+void Quaternion::mahonyUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz) {
+  mahonyKernel(ax, ay, az, gx, gy, gz, mx, my, mz, _halfDt, _twoKiDt);
+}
+
+void Quaternion::mahonyUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz, float deltaT) {
+  mahonyKernel(ax, ay, az, gx, gy, gz, mx, my, mz, 0.5f * deltaT, _twoKi * deltaT);
+}
+
+void Quaternion::mahonyUpdate(float ax, float ay, float az, float gx, float gy, float gz) {
+  mahonyKernel(ax, ay, az, gx, gy, gz, _halfDt, _twoKiDt);
+}
+
+void Quaternion::mahonyUpdate(float ax, float ay, float az, float gx, float gy, float gz, float deltaT) {
+  mahonyKernel(ax, ay, az, gx, gy, gz, 0.5f * deltaT, _twoKi * deltaT);
+}
+
+void Quaternion::mahonyFeedback(float &gx, float &gy, float &gz, float halfex, float halfey, float halfez, float twoKiDt) {
+  //  PI correction of the gyroscope rates from the error between the
+  //  measured and estimated directions.
+  if (twoKiDt > 0.0f) {
+    _integralFBx += twoKiDt * halfex;
+    _integralFBy += twoKiDt * halfey;
+    _integralFBz += twoKiDt * halfez;
+    gx += _integralFBx;
+    gy += _integralFBy;
+    gz += _integralFBz;
+  }
+  else {
+    _integralFBx = _integralFBy = _integralFBz = 0.0f;
+  }
+
+  gx += _twoKp * halfex;
+  gy += _twoKp * halfey;
+  gz += _twoKp * halfez;
+}
+
+void Quaternion::mahonyKernel(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz, float halfDt, float twoKiDt) {
+  //  Use the 6-DOF algorithm if the magnetometer measurement is invalid
+  //  (avoids NaN in magnetometer normalisation).
+  if ((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f)) {
+    mahonyKernel(ax, ay, az, gx, gy, gz, halfDt, twoKiDt);
+    return;
+  }
+
+  if (!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+    float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+
+    recipNorm = invSqrt(mx * mx + my * my + mz * mz);
+    mx *= recipNorm;
+    my *= recipNorm;
+    mz *= recipNorm;
+
+    //  Auxiliary variables to avoid repeated arithmetic
+    float q0q0 = q0 * q0;
+    float q0q1 = q0 * q1;
+    float q0q2 = q0 * q2;
+    float q0q3 = q0 * q3;
+    float q1q1 = q1 * q1;
+    float q1q2 = q1 * q2;
+    float q1q3 = q1 * q3;
+    float q2q2 = q2 * q2;
+    float q2q3 = q2 * q3;
+    float q3q3 = q3 * q3;
+
+    //  Reference direction of Earth's magnetic field
+    float hx = 2.0f * (mx * (0.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
+    float hy = 2.0f * (mx * (q1q2 + q0q3) + my * (0.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
+    float bx = sqrtf(hx * hx + hy * hy);
+    float bz = 2.0f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (0.5f - q1q1 - q2q2));
+
+    //  Estimated direction of gravity and magnetic field
+    float halfvx = q1q3 - q0q2;
+    float halfvy = q0q1 + q2q3;
+    float halfvz = q0q0 - 0.5f + q3q3;
+    float halfwx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
+    float halfwy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
+    float halfwz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);
+
+    //  Error is the sum of the cross products between the estimated
+    //  and measured directions
+    float halfex = (ay * halfvz - az * halfvy) + (my * halfwz - mz * halfwy);
+    float halfey = (az * halfvx - ax * halfvz) + (mz * halfwx - mx * halfwz);
+    float halfez = (ax * halfvy - ay * halfvx) + (mx * halfwy - my * halfwx);
+
+    mahonyFeedback(gx, gy, gz, halfex, halfey, halfez, twoKiDt);
+  }
+
+  rotate(gx, gy, gz, halfDt);
+  normalise();
+}
+
+void Quaternion::mahonyKernel(float ax, float ay, float az, float gx, float gy, float gz, float halfDt, float twoKiDt) {
+  //  6-DOF version, for setups without a magnetometer.
+  if (!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+    float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+
+    //  Estimated direction of gravity
+    float halfvx = q1 * q3 - q0 * q2;
+    float halfvy = q0 * q1 + q2 * q3;
+    float halfvz = q0 * q0 - 0.5f + q3 * q3;
+
+    //  Error is the cross product between the estimated and measured
+    //  direction of gravity
+    float halfex = (ay * halfvz - az * halfvy);
+    float halfey = (az * halfvx - ax * halfvz);
+    float halfez = (ax * halfvy - ay * halfvx);
+
+    mahonyFeedback(gx, gy, gz, halfex, halfey, halfez, twoKiDt);
+  }
+
+  rotate(gx, gy, gz, halfDt);
+  normalise();
+}
+
 /******************************************************************
  * 
  *  Simple Kalman Filter
@@ -144,18 +495,23 @@ float SimpleKalmanFilter::getEstimateError() {
 const float NoiseGenerator::A[] = { 0.02109238, 0.07113478, 0.68873558 }; // rescaled by (1+P)/(1-P)
 const float NoiseGenerator::P[] = { 0.3190,  0.7756,  0.9613  };
 
+void NoiseGenerator::seed(uint32_t seed) {
+  _state = seed;
+  _lfsr = LFSR_INIT ^ (uint16_t)seed;
+  if (_lfsr == 0) _lfsr = LFSR_INIT;
+  clearPinkState();
+}
+
 bool NoiseGenerator::oneBitLFSR() {
   // Returns 1 bit of noise using a Galois Linear Feedback Shift Register
   // Ref: https://en.wikipedia.org/wiki/Linear_feedback_shift_register#Galois_LFSRs
 
-  static uint16_t lfsr = LFSR_INIT; 
-                                
-  if (lfsr & 1) { 
-    lfsr =  (lfsr >>1) ^ LFSR_MASK; 
+  if (_lfsr & 1) { 
+    _lfsr =  (_lfsr >>1) ^ LFSR_MASK; 
     return(true);
   }
   else { 
-    lfsr >>= 1;                      
+    _lfsr >>= 1;                      
     return(false);
   }
 }
@@ -170,30 +526,187 @@ double NoiseGenerator::gaussianWithDeviation(int sd /* =1 */) {
   bool zero = true;
 
   while (zero) {
-    randFloat = (rand() / ((double)RAND_MAX));
+    randFloat = uniform();
     if (randFloat != 0) zero = false;
   }
 
-  distribution = cos((2.0 * (double)PI) * rand() / ((double)RAND_MAX));
+  distribution = cos((2.0 * (double)PI) * uniform());
   return (sqrt(-2.0 * log(randFloat)) * distribution) * sd;
 }
 
 void NoiseGenerator::clearPinkState() {
-  srand((unsigned int)millis()); // initialize random generator
   for (size_t i = 0; i < PINK_NOISE_STAGES; i++)
     state[i] = 0.0;
 }
 
 float NoiseGenerator::threeStagePink() {
-  static const float RMI2 = 2.0 / float(RAND_MAX); // + 1.0; // change for range [0,1)
   static const float offset = A[0] + A[1] + A[2];
-  float temp = float(rand());
+  float temp = uniform();
 
   state[0] = P[0] * (state[0] - temp) + temp;
-  temp = float( rand() );
+  temp = uniform();
   state[1] = P[1] * (state[1] - temp) + temp;
-  temp = float( rand() );
+  temp = uniform();
   state[2] = P[2] * (state[2] - temp) + temp;
 
-  return (A[0]*state[0] + A[1]*state[1] + A[2]*state[2]) * RMI2 - offset;
+  return (A[0]*state[0] + A[1]*state[1] + A[2]*state[2]) * 2.0f - offset;
+}
+
+long NoiseGenerator::randomWithRange(int min /* =-5 */, int max /* =5 */) {
+  //  Returns a random number in [min, max), like random(min, max).
+  if (max <= min) return min;
+  uint32_t range = (uint32_t)((long)max - min);
+  return min + (long)(((uint64_t)random32() * range) >> 32);
+}
+
+/******************************************************************
+ * 
+ *  Signal Generator
+ * 
+ ******************************************************************/
+
+//  2^27 resolutions: the level, steps, noise and outliers added up
+//  stay below 2^61 in fixed point.
+static const float MAX_UNITS = 134217728.0f;
+
+SignalGenerator::SignalGenerator(uint32_t seed /* =1 */, float resolution /* =1/1024 */) : NoiseGenerator(seed) {
+  _resolution = resolution;
+  this->seed(seed);
+}
+
+void SignalGenerator::seed(uint32_t seed) {
+  //  Restarts the random streams and any burst or dropout, but
+  //  keeps the level where it is.
+  NoiseGenerator::seed(seed);
+  uint64_t s = seed;
+  for (uint8_t i = 0; i < STREAMS; i++)
+    _streams[i] = splitMix(s);
+  _outlierLeft = _dropoutLeft = 0;
+}
+
+void SignalGenerator::setLevel(float level) {
+  _level = toFixed(level, MAX_UNITS);
+}
+
+void SignalGenerator::setTrend(float perSample) {
+  _trend = toFixed(perSample, MAX_UNITS);
+}
+
+void SignalGenerator::setSteps(float size, float probability) {
+  //  With the given probability per sample, the level jumps up or
+  //  down by size.
+  _step = toFixed(size, MAX_UNITS);
+  _stepThreshold = toThreshold(probability);
+}
+
+void SignalGenerator::setGaussian(float sd) {
+  //  The sum of 8 bytes has a standard deviation of sqrt(8 * (256^2 - 1) / 12),
+  //  and is at most 1020 away from its mean
+  _gaussian = toFixed(sd / 209.02153f, MAX_UNITS / 1024);
+}
+
+void SignalGenerator::setOutliers(float size, float probability, uint16_t length /* =1 */) {
+  //  With the given probability per sample, a burst of length
+  //  samples is offset by +size or -size.
+  _outlier = toFixed(size, MAX_UNITS);
+  _outlierThreshold = toThreshold(probability);
+  _outlierLength = length > 0 ? length : 1;
+}
+
+void SignalGenerator::setQuantisation(bool on) {
+  _quantise = on;
+}
+
+void SignalGenerator::setDropout(float probability, uint16_t length /* =1 */, float value /* =NAN */) {
+  //  With the given probability per sample, length samples are
+  //  replaced by value, as when a sensor stops answering.
+  _dropoutThreshold = toThreshold(probability);
+  _dropoutLength = length > 0 ? length : 1;
+  _dropoutValue = value;
+}
+
+int64_t SignalGenerator::toFixed(float x, float maxUnits) const {
+  //  Clamped in float, as converting a float out of the range of
+  //  int64_t is undefined.
+  float units = x / _resolution;
+  if (isnan(units)) return 0;
+  if (units > maxUnits) units = maxUnits;
+  else if (units < -maxUnits) units = -maxUnits;
+  return (int64_t)(units * 4294967296.0f);
+}
+
+uint32_t SignalGenerator::toThreshold(float probability) {
+  if (probability <= 0.0f) return 0;
+  if (probability >= 1.0f) return 0xffffffff;
+  return (uint32_t)(probability * 4294967296.0f);
+}
+
+void SignalGenerator::fill(float *buffer, size_t n) {
+  //  The state is copied into locals, as stores to buffer could
+  //  otherwise alias it and keep it out of registers.
+  const int64_t HALF = 0x80000000LL, WHOLE = ~0xffffffffLL;
+  const float scale = _resolution * (1.0f / 4294967296.0f);
+  const int64_t trend = _trend, step = _step, gaussian = _gaussian;
+  const int64_t outlier = _outlier;
+  const uint32_t stepThreshold = _stepThreshold;
+  const uint32_t outlierThreshold = _outlierThreshold;
+  const uint32_t dropoutThreshold = _dropoutThreshold;
+  const bool quantise = _quantise;
+  const float dropoutValue = _dropoutValue;
+  uint64_t steps = _streams[STEPS], noise = _streams[GAUSSIAN];
+  uint64_t outliers = _streams[OUTLIERS], dropouts = _streams[DROPOUT];
+  int64_t level = _level, offset = _outlierUp ? outlier : -outlier;
+  uint16_t outlierLeft = _outlierLeft, dropoutLeft = _dropoutLeft;
+
+  for (size_t i = 0; i < n; i++) {
+    level += trend;
+    if (stepThreshold) {
+      uint64_t r = splitMix(steps);
+      if ((uint32_t)r < stepThreshold)
+        level += (r >> 63) ? step : -step;
+    }
+
+    int64_t x = level;
+    if (gaussian) {
+      //  Add up the 8 bytes in pairs, then the four 16 bit sums with a multiply
+      uint64_t r = splitMix(noise);
+      r = (r & 0x00ff00ff00ff00ffULL) + ((r >> 8) & 0x00ff00ff00ff00ffULL);
+      x += ((int32_t)((r * 0x0001000100010001ULL) >> 48) - 1020) * gaussian;
+    }
+
+    if (outlierLeft == 0 && outlierThreshold) {
+      uint64_t r = splitMix(outliers);
+      if ((uint32_t)r < outlierThreshold) {
+        outlierLeft = _outlierLength;
+        offset = (r >> 63) ? outlier : -outlier;
+      }
+    }
+    if (outlierLeft > 0) {
+      x += offset;
+      outlierLeft--;
+    }
+
+    if (quantise) x = (x + HALF) & WHOLE;
+
+    if (dropoutLeft == 0 && dropoutThreshold) {
+      if ((uint32_t)splitMix(dropouts) < dropoutThreshold)
+        dropoutLeft = _dropoutLength;
+    }
+    if (dropoutLeft > 0) {
+      buffer[i] = dropoutValue;
+      dropoutLeft--;
+    }
+    else {
+      buffer[i] = (float)x * scale;
+    }
+  }
+
+  _streams[STEPS] = steps;
+  _streams[GAUSSIAN] = noise;
+  _streams[OUTLIERS] = outliers;
+  _streams[DROPOUT] = dropouts;
+  _level = level;
+  _outlierUp = offset == outlier;
+  _outlierLeft = outlierLeft;
+  _dropoutLeft = dropoutLeft;
 }
@@ -5,14 +5,18 @@
   @copyright  Please see the accompanying LICENSE.txt file.
 
   Code:        David Such
-  Version:     2.0.0
-  Date:        15/12/22
+  Version:     2.4.0
+  Date:        19/10/26
 
   1.0.0 Original Release.           14/02/22
   1.0.1 Fixed Guassian defn.        20/02/22
   1.0.2 Fixed #define               24/02/22
   1.1.0 Added Madgwick & Mahony     04/03/22
   2.0.0 Changed Repo and Branding   15/12/22
+  2.1.0 Float Madgwick & Mahony     19/10/26
+  2.2.0 Sliding Median & Min/Max    19/10/26
+  2.3.0 Biquad & FIR Filters        19/10/26
+  2.4.0 Seedable Signal Generator   19/10/26
 
   Credits - SMA and EMA filter code is extracted from the 
             Arduino-Filters Library by Pieter Pas
@@ -22,6 +26,12 @@
           - Pink Noise Algorithm (http://www.ridgerat-tech.us/pink/pinkalg.htm)
           - Quaternion conversion to Euler Angles
             (https://en.wikipedia.org/wiki/Conversion_between_quaternions_and_Euler_angles)
+          - Madgwick & Mahony AHRS from the reference implementations
+            by Sebastian Madgwick (https://x-io.co.uk/open-source-imu-and-ahrs-algorithms/)
+          - Biquad designs from the Audio EQ Cookbook by Robert 
+            Bristow-Johnson (https://www.w3.org/TR/audio-eq-cookbook/)
+          - SplitMix64 generator by Sebastiano Vigna
+            (https://prng.di.unimi.it/splitmix64.c)
 
 ******************************************************************/
 
@@ -29,6 +39,8 @@
 #define ReefwingFilter_h
 
 #include "Arduino.h"
+#include <string.h>
+#include <math.h>
 
 /******************************************************************
  *
@@ -36,24 +48,79 @@
  * 
  ******************************************************************/
 
+//  Set to false to normalise with 1/sqrtf() instead of the fast
+//  inverse square root (relative error below 0.07%).
+#ifndef REEFWING_FAST_INVSQRT
+#define REEFWING_FAST_INVSQRT true
+#endif
+
 struct EulerAngles {
-  double yaw, pitch, roll;    
+  float yaw, pitch, roll;    
 };
 
 class Quaternion {
   public:
     Quaternion();
-    Quaternion(double w, double x, double y, double z);
-    Quaternion(double yaw, double pitch, double roll);
+    Quaternion(float w, float x, float y, float z);
+    Quaternion(float yaw, float pitch, float roll);
 
     EulerAngles toEulerAngels();
-    void madgwickUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz); 
 
-    double q0, q1, q2, q3;      //  Euler Parameters
+    //  AHRS updates - accelerometer in any unit, gyroscope in rad/s
+    //  and magnetometer in any unit. Without a dt argument the 
+    //  sample time set with setDeltaT() is used, which saves the
+    //  gain and time step products on every update.
+    void madgwickUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz); 
+    void madgwickUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz, float deltaT); 
+    void madgwickUpdate(float ax, float ay, float az, float gx, float gy, float gz); 
+    void madgwickUpdate(float ax, float ay, float az, float gx, float gy, float gz, float deltaT); 
+    void mahonyUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz); 
+    void mahonyUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz, float deltaT); 
+    void mahonyUpdate(float ax, float ay, float az, float gx, float gy, float gz); 
+    void mahonyUpdate(float ax, float ay, float az, float gx, float gy, float gz, float deltaT); 
+
+    void setDeltaT(float deltaT);
+    void setBeta(float beta);
+    void setKp(float kp);
+    void setKi(float ki);
+    void reset();
+
+    float q0, q1, q2, q3;      //  Euler Parameters
     EulerAngles eulerAngles;
 
+  private:
+    void madgwickKernel(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz, float halfDt, float betaDt);
+    void madgwickKernel(float ax, float ay, float az, float gx, float gy, float gz, float halfDt, float betaDt);
+    void mahonyKernel(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz, float halfDt, float twoKiDt);
+    void mahonyKernel(float ax, float ay, float az, float gx, float gy, float gz, float halfDt, float twoKiDt);
+    void mahonyFeedback(float &gx, float &gy, float &gz, float halfex, float halfey, float halfez, float twoKiDt);
+    void rotate(float gx, float gy, float gz, float halfDt);
+    void normalise();
+
+    float _deltaT = 0.01f;            //  Fixed sample time (s)
+    float _beta = 0.1f;               //  Madgwick gain
+    float _twoKp = 1.0f;              //  2 * Mahony proportional gain
+    float _twoKi = 0.0f;              //  2 * Mahony integral gain
+    float _halfDt, _betaDt, _twoKiDt; //  Hoisted for the fixed sample time
+    float _integralFBx = 0.0f, _integralFBy = 0.0f, _integralFBz = 0.0f;
+
 };
 
+//  Fast inverse square root with an improved magic number and Newton
+//  step (Jan Kadlec), relative error below 0.07%.
+inline float invSqrt(float x) {
+#if REEFWING_FAST_INVSQRT
+  float y;
+  uint32_t i;
+  memcpy(&i, &x, sizeof(i));
+  i = 0x5f1f1412 - (i >> 1);
+  memcpy(&y, &i, sizeof(y));
+  return y * (1.69000231f - 0.714158168f * x * y * y);
+#else
+  return 1.0f / sqrtf(x);
+#endif
+}
+
 /******************************************************************
  *
  * Filter Class Prototypes - 
@@ -116,6 +183,264 @@ class EMA {
     uint_t state = 0;
 };
 
+/*
+ * Sliding window order statistics - the median, a percentile or
+ * a trimmed mean of the N most recent inputs, to remove outlier
+ * spikes (e.g. HC-SR04 echoes or DHT read errors) that an SMA or 
+ * EMA would smear into the output.
+ *
+ * The window is split into a max-heap of its smallest samples and
+ * a min-heap of the rest, sharing one array of N sample slots. A 
+ * new input overwrites the oldest sample in place and is sifted
+ * into position, so each update is O(log N) with a fixed footprint
+ * and no heap allocation.
+ */
+
+//  Stands in for the sum of the lower heap when it isn't needed.
+struct NoSum {
+  NoSum(int = 0) {}
+  template <class T> void operator+=(T) {}
+  template <class T> void operator-=(T) {}
+};
+
+template <uint8_t N, class input_t, class sum_t = NoSum>
+class SlidingRank {
+  protected:
+    //  Add input in place of the oldest sample, then move samples
+    //  between the heaps so that the lower one holds `lower` of them.
+    void push(input_t input, uint8_t lower) {
+      uint8_t slot;
+
+      if (count == N) {
+        slot = oldest;
+        if (++oldest == N)
+          oldest = 0;
+        if (pos[slot] < loCount) {
+          lowerSum -= values[slot];
+          lowerSum += input;
+        }
+        values[slot] = input;
+        if (pos[slot] < loCount)
+          siftLo(pos[slot]);
+        else
+          siftHi(N - 1 - pos[slot]);
+        //  The new sample may belong to the other heap.
+        if (loCount > 0 && hiCount > 0 && values[heap[N - 1]] < values[heap[0]]) {
+          lowerSum -= values[heap[0]];
+          lowerSum += values[heap[N - 1]];
+          exchange(0, N - 1);
+          siftLo(0);
+          siftHi(0);
+        }
+      }
+      else {
+        slot = count++;
+        values[slot] = input;
+        if (loCount > 0 && input < values[heap[0]]) {
+          pushLo(slot);
+        }
+        else {
+          pushHi(slot);
+        }
+      }
+
+      while (loCount > lower)
+        pushHi(popLo());
+      while (loCount < lower)
+        pushLo(popHi());
+    }
+
+    uint8_t next() const { return count < N ? count + 1 : N; }  //  Samples after the next push
+    input_t lowerTop() const { return values[heap[0]]; }      //  Largest of the lower heap
+    input_t upperTop() const { return values[heap[N - 1]]; }  //  Smallest of the upper heap
+
+    uint8_t count = 0;          //  Samples in the window
+    sum_t lowerSum = 0;         //  Sum of the lower heap
+
+  private:
+    //  Lower heap: heap[0 .. loCount - 1], upper heap: heap[N - 1]
+    //  down to heap[N - hiCount]. pos[slot] is where a slot is in heap.
+    void exchange(uint8_t a, uint8_t b) {
+      uint8_t slot = heap[a];
+      heap[a] = heap[b];
+      heap[b] = slot;
+      pos[heap[a]] = a;
+      pos[heap[b]] = b;
+    }
+
+    void siftLo(uint8_t i) {
+      while (i > 0 && values[heap[(i - 1) / 2]] < values[heap[i]]) {
+        exchange(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+      }
+      for (uint16_t c = 2 * i + 1; c < loCount; c = 2 * i + 1) {
+        if (c + 1 < loCount && values[heap[c]] < values[heap[c + 1]])
+          c++;
+        if (!(values[heap[i]] < values[heap[c]]))
+          break;
+        exchange(i, c);
+        i = c;
+      }
+    }
+
+    void siftHi(uint8_t j) {
+      while (j > 0 && values[heap[N - 1 - j]] < values[heap[N - 1 - (j - 1) / 2]]) {
+        exchange(N - 1 - j, N - 1 - (j - 1) / 2);
+        j = (j - 1) / 2;
+      }
+      for (uint16_t c = 2 * j + 1; c < hiCount; c = 2 * j + 1) {
+        if (c + 1 < hiCount && values[heap[N - 2 - c]] < values[heap[N - 1 - c]])
+          c++;
+        if (!(values[heap[N - 1 - c]] < values[heap[N - 1 - j]]))
+          break;
+        exchange(N - 1 - j, N - 1 - c);
+        j = c;
+      }
+    }
+
+    void pushLo(uint8_t slot) {
+      heap[loCount] = slot;
+      pos[slot] = loCount;
+      lowerSum += values[slot];
+      siftLo(loCount++);
+    }
+
+    void pushHi(uint8_t slot) {
+      heap[N - 1 - hiCount] = slot;
+      pos[slot] = N - 1 - hiCount;
+      siftHi(hiCount++);
+    }
+
+    uint8_t popLo() {
+      uint8_t slot = heap[0];
+      lowerSum -= values[slot];
+      if (--loCount > 0) {
+        exchange(0, loCount);
+        siftLo(0);
+      }
+      return slot;
+    }
+
+    uint8_t popHi() {
+      uint8_t slot = heap[N - 1];
+      if (--hiCount > 0) {
+        exchange(N - 1, N - 1 - hiCount);
+        siftHi(0);
+      }
+      return slot;
+    }
+
+    input_t values[N] = {};
+    uint8_t heap[N] = {};
+    uint8_t pos[N] = {};
+    uint8_t loCount = 0, hiCount = 0, oldest = 0;
+};
+
+//  Median of the N most recent inputs. With an even number of 
+//  samples it is the mean of the two middle ones (rounded down).
+template <uint8_t N, class input_t = uint16_t>
+class SlidingMedian : public SlidingRank<N, input_t> {
+  public:
+    input_t operator()(input_t input) {
+      this->push(input, (this->next() + 1) / 2);
+      if (this->count & 1)
+        return this->lowerTop();
+      return this->lowerTop() + (this->upperTop() - this->lowerTop()) / 2;
+    }
+};
+
+//  P-th percentile (0 to 100) of the N most recent inputs, i.e. the
+//  sample of rank round((n - 1) * P / 100) in the sorted window.
+template <uint8_t N, uint8_t P, class input_t = uint16_t>
+class SlidingPercentile : public SlidingRank<N, input_t> {
+  public:
+    input_t operator()(input_t input) {
+      this->push(input, ((uint16_t)(this->next() - 1) * P + 50) / 100 + 1);
+      return this->lowerTop();
+    }
+
+    static_assert(P <= 100, "Error: the percentile should be between 0 and 100.");
+};
+
+//  Mean of the N most recent inputs without the T smallest and T
+//  largest ones (fewer while the window fills). Two heap splits give
+//  the sums below and above the trimmed samples, so it takes twice
+//  the memory of a SlidingMedian.
+template <uint8_t N, uint8_t T, class input_t = uint16_t, class sum_t = uint32_t>
+class TrimmedMean {
+  public:
+    input_t operator()(input_t input) {
+      uint8_t n = low.next();
+      uint8_t t = (uint16_t)n * T / N;
+      low(input, t);
+      high(input, n - t);
+      n -= 2 * t;
+      sum_t sum = high.sum() - low.sum();
+      //  Round to nearest for integer sums, as SMA does
+      if (sum_t(1) / 2 == 0)
+        sum += n / 2;
+      return sum / n;
+    }
+
+    static_assert(2 * T < N, "Error: at least one sample should be left after trimming.");
+
+  private:
+    class Split : public SlidingRank<N, input_t, sum_t> {
+      public:
+        void operator()(input_t input, uint8_t lower) { this->push(input, lower); }
+        using SlidingRank<N, input_t, sum_t>::next;
+        sum_t sum() const { return this->lowerSum; }
+    };
+
+    Split low, high;
+};
+
+//  Minimum or maximum of the N most recent inputs, from a monotonic
+//  queue of the samples that can still become the extremum: each
+//  input is queued and dequeued once, so updates are O(1) on average.
+template <uint8_t N, class input_t, bool maximum>
+class SlidingExtremum {
+  public:
+    input_t operator()(input_t input) {
+      //  Drop the oldest sample once it leaves the window
+      if (size > 0 && (uint16_t)(now - stamps[first]) >= N) {
+        if (++first == N)
+          first = 0;
+        size--;
+      }
+      //  and the queued samples the new one outlives and outranks
+      while (size > 0 && !(maximum ? values[last()] > input : values[last()] < input))
+        size--;
+      uint8_t i = last() + 1;
+      if (i >= N)
+        i -= N;
+      if (size == 0)
+        i = first;
+      values[i] = input;
+      stamps[i] = now;
+      size++;
+      now++;
+      return values[first];
+    }
+
+  private:
+    uint8_t last() const {
+      uint16_t i = first + size + N - 1;
+      return i >= N ? (i >= 2 * N ? i - 2 * N : i - N) : i;
+    }
+
+    input_t values[N] = {};
+    uint16_t stamps[N] = {};   //  Sample number, modulo 2^16
+    uint16_t now = 0;
+    uint8_t first = 0, size = 0;
+};
+
+template <uint8_t N, class input_t = uint16_t>
+using SlidingMin = SlidingExtremum<N, input_t, false>;
+
+template <uint8_t N, class input_t = uint16_t>
+using SlidingMax = SlidingExtremum<N, input_t, true>;
+
 class ComplementaryFilter {
   public:
     ComplementaryFilter() = default;
@@ -173,22 +498,42 @@ private:
  * 
  ******************************************************************/
 
+//  The random numbers come from a SplitMix64 generator, which only
+//  uses integer maths, so a given seed produces the same sequence on
+//  every board and on the host. The default constructor seeds it from
+//  the noise on A0.
 class NoiseGenerator {
   public:
     NoiseGenerator() {
-      randomSeed(analogRead(A0));
-      clearPinkState();
+      seed(analogRead(A0));
     }
 
+    NoiseGenerator(uint32_t seed) {
+      this->seed(seed);
+    }
+
+    void seed(uint32_t seed);
+    uint32_t random32() { return (uint32_t)(splitMix(_state) >> 32); }
+    float uniform() { return (splitMix(_state) >> 40) * (1.0f / 16777216.0f); }
+
     bool oneBitLFSR();
     double gaussianWithDeviation(int sd=1);
     void clearPinkState();
     float threeStagePink();
-    long randomWithRange(int min=-5, int max=5) { return (random(min, max)); }
+    long randomWithRange(int min=-5, int max=5);
+
+    static uint64_t splitMix(uint64_t &state) {
+      uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
 
   private:
     const uint16_t LFSR_INIT = 0xfeed;  //  Seed Value - any non-zero value
     const uint16_t LFSR_MASK = 0x8016;  //  Ref: http://users.ece.cmu.edu/~koopman/lfsr/
+    uint16_t _lfsr;
+    uint64_t _state;
     
     static const uint16_t PINK_NOISE_STAGES = 3;
     float state[PINK_NOISE_STAGES];
@@ -197,4 +542,63 @@ class NoiseGenerator {
 
 };
 
+//  Fills buffers with a synthetic sensor signal, for load testing the
+//  filters and anything downstream of them. Each sample is
+//
+//    level (+ trend and random steps) + Gaussian noise + outlier bursts
+//
+//  then optionally quantised to the resolution, and finally replaced
+//  by the dropout value while a dropout lasts. All the models are off
+//  until set, and each has its own random stream, so turning one on
+//  does not change what the others produce.
+//
+//  The models run in 64 bit integers, in 1/2^32 of the resolution,
+//  and each sample is converted to float once at the end, so a seed
+//  and a set of models give the same samples on every platform with
+//  IEEE 754 floats, whatever the block sizes. The Gaussian noise is
+//  the sum of 8 random bytes (so it is cut off at 4.9 sd). Each model
+//  is clamped to 2^27 times the resolution (the noise at its cut off),
+//  so their sum cannot overflow, and a NaN setting is taken as 0.
+class SignalGenerator : public NoiseGenerator {
+  public:
+    SignalGenerator(uint32_t seed = 1, float resolution = 1.0f / 1024);
+
+    void seed(uint32_t seed);
+    void setLevel(float level);
+    void setTrend(float perSample);
+    void setSteps(float size, float probability);
+    void setGaussian(float sd);
+    void setOutliers(float size, float probability, uint16_t length = 1);
+    void setQuantisation(bool on);
+    void setDropout(float probability, uint16_t length = 1, float value = NAN);
+
+    void fill(float *buffer, size_t n);
+    float operator()() { float x; fill(&x, 1); return x; }
+
+  private:
+    enum { STEPS, GAUSSIAN, OUTLIERS, DROPOUT, STREAMS };
+
+    int64_t toFixed(float x, float maxUnits) const;
+    static uint32_t toThreshold(float probability);
+
+    float _resolution;
+    uint64_t _streams[STREAMS];
+    int64_t _level = 0, _trend = 0;
+    int64_t _step = 0, _gaussian = 0, _outlier = 0;
+    uint32_t _stepThreshold = 0, _outlierThreshold = 0, _dropoutThreshold = 0;
+    uint16_t _outlierLength = 1, _dropoutLength = 1;
+    uint16_t _outlierLeft = 0, _dropoutLeft = 0;
+    bool _outlierUp = true;
+    bool _quantise = false;
+    float _dropoutValue = NAN;
+};
+
+/******************************************************************
+ *
+ * Biquad & FIR Filters - see ReefwingDSP.h
+ * 
+ ******************************************************************/
+
+#include "ReefwingDSP.h"
+
 #endif
\ No newline at end of file
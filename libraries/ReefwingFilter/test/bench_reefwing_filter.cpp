@@ -0,0 +1,467 @@
+#include <benchmark/benchmark.h>
+
+#include "../src/ReefwingFilter.h"
+
+#include <algorithm>
+
+// AHRS updates per second of the float kernels, against Madgwick's reference implementation in double precision.
+// Sliding window filters against sorting the window on every sample.
+// Biquad and FIR filters sample by sample and by blocks, in samples per second.
+
+// Madgwick's reference AHRS in double precision with 1/sqrt, as the library computed it before
+struct ReferenceMadgwick
+{
+    double q0 = 1.0, q1 = 0.0, q2 = 0.0, q3 = 0.0;
+    double beta = 0.1;
+
+    void normalise()
+    {
+        double recipNorm = 1.0 / sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+        q0 *= recipNorm;
+        q1 *= recipNorm;
+        q2 *= recipNorm;
+        q3 *= recipNorm;
+    }
+
+    __attribute__((noinline)) void update(double ax, double ay, double az, double gx, double gy, double gz, double mx,
+                                          double my, double mz, double dt)
+    {
+        double qDot1 = 0.5 * (-q1 * gx - q2 * gy - q3 * gz);
+        double qDot2 = 0.5 * (q0 * gx + q2 * gz - q3 * gy);
+        double qDot3 = 0.5 * (q0 * gy - q1 * gz + q3 * gx);
+        double qDot4 = 0.5 * (q0 * gz + q1 * gy - q2 * gx);
+
+        double recipNorm = 1.0 / sqrt(ax * ax + ay * ay + az * az);
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+        recipNorm = 1.0 / sqrt(mx * mx + my * my + mz * mz);
+        mx *= recipNorm;
+        my *= recipNorm;
+        mz *= recipNorm;
+
+        double hx = mx * (q0 * q0 + q1 * q1 - q2 * q2 - q3 * q3) + 2 * my * (q1 * q2 - q0 * q3) +
+                    2 * mz * (q0 * q2 + q1 * q3);
+        double hy = 2 * mx * (q0 * q3 + q1 * q2) + my * (q0 * q0 - q1 * q1 + q2 * q2 - q3 * q3) +
+                    2 * mz * (q2 * q3 - q0 * q1);
+        double _2bx = sqrt(hx * hx + hy * hy);
+        double _2bz = 2 * mx * (q1 * q3 - q0 * q2) + 2 * my * (q0 * q1 + q2 * q3) +
+                      mz * (q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3);
+
+        double fx = 2 * (q1 * q3 - q0 * q2) - ax;
+        double fy = 2 * (q0 * q1 + q2 * q3) - ay;
+        double fz = 1 - 2 * (q1 * q1 + q2 * q2) - az;
+        double bx = _2bx * (0.5 - q2 * q2 - q3 * q3) + _2bz * (q1 * q3 - q0 * q2) - mx;
+        double by = _2bx * (q1 * q2 - q0 * q3) + _2bz * (q0 * q1 + q2 * q3) - my;
+        double bz = _2bx * (q0 * q2 + q1 * q3) + _2bz * (0.5 - q1 * q1 - q2 * q2) - mz;
+
+        double s0 = -2 * q2 * fx + 2 * q1 * fy - _2bz * q2 * bx + (-_2bx * q3 + _2bz * q1) * by + _2bx * q2 * bz;
+        double s1 = 2 * q3 * fx + 2 * q0 * fy - 4 * q1 * fz + _2bz * q3 * bx + (_2bx * q2 + _2bz * q0) * by +
+                    (_2bx * q3 - 2 * _2bz * q1) * bz;
+        double s2 = -2 * q0 * fx + 2 * q3 * fy - 4 * q2 * fz + (-2 * _2bx * q2 - _2bz * q0) * bx +
+                    (_2bx * q1 + _2bz * q3) * by + (_2bx * q0 - 2 * _2bz * q2) * bz;
+        double s3 = 2 * q1 * fx + 2 * q2 * fy + (-2 * _2bx * q3 + _2bz * q1) * bx + (-_2bx * q0 + _2bz * q2) * by +
+                    _2bx * q1 * bz;
+        recipNorm = 1.0 / sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+
+        q0 += (qDot1 - beta * s0 * recipNorm) * dt;
+        q1 += (qDot2 - beta * s1 * recipNorm) * dt;
+        q2 += (qDot3 - beta * s2 * recipNorm) * dt;
+        q3 += (qDot4 - beta * s3 * recipNorm) * dt;
+        normalise();
+    }
+};
+
+// A second of 100 Hz samples of a sensor turning and rocking, replayed in a loop
+struct Samples
+{
+    static const int N = 100;
+    float ax[N], ay[N], az[N], gx[N], gy[N], gz[N], mx[N], my[N], mz[N];
+
+    Samples()
+    {
+        for (int k = 0; k < N; ++k)
+        {
+            float t = 0.01f * k;
+            ax[k] = 0.1f * sinf(6.3f * t);
+            ay[k] = 0.3f;
+            az[k] = 0.95f;
+            gx[k] = 0.2f * cosf(6.3f * t);
+            gy[k] = 0.15f;
+            gz[k] = 0.5f;
+            mx[k] = 0.6f * cosf(0.5f * t);
+            my[k] = -0.6f * sinf(0.5f * t);
+            mz[k] = -0.8f;
+        }
+    }
+};
+
+enum Update
+{
+    MADGWICK_9DOF,
+    MADGWICK_9DOF_DT,
+    MADGWICK_6DOF,
+    MAHONY_9DOF,
+    MAHONY_6DOF
+};
+
+__attribute__((noinline)) void Step(Quaternion &q, Update update, const Samples &s, int k)
+{
+    switch (update)
+    {
+        case MADGWICK_9DOF:
+            q.madgwickUpdate(s.ax[k], s.ay[k], s.az[k], s.gx[k], s.gy[k], s.gz[k], s.mx[k], s.my[k], s.mz[k]);
+            break;
+        case MADGWICK_9DOF_DT:
+            q.madgwickUpdate(s.ax[k], s.ay[k], s.az[k], s.gx[k], s.gy[k], s.gz[k], s.mx[k], s.my[k], s.mz[k], 0.01f);
+            break;
+        case MADGWICK_6DOF:
+            q.madgwickUpdate(s.ax[k], s.ay[k], s.az[k], s.gx[k], s.gy[k], s.gz[k]);
+            break;
+        case MAHONY_9DOF:
+            q.mahonyUpdate(s.ax[k], s.ay[k], s.az[k], s.gx[k], s.gy[k], s.gz[k], s.mx[k], s.my[k], s.mz[k]);
+            break;
+        case MAHONY_6DOF:
+            q.mahonyUpdate(s.ax[k], s.ay[k], s.az[k], s.gx[k], s.gy[k], s.gz[k]);
+            break;
+    }
+}
+
+void BM_Quaternion(benchmark::State &state)
+{
+    Samples samples;
+    Quaternion q;
+    Update update = Update(state.range(0));
+    q.setDeltaT(0.01f);
+    q.setKi(0.1f);
+    int k = 0;
+
+    for (auto _ : state)
+    {
+        Step(q, update, samples, k);
+        benchmark::DoNotOptimize(q);
+        k = (k + 1) % Samples::N;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ReferenceMadgwick(benchmark::State &state)
+{
+    Samples s;
+    ReferenceMadgwick q;
+    int k = 0;
+
+    for (auto _ : state)
+    {
+        q.update(s.ax[k], s.ay[k], s.az[k], s.gx[k], s.gy[k], s.gz[k], s.mx[k], s.my[k], s.mz[k], 0.01);
+        benchmark::DoNotOptimize(q);
+        k = (k + 1) % Samples::N;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_InvSqrt(benchmark::State &state)
+{
+    float x = 1.0f;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(x = invSqrt(x + 1.0f));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_OneOverSqrt(benchmark::State &state)
+{
+    float x = 1.0f;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(x = 1.0f / sqrtf(x + 1.0f));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// One AHRS update, reported as updates per second
+BENCHMARK(BM_ReferenceMadgwick);
+BENCHMARK(BM_Quaternion)->ArgName("madgwick9")->Arg(MADGWICK_9DOF);
+BENCHMARK(BM_Quaternion)->ArgName("madgwick9dt")->Arg(MADGWICK_9DOF_DT);
+BENCHMARK(BM_Quaternion)->ArgName("madgwick6")->Arg(MADGWICK_6DOF);
+BENCHMARK(BM_Quaternion)->ArgName("mahony9")->Arg(MAHONY_9DOF);
+BENCHMARK(BM_Quaternion)->ArgName("mahony6")->Arg(MAHONY_6DOF);
+
+// The normalisation on its own, as a dependent chain
+BENCHMARK(BM_InvSqrt);
+BENCHMARK(BM_OneOverSqrt);
+
+// The window sorted on every sample with an insertion sort, as the sketches did it
+template <uint8_t N>
+struct SortedMedian
+{
+    uint16_t window[N] = {};
+    uint16_t sorted[N];
+    uint8_t index = 0;
+
+    uint16_t operator()(uint16_t input)
+    {
+        window[index] = input;
+        if (++index == N)
+            index = 0;
+
+        std::copy(window, window + N, sorted);
+        for (int i = 1; i < N; ++i)
+        {
+            uint16_t value = sorted[i];
+            int j = i - 1;
+            for (; j >= 0 && sorted[j] > value; --j)
+            {
+                sorted[j + 1] = sorted[j];
+            }
+            sorted[j + 1] = value;
+        }
+
+        return sorted[N / 2];
+    }
+};
+
+template <typename Filter>
+void RunWindow(benchmark::State &state)
+{
+    Filter filter;
+    uint32_t noise = 12345;
+
+    for (auto _ : state)
+    {
+        noise = noise * 1664525u + 1013904223u;
+        benchmark::DoNotOptimize(filter(uint16_t(500 + (noise >> 24))));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["filter_bytes"] = sizeof(filter);
+}
+
+template <uint8_t N>
+void BM_SortedMedian(benchmark::State &state)
+{
+    RunWindow<SortedMedian<N>>(state);
+}
+
+template <uint8_t N>
+void BM_SlidingMedian(benchmark::State &state)
+{
+    RunWindow<SlidingMedian<N>>(state);
+}
+
+template <uint8_t N>
+void BM_SlidingPercentile(benchmark::State &state)
+{
+    RunWindow<SlidingPercentile<N, 90>>(state);
+}
+
+template <uint8_t N>
+void BM_TrimmedMean(benchmark::State &state)
+{
+    RunWindow<TrimmedMean<N, N / 5>>(state);
+}
+
+template <uint8_t N>
+void BM_SlidingMax(benchmark::State &state)
+{
+    RunWindow<SlidingMax<N>>(state);
+}
+
+template <uint8_t N>
+void BM_SMA(benchmark::State &state)
+{
+    RunWindow<SMA<N>>(state);
+}
+
+// One sample of a sliding window filter, for windows of 5 to 255 samples
+#define BENCHMARK_WINDOW(N)                    \
+    BENCHMARK_TEMPLATE(BM_SortedMedian, N);     \
+    BENCHMARK_TEMPLATE(BM_SlidingMedian, N);    \
+    BENCHMARK_TEMPLATE(BM_SlidingPercentile, N); \
+    BENCHMARK_TEMPLATE(BM_TrimmedMean, N);      \
+    BENCHMARK_TEMPLATE(BM_SlidingMax, N);       \
+    BENCHMARK_TEMPLATE(BM_SMA, N)
+
+BENCHMARK_WINDOW(5);
+BENCHMARK_WINDOW(25);
+BENCHMARK_WINDOW(101);
+BENCHMARK_WINDOW(255);
+
+// A hand rolled direct form I biquad in double, as the sketches filtered the mains hum
+struct DoubleBiquad
+{
+    double b0, b1, b2, a1, a2;
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+    DoubleBiquad(const BiquadCoefficients &c) : b0(c.b0), b1(c.b1), b2(c.b2), a1(c.a1), a2(c.a2) {}
+
+    double operator()(double x)
+    {
+        double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+const int BLOCK = 256;
+
+// A 4th order Butterworth low pass (two sections) at 1 kHz
+const BiquadCoefficients butterworth[] = {butterworthLowPass(20.0, 1000.0, 4, 0),
+                                          butterworthLowPass(20.0, 1000.0, 4, 1)};
+
+void Signal(float *buffer, int n, int &step)
+{
+    for (int i = 0; i < n; ++i, ++step)
+    {
+        buffer[i] = 0.5f * float(step % 97) / 97.0f - 0.25f;
+    }
+}
+
+void Signal(int16_t *buffer, int n, int &step)
+{
+    for (int i = 0; i < n; ++i, ++step)
+    {
+        buffer[i] = int16_t((step % 97) * 168 - 8192);
+    }
+}
+
+void BM_DoubleBiquad(benchmark::State &state)
+{
+    DoubleBiquad first(butterworth[0]), second(butterworth[1]);
+    float buffer[BLOCK];
+    int step = 0;
+
+    for (auto _ : state)
+    {
+        Signal(buffer, BLOCK, step);
+        for (int i = 0; i < BLOCK; ++i)
+        {
+            buffer[i] = float(second(first(buffer[i])));
+        }
+        benchmark::DoNotOptimize(buffer);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BLOCK);
+}
+
+// Per sample with operator() (block = 0) or with process()
+template <typename Filter, typename Sample>
+void RunStream(benchmark::State &state, Filter &filter)
+{
+    Sample buffer[BLOCK];
+    bool block = state.range(0);
+    int step = 0;
+
+    for (auto _ : state)
+    {
+        Signal(buffer, BLOCK, step);
+        if (block)
+        {
+            filter.process(buffer, buffer, BLOCK);
+        }
+        else
+        {
+            for (int i = 0; i < BLOCK; ++i)
+            {
+                buffer[i] = filter(buffer[i]);
+            }
+        }
+        benchmark::DoNotOptimize(buffer);
+    }
+
+    state.SetItemsProcessed(state.iterations() * BLOCK);
+}
+
+void BM_BiquadCascade(benchmark::State &state)
+{
+    BiquadCascade<2> filter(butterworth);
+    RunStream<BiquadCascade<2>, float>(state, filter);
+}
+
+void BM_BiquadCascadeQ15(benchmark::State &state)
+{
+    BiquadCascadeQ15<2> filter(butterworth);
+    RunStream<BiquadCascadeQ15<2>, int16_t>(state, filter);
+}
+
+template <uint8_t Taps>
+void BM_FIR(benchmark::State &state)
+{
+    FIR<Taps> filter(firLowPass<Taps>(50.0, 1000.0));
+    RunStream<FIR<Taps>, float>(state, filter);
+}
+
+template <uint8_t Taps>
+void BM_FIRQ15(benchmark::State &state)
+{
+    FIRQ15<Taps> filter(firLowPass<Taps>(50.0, 1000.0));
+    RunStream<FIRQ15<Taps>, int16_t>(state, filter);
+}
+
+// Blocks of 256 samples through a 4th order Butterworth low pass or a 31 / 127 tap FIR low pass
+BENCHMARK(BM_DoubleBiquad);
+BENCHMARK(BM_BiquadCascade)->ArgName("block")->Arg(0)->Arg(1);
+BENCHMARK(BM_BiquadCascadeQ15)->ArgName("block")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_FIR, 31)->ArgName("block")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_FIRQ15, 31)->ArgName("block")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_FIR, 127)->ArgName("block")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_FIRQ15, 127)->ArgName("block")->Arg(0)->Arg(1);
+
+// Box-Muller on rand(), as NoiseGenerator used to make its Gaussian samples
+static void BM_RandBoxMuller(benchmark::State &state)
+{
+    std::vector<float> buffer(4096);
+    srand(1);
+    for (auto _ : state)
+    {
+        for (float &x : buffer)
+        {
+            double u;
+            do
+            {
+                u = rand() / double(RAND_MAX);
+            } while (u == 0.0);
+            x = 25.0f + float(std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * PI * rand() / double(RAND_MAX)));
+        }
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size() * sizeof(float));
+}
+
+// 0: level and Gaussian noise, 1: every model
+static void BM_SignalGenerator(benchmark::State &state)
+{
+    std::vector<float> buffer(4096);
+    SignalGenerator generator(1, 0.0625f);
+    generator.setLevel(25.0f);
+    generator.setGaussian(1.0f);
+    if (state.range(0))
+    {
+        generator.setTrend(1e-6f);
+        generator.setSteps(2.0f, 1e-4f);
+        generator.setOutliers(40.0f, 1e-3f, 5);
+        generator.setQuantisation(true);
+        generator.setDropout(1e-4f, 50);
+    }
+    for (auto _ : state)
+    {
+        generator.fill(buffer.data(), buffer.size());
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size() * sizeof(float));
+}
+
+BENCHMARK(BM_RandBoxMuller);
+BENCHMARK(BM_SignalGenerator)->ArgName("models")->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
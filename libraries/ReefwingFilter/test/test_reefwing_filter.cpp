@@ -0,0 +1,641 @@
+#include <gtest/gtest.h>
+
+#include "../src/ReefwingFilter.h"
+
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+namespace
+{
+
+// Madgwick's reference AHRS in double precision with 1/sqrt, to check the float kernels against
+struct ReferenceMadgwick
+{
+    double q0 = 1.0, q1 = 0.0, q2 = 0.0, q3 = 0.0;
+    double beta = 0.1;
+
+    void normalise()
+    {
+        double recipNorm = 1.0 / sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+        q0 *= recipNorm;
+        q1 *= recipNorm;
+        q2 *= recipNorm;
+        q3 *= recipNorm;
+    }
+
+    void update(double ax, double ay, double az, double gx, double gy, double gz, double dt)
+    {
+        double qDot1 = 0.5 * (-q1 * gx - q2 * gy - q3 * gz);
+        double qDot2 = 0.5 * (q0 * gx + q2 * gz - q3 * gy);
+        double qDot3 = 0.5 * (q0 * gy - q1 * gz + q3 * gx);
+        double qDot4 = 0.5 * (q0 * gz + q1 * gy - q2 * gx);
+
+        double recipNorm = 1.0 / sqrt(ax * ax + ay * ay + az * az);
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+
+        double s0 = 4 * q0 * q2 * q2 + 2 * q2 * ax + 4 * q0 * q1 * q1 - 2 * q1 * ay;
+        double s1 = 4 * q1 * q3 * q3 - 2 * q3 * ax + 4 * q0 * q0 * q1 - 2 * q0 * ay - 4 * q1 + 8 * q1 * q1 * q1 +
+                    8 * q1 * q2 * q2 + 4 * q1 * az;
+        double s2 = 4 * q0 * q0 * q2 + 2 * q0 * ax + 4 * q2 * q3 * q3 - 2 * q3 * ay - 4 * q2 + 8 * q2 * q1 * q1 +
+                    8 * q2 * q2 * q2 + 4 * q2 * az;
+        double s3 = 4 * q1 * q1 * q3 - 2 * q1 * ax + 4 * q2 * q2 * q3 - 2 * q2 * ay;
+        recipNorm = 1.0 / sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+
+        q0 += (qDot1 - beta * s0 * recipNorm) * dt;
+        q1 += (qDot2 - beta * s1 * recipNorm) * dt;
+        q2 += (qDot3 - beta * s2 * recipNorm) * dt;
+        q3 += (qDot4 - beta * s3 * recipNorm) * dt;
+        normalise();
+    }
+};
+
+// A sensor rolled by 'roll' and turning about the vertical at 'rate', as seen by an ideal IMU. The earth magnetic field
+// points north and down.
+struct Motion
+{
+    double roll = 0.3, rate = 0.5;
+    double ax, ay, az, gx, gy, gz, mx, my, mz;
+
+    void at(double t)
+    {
+        // Body frame vectors are R' * v with R = Rz(yaw) * Rx(roll)
+        double yaw = rate * t;
+        double cr = cos(roll), sr = sin(roll), cy = cos(yaw), sy = sin(yaw);
+        ax = 0.0;
+        ay = sr;
+        az = cr;
+        gx = 0.0;
+        gy = sr * rate;
+        gz = cr * rate;
+        double nx = 0.6, nz = -0.8;
+        mx = cy * nx;
+        my = -sy * cr * nx + sr * nz;
+        mz = sy * sr * nx + cr * nz;
+    }
+
+    double yaw(double t) const { return remainder(rate * t, 2.0 * M_PI); }
+};
+
+enum Algorithm
+{
+    MADGWICK,
+    MAHONY
+};
+
+// Largest error of the Euler angles over the last second of a 30 s run at 100 Hz, starting level and facing north
+double TrackingError(Algorithm algorithm, bool magnetometer)
+{
+    Quaternion q;
+    Motion motion;
+    q.setDeltaT(0.01f);
+    double error = 0.0;
+
+    for (int k = 1; k <= 3000; ++k)
+    {
+        motion.at(k * 0.01);
+
+        float mx = magnetometer ? motion.mx : 0.0f;
+        float my = magnetometer ? motion.my : 0.0f;
+        float mz = magnetometer ? motion.mz : 0.0f;
+
+        if (algorithm == MADGWICK)
+        {
+            q.madgwickUpdate(motion.ax, motion.ay, motion.az, motion.gx, motion.gy, motion.gz, mx, my, mz);
+        }
+        else
+        {
+            q.mahonyUpdate(motion.ax, motion.ay, motion.az, motion.gx, motion.gy, motion.gz, mx, my, mz);
+        }
+
+        if (k > 2900)
+        {
+            EulerAngles angles = q.toEulerAngels();
+            error = std::max(error, fabs(double(angles.roll) - motion.roll));
+            error = std::max(error, fabs(double(angles.pitch)));
+            error = std::max(error, fabs(remainder(double(angles.yaw) - motion.yaw(k * 0.01), 2.0 * M_PI)));
+        }
+    }
+
+    return error;
+}
+
+// A deterministic stand in for sensor readings with outlier spikes
+struct Readings
+{
+    uint32_t state = 12345;
+
+    uint16_t operator()()
+    {
+        state = state * 1664525u + 1013904223u;
+        uint16_t reading = 500 + (state >> 28);
+        return (state >> 8) % 16 == 0 ? reading + 3000 : reading;
+    }
+};
+
+// The sorted window of the last n inputs, as we did it before
+template <typename T>
+std::vector<T> Sorted(const std::vector<T> &history, size_t n)
+{
+    std::vector<T> window(history.end() - std::min(n, history.size()), history.end());
+    std::sort(window.begin(), window.end());
+    return window;
+}
+
+template <uint8_t N, typename T>
+void CheckOrderFilters(T scale)
+{
+    SlidingMedian<N, T> median;
+    SlidingPercentile<N, 10, T> p10;
+    SlidingPercentile<N, 90, T> p90;
+    SlidingMin<N, T> minimum;
+    SlidingMax<N, T> maximum;
+    Readings readings;
+    std::vector<T> history;
+
+    for (int k = 0; k < 1000; ++k)
+    {
+        T input = T(readings()) * scale;
+        history.push_back(input);
+        std::vector<T> window = Sorted(history, N);
+        size_t n = window.size();
+
+        T expected = n % 2 ? window[n / 2] : window[n / 2 - 1] + (window[n / 2] - window[n / 2 - 1]) / 2;
+        ASSERT_EQ(median(input), expected) << "sample " << k;
+        ASSERT_EQ(p10(input), window[((n - 1) * 10 + 50) / 100]) << "sample " << k;
+        ASSERT_EQ(p90(input), window[((n - 1) * 90 + 50) / 100]) << "sample " << k;
+        ASSERT_EQ(minimum(input), window.front()) << "sample " << k;
+        ASSERT_EQ(maximum(input), window.back()) << "sample " << k;
+    }
+}
+
+// Gain of a biquad cascade at frequency f, from its transfer function
+template <size_t Sections>
+double Gain(const BiquadCoefficients (&sections)[Sections], double f, double fs)
+{
+    std::complex<double> z1 = std::polar(1.0, -2.0 * M_PI * f / fs);
+    std::complex<double> h = 1.0;
+
+    for (const BiquadCoefficients &c : sections)
+    {
+        h *= (double(c.b0) + double(c.b1) * z1 + double(c.b2) * z1 * z1) /
+             (1.0 + double(c.a1) * z1 + double(c.a2) * z1 * z1);
+    }
+
+    return std::abs(h);
+}
+
+// An LM35 warming up, read at 1 kHz with 50 Hz mains hum on top
+float Lm35(int k)
+{
+    return 0.25f + 0.05f * float(k) / 4000.0f + 0.1f * sinf(2.0f * float(M_PI) * 50.0f * k / 1000.0f);
+}
+
+}  // namespace
+
+TEST(ReefwingFilter, InvSqrt)
+{
+    for (float x = 1e-6f; x < 1e6f; x *= 1.37f)
+    {
+        EXPECT_NEAR(invSqrt(x) * sqrtf(x), 1.0f, 7e-4f);
+    }
+}
+
+TEST(ReefwingFilter, MadgwickMatchesReference)
+{
+    Quaternion q;
+    ReferenceMadgwick reference;
+    Motion motion;
+    q.setDeltaT(0.01f);
+
+    for (int k = 1; k <= 2000; ++k)
+    {
+        motion.at(k * 0.01);
+        q.madgwickUpdate(motion.ax, motion.ay, motion.az, motion.gx, motion.gy, motion.gz);
+        reference.update(motion.ax, motion.ay, motion.az, motion.gx, motion.gy, motion.gz, 0.01);
+
+        ASSERT_NEAR(q.q0, reference.q0, 2e-3);
+        ASSERT_NEAR(q.q1, reference.q1, 2e-3);
+        ASSERT_NEAR(q.q2, reference.q2, 2e-3);
+        ASSERT_NEAR(q.q3, reference.q3, 2e-3);
+    }
+}
+
+TEST(ReefwingFilter, MadgwickZeroGradient)
+{
+    // A level, stationary sensor facing magnetic north at the identity quaternion fits the model exactly, so the
+    // gradient is zero. That is no step, not a division of zero by zero.
+    Quaternion q6, q9;
+    q6.setDeltaT(0.01f);
+    q9.setDeltaT(0.01f);
+
+    for (int k = 0; k < 10; ++k)
+    {
+        q6.madgwickUpdate(0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
+        q9.madgwickUpdate(0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+    }
+
+    for (const Quaternion &q : {q6, q9})
+    {
+        EXPECT_NEAR(q.q0, 1.0f, 1e-3f);
+        EXPECT_EQ(q.q1, 0.0f);
+        EXPECT_EQ(q.q2, 0.0f);
+        EXPECT_EQ(q.q3, 0.0f);
+    }
+}
+
+TEST(ReefwingFilter, FixedSampleTime)
+{
+    // The hoisted products are the ones the deltaT overloads work out, so both give the same bits
+    Quaternion fixed, variable;
+    Motion motion;
+    fixed.setDeltaT(0.02f);
+    fixed.setKi(0.05f);
+    variable.setKi(0.05f);
+
+    for (int k = 1; k <= 200; ++k)
+    {
+        motion.at(k * 0.02);
+        fixed.madgwickUpdate(motion.ax, motion.ay, motion.az, motion.gx, motion.gy, motion.gz, motion.mx, motion.my,
+                             motion.mz);
+        variable.madgwickUpdate(motion.ax, motion.ay, motion.az, motion.gx, motion.gy, motion.gz, motion.mx, motion.my,
+                                motion.mz, 0.02f);
+        fixed.mahonyUpdate(motion.ax, motion.ay, motion.az, motion.gx, motion.gy, motion.gz);
+        variable.mahonyUpdate(motion.ax, motion.ay, motion.az, motion.gx, motion.gy, motion.gz, 0.02f);
+    }
+
+    EXPECT_EQ(fixed.q0, variable.q0);
+    EXPECT_EQ(fixed.q1, variable.q1);
+    EXPECT_EQ(fixed.q2, variable.q2);
+    EXPECT_EQ(fixed.q3, variable.q3);
+}
+
+TEST(ReefwingFilter, Tracking)
+{
+    EXPECT_LT(TrackingError(MADGWICK, true), 0.02);
+    EXPECT_LT(TrackingError(MADGWICK, false), 0.02);
+    EXPECT_LT(TrackingError(MAHONY, true), 0.02);
+    EXPECT_LT(TrackingError(MAHONY, false), 0.02);
+}
+
+TEST(ReefwingFilter, MahonyGyroBias)
+{
+    // Level and still with a biased gyroscope: the integral feedback learns the bias and the attitude stays level
+    Quaternion q;
+    q.setDeltaT(0.01f);
+    q.setKi(0.1f);
+
+    for (int k = 0; k < 6000; ++k)
+    {
+        q.mahonyUpdate(0.0f, 0.0f, 1.0f, 0.05f, -0.03f, 0.0f);
+    }
+
+    EulerAngles angles = q.toEulerAngels();
+    EXPECT_NEAR(angles.roll, 0.0f, 1e-3f);
+    EXPECT_NEAR(angles.pitch, 0.0f, 1e-3f);
+
+    q.reset();
+    EXPECT_EQ(q.q0, 1.0f);
+    EXPECT_EQ(q.q1, 0.0f);
+}
+
+TEST(ReefwingFilter, SlidingOrderStatistics)
+{
+    CheckOrderFilters<1, uint16_t>(1);
+    CheckOrderFilters<2, uint16_t>(1);
+    CheckOrderFilters<5, uint16_t>(1);
+    CheckOrderFilters<24, int16_t>(-1);
+    CheckOrderFilters<101, float>(0.1f);
+    CheckOrderFilters<255, uint16_t>(1);
+}
+
+TEST(ReefwingFilter, TrimmedMean)
+{
+    TrimmedMean<9, 2> trimmed;
+    TrimmedMean<9, 2, float, float> trimmedFloat;
+    Readings readings;
+    std::vector<uint16_t> history;
+
+    for (int k = 0; k < 1000; ++k)
+    {
+        uint16_t input = readings();
+        history.push_back(input);
+        std::vector<uint16_t> window = Sorted(history, 9);
+        size_t t = window.size() * 2 / 9;
+        double sum = 0.0;
+
+        for (size_t i = t; i < window.size() - t; ++i)
+        {
+            sum += window[i];
+        }
+
+        double expected = sum / (window.size() - 2 * t);
+        uint16_t output = trimmed(input);
+        ASSERT_NEAR(output, expected, 0.5) << "sample " << k;
+        ASSERT_NEAR(trimmedFloat(input), expected, 1e-3) << "sample " << k;
+
+        // Up to two spikes in a window of nine are trimmed away
+        if (k >= 8 && window[6] < 3000)
+        {
+            ASSERT_LT(output, 600);
+        }
+    }
+}
+
+// Evaluated by the compiler
+constexpr BiquadCoefficients quarterBand = lowPassBiquad(250.0, 1000.0);
+static_assert(quarterBand.b0 > 0.29289f && quarterBand.b0 < 0.29290f, "RBJ low pass at fs / 4");
+static_assert(quarterBand.a1 > -1e-6f && quarterBand.a1 < 1e-6f, "RBJ low pass at fs / 4");
+static_assert(quarterBand.a2 > 0.17157f && quarterBand.a2 < 0.17158f, "RBJ low pass at fs / 4");
+constexpr FirCoefficients<5> fiveTaps = firLowPass<5>(100.0, 1000.0);
+static_assert(fiveTaps.h[0] == fiveTaps.h[4] && fiveTaps.h[1] == fiveTaps.h[3], "linear phase");
+
+TEST(ReefwingFilter, BiquadDesign)
+{
+    constexpr BiquadCoefficients butterworth[] = {butterworthLowPass(10.0, 1000.0, 4, 0),
+                                                  butterworthLowPass(10.0, 1000.0, 4, 1)};
+    EXPECT_NEAR(Gain(butterworth, 0.0, 1000.0), 1.0, 1e-4);
+    EXPECT_NEAR(Gain(butterworth, 1.0, 1000.0), 1.0, 1e-4);
+    EXPECT_NEAR(Gain(butterworth, 10.0, 1000.0), M_SQRT1_2, 1e-3);
+    EXPECT_LT(Gain(butterworth, 100.0, 1000.0), 2e-4);
+
+    constexpr BiquadCoefficients highPass[] = {butterworthHighPass(10.0, 1000.0, 2, 0)};
+    EXPECT_NEAR(Gain(highPass, 10.0, 1000.0), M_SQRT1_2, 1e-3);
+    EXPECT_NEAR(Gain(highPass, 400.0, 1000.0), 1.0, 1e-3);
+    EXPECT_LT(Gain(highPass, 0.5, 1000.0), 3e-3);
+
+    constexpr BiquadCoefficients notch[] = {notchBiquad(50.0, 1000.0, 5.0)};
+    EXPECT_LT(Gain(notch, 50.0, 1000.0), 1e-3);
+    EXPECT_GT(Gain(notch, 5.0, 1000.0), 0.99);
+    EXPECT_GT(Gain(notch, 200.0, 1000.0), 0.99);
+
+    constexpr BiquadCoefficients bandPass[] = {bandPassBiquad(50.0, 1000.0, 5.0)};
+    EXPECT_NEAR(Gain(bandPass, 50.0, 1000.0), 1.0, 1e-4);
+    EXPECT_LT(Gain(bandPass, 5.0, 1000.0), 0.03);
+
+    FirCoefficients<31> taps = firLowPass<31>(50.0, 1000.0);
+    float sum = 0.0f;
+    for (float h : taps.h)
+    {
+        sum += h;
+    }
+    EXPECT_NEAR(sum, 1.0f, 1e-6f);
+}
+
+TEST(ReefwingFilter, BiquadCascade)
+{
+    const BiquadCoefficients sections[] = {notchBiquad(50.0, 1000.0, 5.0), butterworthLowPass(20.0, 1000.0, 2, 0)};
+    BiquadCascade<2> filter(sections);
+    BiquadCascade<2> block(sections);
+    BiquadCascadeQ15<2> fixed(sections);
+
+    // Direct form I in double, to check the transposed float sections against
+    double x1[2] = {}, x2[2] = {}, y1[2] = {}, y2[2] = {};
+
+    std::vector<float> input(4000), output(4000);
+    for (int k = 0; k < 4000; ++k)
+    {
+        input[k] = Lm35(k);
+    }
+
+    // Odd block sizes, in place
+    output = input;
+    for (size_t start = 0; start < output.size(); start += 37)
+    {
+        block.process(&output[start], &output[start], std::min<size_t>(37, output.size() - start));
+    }
+
+    for (int k = 0; k < 4000; ++k)
+    {
+        double x = input[k];
+        for (int i = 0; i < 2; ++i)
+        {
+            const BiquadCoefficients &c = sections[i];
+            double y = c.b0 * x + c.b1 * x1[i] + c.b2 * x2[i] - c.a1 * y1[i] - c.a2 * y2[i];
+            x2[i] = x1[i];
+            x1[i] = x;
+            y2[i] = y1[i];
+            y1[i] = y;
+            x = y;
+        }
+
+        float y = filter(input[k]);
+        ASSERT_NEAR(y, x, 1e-5) << "sample " << k;
+        ASSERT_EQ(output[k], y) << "sample " << k;
+        int16_t q = fixed(toQ15(input[k]));
+        ASSERT_NEAR(q / 32768.0, x, 2e-3) << "sample " << k;
+
+        // The hum is gone once the filters settled
+        if (k > 500)
+        {
+            ASSERT_NEAR(y, 0.25f + 0.05f * float(k) / 4000.0f, 2e-3f) << "sample " << k;
+        }
+    }
+}
+
+TEST(ReefwingFilter, FIR)
+{
+    constexpr FirCoefficients<31> taps = firLowPass<31>(50.0, 1000.0);
+    FIR<31> filter(taps);
+    FIR<31> block(taps);
+    FIRQ15<31> fixed(taps);
+
+    std::vector<float> input(2000), output(2000);
+    for (int k = 0; k < 2000; ++k)
+    {
+        input[k] = Lm35(k) - 0.25f;
+    }
+
+    block.process(input.data(), output.data(), 1000);
+    block.process(input.data() + 1000, output.data() + 1000, 1000);
+
+    for (int k = 0; k < 2000; ++k)
+    {
+        double expected = 0.0;
+        for (int i = 0; i < 31 && i <= k; ++i)
+        {
+            expected += double(taps.h[i]) * input[k - i];
+        }
+
+        float y = filter(input[k]);
+        ASSERT_NEAR(y, expected, 1e-6) << "sample " << k;
+        ASSERT_NEAR(output[k], expected, 1e-6) << "sample " << k;
+        int16_t q = fixed(toQ15(input[k]));
+        ASSERT_NEAR(q / 32768.0, expected, 2e-4) << "sample " << k;
+    }
+}
+
+TEST(ReefwingFilter, NoiseGeneratorSeed)
+{
+    NoiseGenerator a(42), b(42), c(43);
+    bool differs = false;
+    for (int k = 0; k < 1000; ++k)
+    {
+        long x = a.randomWithRange(-25, 25);
+        EXPECT_EQ(x, b.randomWithRange(-25, 25));
+        EXPECT_GE(x, -25);
+        EXPECT_LT(x, 25);
+        differs |= x != c.randomWithRange(-25, 25);
+        EXPECT_EQ(a.oneBitLFSR(), b.oneBitLFSR());
+        EXPECT_EQ(a.threeStagePink(), b.threeStagePink());
+    }
+    EXPECT_TRUE(differs);
+
+    a.seed(7);
+    b.seed(7);
+    EXPECT_EQ(a.gaussianWithDeviation(2), b.gaussianWithDeviation(2));
+}
+
+static SignalGenerator Everything(uint32_t seed)
+{
+    SignalGenerator generator(seed, 0.0625f);
+    generator.setLevel(25.0f);
+    generator.setTrend(1e-4f);
+    generator.setSteps(2.0f, 1e-3f);
+    generator.setGaussian(0.5f);
+    generator.setOutliers(40.0f, 2e-3f, 5);
+    generator.setQuantisation(true);
+    generator.setDropout(1e-3f, 20);
+    return generator;
+}
+
+TEST(ReefwingFilter, SignalGeneratorDeterministic)
+{
+    // Same seed, any block sizes, same samples
+    SignalGenerator a = Everything(1234), b = Everything(1234);
+    std::vector<float> x(100000), y(100000);
+    a.fill(x.data(), x.size());
+    for (size_t k = 0, n = 1; k < y.size(); k += n, n = n * 3 % 1021)
+    {
+        b.fill(y.data() + k, std::min(n, y.size() - k));
+    }
+    ASSERT_EQ(0, memcmp(x.data(), y.data(), x.size() * sizeof(float)));
+
+    // and the same samples as on any other platform: FNV-1a of the bits
+    uint32_t hash = 2166136261u;
+    for (float f : x)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        for (int i = 0; i < 4; ++i)
+        {
+            hash = (hash ^ ((bits >> (8 * i)) & 0xff)) * 16777619u;
+        }
+    }
+    EXPECT_EQ(3351399813u, hash);
+}
+
+TEST(ReefwingFilter, SignalGeneratorModels)
+{
+    const int n = 200000;
+    std::vector<float> clean(n), noisy(n), x(n);
+
+    // A trend on its own is exact
+    SignalGenerator trend(1, 1.0f / 1024);
+    trend.setLevel(-3.0f);
+    trend.setTrend(0.25f);
+    trend.fill(clean.data(), 8);
+    for (int k = 0; k < 8; ++k)
+    {
+        EXPECT_EQ(-3.0f + 0.25f * (k + 1), clean[k]);
+    }
+
+    // Gaussian noise has the right mean and deviation, and is cut off at 4.9 sd
+    SignalGenerator gaussian(2);
+    gaussian.setGaussian(3.0f);
+    gaussian.fill(noisy.data(), n);
+    double sum = 0.0, squares = 0.0, largest = 0.0;
+    int beyond2 = 0;
+    for (float v : noisy)
+    {
+        sum += v;
+        squares += double(v) * v;
+        largest = std::max(largest, double(std::fabs(v)));
+        beyond2 += std::fabs(v) > 6.0f;
+    }
+    EXPECT_NEAR(sum / n, 0.0, 0.03);
+    EXPECT_NEAR(std::sqrt(squares / n), 3.0, 0.02);
+    EXPECT_LE(largest, 3.0 * 4.9);
+    EXPECT_NEAR(double(beyond2) / n, 0.0455, 0.003);
+
+    // Each model has its own stream: adding outliers, quantisation and dropout
+    // leaves the noise of the other samples alone
+    SignalGenerator all(2, 0.125f);
+    all.setGaussian(3.0f);
+    all.setOutliers(100.0f, 1e-3f, 4);
+    all.setQuantisation(true);
+    all.setDropout(2e-3f, 10, -1000.0f);
+    all.fill(x.data(), n);
+    int outliers = 0, dropped = 0, run = 0, longest = 0;
+    for (int k = 0; k < n; ++k)
+    {
+        if (x[k] == -1000.0f)
+        {
+            dropped++;
+            run++;
+            continue;
+        }
+        EXPECT_EQ(0, run % 10) << "dropouts come in runs of 10, maybe back to back";
+        longest = std::max(longest, run);
+        run = 0;
+        EXPECT_EQ(x[k], std::round(x[k] * 8.0f) / 8.0f);
+        float offset = x[k] - noisy[k];
+        if (std::fabs(offset) > 50.0f)
+        {
+            outliers++;
+            offset -= std::copysign(100.0f, offset);
+        }
+        ASSERT_LE(std::fabs(offset), 0.0625f + 1e-4f) << "sample " << k;
+    }
+    EXPECT_GE(longest, 10);
+    // a dropout or burst starts with probability p on each sample outside one
+    EXPECT_NEAR(double(dropped) / n, 10 * 2e-3 / (1 + 10 * 2e-3), 0.004);
+    EXPECT_NEAR(double(outliers) / (n - dropped), 4 * 1e-3 / (1 + 4 * 1e-3), 0.001);
+
+    // Steps move the level by whole steps
+    SignalGenerator steps(3);
+    steps.setSteps(0.5f, 0.01f);
+    steps.fill(x.data(), n);
+    int jumps = 0;
+    for (int k = 1; k < n; ++k)
+    {
+        float d = x[k] - x[k - 1];
+        ASSERT_TRUE(d == 0.0f || std::fabs(d) == 0.5f);
+        jumps += d != 0.0f;
+    }
+    EXPECT_NEAR(double(jumps) / n, 0.01, 0.001);
+
+    // Dropouts are NaN by default
+    SignalGenerator nan(4);
+    nan.setDropout(1.0f);
+    EXPECT_TRUE(std::isnan(nan()));
+}
+
+TEST(ReefwingFilter, SignalGeneratorClampsModels)
+{
+    // Settings far past 2^27 resolutions are clamped rather than overflowing 64 bits
+    const float limit = 134217728.0f * 1e-6f;
+    SignalGenerator g(5, 1e-6f);
+    g.setLevel(1e12f);
+    EXPECT_EQ(limit, g());
+    g.setLevel(-1e12f);
+    EXPECT_EQ(-limit, g());
+    g.setLevel(NAN);
+    EXPECT_EQ(0.0f, g());
+
+    // and all of them together still fit
+    g.setLevel(-1e12f);
+    g.setGaussian(1e12f);
+    g.setOutliers(-1e12f, 0.5f, 3);
+    g.setQuantisation(true);
+    std::vector<float> x(10000);
+    g.fill(x.data(), x.size());
+    for (float v : x)
+    {
+        ASSERT_TRUE(std::isfinite(v));
+        ASSERT_LE(std::fabs(v), 3.0f * limit);
+    }
+}
+
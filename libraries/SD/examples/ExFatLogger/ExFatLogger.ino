@@ -0,0 +1,78 @@
+/*
+  exFAT datalogger
+
+  This example shows how to log analog readings to an SDXC card
+  formatted with exFAT.  The SD class only opens FAT16 and FAT32
+  volumes so the card and volume are used directly.
+
+  The log file is preallocated so each write goes straight to a
+  contiguous block range without reading or writing the FAT.
+
+  The circuit:
+   analog sensor on analog in 0
+   SD card attached to SPI bus as follows:
+ ** MOSI - pin 11
+ ** MISO - pin 12
+ ** CLK - pin 13
+ ** CS - pin 4 (for MKRZero SD: SDCARD_SS_PIN)
+
+  This example code is in the public domain.
+
+*/
+
+#include <SPI.h>
+#include <SD.h>
+#include <utility/ExFat.h>
+
+const int chipSelect = 4;
+
+// bytes to reserve for the log file
+const uint32_t logSize = 10UL * 1024 * 1024;
+
+Sd2Card card;
+ExFatVolume volume;
+ExFatFile root;
+ExFatFile logFile;
+
+void setup() {
+  // Open serial communications and wait for port to open:
+  Serial.begin(9600);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+
+  Serial.print("Initializing exFAT volume...");
+  if (!card.init(SPI_HALF_SPEED, chipSelect) || !volume.init(&card) ||
+      !root.openRoot(&volume)) {
+    Serial.println("failed, is the card formatted exFAT?");
+    while (1);
+  }
+  Serial.println("done.");
+
+  if (!logFile.open(&root, "analog log.csv", O_CREAT | O_WRITE | O_TRUNC) ||
+      !logFile.preAllocate(logSize)) {
+    Serial.println("error opening log file");
+    while (1);
+  }
+  Serial.print("contiguous: ");
+  Serial.println(logFile.isContiguous() ? "yes" : "no");
+}
+
+void loop() {
+  logFile.print(millis());
+  logFile.print(',');
+  logFile.println(analogRead(A0));
+
+  // save the entry set once a second, stop when the reserve is full
+  static uint32_t lastSync = 0;
+  if (millis() - lastSync >= 1000) {
+    lastSync = millis();
+    logFile.sync();
+    if (logFile.fileSize() + 32 > logSize) {
+      logFile.truncate(logFile.fileSize());
+      logFile.close();
+      Serial.println("log full");
+      while (1);
+    }
+  }
+}
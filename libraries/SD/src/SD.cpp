@@ -613,7 +613,8 @@ namespace SDLib {
       //Serial.print("try to open file ");
       //Serial.println(name);
 
-      if (f.open(_file, name, mode)) {
+      // open by index, the entry just read, instead of searching by name
+      if (f.open(_file, _file->curPosition() / 32 - 1, mode)) {
         //Serial.println("OK!");
         return File(f, name);
       } else {
@@ -632,6 +633,16 @@ namespace SDLib {
     }
   }
 
+  // walk a directory without opening each entry
+  SdDirIterator File::dirIterator(void) {
+    return SdDirIterator(isDirectory() ? _file : NULL);
+  }
+
+  // delete the oldest files in a directory
+  int File::removeOldest(uint16_t count) {
+    return isDirectory() ? _file->removeOldest(count) : -1;
+  }
+
   SDClass SD;
 
 };
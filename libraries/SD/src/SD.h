@@ -51,6 +51,8 @@ namespace SDLib {
       boolean isDirectory(void);
       File openNextFile(uint8_t mode = O_RDONLY);
       void rewindDirectory(void);
+      SdDirIterator dirIterator(void);
+      int removeOldest(uint16_t count);
 
       using Print::write;
   };
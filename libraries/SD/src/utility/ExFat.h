@@ -0,0 +1,273 @@
+/* Arduino SdFat Library
+   Copyright (C) 2009 by William Greiman
+
+   This file is part of the Arduino SdFat Library
+
+   This Library is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the Arduino SdFat Library.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+#ifndef ExFat_h
+#define ExFat_h
+/**
+   \file
+   ExFatFile and ExFatVolume classes
+*/
+#include "SdFat.h"
+//------------------------------------------------------------------------------
+/**
+   Runs of consecutive clusters ExFatVolume::freeChain() collects from a
+   fragmented chain before clearing them in the allocation bitmap.  Each
+   batch costs one bitmap block write per bitmap block it touches instead
+   of one per cluster, for eight bytes of stack per run.
+*/
+#ifndef EXFAT_FREE_CHAIN_RUNS
+  #define EXFAT_FREE_CHAIN_RUNS 8
+#endif  // EXFAT_FREE_CHAIN_RUNS
+//------------------------------------------------------------------------------
+// forward declaration since ExFatVolume is used in ExFatFile
+class ExFatVolume;
+//==============================================================================
+// ExFatFile class
+/**
+   \class ExFatFile
+   \brief Access files and directories on exFAT volumes.
+
+   ExFatFile uses the same block cache and Sd2Card as SdFile so FAT and
+   exFAT files should not be open on different cards at the same time.
+
+   Names are limited to printable ASCII.  A file written sequentially stays
+   contiguous and is marked NoFatChain so reads, writes and seeks never touch
+   the FAT.  The FAT chain is only written if an allocation is not contiguous.
+*/
+class ExFatFile : public Print {
+  public:
+    /** Create an instance of ExFatFile. */
+    ExFatFile(void) : type_(FAT_FILE_TYPE_CLOSED) {}
+    uint8_t close(void);
+    uint8_t contiguousRange(uint32_t* bgnBlock, uint32_t* endBlock);
+    /** \return The current cluster number for a file or directory. */
+    uint32_t curCluster(void) const {
+      return curCluster_;
+    }
+    /** \return The current position for a file or directory. */
+    uint32_t curPosition(void) const {
+      return curPosition_;
+    }
+    /** \return Number of bytes allocated to the file, at least fileSize(). */
+    uint32_t dataLength(void) const {
+      return dataLength_;
+    }
+    /** \return The number of bytes of valid data in a file or directory. */
+    uint32_t fileSize(void) const {
+      return fileSize_;
+    }
+    /** \return The first cluster number for a file or directory. */
+    uint32_t firstCluster(void) const {
+      return firstCluster_;
+    }
+    uint8_t getName(char* name, uint16_t size);
+    /** \return True if the file's clusters are contiguous and the FAT
+        chain is not used. */
+    uint8_t isContiguous(void) const {
+      return (streamFlags_ & EXFAT_FLAG_NO_FAT_CHAIN) != 0;
+    }
+    /** \return True if this is an ExFatFile for a directory else false. */
+    uint8_t isDir(void) const {
+      return type_ >= FAT_FILE_TYPE_MIN_DIR;
+    }
+    /** \return True if this is an ExFatFile for a file else false. */
+    uint8_t isFile(void) const {
+      return type_ == FAT_FILE_TYPE_NORMAL;
+    }
+    /** \return True if this is an ExFatFile for an open file/directory. */
+    uint8_t isOpen(void) const {
+      return type_ != FAT_FILE_TYPE_CLOSED;
+    }
+    /** \return True if this is an ExFatFile for the root directory. */
+    uint8_t isRoot(void) const {
+      return type_ == FAT_FILE_TYPE_ROOT32;
+    }
+    /** \return True if this is an ExFatFile for a subdirectory else false. */
+    uint8_t isSubDir(void) const {
+      return type_ == FAT_FILE_TYPE_SUBDIR;
+    }
+    uint8_t makeDir(ExFatFile* dir, const char* dirName);
+    uint8_t open(ExFatFile* dirFile, const char* fileName, uint8_t oflag);
+    uint8_t openNext(ExFatFile* dirFile, uint8_t oflag = O_READ);
+    uint8_t openRoot(ExFatVolume* vol);
+    uint8_t preAllocate(uint32_t length);
+    /**
+       Read the next byte from a file.
+
+       \return For success read returns the next byte in the file as an int.
+       If an error occurs or end of file is reached -1 is returned.
+    */
+    int16_t read(void) {
+      uint8_t b;
+      return read(&b, 1) == 1 ? b : -1;
+    }
+    int16_t read(void* buf, uint16_t nbyte);
+    uint8_t remove(void);
+    /** Set the file's current position to zero. */
+    void rewind(void) {
+      curPosition_ = curCluster_ = 0;
+    }
+    uint8_t rmDir(void);
+    /** Set the files position to current position + \a pos. See seekSet(). */
+    uint8_t seekCur(uint32_t pos) {
+      return seekSet(curPosition_ + pos);
+    }
+    /** Set the files current position to end of file. See seekSet(). */
+    uint8_t seekEnd(void) {
+      return seekSet(fileSize_);
+    }
+    uint8_t seekSet(uint32_t pos);
+    uint8_t sync(void);
+    uint8_t truncate(uint32_t length);
+    /** \return ExFatVolume that contains this file. */
+    ExFatVolume* volume(void) const {
+      return vol_;
+    }
+    size_t write(uint8_t b);
+    size_t write(const void* buf, uint16_t nbyte);
+    size_t write(const char* str);
+
+  private:
+    // ExFatVolume reads the root directory during init
+    friend class ExFatVolume;
+
+    // bits defined in flags_ above F_OFLAG
+    static uint8_t const F_OFLAG = (O_ACCMODE | O_APPEND | O_SYNC);
+    // sync of directory entry set required
+    static uint8_t const F_FILE_DIR_DIRTY = 0X80;
+
+    // private data
+    uint8_t   flags_;         // O_ flags and F_FILE_DIR_DIRTY
+    uint8_t   type_;          // FAT_FILE_TYPE_ values, ROOT32 for the root
+    uint8_t   streamFlags_;   // EXFAT_FLAG_ bits from the stream entry
+    uint8_t   setCount_;      // secondary entries in the entry set
+    uint16_t  attributes_;    // EXFAT_ATTRIB_ bits from the file entry
+    uint32_t  curCluster_;    // cluster for current file position
+    uint32_t  curPosition_;   // current file position in bytes from beginning
+    uint32_t  dataLength_;    // bytes allocated, DataLength in the stream entry
+    uint32_t  dirBlock_;      // block that contains the file entry
+    uint32_t  dirCluster_;    // cluster that contains dirBlock_
+    uint8_t   dirIndex_;      // index of file entry in dirBlock_, 0 - 0XF
+    uint8_t   dirFlags_;      // stream flags of the parent directory
+    uint32_t  fileSize_;      // ValidDataLength in the stream entry
+    uint32_t  firstCluster_;  // first cluster of file
+    ExFatVolume* vol_;        // volume where file is located
+
+    // private functions
+    uint8_t addCluster(void);
+    uint8_t addDirCluster(void);
+    uint8_t advanceCluster(void);
+    uint8_t nextSetEntry(uint32_t* block, uint8_t* index, uint32_t* cluster);
+    uint8_t openCachedSet(ExFatFile* dirFile, uint8_t oflag);
+    exfat_dir_t* readDirCache(void);
+    uint8_t setStream(const exfat_dir_t* p);
+    uint8_t writeEntrySet(const char* name, uint8_t nameLength);
+};
+//==============================================================================
+// ExFatVolume class
+/**
+   \class ExFatVolume
+   \brief Access exFAT volumes on SD cards.
+
+   The allocation bitmap is the only record of free space so allocation
+   scans the bitmap and never reads the FAT.
+*/
+class ExFatVolume {
+  public:
+    /** Create an instance of ExFatVolume */
+    ExFatVolume(void) : allocSearchStart_(EXFAT_FIRST_CLUSTER),
+      clusterCount_(0) {}
+    /**
+       Initialize an exFAT volume.  Try partition one first then try super
+       floppy format.
+
+       \param[in] dev The Sd2Card where the volume is located.
+
+       \return The value one, true, is returned for success and
+       the value zero, false, is returned for failure.  Reasons for
+       failure include not finding a valid partition, not finding a valid
+       exFAT file system or an I/O error.
+    */
+    uint8_t init(Sd2Card* dev) {
+      return init(dev, 1) ? true : init(dev, 0);
+    }
+    uint8_t init(Sd2Card* dev, uint8_t part);
+
+    // inline functions that return volume info
+    /** \return The volume's cluster size in blocks. */
+    uint32_t blocksPerCluster(void) const {
+      return 1UL << clusterSizeShift_;
+    }
+    /** \return The total number of clusters in the volume. */
+    uint32_t clusterCount(void) const {
+      return clusterCount_;
+    }
+    /** \return The shift count required to multiply by blocksPerCluster. */
+    uint8_t clusterSizeShift(void) const {
+      return clusterSizeShift_;
+    }
+    /** \return The logical block number for the start of the cluster heap. */
+    uint32_t dataStartBlock(void) const {
+      return dataStartBlock_;
+    }
+    /** \return The logical block number for the start of the active FAT. */
+    uint32_t fatStartBlock(void) const {
+      return fatStartBlock_;
+    }
+    uint8_t freeClusterCount(uint32_t* count);
+    /** \return The first cluster of the root directory. */
+    uint32_t rootDirStart(void) const {
+      return rootDirStart_;
+    }
+
+  private:
+    // Allow ExFatFile access to ExFatVolume private data.
+    friend class ExFatFile;
+
+    uint32_t allocSearchStart_;   // start cluster for alloc search
+    uint32_t bitmapStartBlock_;   // first block of the allocation bitmap
+    uint32_t clusterCount_;       // clusters in the cluster heap
+    uint8_t clusterSizeShift_;    // shift to convert cluster count to block count
+    uint32_t dataStartBlock_;     // first block of the cluster heap
+    uint32_t fatStartBlock_;      // start block for the active FAT
+    uint32_t rootDirStart_;       // first cluster of the root directory
+    //----------------------------------------------------------------------------
+    uint8_t allocContiguous(uint32_t count, uint32_t* cluster);
+    uint8_t bitmapClearRuns(uint32_t* first, uint32_t* length, uint8_t n);
+    uint8_t bitmapSet(uint32_t cluster, uint32_t count, uint8_t value);
+    uint32_t blockOfCluster(uint32_t position) const {
+      return (position >> 9) & ((1UL << clusterSizeShift_) - 1);
+    }
+    uint8_t chainSize(uint32_t cluster, uint32_t* size);
+    uint32_t clusterStartBlock(uint32_t cluster) const {
+      return dataStartBlock_ + ((cluster - 2) << clusterSizeShift_);
+    }
+    // number of clusters needed for length bytes
+    uint32_t clustersForLength(uint32_t length) const {
+      return length ? ((length - 1) >> (clusterSizeShift_ + 9)) + 1 : 0;
+    }
+    uint8_t fatGet(uint32_t cluster, uint32_t* value);
+    uint8_t fatPut(uint32_t cluster, uint32_t value);
+    uint8_t freeChain(uint32_t cluster, uint32_t count, uint8_t contiguous);
+    uint8_t isValidCluster(uint32_t cluster) const {
+      return cluster >= EXFAT_FIRST_CLUSTER &&
+             cluster < clusterCount_ + EXFAT_FIRST_CLUSTER;
+    }
+};
+#endif  // ExFat_h
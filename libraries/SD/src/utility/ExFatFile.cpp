@@ -0,0 +1,1082 @@
+/* Arduino SdFat Library
+   Copyright (C) 2009 by William Greiman
+
+   This file is part of the Arduino SdFat Library
+
+   This Library is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the Arduino SdFat Library.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+#include "ExFat.h"
+#include <Arduino.h>
+//------------------------------------------------------------------------------
+// up-case an ASCII character, exFAT names are not case sensitive
+static uint16_t exfatUpcase(uint16_t c) {
+  return c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+}
+//------------------------------------------------------------------------------
+// return the length of a valid name or zero if the name is not valid
+static uint8_t exfatNameLength(const char* name) {
+  uint16_t n = 0;
+  for (; name[n]; n++) {
+    uint8_t c = name[n];
+    if (n >= EXFAT_NAME_MAX || c < 0X20 || c > 0X7E ||
+        strchr("\"*/:<>?\\|", c)) {
+      return 0;
+    }
+  }
+  return n;
+}
+//------------------------------------------------------------------------------
+// add a cluster to a file
+// the file stays NoFatChain while each new cluster follows the last one
+uint8_t ExFatFile::addCluster(void) {
+  uint32_t next = curCluster_ ? curCluster_ + 1 : 0;
+  if (!vol_->allocContiguous(1, &next)) {
+    return false;
+  }
+  if (curCluster_ == 0) {
+    // first cluster of file
+    firstCluster_ = next;
+    streamFlags_ |= EXFAT_FLAG_ALLOCATION_POSSIBLE | EXFAT_FLAG_NO_FAT_CHAIN;
+  } else if (next != (curCluster_ + 1) || !isContiguous()) {
+    if (isContiguous()) {
+      // no longer contiguous, write the FAT chain for existing clusters
+      for (uint32_t c = firstCluster_; c != curCluster_; c++) {
+        if (!vol_->fatPut(c, c + 1)) {
+          return false;
+        }
+      }
+      streamFlags_ &= ~EXFAT_FLAG_NO_FAT_CHAIN;
+    }
+    if (!vol_->fatPut(curCluster_, next)) {
+      return false;
+    }
+  }
+  if (!isContiguous() && !vol_->fatPut(next, EXFAT_EOC)) {
+    return false;
+  }
+  curCluster_ = next;
+  flags_ |= F_FILE_DIR_DIRTY;
+  return true;
+}
+//------------------------------------------------------------------------------
+// Add a cluster to a directory file and zero the cluster.
+// return with first block of cluster in the cache
+uint8_t ExFatFile::addDirCluster(void) {
+  if (!addCluster()) {
+    return false;
+  }
+
+  // zero data in cluster insure first cluster is in cache
+  uint32_t block = vol_->clusterStartBlock(curCluster_);
+  for (uint32_t i = vol_->blocksPerCluster(); i != 0; i--) {
+    if (!SdVolume::cacheZeroBlock(block + i - 1)) {
+      return false;
+    }
+    SdVolume::cacheSetDirDirty();
+  }
+  // Increase directory size by cluster size, valid length is always the same
+  fileSize_ += 512UL << vol_->clusterSizeShift_;
+  dataLength_ = fileSize_;
+  return true;
+}
+//------------------------------------------------------------------------------
+// set curCluster_ for curPosition_ at the start of a cluster
+uint8_t ExFatFile::advanceCluster(void) {
+  if (curPosition_ == 0) {
+    curCluster_ = firstCluster_;
+  } else if (isContiguous()) {
+    curCluster_++;
+  } else {
+    uint32_t next;
+    if (!vol_->fatGet(curCluster_, &next) || !vol_->isValidCluster(next)) {
+      return false;
+    }
+    curCluster_ = next;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+    Close a file and force cached data and directory information
+    to be written to the storage device.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include no file is open or an I/O error.
+*/
+uint8_t ExFatFile::close(void) {
+  if (!sync()) {
+    return false;
+  }
+  type_ = FAT_FILE_TYPE_CLOSED;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+   Return the raw block range of a contiguous file.
+
+   \param[out] bgnBlock the first block address for the file.
+   \param[out] endBlock the last block address allocated to the file.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include file is not contiguous or has no clusters.
+*/
+uint8_t ExFatFile::contiguousRange(uint32_t* bgnBlock, uint32_t* endBlock) {
+  if (firstCluster_ == 0 || !isContiguous()) {
+    return false;
+  }
+  uint32_t n = vol_->clustersForLength(dataLength_);
+  *bgnBlock = vol_->clusterStartBlock(firstCluster_);
+  *endBlock = *bgnBlock + (n << vol_->clusterSizeShift_) - 1;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+   Get the name of a file or directory.
+
+   Characters outside printable ASCII are returned as '?'.
+
+   \param[out] name Location for the zero terminated name.
+   \param[in] size Size of \a name in bytes.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include no file is open, \a name is too small or
+   an I/O error.
+*/
+uint8_t ExFatFile::getName(char* name, uint16_t size) {
+  if (!isOpen() || size < 2) {
+    return false;
+  }
+  if (isRoot()) {
+    name[0] = '/';
+    name[1] = 0;
+    return true;
+  }
+  uint32_t block = dirBlock_;
+  uint32_t cluster = dirCluster_;
+  uint8_t index = dirIndex_;
+  uint8_t nameLength = 0;
+  uint16_t n = 0;
+  for (uint8_t i = 1; i <= setCount_; i++) {
+    if (!nextSetEntry(&block, &index, &cluster) ||
+        !SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_READ)) {
+      return false;
+    }
+    exfat_dir_t* p = SdVolume::cacheBuffer_.exfatDir + index;
+    if (p->type == EXFAT_TYPE_STREAM) {
+      nameLength = p->stream.nameLength;
+      continue;
+    }
+    if (p->type != EXFAT_TYPE_NAME) {
+      continue;
+    }
+    for (uint8_t k = 0; k < EXFAT_NAME_CHARS && n < nameLength; k++) {
+      if ((n + 1) >= size) {
+        name[n] = 0;
+        return false;
+      }
+      uint16_t c = p->name.name[k];
+      name[n++] = c < 0X7F ? c : '?';
+    }
+  }
+  name[n] = 0;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+   Make a new directory.
+
+   \param[in] dir An open ExFatFile instance for the directory that will
+   contain the new directory.
+
+   \param[in] dirName A valid name for the new directory.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include this ExFatFile is already open, \a dir is not
+   a directory, \a dirName is invalid or already exists in \a dir.
+*/
+uint8_t ExFatFile::makeDir(ExFatFile* dir, const char* dirName) {
+  if (!open(dir, dirName, O_CREAT | O_EXCL | O_RDWR)) {
+    return false;
+  }
+  // convert the empty file to a directory with one zero cluster
+  attributes_ = EXFAT_ATTRIB_DIRECTORY;
+  type_ = FAT_FILE_TYPE_SUBDIR;
+  flags_ = O_READ;
+  if (!addDirCluster()) {
+    return false;
+  }
+  rewind();
+  return sync();
+}
+//------------------------------------------------------------------------------
+// advance to the next entry of this file's entry set
+uint8_t ExFatFile::nextSetEntry(uint32_t* block, uint8_t* index,
+                                uint32_t* cluster) {
+  if (++*index < 16) {
+    return true;
+  }
+  *index = 0;
+  (*block)++;
+  if ((*block - vol_->dataStartBlock_) & (vol_->blocksPerCluster() - 1)) {
+    return true;
+  }
+  // next cluster of the parent directory
+  if (dirFlags_ & EXFAT_FLAG_NO_FAT_CHAIN) {
+    (*cluster)++;
+  } else if (!vol_->fatGet(*cluster, cluster) ||
+             !vol_->isValidCluster(*cluster)) {
+    return false;
+  }
+  *block = vol_->clusterStartBlock(*cluster);
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+   Open a file or directory by name.
+
+   \param[in] dirFile An open ExFatFile instance for the directory containing
+   the file to be opened.
+
+   \param[in] fileName A valid name for a file to be opened.
+
+   \param[in] oflag Values for \a oflag are constructed by a bitwise-inclusive
+   OR of the same flags used by SdFile::open(), O_READ, O_WRITE, O_RDWR,
+   O_APPEND, O_CREAT, O_EXCL, O_SYNC and O_TRUNC.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include this ExFatFile is already open, \a dirFile is
+   not a directory, \a fileName is invalid, the file does not exist and
+   O_CREAT is not set, the file is larger than 4 GB, or the file is a
+   directory or read-only and O_WRITE or O_TRUNC is set.
+*/
+uint8_t ExFatFile::open(ExFatFile* dirFile, const char* fileName,
+                        uint8_t oflag) {
+  // error if already open
+  if (isOpen() || !dirFile->isDir()) {
+    return false;
+  }
+  uint8_t nameLength = exfatNameLength(fileName);
+  if (nameLength == 0) {
+    return false;
+  }
+  uint16_t nameHash = 0;
+  for (uint8_t i = 0; i < nameLength; i++) {
+    nameHash = exfatNameHash(nameHash, exfatUpcase(fileName[i]));
+  }
+  // file, stream and name entries
+  uint8_t freeNeed = 2 + (nameLength + EXFAT_NAME_CHARS - 1) / EXFAT_NAME_CHARS;
+
+  vol_ = dirFile->vol_;
+  dirFile->rewind();
+
+  // first free run long enough for a new entry set
+  uint8_t freeCount = 0;
+  uint32_t freeBlock = 0;
+  uint32_t freeCluster = 0;
+  uint8_t freeIndex = 0;
+
+  // state of the entry set being compared
+  uint8_t inSet = 0;
+  uint8_t match = false;
+  uint8_t nameOffset = 0;
+  uint8_t tooBig = false;
+
+  // search for file
+  while (dirFile->curPosition_ < dirFile->fileSize_) {
+    uint8_t index = 0XF & (dirFile->curPosition_ >> 5);
+    exfat_dir_t* p = dirFile->readDirCache();
+    if (p == NULL) {
+      return false;
+    }
+    if (!(p->type & EXFAT_TYPE_IN_USE)) {
+      inSet = 0;
+      if (freeCount < freeNeed && freeCount++ == 0) {
+        freeBlock = SdVolume::cacheBlockNumber_;
+        freeIndex = index;
+        freeCluster = dirFile->curCluster_;
+      }
+      // done if no entries follow
+      if (p->type == EXFAT_TYPE_END && freeCount == freeNeed) {
+        break;
+      }
+      continue;
+    }
+    if (freeCount < freeNeed) {
+      freeCount = 0;
+    }
+    if (p->type == EXFAT_TYPE_FILE) {
+      // remember location of a possible match
+      dirBlock_ = SdVolume::cacheBlockNumber_;
+      dirIndex_ = index;
+      dirCluster_ = dirFile->curCluster_;
+      setCount_ = p->file.secondaryCount;
+      attributes_ = p->file.attributes;
+      inSet = setCount_;
+      match = false;
+      continue;
+    }
+    if (inSet == 0) {
+      continue;
+    }
+    inSet--;
+    if (p->type == EXFAT_TYPE_STREAM) {
+      tooBig = !setStream(p);
+      match = p->stream.nameLength == nameLength &&
+              p->stream.nameHash == nameHash;
+      nameOffset = 0;
+    } else if (p->type == EXFAT_TYPE_NAME && match) {
+      for (uint8_t i = 0; i < EXFAT_NAME_CHARS && nameOffset < nameLength;
+           i++, nameOffset++) {
+        if (exfatUpcase(p->name.name[i]) != exfatUpcase(fileName[nameOffset])) {
+          match = false;
+          break;
+        }
+      }
+    }
+    if (inSet == 0 && match && nameOffset == nameLength) {
+      // don't open existing file if O_CREAT and O_EXCL
+      if (tooBig || (oflag & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL)) {
+        return false;
+      }
+      return openCachedSet(dirFile, oflag);
+    }
+  }
+  // only create file if O_CREAT and O_WRITE
+  if ((oflag & (O_CREAT | O_WRITE)) != (O_CREAT | O_WRITE)) {
+    return false;
+  }
+  if (freeCount < freeNeed) {
+    // a free run at the end of the directory continues in the new cluster
+    if (!dirFile->addDirCluster()) {
+      return false;
+    }
+    if (freeCount == 0) {
+      freeCluster = dirFile->curCluster_;
+      freeBlock = vol_->clusterStartBlock(freeCluster);
+      freeIndex = 0;
+    }
+    dirFile->rewind();
+    if (!dirFile->sync()) {
+      return false;
+    }
+  }
+  dirBlock_ = freeBlock;
+  dirIndex_ = freeIndex;
+  dirCluster_ = freeCluster;
+  dirFlags_ = dirFile->streamFlags_;
+  // initialize as empty file
+  setCount_ = freeNeed - 1;
+  attributes_ = EXFAT_ATTRIB_ARCHIVE;
+  streamFlags_ = EXFAT_FLAG_ALLOCATION_POSSIBLE;
+  firstCluster_ = 0;
+  fileSize_ = 0;
+  dataLength_ = 0;
+  if (!writeEntrySet(fileName, nameLength)) {
+    return false;
+  }
+  return openCachedSet(dirFile, oflag);
+}
+//------------------------------------------------------------------------------
+// open the entry set found by open() or openNext()
+uint8_t ExFatFile::openCachedSet(ExFatFile* dirFile, uint8_t oflag) {
+  // write or truncate is an error for a directory or read-only file
+  if (attributes_ & (EXFAT_ATTRIB_READ_ONLY | EXFAT_ATTRIB_DIRECTORY)) {
+    if (oflag & (O_WRITE | O_TRUNC)) {
+      return false;
+    }
+  }
+  // needed to follow the entry set in the parent directory
+  dirFlags_ = dirFile->streamFlags_;
+
+  if (attributes_ & EXFAT_ATTRIB_DIRECTORY) {
+    // directories have no data past valid length
+    fileSize_ = dataLength_;
+    type_ = FAT_FILE_TYPE_SUBDIR;
+  } else {
+    type_ = FAT_FILE_TYPE_NORMAL;
+  }
+  // save open flags for read/write
+  flags_ = oflag & F_OFLAG;
+
+  // set to start of file
+  curCluster_ = 0;
+  curPosition_ = 0;
+
+  // truncate file to zero length if requested
+  if (oflag & O_TRUNC) {
+    return truncate(0);
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+   Open the next file or subdirectory in a directory.
+
+   \param[in] dirFile An open ExFatFile instance for the directory, positioned
+   by a previous openNext() or rewind().
+
+   \param[in] oflag Open flags, see open().
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned at the end of the directory or
+   for failure.
+*/
+uint8_t ExFatFile::openNext(ExFatFile* dirFile, uint8_t oflag) {
+  if (isOpen() || !dirFile->isDir()) {
+    return false;
+  }
+  vol_ = dirFile->vol_;
+  uint8_t inSet = 0;
+  uint8_t valid = false;
+  while (dirFile->curPosition_ < dirFile->fileSize_) {
+    uint8_t index = 0XF & (dirFile->curPosition_ >> 5);
+    exfat_dir_t* p = dirFile->readDirCache();
+    if (p == NULL || p->type == EXFAT_TYPE_END) {
+      return false;
+    }
+    if (p->type == EXFAT_TYPE_FILE) {
+      dirBlock_ = SdVolume::cacheBlockNumber_;
+      dirIndex_ = index;
+      dirCluster_ = dirFile->curCluster_;
+      setCount_ = p->file.secondaryCount;
+      attributes_ = p->file.attributes;
+      inSet = setCount_;
+      valid = false;
+      continue;
+    }
+    if (inSet == 0 || !(p->type & EXFAT_TYPE_IN_USE)) {
+      inSet = 0;
+      continue;
+    }
+    if (p->type == EXFAT_TYPE_STREAM) {
+      valid = setStream(p);
+    }
+    if (--inSet == 0 && valid) {
+      return openCachedSet(dirFile, oflag);
+    }
+  }
+  return false;
+}
+//------------------------------------------------------------------------------
+/**
+   Open the root directory of an exFAT volume.
+
+   \param[in] vol The exFAT volume containing the root directory.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t ExFatFile::openRoot(ExFatVolume* vol) {
+  // error if file is already open
+  if (isOpen()) {
+    return false;
+  }
+  vol_ = vol;
+  firstCluster_ = vol->rootDirStart();
+  if (!vol->chainSize(firstCluster_, &fileSize_)) {
+    return false;
+  }
+  // the root directory always uses the FAT chain
+  dataLength_ = fileSize_;
+  streamFlags_ = EXFAT_FLAG_ALLOCATION_POSSIBLE;
+  attributes_ = EXFAT_ATTRIB_DIRECTORY;
+  type_ = FAT_FILE_TYPE_ROOT32;
+  flags_ = O_READ;
+  curCluster_ = 0;
+  curPosition_ = 0;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+   Allocate contiguous clusters for an empty file.
+
+   The file size is not changed.  Writes up to \a length bytes will not
+   allocate clusters or write the FAT.  A raw writer may also use the block
+   range from contiguousRange().
+
+   \param[in] length Number of bytes to allocate.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include the file is not open for write, already has
+   clusters, or there is no free run of clusters long enough.
+*/
+uint8_t ExFatFile::preAllocate(uint32_t length) {
+  if (!isFile() || !(flags_ & O_WRITE) || firstCluster_ || length == 0) {
+    return false;
+  }
+  uint32_t cluster = 0;
+  if (!vol_->allocContiguous(vol_->clustersForLength(length), &cluster)) {
+    return false;
+  }
+  firstCluster_ = cluster;
+  streamFlags_ = EXFAT_FLAG_ALLOCATION_POSSIBLE | EXFAT_FLAG_NO_FAT_CHAIN;
+  dataLength_ = length;
+  flags_ |= F_FILE_DIR_DIRTY;
+  return sync();
+}
+//------------------------------------------------------------------------------
+/**
+   Read data from a file starting at the current position.
+
+   Contiguous files are read without accessing the FAT.
+
+   \param[out] buf Pointer to the location that will receive the data.
+
+   \param[in] nbyte Maximum number of bytes to read.
+
+   \return For success read() returns the number of bytes read.
+   A value less than \a nbyte, including zero, will be returned
+   if end of file is reached.
+   If an error occurs, read() returns -1.
+*/
+int16_t ExFatFile::read(void* buf, uint16_t nbyte) {
+  uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
+
+  // error if not open or write only
+  if (!isOpen() || !(flags_ & O_READ)) {
+    return -1;
+  }
+
+  // max bytes left in file
+  if (nbyte > (fileSize_ - curPosition_)) {
+    nbyte = fileSize_ - curPosition_;
+  }
+
+  // amount left to read
+  uint16_t toRead = nbyte;
+  while (toRead > 0) {
+    uint16_t offset = curPosition_ & 0X1FF;  // offset in block
+    uint32_t blockOfCluster = vol_->blockOfCluster(curPosition_);
+    if (offset == 0 && blockOfCluster == 0) {
+      // start of new cluster
+      if (!advanceCluster()) {
+        return -1;
+      }
+    }
+    uint32_t block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
+    uint16_t n = toRead;
+
+    // amount to be read from current block
+    if (n > (512 - offset)) {
+      n = 512 - offset;
+    }
+
+    // no buffering needed if n == 512
+    if (n == 512 && block != SdVolume::cacheBlockNumber_) {
+      if (!SdVolume::sdCard_->readBlock(block, dst)) {
+        return -1;
+      }
+    } else {
+      // read block to cache and copy data to caller
+      if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_READ)) {
+        return -1;
+      }
+      memcpy(dst, SdVolume::cacheBuffer_.data + offset, n);
+    }
+    dst += n;
+    curPosition_ += n;
+    toRead -= n;
+  }
+  return nbyte;
+}
+//------------------------------------------------------------------------------
+// Read next directory entry into the cache
+// Assumes file is correctly positioned
+exfat_dir_t* ExFatFile::readDirCache(void) {
+  // error if not directory
+  if (!isDir()) {
+    return NULL;
+  }
+
+  // index of entry in cache
+  uint8_t i = (curPosition_ >> 5) & 0XF;
+
+  // use read to locate and cache block
+  if (read() < 0) {
+    return NULL;
+  }
+
+  // advance to next entry
+  curPosition_ += 31;
+
+  // return pointer to entry
+  return (SdVolume::cacheBuffer_.exfatDir + i);
+}
+//------------------------------------------------------------------------------
+/**
+   Remove a file.
+
+   The entry set is marked unused and the file's clusters are freed in the
+   allocation bitmap.  The FAT is not read for contiguous files.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include the file is read-only or not open for write,
+   is a directory or an I/O error occurred.
+*/
+uint8_t ExFatFile::remove(void) {
+  if (!isFile() || !(flags_ & O_WRITE)) {
+    return false;
+  }
+  if (firstCluster_ && !vol_->freeChain(firstCluster_,
+                                        vol_->clustersForLength(dataLength_),
+                                        isContiguous())) {
+    return false;
+  }
+  uint32_t block = dirBlock_;
+  uint32_t cluster = dirCluster_;
+  uint8_t index = dirIndex_;
+  for (uint8_t i = 0; i <= setCount_; i++) {
+    if ((i && !nextSetEntry(&block, &index, &cluster)) ||
+        !SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) {
+      return false;
+    }
+    SdVolume::cacheSetDirDirty();
+    SdVolume::cacheBuffer_.exfatDir[index].type &= ~EXFAT_TYPE_IN_USE;
+  }
+  type_ = FAT_FILE_TYPE_CLOSED;
+
+  // write entry set and bitmap to SD
+  return SdVolume::cacheFlush();
+}
+//------------------------------------------------------------------------------
+/**
+   Remove a directory file.
+
+   The directory file will be removed only if it is empty and is not the
+   root directory.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t ExFatFile::rmDir(void) {
+  // must be open subdirectory
+  if (!isSubDir()) {
+    return false;
+  }
+  rewind();
+
+  // make sure directory is empty
+  while (curPosition_ < fileSize_) {
+    exfat_dir_t* p = readDirCache();
+    if (p == NULL) {
+      return false;
+    }
+    if (p->type == EXFAT_TYPE_END) {
+      break;
+    }
+    if (p->type == EXFAT_TYPE_FILE) {
+      return false;
+    }
+  }
+  // convert empty directory to normal file for remove
+  type_ = FAT_FILE_TYPE_NORMAL;
+  flags_ |= O_WRITE;
+  return remove();
+}
+//------------------------------------------------------------------------------
+/**
+   Sets a file's position.
+
+   Contiguous files seek in constant time without reading the FAT.
+
+   \param[in] pos The new position in bytes from the beginning of the file.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t ExFatFile::seekSet(uint32_t pos) {
+  // error if file not open or seek past end of file
+  if (!isOpen() || pos > fileSize_) {
+    return false;
+  }
+  if (pos == 0) {
+    // set position to start of file
+    curCluster_ = 0;
+    curPosition_ = 0;
+    return true;
+  }
+  uint8_t shift = vol_->clusterSizeShift_ + 9;
+  uint32_t nNew = (pos - 1) >> shift;
+  if (isContiguous()) {
+    curCluster_ = firstCluster_ + nNew;
+    curPosition_ = pos;
+    return true;
+  }
+  // calculate cluster index for cur position
+  uint32_t nCur = (curPosition_ - 1) >> shift;
+
+  if (nNew < nCur || curPosition_ == 0) {
+    // must follow chain from first cluster
+    curCluster_ = firstCluster_;
+  } else {
+    // advance from curPosition
+    nNew -= nCur;
+  }
+  while (nNew--) {
+    if (!vol_->fatGet(curCluster_, &curCluster_)) {
+      return false;
+    }
+  }
+  curPosition_ = pos;
+  return true;
+}
+//------------------------------------------------------------------------------
+// copy stream entry fields, false if the file is too large for 32-bit sizes
+uint8_t ExFatFile::setStream(const exfat_dir_t* p) {
+  if (p->stream.dataLength > 0XFFFFFFFF) {
+    return false;
+  }
+  streamFlags_ = p->stream.flags;
+  firstCluster_ = p->stream.firstCluster;
+  fileSize_ = p->stream.validDataLength;
+  dataLength_ = p->stream.dataLength;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+   The sync() call causes all modified data and directory fields
+   to be written to the storage device.
+
+   The stream entry and the entry set checksum are updated.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include a call to sync() before a file has been
+   opened or an I/O error.
+*/
+uint8_t ExFatFile::sync(void) {
+  // only allow open files and directories
+  if (!isOpen()) {
+    return false;
+  }
+  // the root directory has no entry set
+  if ((flags_ & F_FILE_DIR_DIRTY) && !isRoot()) {
+    uint32_t block = dirBlock_;
+    uint32_t cluster = dirCluster_;
+    uint8_t index = dirIndex_;
+    uint16_t checksum = 0;
+    for (uint8_t i = 0; i <= setCount_; i++) {
+      if (i && !nextSetEntry(&block, &index, &cluster)) {
+        return false;
+      }
+      uint8_t action = i < 2 ? SdVolume::CACHE_FOR_WRITE :
+                       SdVolume::CACHE_FOR_READ;
+      if (!SdVolume::cacheRawBlock(block, action)) {
+        return false;
+      }
+      exfat_dir_t* p = SdVolume::cacheBuffer_.exfatDir + index;
+      if (i == 0) {
+        if (p->type != EXFAT_TYPE_FILE) {
+          return false;
+        }
+        SdVolume::cacheSetDirDirty();
+        p->file.attributes = attributes_;
+        // set modify time if user supplied a callback date/time function
+        if (SdFile::dateTime_) {
+          uint16_t date;
+          uint16_t time;
+          SdFile::dateTime_(&date, &time);
+          p->file.modifyTimestamp = (uint32_t)date << 16 | time;
+          p->file.accessTimestamp = p->file.modifyTimestamp;
+          p->file.modify10ms = 0;
+        }
+      } else if (i == 1) {
+        if (p->type != EXFAT_TYPE_STREAM) {
+          return false;
+        }
+        SdVolume::cacheSetDirDirty();
+        p->stream.flags = streamFlags_;
+        p->stream.validDataLength = fileSize_;
+        p->stream.firstCluster = firstCluster_;
+        p->stream.dataLength = dataLength_;
+      }
+      checksum = exfatSetChecksum(checksum, p->data, i == 0);
+    }
+    // the file entry may have left the cache if the set spans blocks
+    if (!SdVolume::cacheRawBlock(dirBlock_, SdVolume::CACHE_FOR_WRITE)) {
+      return false;
+    }
+    SdVolume::cacheSetDirDirty();
+    SdVolume::cacheBuffer_.exfatDir[dirIndex_].file.setChecksum = checksum;
+  }
+  // clear directory dirty
+  flags_ &= ~F_FILE_DIR_DIRTY;
+
+  return SdVolume::cacheFlush();
+}
+//------------------------------------------------------------------------------
+/**
+   Truncate a file to a specified length.  The current file position
+   will be maintained if it is less than or equal to \a length otherwise
+   it will be set to end of file.  Clusters past \a length, including
+   preallocated clusters, are freed.
+
+   \param[in] length The desired length for the file.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include file is read only, file is a directory,
+   \a length is greater than the current file size or an I/O error occurs.
+*/
+uint8_t ExFatFile::truncate(uint32_t length) {
+  // error if not a normal file or read-only
+  if (!isFile() || !(flags_ & O_WRITE) || length > fileSize_) {
+    return false;
+  }
+  // remember position for seek after truncation
+  uint32_t newPos = curPosition_ > length ? length : curPosition_;
+
+  uint32_t keep = vol_->clustersForLength(length);
+  uint32_t have = vol_->clustersForLength(dataLength_);
+  if (keep == 0 && have) {
+    // free all clusters
+    if (!vol_->freeChain(firstCluster_, have, isContiguous())) {
+      return false;
+    }
+    firstCluster_ = 0;
+    streamFlags_ = EXFAT_FLAG_ALLOCATION_POSSIBLE;
+  } else if (keep < have) {
+    if (isContiguous()) {
+      if (!vol_->freeChain(firstCluster_ + keep, have - keep, true)) {
+        return false;
+      }
+    } else {
+      // find last cluster to keep
+      uint32_t last = firstCluster_;
+      for (uint32_t n = keep; n > 1; n--) {
+        if (!vol_->fatGet(last, &last)) {
+          return false;
+        }
+      }
+      uint32_t toFree;
+      if (!vol_->fatGet(last, &toFree) ||
+          !vol_->fatPut(last, EXFAT_EOC) ||
+          !vol_->freeChain(toFree, have - keep, false)) {
+        return false;
+      }
+    }
+  }
+  fileSize_ = length;
+  dataLength_ = length;
+
+  // need to update directory entry
+  flags_ |= F_FILE_DIR_DIRTY;
+  rewind();
+
+  if (!sync()) {
+    return false;
+  }
+
+  // set file to correct position
+  return seekSet(newPos);
+}
+//------------------------------------------------------------------------------
+// write a new entry set at dirBlock_, dirIndex_ from the file's fields
+uint8_t ExFatFile::writeEntrySet(const char* name, uint8_t nameLength) {
+  uint32_t block = dirBlock_;
+  uint32_t cluster = dirCluster_;
+  uint8_t index = dirIndex_;
+
+  // set timestamps
+  uint16_t date = FAT_DEFAULT_DATE;
+  uint16_t time = FAT_DEFAULT_TIME;
+  if (SdFile::dateTime_) {
+    // call user function
+    SdFile::dateTime_(&date, &time);
+  }
+  uint32_t timestamp = (uint32_t)date << 16 | time;
+
+  uint16_t checksum = 0;
+  for (uint8_t i = 0; i <= setCount_; i++) {
+    if ((i && !nextSetEntry(&block, &index, &cluster)) ||
+        !SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) {
+      return false;
+    }
+    SdVolume::cacheSetDirDirty();
+    exfat_dir_t* p = SdVolume::cacheBuffer_.exfatDir + index;
+    memset(p, 0, sizeof(exfat_dir_t));
+    if (i == 0) {
+      p->type = EXFAT_TYPE_FILE;
+      p->file.secondaryCount = setCount_;
+      p->file.attributes = attributes_;
+      p->file.createTimestamp = timestamp;
+      p->file.modifyTimestamp = timestamp;
+      p->file.accessTimestamp = timestamp;
+    } else if (i == 1) {
+      uint16_t nameHash = 0;
+      for (uint8_t k = 0; k < nameLength; k++) {
+        nameHash = exfatNameHash(nameHash, exfatUpcase(name[k]));
+      }
+      p->type = EXFAT_TYPE_STREAM;
+      p->stream.flags = streamFlags_;
+      p->stream.nameLength = nameLength;
+      p->stream.nameHash = nameHash;
+      p->stream.validDataLength = fileSize_;
+      p->stream.firstCluster = firstCluster_;
+      p->stream.dataLength = dataLength_;
+    } else {
+      p->type = EXFAT_TYPE_NAME;
+      uint16_t offset = (i - 2) * EXFAT_NAME_CHARS;
+      for (uint8_t k = 0; k < EXFAT_NAME_CHARS && offset < nameLength;
+           k++, offset++) {
+        p->name.name[k] = (uint8_t)name[offset];
+      }
+    }
+    checksum = exfatSetChecksum(checksum, p->data, i == 0);
+  }
+  if (!SdVolume::cacheRawBlock(dirBlock_, SdVolume::CACHE_FOR_WRITE)) {
+    return false;
+  }
+  SdVolume::cacheSetDirDirty();
+  SdVolume::cacheBuffer_.exfatDir[dirIndex_].file.setChecksum = checksum;
+
+  // force write of entry set to SD
+  return SdVolume::cacheFlush();
+}
+//------------------------------------------------------------------------------
+/**
+   Write data to an open file.
+
+   Sequential writes to a contiguous file never read or write the FAT.
+
+   \param[in] buf Pointer to the location of the data to be written.
+
+   \param[in] nbyte Number of bytes to write.
+
+   \return For success write() returns the number of bytes written, always
+   \a nbyte.  If an error occurs, write() returns 0.
+*/
+size_t ExFatFile::write(const void* buf, uint16_t nbyte) {
+  // convert void* to uint8_t*  -  must be before goto statements
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(buf);
+
+  // number of bytes left to write  -  must be before goto statements
+  uint16_t nToWrite = nbyte;
+
+  // error if not a normal file or is read-only
+  if (!isFile() || !(flags_ & O_WRITE)) {
+    goto writeErrorReturn;
+  }
+
+  // seek to end of file if append flag
+  if ((flags_ & O_APPEND) && curPosition_ != fileSize_) {
+    if (!seekEnd()) {
+      goto writeErrorReturn;
+    }
+  }
+
+  while (nToWrite > 0) {
+    uint32_t blockOfCluster = vol_->blockOfCluster(curPosition_);
+    uint16_t blockOffset = curPosition_ & 0X1FF;
+    if (blockOfCluster == 0 && blockOffset == 0) {
+      // start of new cluster, use allocated clusters first
+      uint32_t n = curPosition_ >> (vol_->clusterSizeShift_ + 9);
+      if (n < vol_->clustersForLength(dataLength_)) {
+        if (!advanceCluster()) {
+          goto writeErrorReturn;
+        }
+      } else if (!addCluster()) {
+        goto writeErrorReturn;
+      }
+    }
+    // max space in block
+    uint16_t n = 512 - blockOffset;
+
+    // lesser of space and amount to write
+    if (n > nToWrite) {
+      n = nToWrite;
+    }
+
+    // block for data write
+    uint32_t block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
+    if (n == 512) {
+      // full block - don't need to use cache
+      // invalidate cache if block is in cache
+      if (SdVolume::cacheBlockNumber_ == block) {
+        SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
+      }
+      if (!SdVolume::sdCard_->writeBlock(block, src)) {
+        goto writeErrorReturn;
+      }
+      SD_STATS_INC(dataBlocksWritten);
+      src += 512;
+    } else {
+      if (blockOffset == 0 && curPosition_ >= fileSize_) {
+        // start of new block don't need to read into cache
+        if (!SdVolume::cacheFlush()) {
+          goto writeErrorReturn;
+        }
+        SdVolume::cacheBlockNumber_ = block;
+        SdVolume::cacheSetDirty();
+      } else {
+        // rewrite part of block
+        if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) {
+          goto writeErrorReturn;
+        }
+      }
+      memcpy(SdVolume::cacheBuffer_.data + blockOffset, src, n);
+      src += n;
+    }
+    nToWrite -= n;
+    curPosition_ += n;
+  }
+  if (curPosition_ > fileSize_) {
+    // update sizes and insure sync will update the stream entry
+    fileSize_ = curPosition_;
+    if (fileSize_ > dataLength_) {
+      dataLength_ = fileSize_;
+    }
+    flags_ |= F_FILE_DIR_DIRTY;
+  } else if (SdFile::dateTime_ && nbyte) {
+    // insure sync will update modified date and time
+    flags_ |= F_FILE_DIR_DIRTY;
+  }
+
+  if (flags_ & O_SYNC) {
+    if (!sync()) {
+      goto writeErrorReturn;
+    }
+  }
+  return nbyte;
+
+writeErrorReturn:
+  setWriteError();
+  return 0;
+}
+//------------------------------------------------------------------------------
+/**
+   Write a byte to a file. Required by the Arduino Print class.
+
+   Use ExFatFile::writeError to check for errors.
+*/
+size_t ExFatFile::write(uint8_t b) {
+  return write(&b, 1);
+}
+//------------------------------------------------------------------------------
+/**
+   Write a string to a file. Used by the Arduino Print class.
+
+   Use ExFatFile::writeError to check for errors.
+*/
+size_t ExFatFile::write(const char* str) {
+  return write(str, strlen(str));
+}
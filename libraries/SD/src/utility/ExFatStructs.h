@@ -0,0 +1,277 @@
+/* Arduino SdFat Library
+   Copyright (C) 2009 by William Greiman
+
+   This file is part of the Arduino SdFat Library
+
+   This Library is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the Arduino SdFat Library.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+#ifndef ExFatStructs_h
+#define ExFatStructs_h
+/**
+   \file
+   exFAT file structures
+*/
+/*
+   from the Microsoft exFAT File System Specification
+   https://learn.microsoft.com/en-us/windows/win32/fileio/exfat-specification
+*/
+//------------------------------------------------------------------------------
+/**
+   \struct exfatBootSector
+   \brief Main boot sector for an exFAT volume.
+
+   All offsets and lengths are in sectors relative to the start of the volume.
+*/
+struct exfatBootSector {
+  /** X86 jmp to boot program, EB 76 90 */
+  uint8_t  jumpBoot[3];
+  /** Must be "EXFAT   " */
+  char     fileSystemName[8];
+  /** Must be zero, overlays the FAT BIOS parameter block */
+  uint8_t  mustBeZero[53];
+  /** Media-relative sector offset of the partition, informational */
+  uint64_t partitionOffset;
+  /** Size of the volume in sectors */
+  uint64_t volumeLength;
+  /** Sector offset of the first FAT */
+  uint32_t fatOffset;
+  /** Length of each FAT in sectors */
+  uint32_t fatLength;
+  /** Sector offset of the cluster heap */
+  uint32_t clusterHeapOffset;
+  /** Number of clusters in the cluster heap */
+  uint32_t clusterCount;
+  /** First cluster of the root directory */
+  uint32_t rootDirectoryCluster;
+  /** Volume serial number */
+  uint32_t volumeSerialNumber;
+  /** Major revision in the high byte, minor in the low byte. Must be 1.xx */
+  uint16_t fileSystemRevision;
+  /** ActiveFat, VolumeDirty and MediaFailure bits */
+  uint16_t volumeFlags;
+  /** log2 of bytes per sector, 9 for SD cards */
+  uint8_t  bytesPerSectorShift;
+  /** log2 of sectors per cluster */
+  uint8_t  sectorsPerClusterShift;
+  /** Number of FATs, 1 or 2 for TexFAT */
+  uint8_t  numberOfFats;
+  /** INT 13h drive number, usually 0X80 */
+  uint8_t  driveSelect;
+  /** Percentage of the cluster heap allocated or 0XFF if not known */
+  uint8_t  percentInUse;
+  /** Reserved */
+  uint8_t  reserved[7];
+  /** X86 boot code */
+  uint8_t  bootCode[390];
+  /** must be 0X55 */
+  uint8_t  bootSignature0;
+  /** must be 0XAA */
+  uint8_t  bootSignature1;
+} __attribute__((packed));
+/** Type name for exfatBootSector */
+typedef struct exfatBootSector exfat_bs_t;
+//------------------------------------------------------------------------------
+/** volumeFlags bit - the second FAT and allocation bitmap are active */
+uint16_t const EXFAT_FLAG_ACTIVE_FAT = 0X0001;
+/** First cluster of the cluster heap */
+uint32_t const EXFAT_FIRST_CLUSTER = 2;
+/** exFAT end of chain value */
+uint32_t const EXFAT_EOC = 0XFFFFFFFF;
+/** Largest valid exFAT cluster number */
+uint32_t const EXFAT_CLUSTER_MAX = 0XFFFFFFF6;
+//------------------------------------------------------------------------------
+// directory entry types
+/** end of directory marker */
+uint8_t const EXFAT_TYPE_END = 0X00;
+/** in use bit of an entry type */
+uint8_t const EXFAT_TYPE_IN_USE = 0X80;
+/** allocation bitmap entry */
+uint8_t const EXFAT_TYPE_BITMAP = 0X81;
+/** up-case table entry */
+uint8_t const EXFAT_TYPE_UPCASE = 0X82;
+/** volume label entry */
+uint8_t const EXFAT_TYPE_LABEL = 0X83;
+/** file entry, first entry of a file or directory entry set */
+uint8_t const EXFAT_TYPE_FILE = 0X85;
+/** stream extension entry, always follows a file entry */
+uint8_t const EXFAT_TYPE_STREAM = 0XC0;
+/** file name entry, 15 UTF-16 characters each */
+uint8_t const EXFAT_TYPE_NAME = 0XC1;
+/** Number of name characters in a file name entry */
+uint8_t const EXFAT_NAME_CHARS = 15;
+/** Maximum length of an exFAT name */
+uint8_t const EXFAT_NAME_MAX = 255;
+// stream extension flags
+/** stream flag - clusters have been allocated */
+uint8_t const EXFAT_FLAG_ALLOCATION_POSSIBLE = 0X01;
+/** stream flag - clusters are contiguous and the FAT chain is not valid */
+uint8_t const EXFAT_FLAG_NO_FAT_CHAIN = 0X02;
+// file attributes
+/** file is read-only */
+uint16_t const EXFAT_ATTRIB_READ_ONLY = 0X0001;
+/** file is hidden */
+uint16_t const EXFAT_ATTRIB_HIDDEN = 0X0002;
+/** system file */
+uint16_t const EXFAT_ATTRIB_SYSTEM = 0X0004;
+/** entry is a directory */
+uint16_t const EXFAT_ATTRIB_DIRECTORY = 0X0010;
+/** file has been modified since last backup */
+uint16_t const EXFAT_ATTRIB_ARCHIVE = 0X0020;
+//------------------------------------------------------------------------------
+/**
+   \struct exfatBitmapEntry
+   \brief Allocation bitmap directory entry, type 0X81.
+*/
+struct exfatBitmapEntry {
+  /** EXFAT_TYPE_BITMAP */
+  uint8_t  type;
+  /** Bit 0 is zero for the first bitmap, one for the TexFAT second bitmap */
+  uint8_t  flags;
+  /** Reserved */
+  uint8_t  reserved[18];
+  /** First cluster of the bitmap */
+  uint32_t firstCluster;
+  /** Size of the bitmap in bytes */
+  uint64_t dataLength;
+} __attribute__((packed));
+//------------------------------------------------------------------------------
+/**
+   \struct exfatFileEntry
+   \brief File directory entry, type 0X85.
+
+   Timestamps use the FAT date in the high 16 bits and the FAT time in the
+   low 16 bits.
+*/
+struct exfatFileEntry {
+  /** EXFAT_TYPE_FILE */
+  uint8_t  type;
+  /** Number of entries following this one in the set */
+  uint8_t  secondaryCount;
+  /** Checksum of all entries in the set, see exfatSetChecksum */
+  uint16_t setChecksum;
+  /** EXFAT_ATTRIB_ bits */
+  uint16_t attributes;
+  /** Reserved */
+  uint16_t reserved1;
+  /** Creation date and time */
+  uint32_t createTimestamp;
+  /** Last modification date and time */
+  uint32_t modifyTimestamp;
+  /** Last access date and time */
+  uint32_t accessTimestamp;
+  /** Creation time 10 ms increments, 0-199 */
+  uint8_t  create10ms;
+  /** Modify time 10 ms increments, 0-199 */
+  uint8_t  modify10ms;
+  /** Creation time UTC offset */
+  uint8_t  createUtcOffset;
+  /** Modify time UTC offset */
+  uint8_t  modifyUtcOffset;
+  /** Access time UTC offset */
+  uint8_t  accessUtcOffset;
+  /** Reserved */
+  uint8_t  reserved2[7];
+} __attribute__((packed));
+//------------------------------------------------------------------------------
+/**
+   \struct exfatStreamEntry
+   \brief Stream extension directory entry, type 0XC0.
+*/
+struct exfatStreamEntry {
+  /** EXFAT_TYPE_STREAM */
+  uint8_t  type;
+  /** EXFAT_FLAG_ALLOCATION_POSSIBLE and EXFAT_FLAG_NO_FAT_CHAIN */
+  uint8_t  flags;
+  /** Reserved */
+  uint8_t  reserved1;
+  /** Length of the name in UTF-16 characters */
+  uint8_t  nameLength;
+  /** Hash of the up-cased name, see exfatNameHash */
+  uint16_t nameHash;
+  /** Reserved */
+  uint16_t reserved2;
+  /** Bytes of valid data, reads past this return zero */
+  uint64_t validDataLength;
+  /** Reserved */
+  uint32_t reserved3;
+  /** First cluster or zero if no clusters are allocated */
+  uint32_t firstCluster;
+  /** Size of the file in bytes */
+  uint64_t dataLength;
+} __attribute__((packed));
+//------------------------------------------------------------------------------
+/**
+   \struct exfatNameEntry
+   \brief File name directory entry, type 0XC1.
+*/
+struct exfatNameEntry {
+  /** EXFAT_TYPE_NAME */
+  uint8_t  type;
+  /** Must be zero */
+  uint8_t  flags;
+  /** Up to 15 UTF-16LE characters of the name */
+  uint16_t name[EXFAT_NAME_CHARS];
+} __attribute__((packed));
+//------------------------------------------------------------------------------
+/**
+   \union exfatDirEntry
+   \brief Any 32 byte exFAT directory entry.
+*/
+union exfatDirEntry {
+  /** Raw bytes of the entry */
+  uint8_t data[32];
+  /** Entry type, common to all entries */
+  uint8_t type;
+  /** Allocation bitmap entry */
+  struct exfatBitmapEntry bitmap;
+  /** File entry */
+  struct exfatFileEntry file;
+  /** Stream extension entry */
+  struct exfatStreamEntry stream;
+  /** File name entry */
+  struct exfatNameEntry name;
+};
+/** Type name for exfatDirEntry */
+typedef union exfatDirEntry exfat_dir_t;
+//------------------------------------------------------------------------------
+/** Add \a data to an entry set checksum.  Skip the checksum field itself,
+    bytes 2 and 3 of the file entry, by passing \a first true for that entry.
+
+   \param[in] sum Checksum of the preceding entries.
+   \param[in] data The 32 byte entry.
+   \param[in] first True if \a data is the file entry of the set.
+   \return The updated checksum.
+*/
+static inline uint16_t exfatSetChecksum(uint16_t sum, const uint8_t* data,
+                                        bool first) {
+  for (uint8_t i = 0; i < 32; i++) {
+    if (first && (i == 2 || i == 3)) {
+      continue;
+    }
+    sum = ((sum << 15) | (sum >> 1)) + data[i];
+  }
+  return sum;
+}
+/** Add one up-cased UTF-16 character to a name hash.
+
+   \param[in] hash Hash of the preceding characters.
+   \param[in] c The up-cased character.
+   \return The updated hash.
+*/
+static inline uint16_t exfatNameHash(uint16_t hash, uint16_t c) {
+  hash = ((hash << 15) | (hash >> 1)) + (c & 0XFF);
+  return ((hash << 15) | (hash >> 1)) + (c >> 8);
+}
+#endif  // ExFatStructs_h
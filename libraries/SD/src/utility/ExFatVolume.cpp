@@ -0,0 +1,334 @@
+/* Arduino SdFat Library
+   Copyright (C) 2009 by William Greiman
+
+   This file is part of the Arduino SdFat Library
+
+   This Library is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the Arduino SdFat Library.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+#include "ExFat.h"
+//------------------------------------------------------------------------------
+// find a run of count free clusters and mark it allocated
+// *cluster is a hint for the first cluster or zero to use allocSearchStart_
+uint8_t ExFatVolume::allocContiguous(uint32_t count, uint32_t* cluster) {
+  uint32_t endCluster = clusterCount_ + EXFAT_FIRST_CLUSTER;
+  // start of search
+  uint32_t c = isValidCluster(*cluster) ? *cluster : allocSearchStart_;
+  if (!isValidCluster(c)) {
+    c = EXFAT_FIRST_CLUSTER;
+  }
+  // first cluster and length of the current free run
+  uint32_t bgnCluster = c;
+  uint32_t run = 0;
+
+  for (uint32_t n = 0; n < clusterCount_; n++, c++) {
+    if (c >= endCluster) {
+      // wrap to start of heap, a run can not span the end
+      c = EXFAT_FIRST_CLUSTER;
+      run = 0;
+    }
+    uint32_t i = c - EXFAT_FIRST_CLUSTER;
+    if (!SdVolume::cacheRawBlock(bitmapStartBlock_ + (i >> 12),
+                                 SdVolume::CACHE_FOR_READ)) {
+      return false;
+    }
+    uint8_t b = SdVolume::cacheBuffer_.data[(i >> 3) & 0X1FF];
+    if ((i & 7) == 0 && b == 0XFF && (c + 8) <= endCluster) {
+      // skip eight allocated clusters
+      run = 0;
+      n += 7;
+      c += 7;
+      continue;
+    }
+    if (b & (1 << (i & 7))) {
+      run = 0;
+      continue;
+    }
+    if (run++ == 0) {
+      bgnCluster = c;
+    }
+    if (run == count) {
+      // mark the run allocated
+      if (!bitmapSet(bgnCluster, count, 1)) {
+        return false;
+      }
+      allocSearchStart_ = bgnCluster + count;
+      *cluster = bgnCluster;
+      return true;
+    }
+  }
+  return false;
+}
+//------------------------------------------------------------------------------
+// clear n runs of clusters in the allocation bitmap, grouped by bitmap block
+// so the cache writes each block once
+uint8_t ExFatVolume::bitmapClearRuns(uint32_t* first, uint32_t* length,
+                                     uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) {
+    if (length[i] == 0) {
+      continue;
+    }
+    uint32_t block = (first[i] - EXFAT_FIRST_CLUSTER) >> 12;
+    for (uint8_t j = i; j < n; j++) {
+      if (length[j] && ((first[j] - EXFAT_FIRST_CLUSTER) >> 12) == block) {
+        if (!bitmapSet(first[j], length[j], 0)) {
+          return false;
+        }
+        length[j] = 0;
+      }
+    }
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// set or clear count bits in the allocation bitmap
+uint8_t ExFatVolume::bitmapSet(uint32_t cluster, uint32_t count,
+                               uint8_t value) {
+  if (!isValidCluster(cluster) ||
+      count > clusterCount_ + EXFAT_FIRST_CLUSTER - cluster) {
+    return false;
+  }
+  for (uint32_t i = cluster - EXFAT_FIRST_CLUSTER; count; count--, i++) {
+    if (!SdVolume::cacheRawBlock(bitmapStartBlock_ + (i >> 12),
+                                 SdVolume::CACHE_FOR_WRITE)) {
+      return false;
+    }
+    // bitmap blocks are allocation metadata like the FAT
+    SdVolume::cacheDirty_ |= SdVolume::CACHE_FAT_DIRTY;
+    uint8_t* b = &SdVolume::cacheBuffer_.data[(i >> 3) & 0X1FF];
+    if (value) {
+      *b |= 1 << (i & 7);
+    } else {
+      *b &= ~(1 << (i & 7));
+    }
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// return the size in bytes of a FAT chain
+uint8_t ExFatVolume::chainSize(uint32_t cluster, uint32_t* size) {
+  uint32_t s = 0;
+  do {
+    // error if the chain is longer than the volume, it must be a loop
+    if (s++ > clusterCount_ || !fatGet(cluster, &cluster)) {
+      return false;
+    }
+  } while (cluster != EXFAT_EOC);
+  *size = s << (clusterSizeShift_ + 9);
+  return true;
+}
+//------------------------------------------------------------------------------
+// Fetch a FAT entry
+uint8_t ExFatVolume::fatGet(uint32_t cluster, uint32_t* value) {
+  if (!isValidCluster(cluster)) {
+    return false;
+  }
+  SD_STATS_INC(fatReads);
+  uint32_t lba = fatStartBlock_ + (cluster >> 7);
+  if (!SdVolume::cacheRawBlock(lba, SdVolume::CACHE_FOR_READ)) {
+    return false;
+  }
+  *value = SdVolume::cacheBuffer_.fat32[cluster & 0X7F];
+  return true;
+}
+//------------------------------------------------------------------------------
+// Store a FAT entry
+uint8_t ExFatVolume::fatPut(uint32_t cluster, uint32_t value) {
+  if (!isValidCluster(cluster)) {
+    return false;
+  }
+  SD_STATS_INC(fatWrites);
+  uint32_t lba = fatStartBlock_ + (cluster >> 7);
+  if (!SdVolume::cacheRawBlock(lba, SdVolume::CACHE_FOR_WRITE)) {
+    return false;
+  }
+  SdVolume::cacheBuffer_.fat32[cluster & 0X7F] = value;
+  SdVolume::cacheDirty_ |= SdVolume::CACHE_FAT_DIRTY;
+  return true;
+}
+//------------------------------------------------------------------------------
+// free count clusters starting at cluster
+// contiguous files are freed in the bitmap without reading the FAT
+// a FAT chain is walked first and its runs of consecutive clusters cleared
+// in batches, so the shared cache doesn't swap a FAT block for a bitmap
+// block, and write the bitmap block back, at every cluster
+uint8_t ExFatVolume::freeChain(uint32_t cluster, uint32_t count,
+                               uint8_t contiguous) {
+  if (cluster < allocSearchStart_) {
+    allocSearchStart_ = cluster;
+  }
+  if (contiguous) {
+    return bitmapSet(cluster, count, 0);
+  }
+  uint32_t first[EXFAT_FREE_CHAIN_RUNS];
+  uint32_t length[EXFAT_FREE_CHAIN_RUNS];
+  uint8_t n = 0;
+  while (count--) {
+    if (n && cluster == first[n - 1] + length[n - 1]) {
+      length[n - 1]++;
+    } else {
+      if (n == EXFAT_FREE_CHAIN_RUNS) {
+        if (!bitmapClearRuns(first, length, n)) {
+          return false;
+        }
+        n = 0;
+      }
+      first[n] = cluster;
+      length[n++] = 1;
+    }
+    uint32_t next;
+    if (!fatGet(cluster, &next)) {
+      return false;
+    }
+    if (next == EXFAT_EOC) {
+      break;
+    }
+    if (next < allocSearchStart_) {
+      allocSearchStart_ = next;
+    }
+    cluster = next;
+  }
+  return bitmapClearRuns(first, length, n);
+}
+//------------------------------------------------------------------------------
+/**
+   Count free clusters by scanning the allocation bitmap.
+
+   \param[out] count The number of free clusters.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t ExFatVolume::freeClusterCount(uint32_t* count) {
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < clusterCount_; i += 8) {
+    if (!SdVolume::cacheRawBlock(bitmapStartBlock_ + (i >> 12),
+                                 SdVolume::CACHE_FOR_READ)) {
+      return false;
+    }
+    uint8_t b = SdVolume::cacheBuffer_.data[(i >> 3) & 0X1FF];
+    if ((clusterCount_ - i) < 8) {
+      // ignore bits past the last cluster
+      b &= (1 << (clusterCount_ - i)) - 1;
+    }
+    for (; b; b &= b - 1) {
+      used++;
+    }
+  }
+  *count = clusterCount_ - used;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+   Initialize an exFAT volume.
+
+   \param[in] dev The SD card where the volume is located.
+
+   \param[in] part The partition to be used.  Legal values for \a part are
+   1-4 to use the corresponding partition on a device formatted with
+   a MBR, Master Boot Record, or zero if the device is formatted as
+   a super floppy with the exFAT boot sector in block zero.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.  Reasons for
+   failure include not finding a valid partition, not finding a valid
+   exFAT file system in the specified partition, a non-contiguous
+   allocation bitmap or an I/O error.
+*/
+uint8_t ExFatVolume::init(Sd2Card* dev, uint8_t part) {
+  uint32_t volumeStartBlock = 0;
+  // write back a dirty block, then forget the cached block since the card
+  // may have been replaced
+  if (!SdVolume::cacheFlush()) {
+    return false;
+  }
+  SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
+  SdVolume::sdCard_ = dev;
+  // if part == 0 assume super floppy with exFAT boot sector in block zero
+  // if part > 0 assume mbr volume with partition table
+  if (part) {
+    if (part > 4) {
+      return false;
+    }
+    if (!SdVolume::cacheRawBlock(volumeStartBlock, SdVolume::CACHE_FOR_READ)) {
+      return false;
+    }
+    part_t* p = &SdVolume::cacheBuffer_.mbr.part[part - 1];
+    if ((p->boot & 0X7F) != 0  ||
+        p->totalSectors < 100 ||
+        p->firstSector == 0) {
+      // not a valid partition
+      return false;
+    }
+    volumeStartBlock = p->firstSector;
+  }
+  if (!SdVolume::cacheRawBlock(volumeStartBlock, SdVolume::CACHE_FOR_READ)) {
+    return false;
+  }
+  exfat_bs_t* bs = &SdVolume::cacheBuffer_.exfatBs;
+  if (memcmp(bs->fileSystemName, "EXFAT   ", 8) != 0 ||
+      bs->bytesPerSectorShift != 9 ||
+      bs->sectorsPerClusterShift > 16 ||
+      bs->numberOfFats == 0 ||
+      bs->clusterCount == 0) {
+    // not valid exFAT volume
+    return false;
+  }
+  clusterSizeShift_ = bs->sectorsPerClusterShift;
+  clusterCount_ = bs->clusterCount;
+  dataStartBlock_ = volumeStartBlock + bs->clusterHeapOffset;
+  rootDirStart_ = bs->rootDirectoryCluster;
+  allocSearchStart_ = EXFAT_FIRST_CLUSTER;
+
+  // TexFAT volumes may have the second FAT and bitmap active
+  uint8_t activeFat = 0;
+  fatStartBlock_ = volumeStartBlock + bs->fatOffset;
+  if (bs->numberOfFats > 1 && (bs->volumeFlags & EXFAT_FLAG_ACTIVE_FAT)) {
+    fatStartBlock_ += bs->fatLength;
+    activeFat = 1;
+  }
+  if (!isValidCluster(rootDirStart_)) {
+    return false;
+  }
+  // find the allocation bitmap in the root directory
+  ExFatFile root;
+  if (!root.openRoot(this)) {
+    return false;
+  }
+  while (root.curPosition_ < root.fileSize_) {
+    exfat_dir_t* p = root.readDirCache();
+    if (!p || p->type == EXFAT_TYPE_END) {
+      break;
+    }
+    if (p->type != EXFAT_TYPE_BITMAP || (p->bitmap.flags & 1) != activeFat) {
+      continue;
+    }
+    uint32_t first = p->bitmap.firstCluster;
+    uint32_t length = (clusterCount_ + 7) >> 3;
+    if (!isValidCluster(first) || p->bitmap.dataLength < length) {
+      return false;
+    }
+    // the bitmap is indexed by block so it must be contiguous
+    uint32_t cluster = first;
+    for (uint32_t n = clustersForLength(length); n > 1; n--, cluster++) {
+      uint32_t next;
+      if (!fatGet(cluster, &next) || next != (cluster + 1)) {
+        return false;
+      }
+    }
+    bitmapStartBlock_ = clusterStartBlock(first);
+    return true;
+  }
+  return false;
+}
@@ -117,6 +117,8 @@ uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
   // select card
   chipSelectLow();
 
+  SD_STATS_START(t0);
+
   // wait up to 300 ms if busy
   waitNotBusy(300);
 
@@ -141,6 +143,7 @@ uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
   // wait for response
   for (uint8_t i = 0; ((status_ = spiRec()) & 0X80) && i != 0XFF; i++)
     ;
+  SD_STATS_COMMAND(cmd, t0);
   return status_;
 }
 //------------------------------------------------------------------------------
@@ -422,6 +425,7 @@ uint8_t Sd2Card::readData(uint32_t block,
     }
     offset_ = 0;
     inBlock_ = 1;
+    SD_STATS_INC(blocksRead);
   }
 
   #ifdef OPTIMIZE_HARDWARE_SPI
@@ -571,27 +575,34 @@ uint8_t Sd2Card::setSpiClock(uint32_t clock) {
 //------------------------------------------------------------------------------
 // wait for card to go not busy
 uint8_t Sd2Card::waitNotBusy(unsigned int timeoutMillis) {
+  SD_STATS_START(t1);
   unsigned int t0 = millis();
   unsigned int d;
   do {
     if (spiRec() == 0XFF) {
+      SD_STATS_LATENCY(waitNotBusy, t1);
       return true;
     }
     d = millis() - t0;
   } while (d < timeoutMillis);
+  SD_STATS_LATENCY(waitNotBusy, t1);
+  SD_STATS_INC(busyTimeouts);
   return false;
 }
 //------------------------------------------------------------------------------
 /** Wait for start block token */
 uint8_t Sd2Card::waitStartBlock(void) {
+  SD_STATS_START(t1);
   unsigned int t0 = millis();
   while ((status_ = spiRec()) == 0XFF) {
     unsigned int d = millis() - t0;
     if (d > SD_READ_TIMEOUT) {
+      SD_STATS_LATENCY(waitStartBlock, t1);
       error(SD_CARD_ERROR_READ_TIMEOUT);
       goto fail;
     }
   }
+  SD_STATS_LATENCY(waitStartBlock, t1);
   if (status_ != DATA_START_BLOCK) {
     error(SD_CARD_ERROR_READ);
     goto fail;
@@ -699,6 +710,7 @@ uint8_t Sd2Card::writeData(uint8_t token, const uint8_t* src) {
     chipSelectHigh();
     return false;
   }
+  SD_STATS_INC(blocksWritten);
   return true;
 }
 //------------------------------------------------------------------------------
@@ -28,15 +28,25 @@
 #endif
 #include "Sd2Card.h"
 #include "FatStructs.h"
+#include "ExFatStructs.h"
 #include <Print.h>
 //------------------------------------------------------------------------------
 /**
    Allow use of deprecated functions if non-zero
 */
 #define ALLOW_DEPRECATED_FUNCTIONS 1
+/**
+   Number of files SdFile::removeOldest() selects per directory scan.
+   Each slot uses 16 bytes of stack.
+*/
+#ifndef SD_REMOVE_OLDEST_BATCH
+  #define SD_REMOVE_OLDEST_BATCH 16
+#endif  // SD_REMOVE_OLDEST_BATCH
 //------------------------------------------------------------------------------
 // forward declaration since SdVolume is used in SdFile
 class SdVolume;
+// forward declaration for friend access to the block cache and date callback
+class ExFatFile;
 //==============================================================================
 // SdFile class
 
@@ -278,6 +288,7 @@ class SdFile : public Print {
     int8_t readDir(dir_t* dir);
     static uint8_t remove(SdFile* dirFile, const char* fileName);
     uint8_t remove(void);
+    int16_t removeOldest(uint16_t count);
     /** Set the file's current position to zero. */
     void rewind(void) {
       curPosition_ = curCluster_ = 0;
@@ -418,6 +429,11 @@ class SdFile : public Print {
     }
     #endif  // ALLOW_DEPRECATED_FUNCTIONS
   private:
+    // Allow ExFatFile to share the date/time callback.
+    friend class ExFatFile;
+    // SdDirIterator reads entries in place from the cache.
+    friend class SdDirIterator;
+
     // bits defined in flags_
     // should be 0XF
     static uint8_t const F_OFLAG = (O_ACCMODE | O_APPEND | O_SYNC);
@@ -455,6 +471,59 @@ class SdFile : public Print {
     uint8_t openCachedEntry(uint8_t cacheIndex, uint8_t oflags);
     dir_t* readDirCache(void);
 };
+//------------------------------------------------------------------------------
+/**
+   \class SdDirIterator
+   \brief Walk a directory without opening or copying its entries.
+
+   next() returns a pointer to the entry in the SdVolume block cache.  The
+   pointer is only valid until the next SdFile, SdVolume or iterator call.
+   Deleted entries, long name entries, the volume label and the dot entries
+   are skipped.
+
+   \code
+   SdDirIterator it(&dir);
+   const dir_t* p;
+   while ((p = it.next())) {
+     uint32_t size = p->fileSize;
+     uint32_t mtime = SdDirIterator::modifyTime(p);
+   }
+   \endcode
+*/
+class SdDirIterator {
+  public:
+    /** Start iterating over the open directory \a dir from its first entry. */
+    explicit SdDirIterator(SdFile* dir)
+      : dir_(dir), block_(0XFFFFFFFF), error_(false) {
+      if (dir) {
+        dir->rewind();
+      }
+    }
+    /** \return True if next() stopped because of an I/O error. */
+    uint8_t error(void) const {
+      return error_;
+    }
+    /** \return The first cluster of an entry, zero if none is allocated. */
+    static uint32_t firstCluster(const dir_t* p) {
+      return (uint32_t)p->firstClusterHigh << 16 | p->firstClusterLow;
+    }
+    /** \return Index in the directory of the entry last returned by next().
+        Use with SdFile::open(SdFile* dirFile, uint16_t index, uint8_t oflag).
+    */
+    uint16_t index(void) const {
+      return (dir_->curPosition_ >> 5) - 1;
+    }
+    /** \return Last write date in the high 16 bits and time in the low
+        16 bits.  Larger values are newer. */
+    static uint32_t modifyTime(const dir_t* p) {
+      return (uint32_t)p->lastWriteDate << 16 | p->lastWriteTime;
+    }
+    const dir_t* next(void);
+  private:
+    SdFile* dir_;
+    uint32_t block_;  // block of the last entry returned
+    uint8_t error_;
+};
 //==============================================================================
 // SdVolume class
 /**
@@ -473,6 +542,10 @@ union cache_t {
   mbr_t    mbr;
   /** Used to access to a cached FAT boot sector. */
   fbs_t    fbs;
+  /** Used to access cached exFAT directory entries. */
+  exfat_dir_t exfatDir[16];
+  /** Used to access a cached exFAT boot sector. */
+  exfat_bs_t  exfatBs;
 };
 //------------------------------------------------------------------------------
 /**
@@ -570,11 +643,20 @@ class SdVolume {
   private:
     // Allow SdFile access to SdVolume private data.
     friend class SdFile;
+    // exFAT shares the block cache and card.
+    friend class ExFatVolume;
+    friend class ExFatFile;
+    // SdDirIterator returns entries in place from the cache.
+    friend class SdDirIterator;
 
     // value for action argument in cacheRawBlock to indicate read from cache
     static uint8_t const CACHE_FOR_READ = 0;
     // value for action argument in cacheRawBlock to indicate cache dirty
     static uint8_t const CACHE_FOR_WRITE = 1;
+    // cacheDirty_ bit - dirty cache block holds FAT entries
+    static uint8_t const CACHE_FAT_DIRTY = 2;
+    // cacheDirty_ bit - dirty cache block holds directory entries
+    static uint8_t const CACHE_DIR_DIRTY = 4;
 
     static cache_t cacheBuffer_;        // 512 byte cache for device blocks
     static uint32_t cacheBlockNumber_;  // Logical number of block in the cache
@@ -610,6 +692,9 @@ class SdVolume {
     static void cacheSetDirty(void) {
       cacheDirty_ |= CACHE_FOR_WRITE;
     }
+    static void cacheSetDirDirty(void) {
+      cacheDirty_ |= CACHE_FOR_WRITE | CACHE_DIR_DIRTY;
+    }
     static uint8_t cacheZeroBlock(uint32_t blockNumber);
     uint8_t chainSize(uint32_t beginCluster, uint32_t* size) const;
     uint8_t fatGet(uint32_t cluster, uint32_t* value) const;
@@ -59,6 +59,7 @@ uint8_t SdFile::addDirCluster(void) {
     if (!SdVolume::cacheZeroBlock(block + i - 1)) {
       return false;
     }
+    SdVolume::cacheSetDirDirty();
   }
   // Increase directory file size by cluster size
   fileSize_ += 512UL << vol_->clusterSizeShift_;
@@ -71,6 +72,9 @@ dir_t* SdFile::cacheDirEntry(uint8_t action) {
   if (!SdVolume::cacheRawBlock(dirBlock_, action)) {
     return NULL;
   }
+  if (action == SdVolume::CACHE_FOR_WRITE) {
+    SdVolume::cacheSetDirDirty();
+  }
   return SdVolume::cacheBuffer_.dir + dirIndex_;
 }
 //------------------------------------------------------------------------------
@@ -381,6 +385,7 @@ uint8_t SdFile::makeDir(SdFile* dir, const char* dirName) {
   if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) {
     return false;
   }
+  SdVolume::cacheSetDirDirty();
 
   // copy '.' to block
   memcpy(&SdVolume::cacheBuffer_.dir[0], &d, sizeof(d));
@@ -892,6 +897,48 @@ dir_t* SdFile::readDirCache(void) {
   return (SdVolume::cacheBuffer_.dir + i);
 }
 //------------------------------------------------------------------------------
+/**
+   Advance to the next file or subdirectory entry.
+
+   Entries in the block already in the cache are returned without calling
+   SdFile::read().
+
+   \return A pointer to the entry in the block cache, or NULL at the end of
+   the directory or for an I/O error, see error().
+*/
+const dir_t* SdDirIterator::next(void) {
+  if (!dir_ || !dir_->isDir()) {
+    return NULL;
+  }
+  while (dir_->curPosition_ < dir_->fileSize_) {
+    uint8_t i = (dir_->curPosition_ >> 5) & 0XF;
+    dir_t* p;
+    if (i && SdVolume::cacheBlockNumber_ == block_) {
+      // same block as the previous entry
+      p = SdVolume::cacheBuffer_.dir + i;
+      dir_->curPosition_ += 32;
+    } else {
+      p = dir_->readDirCache();
+      if (!p) {
+        error_ = true;
+        return NULL;
+      }
+      block_ = SdVolume::cacheBlockNumber_;
+    }
+    // done if past last entry
+    if (p->name[0] == DIR_NAME_FREE) {
+      break;
+    }
+    // skip deleted entries, '.', '..', long names and the volume label
+    if (p->name[0] == DIR_NAME_DELETED || p->name[0] == '.' ||
+        !DIR_IS_FILE_OR_SUBDIR(p)) {
+      continue;
+    }
+    return p;
+  }
+  return NULL;
+}
+//------------------------------------------------------------------------------
 /**
    Remove a file.
 
@@ -954,6 +1001,111 @@ uint8_t SdFile::remove(SdFile* dirFile, const char* fileName) {
   return file.remove();
 }
 //------------------------------------------------------------------------------
+/**
+   Remove the oldest files in a directory.
+
+   Files are ranked by last write date and time, ties by position in the
+   directory.  Subdirectories and read-only files are not removed.
+
+   Each scan of the directory selects up to SD_REMOVE_OLDEST_BATCH files.
+   Their entries are marked deleted in block order, then their cluster
+   chains are freed in cluster order so each FAT block is read and written
+   about once, and the cache is flushed once per batch.  Entries are deleted
+   before clusters are freed so a power loss can only leak clusters.
+
+   Like remove(), long name entries of removed files are not deleted.
+
+   \param[in] count Number of files to remove.
+
+   \return The number of files removed, less than \a count if the directory
+   has fewer files, or -1 if this is not a directory or an I/O error occurs.
+*/
+int16_t SdFile::removeOldest(uint16_t count) {
+  struct oldest_t {
+    uint32_t time;     // SdDirIterator::modifyTime()
+    uint32_t block;    // block that contains the entry
+    uint32_t cluster;  // first cluster of the file
+    uint8_t index;     // index of the entry in block
+  } slot[SD_REMOVE_OLDEST_BATCH];
+
+  if (!isDir() || count > 0X7FFF) {
+    return -1;
+  }
+  int16_t removed = 0;
+  while (removed < (int16_t)count) {
+    uint8_t want = SD_REMOVE_OLDEST_BATCH;
+    if ((count - removed) < want) {
+      want = count - removed;
+    }
+    // keep the oldest files sorted by time
+    uint8_t n = 0;
+    SdDirIterator it(this);
+    const dir_t* p;
+    while ((p = it.next())) {
+      if (!DIR_IS_FILE(p) || (p->attributes & DIR_ATT_READ_ONLY)) {
+        continue;
+      }
+      uint32_t time = SdDirIterator::modifyTime(p);
+      if (n == want && time >= slot[n - 1].time) {
+        continue;
+      }
+      uint8_t i = n < want ? n++ : n - 1;
+      for (; i > 0 && slot[i - 1].time > time; i--) {
+        slot[i] = slot[i - 1];
+      }
+      slot[i].time = time;
+      slot[i].block = SdVolume::cacheBlockNumber_;
+      slot[i].cluster = SdDirIterator::firstCluster(p);
+      slot[i].index = it.index() & 0XF;
+    }
+    if (it.error()) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    // mark entries deleted in block order
+    for (uint8_t i = 1; i < n; i++) {
+      oldest_t t = slot[i];
+      uint8_t j = i;
+      for (; j > 0 && slot[j - 1].block > t.block; j--) {
+        slot[j] = slot[j - 1];
+      }
+      slot[j] = t;
+    }
+    for (uint8_t i = 0; i < n; i++) {
+      if (!SdVolume::cacheRawBlock(slot[i].block, SdVolume::CACHE_FOR_WRITE)) {
+        return -1;
+      }
+      SdVolume::cacheSetDirDirty();
+      SdVolume::cacheBuffer_.dir[slot[i].index].name[0] = DIR_NAME_DELETED;
+    }
+    // free chains in cluster order
+    for (uint8_t i = 1; i < n; i++) {
+      oldest_t t = slot[i];
+      uint8_t j = i;
+      for (; j > 0 && slot[j - 1].cluster > t.cluster; j--) {
+        slot[j] = slot[j - 1];
+      }
+      slot[j] = t;
+    }
+    for (uint8_t i = 0; i < n; i++) {
+      if (slot[i].cluster && !vol_->freeChain(slot[i].cluster)) {
+        return -1;
+      }
+    }
+    if (!SdVolume::cacheFlush()) {
+      return -1;
+    }
+    removed += n;
+    if (n < want) {
+      break;
+    }
+  }
+  rewind();
+  return removed;
+}
+//------------------------------------------------------------------------------
 /** Remove a directory file.
 
    The directory file will be removed only if it is empty and is not the
@@ -1396,6 +1548,7 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
       if (!vol_->writeBlock(block, src, blocking)) {
         goto writeErrorReturn;
       }
+      SD_STATS_INC(dataBlocksWritten);
       src += 512;
     } else {
       if (blockOffset == 0 && curPosition_ >= fileSize_) {
@@ -0,0 +1,130 @@
+/* Arduino SdFat Library
+   Copyright (C) 2009 by William Greiman
+
+   This file is part of the Arduino SdFat Library
+
+   This Library is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the Arduino SdFat Library.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+#include "SdStats.h"
+#include "SdInfo.h"
+#if SD_STATS_ENABLED
+//------------------------------------------------------------------------------
+SdStats sdStats;
+//------------------------------------------------------------------------------
+static void printCounter(Print* pr, const char* name, uint32_t value) {
+  pr->print(name);
+  pr->print(' ');
+  pr->println(value);
+}
+//------------------------------------------------------------------------------
+/** Add one latency sample.
+
+   \param[in] us The latency in microseconds.
+*/
+void SdLatencyHistogram::add(uint32_t us) {
+  uint8_t i = 0;
+  for (uint32_t v = us >> 1; v && i < (SD_STATS_BUCKETS - 1); v >>= 1) {
+    i++;
+  }
+  if (bucket[i] != 0XFFFF) {
+    bucket[i]++;
+  }
+  count++;
+  totalMicros += us;
+  if (us > maxMicros) {
+    maxMicros = us;
+  }
+}
+//------------------------------------------------------------------------------
+/** %Print a histogram as one line.
+
+   Format is: name count total max followed by lower_bound:count for
+   each nonzero bucket.  Times are in microseconds.
+
+   \param[in] pr The Print stream for output.
+   \param[in] name Label for the line.
+*/
+void SdLatencyHistogram::print(Print* pr, const char* name) const {
+  pr->print(name);
+  pr->print(' ');
+  pr->print(count);
+  pr->print(' ');
+  pr->print(totalMicros);
+  pr->print(' ');
+  pr->print(maxMicros);
+  for (uint8_t i = 0; i < SD_STATS_BUCKETS; i++) {
+    if (bucket[i]) {
+      pr->print(' ');
+      pr->print(i ? 1UL << i : 0UL);
+      pr->print(':');
+      pr->print(bucket[i]);
+    }
+  }
+  pr->println();
+}
+//------------------------------------------------------------------------------
+/** Map an SD command to one of the SD_STATS_CMD_ classes. */
+uint8_t SdStats::commandClass(uint8_t cmd) {
+  switch (cmd) {
+    case CMD17: return SD_STATS_CMD_READ;
+    case CMD24: return SD_STATS_CMD_WRITE;
+    case CMD25: return SD_STATS_CMD_WRITE_MULTIPLE;
+    case CMD13: return SD_STATS_CMD_STATUS;
+    case CMD32:
+    case CMD33:
+    case CMD38: return SD_STATS_CMD_ERASE;
+    case CMD9:
+    case CMD10:
+    case CMD58: return SD_STATS_CMD_REGISTER;
+    default: return SD_STATS_CMD_OTHER;
+  }
+}
+//------------------------------------------------------------------------------
+/** %Print all counters and histograms, one per line, to \a pr.
+
+   Histogram lines are name, count, total us, max us and then
+   bucket_lower_bound_us:count for nonzero buckets.
+   Counter lines are name and value.
+
+   \param[in] pr The Print stream for output, for example &Serial or an
+   open File.
+*/
+void SdStats::print(Print* pr) const {
+  static const char* const cmdName[SD_STATS_CMD_COUNT] = {
+    "cmd_read", "cmd_write", "cmd_write_multiple", "cmd_status",
+    "cmd_erase", "cmd_register", "cmd_other"
+  };
+  for (uint8_t i = 0; i < SD_STATS_CMD_COUNT; i++) {
+    command[i].print(pr, cmdName[i]);
+  }
+  waitNotBusy.print(pr, "wait_not_busy");
+  waitStartBlock.print(pr, "wait_start_block");
+  printCounter(pr, "busy_timeouts", busyTimeouts);
+  printCounter(pr, "blocks_read", blocksRead);
+  printCounter(pr, "blocks_written", blocksWritten);
+  printCounter(pr, "cache_hits", cacheHits);
+  printCounter(pr, "cache_misses", cacheMisses);
+  printCounter(pr, "fat_reads", fatReads);
+  printCounter(pr, "fat_writes", fatWrites);
+  printCounter(pr, "fat_blocks_written", fatBlocksWritten);
+  printCounter(pr, "dir_blocks_written", dirBlocksWritten);
+  printCounter(pr, "data_blocks_written", dataBlocksWritten);
+}
+//------------------------------------------------------------------------------
+/** Clear all counters and histograms. */
+void SdStats::reset(void) {
+  memset(this, 0, sizeof(*this));
+}
+#endif  // SD_STATS_ENABLED
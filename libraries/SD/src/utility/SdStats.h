@@ -0,0 +1,145 @@
+/* Arduino SdFat Library
+   Copyright (C) 2009 by William Greiman
+
+   This file is part of the Arduino SdFat Library
+
+   This Library is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the Arduino SdFat Library.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+#ifndef SdStats_h
+#define SdStats_h
+/**
+   \file
+   SdStats class - optional Sd2Card and SdVolume instrumentation
+*/
+#include <Arduino.h>
+#include <Print.h>
+//------------------------------------------------------------------------------
+/**
+   SD_STATS_ENABLED: if nonzero, Sd2Card and SdVolume count commands, cache
+   hits and misses and blocks written, and keep log2 latency histograms in
+   the global sdStats.  If zero all instrumentation code and data is removed.
+
+   Uses about 500 bytes of RAM so leave this off on small AVR boards unless
+   you are chasing a problem.
+*/
+#ifndef SD_STATS_ENABLED
+  #define SD_STATS_ENABLED 0
+#endif  // SD_STATS_ENABLED
+/**
+   Number of buckets in a latency histogram.  Bucket zero counts latencies
+   below 2 us, bucket n counts latencies in [2^n, 2^(n+1)) us and the last
+   bucket also counts everything longer.
+*/
+#ifndef SD_STATS_BUCKETS
+  #define SD_STATS_BUCKETS 20
+#endif  // SD_STATS_BUCKETS
+//------------------------------------------------------------------------------
+// command classes for SdStats::command
+/** CMD17 - read a block */
+uint8_t const SD_STATS_CMD_READ = 0;
+/** CMD24 - write a block */
+uint8_t const SD_STATS_CMD_WRITE = 1;
+/** CMD25 - start a multiple block write */
+uint8_t const SD_STATS_CMD_WRITE_MULTIPLE = 2;
+/** CMD13 - status check after a write */
+uint8_t const SD_STATS_CMD_STATUS = 3;
+/** CMD32, CMD33 and CMD38 - erase */
+uint8_t const SD_STATS_CMD_ERASE = 4;
+/** CMD9, CMD10 and CMD58 - read a card register */
+uint8_t const SD_STATS_CMD_REGISTER = 5;
+/** All other commands, mostly card initialization */
+uint8_t const SD_STATS_CMD_OTHER = 6;
+/** Number of command classes */
+uint8_t const SD_STATS_CMD_COUNT = 7;
+//------------------------------------------------------------------------------
+/**
+   \class SdLatencyHistogram
+   \brief Count, total, maximum and log2 histogram of latencies in microseconds.
+*/
+class SdLatencyHistogram {
+  public:
+    /** Number of samples. */
+    uint32_t count;
+    /** Sum of all samples in microseconds. */
+    uint32_t totalMicros;
+    /** Largest sample in microseconds. */
+    uint32_t maxMicros;
+    /** Samples per log2 bucket, saturates at 0XFFFF. */
+    uint16_t bucket[SD_STATS_BUCKETS];
+
+    void add(uint32_t us);
+    void print(Print* pr, const char* name) const;
+};
+//------------------------------------------------------------------------------
+/**
+   \class SdStats
+   \brief Counters and latency histograms for an SD card and its FAT volume.
+*/
+class SdStats {
+  public:
+    /** Command latency, from select through R1 response, by command class. */
+    SdLatencyHistogram command[SD_STATS_CMD_COUNT];
+    /** Time spent in Sd2Card::waitNotBusy(). */
+    SdLatencyHistogram waitNotBusy;
+    /** Time spent in Sd2Card::waitStartBlock(). */
+    SdLatencyHistogram waitStartBlock;
+    /** waitNotBusy() calls that timed out. */
+    uint32_t busyTimeouts;
+    /** Blocks, or partial blocks, read from the card. */
+    uint32_t blocksRead;
+    /** Blocks written to the card. */
+    uint32_t blocksWritten;
+    /** SdVolume block cache requests satisfied without I/O. */
+    uint32_t cacheHits;
+    /** SdVolume block cache requests that read a block. */
+    uint32_t cacheMisses;
+    /** FAT entries read by SdVolume. */
+    uint32_t fatReads;
+    /** FAT entries written by SdVolume. */
+    uint32_t fatWrites;
+    /** FAT blocks written, including mirror FAT blocks. */
+    uint32_t fatBlocksWritten;
+    /** Directory blocks written. */
+    uint32_t dirBlocksWritten;
+    /** File data blocks written. */
+    uint32_t dataBlocksWritten;
+
+    /** Record the latency of a command. */
+    void addCommand(uint8_t cmd, uint32_t us) {
+      command[commandClass(cmd)].add(us);
+    }
+    static uint8_t commandClass(uint8_t cmd);
+    void print(Print* pr) const;
+    void reset(void);
+};
+#if SD_STATS_ENABLED
+  /** Statistics for the SD card and volume. */
+  extern SdStats sdStats;
+
+  /** Increment an sdStats counter. */
+  #define SD_STATS_INC(field) (sdStats.field++)
+  /** Declare and start a microsecond timer. */
+  #define SD_STATS_START(t0) uint32_t t0 = micros()
+  /** Add the time elapsed since \a t0 to an sdStats histogram. */
+  #define SD_STATS_LATENCY(hist, t0) sdStats.hist.add(micros() - (t0))
+  /** Add the time elapsed since \a t0 to the histogram for \a cmd. */
+  #define SD_STATS_COMMAND(cmd, t0) sdStats.addCommand((cmd), micros() - (t0))
+#else  // SD_STATS_ENABLED
+  #define SD_STATS_INC(field) ((void)0)
+  #define SD_STATS_START(t0) ((void)0)
+  #define SD_STATS_LATENCY(hist, t0) ((void)0)
+  #define SD_STATS_COMMAND(cmd, t0) ((void)0)
+#endif  // SD_STATS_ENABLED
+#endif  // SdStats_h
@@ -113,6 +113,15 @@ uint8_t SdVolume::cacheFlush(uint8_t blocking) {
     if (!sdCard_->writeBlock(cacheBlockNumber_, cacheBuffer_.data, blocking)) {
       return false;
     }
+    #if SD_STATS_ENABLED
+    if (cacheDirty_ & CACHE_FAT_DIRTY) {
+      sdStats.fatBlocksWritten++;
+    } else if (cacheDirty_ & CACHE_DIR_DIRTY) {
+      sdStats.dirBlocksWritten++;
+    } else {
+      sdStats.dataBlocksWritten++;
+    }
+    #endif  // SD_STATS_ENABLED
 
     if (!blocking) {
       return true;
@@ -132,6 +141,7 @@ uint8_t SdVolume::cacheMirrorBlockFlush(uint8_t blocking) {
     if (!sdCard_->writeBlock(cacheMirrorBlock_, cacheBuffer_.data, blocking)) {
       return false;
     }
+    SD_STATS_INC(fatBlocksWritten);
     cacheMirrorBlock_ = 0;
   }
   return true;
@@ -139,6 +149,7 @@ uint8_t SdVolume::cacheMirrorBlockFlush(uint8_t blocking) {
 //------------------------------------------------------------------------------
 uint8_t SdVolume::cacheRawBlock(uint32_t blockNumber, uint8_t action) {
   if (cacheBlockNumber_ != blockNumber) {
+    SD_STATS_INC(cacheMisses);
     if (!cacheFlush()) {
       return false;
     }
@@ -146,6 +157,8 @@ uint8_t SdVolume::cacheRawBlock(uint32_t blockNumber, uint8_t action) {
       return false;
     }
     cacheBlockNumber_ = blockNumber;
+  } else {
+    SD_STATS_INC(cacheHits);
   }
   cacheDirty_ |= action;
   return true;
@@ -184,12 +197,15 @@ uint8_t SdVolume::fatGet(uint32_t cluster, uint32_t* value) const {
   if (cluster > (clusterCount_ + 1)) {
     return false;
   }
+  SD_STATS_INC(fatReads);
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
   if (lba != cacheBlockNumber_) {
     if (!cacheRawBlock(lba, CACHE_FOR_READ)) {
       return false;
     }
+  } else {
+    SD_STATS_INC(cacheHits);
   }
   if (fatType_ == 16) {
     *value = cacheBuffer_.fat16[cluster & 0XFF];
@@ -211,6 +227,8 @@ uint8_t SdVolume::fatPut(uint32_t cluster, uint32_t value) {
     return false;
   }
 
+  SD_STATS_INC(fatWrites);
+
   // calculate block address for entry
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
@@ -219,6 +237,8 @@ uint8_t SdVolume::fatPut(uint32_t cluster, uint32_t value) {
     if (!cacheRawBlock(lba, CACHE_FOR_READ)) {
       return false;
     }
+  } else {
+    SD_STATS_INC(cacheHits);
   }
   // store entry
   if (fatType_ == 16) {
@@ -226,7 +246,7 @@ uint8_t SdVolume::fatPut(uint32_t cluster, uint32_t value) {
   } else {
     cacheBuffer_.fat32[cluster & 0X7F] = value;
   }
-  cacheSetDirty();
+  cacheDirty_ |= CACHE_FOR_WRITE | CACHE_FAT_DIRTY;
 
   // mirror second FAT
   if (fatCount_ > 1) {
@@ -274,6 +294,12 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
 */
 uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
   uint32_t volumeStartBlock = 0;
+  // write back a dirty block, FAT mirror included, then forget the cached
+  // block since the card may have been replaced
+  if (!cacheFlush()) {
+    return false;
+  }
+  cacheBlockNumber_ = 0XFFFFFFFF;
   sdCard_ = dev;
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
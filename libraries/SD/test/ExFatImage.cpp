@@ -0,0 +1,297 @@
+/*
+   ExFatImage - exFAT card images for the host tests of the SD library.
+*/
+#include "ExFatImage.h"
+
+#include <ctype.h>
+#include <string.h>
+
+// the FAT starts at the usual offset of mkfs.exfat
+static const uint32_t FAT_OFFSET = 128;
+// only ASCII is up-cased, the library accepts nothing else in names
+static const uint16_t UPCASE_CHARS = 128;
+//------------------------------------------------------------------------------
+static uint32_t bootChecksum(uint32_t sum, uint8_t b) {
+  return ((sum << 31) | (sum >> 1)) + b;
+}
+//------------------------------------------------------------------------------
+ExFatImage::ExFatImage(uint32_t megabytes, uint8_t clusterShift, bool partitioned)
+  : image(megabytes * 1024UL * 1024UL) {
+  uint32_t volumeStart = partitioned ? 2048 : 0;
+  uint32_t volumeLength = megabytes * 2048UL - volumeStart;
+  uint32_t fatLength = (((volumeLength >> clusterShift) + 2) * 4 + 511) / 512;
+  uint32_t blocksPerCluster = 1UL << clusterShift;
+  uint32_t heapOffset = (FAT_OFFSET + fatLength + blocksPerCluster - 1) & ~(blocksPerCluster - 1);
+  uint32_t clusterCount = (volumeLength - heapOffset) >> clusterShift;
+  uint32_t clusterBytes = 512UL << clusterShift;
+  uint32_t bitmapLength = (clusterCount + 7) / 8;
+  uint32_t bitmapClusters = (bitmapLength + clusterBytes - 1) / clusterBytes;
+  uint32_t upcaseCluster = EXFAT_FIRST_CLUSTER + bitmapClusters;
+  uint32_t rootCluster = upcaseCluster + 1;
+
+  uint8_t* vol = &image[volumeStart * 512UL];
+  exfat_bs_t* bs = reinterpret_cast<exfat_bs_t*>(vol);
+  const uint8_t jump[3] = {0XEB, 0X76, 0X90};
+  memcpy(bs->jumpBoot, jump, 3);
+  memcpy(bs->fileSystemName, "EXFAT   ", 8);
+  bs->partitionOffset = volumeStart;
+  bs->volumeLength = volumeLength;
+  bs->fatOffset = FAT_OFFSET;
+  bs->fatLength = fatLength;
+  bs->clusterHeapOffset = heapOffset;
+  bs->clusterCount = clusterCount;
+  bs->rootDirectoryCluster = rootCluster;
+  bs->volumeSerialNumber = 0X12345678;
+  bs->fileSystemRevision = 0X100;
+  bs->volumeFlags = 0;
+  bs->bytesPerSectorShift = 9;
+  bs->sectorsPerClusterShift = clusterShift;
+  bs->numberOfFats = 1;
+  bs->driveSelect = 0X80;
+  bs->percentInUse = 0XFF;
+  bs->bootSignature0 = 0X55;
+  bs->bootSignature1 = 0XAA;
+  // extended boot sectors, then the boot checksum of the first eleven
+  // sectors less VolumeFlags and PercentInUse
+  for (uint8_t i = 1; i < 9; i++) {
+    vol[i * 512 + 510] = 0X55;
+    vol[i * 512 + 511] = 0XAA;
+  }
+  uint32_t sum = 0;
+  for (uint32_t i = 0; i < 11 * 512; i++) {
+    if (i != 106 && i != 107 && i != 112) {
+      sum = bootChecksum(sum, vol[i]);
+    }
+  }
+  for (uint32_t i = 0; i < 512; i += 4) {
+    memcpy(&vol[11 * 512 + i], &sum, 4);
+  }
+  // backup boot region
+  memcpy(&vol[12 * 512], vol, 12 * 512);
+
+  if (partitioned) {
+    part_t* p = reinterpret_cast<mbr_t*>(&image[0])->part;
+    p->boot = 0;
+    p->type = 7;
+    p->firstSector = volumeStart;
+    p->totalSectors = volumeLength;
+    image[510] = 0X55;
+    image[511] = 0XAA;
+  }
+  init();
+
+  fatPut(0, 0XFFFFFFF8);
+  fatPut(1, EXFAT_EOC);
+  for (uint32_t c = EXFAT_FIRST_CLUSTER; c < upcaseCluster; c++) {
+    fatPut(c, c + 1 < upcaseCluster ? c + 1 : EXFAT_EOC);
+  }
+  fatPut(upcaseCluster, EXFAT_EOC);
+  fatPut(rootCluster, EXFAT_EOC);
+  for (uint32_t c = EXFAT_FIRST_CLUSTER; c <= rootCluster; c++) {
+    uint32_t i = c - EXFAT_FIRST_CLUSTER;
+    clusterData(EXFAT_FIRST_CLUSTER)[i >> 3] |= 1 << (i & 7);
+  }
+  uint8_t* upcase = clusterData(upcaseCluster);
+  uint32_t upcaseSum = 0;
+  for (uint16_t c = 0; c < UPCASE_CHARS; c++) {
+    uint16_t u = toupper(c);
+    memcpy(&upcase[2 * c], &u, 2);
+  }
+  for (uint16_t i = 0; i < 2 * UPCASE_CHARS; i++) {
+    upcaseSum = bootChecksum(upcaseSum, upcase[i]);
+  }
+
+  exfat_dir_t* root = reinterpret_cast<exfat_dir_t*>(clusterData(rootCluster));
+  root[0].bitmap.type = EXFAT_TYPE_BITMAP;
+  root[0].bitmap.firstCluster = EXFAT_FIRST_CLUSTER;
+  root[0].bitmap.dataLength = bitmapLength;
+  // the up-case entry has TableChecksum at offset 4, FirstCluster at 20
+  // and DataLength at 24
+  root[1].type = EXFAT_TYPE_UPCASE;
+  memcpy(&root[1].data[4], &upcaseSum, 4);
+  memcpy(&root[1].data[20], &upcaseCluster, 4);
+  uint64_t upcaseLength = 2 * UPCASE_CHARS;
+  memcpy(&root[1].data[24], &upcaseLength, 8);
+}
+//------------------------------------------------------------------------------
+ExFatImage::ExFatImage(const std::vector<uint8_t>& contents) : image(contents) {
+  init();
+}
+//------------------------------------------------------------------------------
+void ExFatImage::init() {
+  volumeStart_ = 0;
+  if (memcmp(&image[3], "EXFAT   ", 8)) {
+    volumeStart_ = reinterpret_cast<const mbr_t*>(&image[0])->part[0].firstSector;
+  }
+  const exfat_bs_t* bs = reinterpret_cast<const exfat_bs_t*>(&image[volumeStart_ * 512UL]);
+  fatStart_ = volumeStart_ + bs->fatOffset;
+  heapStart_ = volumeStart_ + bs->clusterHeapOffset;
+  clusterCount_ = bs->clusterCount;
+  clusterShift_ = bs->sectorsPerClusterShift;
+  rootCluster_ = bs->rootDirectoryCluster;
+  bitmapCluster_ = EXFAT_FIRST_CLUSTER;
+  // the bitmap is found through its root directory entry
+  const exfat_dir_t* root = reinterpret_cast<const exfat_dir_t*>(clusterData(rootCluster_));
+  for (uint16_t i = 0; i < clusterBytes() / 32 && root[i].type != EXFAT_TYPE_END; i++) {
+    if (root[i].type == EXFAT_TYPE_BITMAP) {
+      bitmapCluster_ = root[i].bitmap.firstCluster;
+      break;
+    }
+  }
+}
+//------------------------------------------------------------------------------
+uint32_t ExFatImage::fatGet(uint32_t cluster) const {
+  uint32_t v;
+  memcpy(&v, &image[fatStart_ * 512UL + 4 * cluster], 4);
+  return v;
+}
+//------------------------------------------------------------------------------
+void ExFatImage::fatPut(uint32_t cluster, uint32_t value) {
+  memcpy(&image[fatStart_ * 512UL + 4 * cluster], &value, 4);
+}
+//------------------------------------------------------------------------------
+uint8_t* ExFatImage::clusterData(uint32_t cluster) {
+  return &image[(heapStart_ + ((cluster - EXFAT_FIRST_CLUSTER) << clusterShift_)) * 512UL];
+}
+//------------------------------------------------------------------------------
+const uint8_t* ExFatImage::clusterData(uint32_t cluster) const {
+  return &image[(heapStart_ + ((cluster - EXFAT_FIRST_CLUSTER) << clusterShift_)) * 512UL];
+}
+//------------------------------------------------------------------------------
+// the bitmap is contiguous, the library refuses to mount it otherwise
+bool ExFatImage::bitmapGet(uint32_t cluster) const {
+  uint32_t i = cluster - EXFAT_FIRST_CLUSTER;
+  return (clusterData(bitmapCluster_)[i >> 3] >> (i & 7)) & 1;
+}
+//------------------------------------------------------------------------------
+uint32_t ExFatImage::usedClusters() const {
+  uint32_t n = 0;
+  for (uint32_t c = EXFAT_FIRST_CLUSTER; c < clusterCount_ + EXFAT_FIRST_CLUSTER; c++) {
+    n += bitmapGet(c);
+  }
+  return n;
+}
+//------------------------------------------------------------------------------
+// the clusters of length bytes, zero length for a chain that runs to its end
+// of chain mark, and mark them as used
+bool ExFatImage::chain(uint32_t first, uint64_t length, bool noFatChain,
+                       std::vector<uint32_t>* clusters, std::vector<uint8_t>* used,
+                       Report* report) const {
+  uint64_t count = length ? (length + clusterBytes() - 1) / clusterBytes() : UINT64_MAX;
+  uint32_t c = first;
+  for (uint64_t n = 0; n < count; n++) {
+    if (c == EXFAT_EOC && !length) {
+      return true;
+    }
+    if (c < EXFAT_FIRST_CLUSTER || c >= clusterCount_ + EXFAT_FIRST_CLUSTER) {
+      report->badChains++;
+      return false;
+    }
+    if ((*used)[c]) {
+      report->crossLinks++;
+      return false;
+    }
+    (*used)[c] = 1;
+    clusters->push_back(c);
+    c = noFatChain ? c + 1 : fatGet(c);
+  }
+  if (!noFatChain && c != EXFAT_EOC) {
+    report->badChains++;
+    return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+void ExFatImage::walk(const std::vector<uint32_t>& clusters, uint64_t length,
+                      std::vector<uint8_t>* used, Report* report) const {
+  std::vector<const exfat_dir_t*> entries;
+  for (size_t k = 0; k < clusters.size(); k++) {
+    const exfat_dir_t* dir = reinterpret_cast<const exfat_dir_t*>(clusterData(clusters[k]));
+    for (uint16_t i = 0; i < clusterBytes() / 32; i++) {
+      entries.push_back(&dir[i]);
+    }
+  }
+  if (length && length < entries.size() * 32) {
+    entries.resize(length / 32);
+  }
+  for (size_t i = 0; i < entries.size(); i++) {
+    const exfat_dir_t* p = entries[i];
+    if (p->type == EXFAT_TYPE_END) {
+      break;
+    }
+    std::vector<uint32_t> data;
+    if (p->type == EXFAT_TYPE_BITMAP) {
+      chain(p->bitmap.firstCluster, p->bitmap.dataLength, false, &data, used, report);
+      continue;
+    }
+    if (p->type == EXFAT_TYPE_UPCASE) {
+      uint32_t first;
+      uint64_t dataLength;
+      memcpy(&first, &p->data[20], 4);
+      memcpy(&dataLength, &p->data[24], 8);
+      chain(first, dataLength, false, &data, used, report);
+      continue;
+    }
+    if (p->type != EXFAT_TYPE_FILE) {
+      continue;
+    }
+    uint8_t count = p->file.secondaryCount;
+    if (count < 2 || i + count >= entries.size() || entries[i + 1]->type != EXFAT_TYPE_STREAM) {
+      report->badEntrySets++;
+      continue;
+    }
+    uint16_t sum = 0;
+    for (uint8_t k = 0; k <= count; k++) {
+      sum = exfatSetChecksum(sum, entries[i + k]->data, k == 0);
+    }
+    const exfatStreamEntry* s = &entries[i + 1]->stream;
+    uint16_t hash = 0;
+    uint8_t chars = 0;
+    for (uint8_t k = 2; k <= count && chars < s->nameLength; k++) {
+      if (entries[i + k]->type != EXFAT_TYPE_NAME) {
+        report->badEntrySets++;
+        break;
+      }
+      for (uint8_t j = 0; j < EXFAT_NAME_CHARS && chars < s->nameLength; j++, chars++) {
+        uint16_t c = entries[i + k]->name.name[j];
+        hash = exfatNameHash(hash, c < UPCASE_CHARS ? toupper(c) : c);
+      }
+    }
+    if (sum != p->file.setChecksum || hash != s->nameHash || chars != s->nameLength) {
+      report->badEntrySets++;
+    }
+    if (s->validDataLength > s->dataLength) {
+      report->badLengths++;
+    }
+    bool noFatChain = s->flags & EXFAT_FLAG_NO_FAT_CHAIN;
+    if (p->file.attributes & EXFAT_ATTRIB_DIRECTORY) {
+      report->directories++;
+      if (!s->dataLength || s->dataLength % clusterBytes() || s->validDataLength != s->dataLength) {
+        report->badLengths++;
+      } else if (chain(s->firstCluster, s->dataLength, noFatChain, &data, used, report)) {
+        walk(data, s->dataLength, used, report);
+      }
+    } else {
+      report->files++;
+      if (s->dataLength) {
+        chain(s->firstCluster, s->dataLength, noFatChain, &data, used, report);
+      }
+    }
+    i += count;
+  }
+}
+//------------------------------------------------------------------------------
+ExFatImage::Report ExFatImage::check() const {
+  Report report;
+  memset(&report, 0, sizeof(report));
+  std::vector<uint8_t> used(clusterCount_ + EXFAT_FIRST_CLUSTER);
+  std::vector<uint32_t> root;
+  if (chain(rootCluster_, 0, false, &root, &used, &report)) {
+    walk(root, 0, &used, &report);
+  }
+  for (uint32_t c = EXFAT_FIRST_CLUSTER; c < clusterCount_ + EXFAT_FIRST_CLUSTER; c++) {
+    report.leakedClusters += bitmapGet(c) && !used[c];
+    report.unmarkedClusters += !bitmapGet(c) && used[c];
+  }
+  return report;
+}
@@ -0,0 +1,88 @@
+/*
+   ExFatImage - exFAT card images for the host tests of the SD library.
+
+   Formats an empty volume, with or without a partition table, the way
+   mkfs.exfat would: allocation bitmap, up-case table and root directory in
+   the first clusters of the heap.  check() walks every directory entry set
+   and chain and compares the clusters in use with the allocation bitmap.
+*/
+#ifndef ExFatImage_h
+#define ExFatImage_h
+
+#include <stdint.h>
+#include <vector>
+
+#include <utility/FatStructs.h>
+#include <utility/ExFatStructs.h>
+
+class ExFatImage {
+  public:
+    /** What check() found on the volume. */
+    struct Report {
+      /** Files and directories, not counting the root. */
+      uint32_t files;
+      uint32_t directories;
+      /** Clusters marked in the bitmap that nothing uses. */
+      uint32_t leakedClusters;
+      /** Clusters in use that the bitmap marks free. */
+      uint32_t unmarkedClusters;
+      /** Chains that leave the heap, don't end at their length or aren't
+          terminated. */
+      uint32_t badChains;
+      /** Clusters used by more than one chain. */
+      uint32_t crossLinks;
+      /** Entry sets with a bad checksum, name hash or secondary entry. */
+      uint32_t badEntrySets;
+      /** Valid data past the data length, or a directory length that isn't
+          a whole number of clusters. */
+      uint32_t badLengths;
+
+      bool ok() const {
+        return !leakedClusters && !unmarkedClusters && !badChains &&
+               !crossLinks && !badEntrySets && !badLengths;
+      }
+    };
+    /** The card contents. */
+    std::vector<uint8_t> image;
+
+    /** Format a volume of \a megabytes with 512 << \a clusterShift byte
+        clusters, in partition one at block 2048 if \a partitioned. */
+    ExFatImage(uint32_t megabytes, uint8_t clusterShift, bool partitioned = false);
+    /** Attach to a card image, for check(). */
+    explicit ExFatImage(const std::vector<uint8_t>& contents);
+
+    uint32_t clusterCount() const {
+      return clusterCount_;
+    }
+    uint32_t clusterBytes() const {
+      return 512UL << clusterShift_;
+    }
+    /** Clusters marked in the allocation bitmap. */
+    uint32_t usedClusters() const;
+    /** Whether \a cluster is marked in the allocation bitmap. */
+    bool bitmapGet(uint32_t cluster) const;
+
+    /** Walk every directory and chain. */
+    Report check() const;
+
+  private:
+    uint32_t volumeStart_;
+    uint32_t fatStart_;
+    uint32_t heapStart_;
+    uint32_t clusterCount_;
+    uint8_t clusterShift_;
+    uint32_t rootCluster_;
+    uint32_t bitmapCluster_;
+
+    void init();
+    uint32_t fatGet(uint32_t cluster) const;
+    void fatPut(uint32_t cluster, uint32_t value);
+    uint8_t* clusterData(uint32_t cluster);
+    const uint8_t* clusterData(uint32_t cluster) const;
+    bool chain(uint32_t first, uint64_t length, bool noFatChain,
+               std::vector<uint32_t>* clusters, std::vector<uint8_t>* used, Report* report) const;
+    void walk(const std::vector<uint32_t>& clusters, uint64_t length,
+              std::vector<uint8_t>* used, Report* report) const;
+};
+
+#endif  // ExFatImage_h
@@ -0,0 +1,366 @@
+/*
+   FatImage - FAT16 and FAT32 card images for the host tests of the SD library.
+*/
+#include "FatImage.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+//------------------------------------------------------------------------------
+// "name.ext" to the blank filled, upper case 11 characters of a dir_t
+static void shortName(const char* name, uint8_t* out) {
+  memset(out, ' ', 11);
+  if (!strcmp(name, ".") || !strcmp(name, "..")) {
+    memcpy(out, name, strlen(name));
+    return;
+  }
+  uint8_t i = 0;
+  uint8_t end = 8;
+  for (const char* p = name; *p; p++) {
+    if (*p == '.') {
+      i = 8;
+      end = 11;
+    } else if (i < end) {
+      out[i++] = toupper(*p);
+    }
+  }
+}
+//------------------------------------------------------------------------------
+FatImage::FatImage(uint32_t megabytes, uint8_t fatType) : image(megabytes * 1024UL * 1024UL) {
+  uint32_t totalBlocks = megabytes * 2048UL;
+  bool fat32 = fatType == 32;
+  uint8_t sectorsPerCluster = fat32 ? 1 : 4;
+  uint16_t reservedBlocks = fat32 ? 32 : 1;
+  uint16_t rootEntries = fat32 ? 0 : 512;
+  uint32_t fatBlocks = fat32 ? ((totalBlocks + 2) * 4 + 511) / 512
+                       : ((totalBlocks / sectorsPerCluster + 2) * 2 + 511) / 512;
+
+  fbs_t* fbs = reinterpret_cast<fbs_t*>(&image[0]);
+  const uint8_t jump[3] = {0XEB, (uint8_t)(fat32 ? 0X58 : 0X3C), 0X90};
+  memcpy(fbs->jmpToBootCode, jump, 3);
+  memcpy(fbs->oemName, "MSWIN4.1", 8);
+  bpb_t* bpb = &fbs->bpb;
+  bpb->bytesPerSector = 512;
+  bpb->sectorsPerCluster = sectorsPerCluster;
+  bpb->reservedSectorCount = reservedBlocks;
+  bpb->fatCount = 2;
+  bpb->rootDirEntryCount = rootEntries;
+  bpb->totalSectors16 = 0;
+  bpb->mediaType = 0XF8;
+  bpb->sectorsPerFat16 = fat32 ? 0 : fatBlocks;
+  bpb->sectorsPerTrtack = 63;
+  bpb->headCount = 255;
+  bpb->hidddenSectors = 0;
+  bpb->totalSectors32 = totalBlocks;
+  if (fat32) {
+    bpb->sectorsPerFat32 = fatBlocks;
+    bpb->fat32RootCluster = 2;
+    bpb->fat32FSInfo = 1;
+    bpb->fat32BackBootBlock = 6;
+  }
+  // the FAT16 boot sector has its extended fields where the FAT32 BPB starts
+  uint8_t* ext = fat32 ? &fbs->driveNumber : &image[36];
+  ext[0] = 0X80;
+  ext[2] = 0X29;
+  memcpy(ext + 7, "NO NAME    ", 11);
+  memcpy(ext + 18, fat32 ? "FAT32   " : "FAT16   ", 8);
+  fbs->bootSectorSig0 = 0X55;
+  fbs->bootSectorSig1 = 0XAA;
+  if (fat32) {
+    // FSINFO with unknown free count, and the backup boot sector
+    uint8_t* fsInfo = &image[512];
+    const uint32_t lead = 0X41615252, structSig = 0X61417272, unknown = 0XFFFFFFFF, trail = 0XAA550000;
+    memcpy(fsInfo, &lead, 4);
+    memcpy(fsInfo + 484, &structSig, 4);
+    memcpy(fsInfo + 488, &unknown, 4);
+    memcpy(fsInfo + 492, &unknown, 4);
+    memcpy(fsInfo + 508, &trail, 4);
+    memcpy(&image[6 * 512], &image[0], 2 * 512);
+  }
+  init();
+
+  fatPut(0, fat32 ? 0X0FFFFFF8 : 0XFFF8);
+  fatPut(1, fat32 ? FAT32EOC : FAT16EOC);
+  if (fat32) {
+    fatPut(rootCluster_, FAT32EOC);
+  }
+}
+//------------------------------------------------------------------------------
+FatImage::FatImage(const std::vector<uint8_t>& contents) : image(contents) {
+  init();
+}
+//------------------------------------------------------------------------------
+void FatImage::init() {
+  const bpb_t* bpb = &reinterpret_cast<const fbs_t*>(&image[0])->bpb;
+  fatCount_ = bpb->fatCount;
+  sectorsPerCluster_ = bpb->sectorsPerCluster;
+  fatStartBlock_ = bpb->reservedSectorCount;
+  blocksPerFat_ = bpb->sectorsPerFat16 ? bpb->sectorsPerFat16 : bpb->sectorsPerFat32;
+  rootDirStart_ = fatStartBlock_ + fatCount_ * blocksPerFat_;
+  rootDirEntryCount_ = bpb->rootDirEntryCount;
+  dataStartBlock_ = rootDirStart_ + (32UL * rootDirEntryCount_ + 511) / 512;
+  uint32_t totalBlocks = bpb->totalSectors16 ? bpb->totalSectors16 : bpb->totalSectors32;
+  clusterCount_ = (totalBlocks - dataStartBlock_) / sectorsPerCluster_;
+  fatType_ = clusterCount_ < 65525 ? 16 : 32;
+  rootCluster_ = fatType_ == 32 ? bpb->fat32RootCluster : 0;
+  nextFree_ = 2;
+}
+//------------------------------------------------------------------------------
+uint32_t FatImage::fatGet(uint32_t cluster, uint8_t fat) const {
+  const uint8_t* p = &image[(fatStartBlock_ + fat * blocksPerFat_) * 512UL];
+  if (fatType_ == 16) {
+    uint16_t v;
+    memcpy(&v, p + 2 * cluster, 2);
+    return v;
+  }
+  uint32_t v;
+  memcpy(&v, p + 4 * cluster, 4);
+  return v & FAT32MASK;
+}
+//------------------------------------------------------------------------------
+void FatImage::fatPut(uint32_t cluster, uint32_t value) {
+  for (uint8_t fat = 0; fat < fatCount_; fat++) {
+    uint8_t* p = &image[(fatStartBlock_ + fat * blocksPerFat_) * 512UL];
+    if (fatType_ == 16) {
+      uint16_t v = value;
+      memcpy(p + 2 * cluster, &v, 2);
+    } else {
+      memcpy(p + 4 * cluster, &value, 4);
+    }
+  }
+}
+//------------------------------------------------------------------------------
+bool FatImage::isEOC(uint32_t cluster) const {
+  return cluster >= (fatType_ == 16 ? FAT16EOC_MIN : FAT32EOC_MIN);
+}
+//------------------------------------------------------------------------------
+uint32_t FatImage::usedClusters() const {
+  uint32_t n = 0;
+  for (uint32_t c = 2; c < clusterCount_ + 2; c++) {
+    n += fatGet(c) != 0;
+  }
+  return n;
+}
+//------------------------------------------------------------------------------
+// contiguous clusters, zero filled
+uint32_t FatImage::allocate(uint32_t count) {
+  while (nextFree_ < clusterCount_ + 2 && fatGet(nextFree_)) {
+    nextFree_++;
+  }
+  uint32_t first = nextFree_;
+  if (!count || first + count > clusterCount_ + 2) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    fatPut(first + i, i + 1 < count ? first + i + 1 : FAT32EOC);
+    memset(clusterData(first + i), 0, clusterBytes());
+  }
+  nextFree_ = first + count;
+  return first;
+}
+//------------------------------------------------------------------------------
+uint8_t* FatImage::clusterData(uint32_t cluster) {
+  return &image[(dataStartBlock_ + (cluster - 2) * sectorsPerCluster_) * 512UL];
+}
+//------------------------------------------------------------------------------
+const uint8_t* FatImage::clusterData(uint32_t cluster) const {
+  return &image[(dataStartBlock_ + (cluster - 2) * sectorsPerCluster_) * 512UL];
+}
+//------------------------------------------------------------------------------
+// first free entry of a directory, which grows by a cluster when full
+dir_t* FatImage::freeEntry(uint32_t dirCluster) {
+  uint16_t perCluster = clusterBytes() / 32;
+  if (!dirCluster && fatType_ == 16) {
+    dir_t* dir = reinterpret_cast<dir_t*>(&image[rootDirStart_ * 512UL]);
+    for (uint16_t i = 0; i < rootDirEntryCount_; i++) {
+      if (dir[i].name[0] == DIR_NAME_FREE) {
+        return &dir[i];
+      }
+    }
+    return NULL;
+  }
+  uint32_t cluster = dirCluster ? dirCluster : rootCluster_;
+  for (;;) {
+    dir_t* dir = reinterpret_cast<dir_t*>(clusterData(cluster));
+    for (uint16_t i = 0; i < perCluster; i++) {
+      if (dir[i].name[0] == DIR_NAME_FREE) {
+        return &dir[i];
+      }
+    }
+    uint32_t next = fatGet(cluster);
+    if (isEOC(next)) {
+      next = allocate(1);
+      if (!next) {
+        return NULL;
+      }
+      fatPut(cluster, next);
+    }
+    cluster = next;
+  }
+}
+//------------------------------------------------------------------------------
+void FatImage::addEntry(uint32_t dirCluster, const dir_t& entry) {
+  dir_t* d = freeEntry(dirCluster);
+  if (d) {
+    *d = entry;
+  }
+}
+//------------------------------------------------------------------------------
+uint32_t FatImage::add(uint32_t dirCluster, const char* name, uint8_t attributes,
+                       uint32_t size, uint16_t date, uint16_t time) {
+  dir_t entry;
+  memset(&entry, 0, sizeof(entry));
+  shortName(name, entry.name);
+  entry.attributes = attributes;
+  entry.creationDate = entry.lastAccessDate = entry.lastWriteDate = date;
+  entry.creationTime = entry.lastWriteTime = time;
+
+  uint32_t first = 0;
+  if (attributes & DIR_ATT_DIRECTORY) {
+    first = allocate(1);
+    if (!first) {
+      return 0;
+    }
+    dir_t* dot = reinterpret_cast<dir_t*>(clusterData(first));
+    dot[0] = entry;
+    shortName(".", dot[0].name);
+    dot[0].firstClusterHigh = first >> 16;
+    dot[0].firstClusterLow = first & 0XFFFF;
+    dot[1] = entry;
+    shortName("..", dot[1].name);
+    dot[1].firstClusterHigh = dirCluster >> 16;
+    dot[1].firstClusterLow = dirCluster & 0XFFFF;
+  } else if (size) {
+    uint32_t count = (size + clusterBytes() - 1) / clusterBytes();
+    first = allocate(count);
+    if (!first) {
+      return 0;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      clusterData(first + i / clusterBytes())[i % clusterBytes()] = pattern(i, first);
+    }
+    entry.fileSize = size;
+  }
+  entry.firstClusterHigh = first >> 16;
+  entry.firstClusterLow = first & 0XFFFF;
+  dir_t* d = freeEntry(dirCluster);
+  if (!d) {
+    return 0;
+  }
+  *d = entry;
+  return first;
+}
+//------------------------------------------------------------------------------
+bool FatImage::addLogs(uint32_t dirCluster, uint32_t count, uint32_t seed) {
+  // modify times are distinct two second steps from 2023-01-01, in an order
+  // shuffled by an LCG so the images are the same on every host
+  std::vector<uint32_t> order(count);
+  for (uint32_t i = 0; i < count; i++) {
+    order[i] = i;
+  }
+  uint32_t r = seed;
+  for (uint32_t i = count; i > 1; i--) {
+    r = r * 1664525UL + 1013904223UL;
+    uint32_t j = (r >> 8) % i;
+    uint32_t t = order[i - 1];
+    order[i - 1] = order[j];
+    order[j] = t;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    r = r * 1664525UL + 1013904223UL;
+    uint32_t size = 100 + (r >> 8) % (3 * clusterBytes() - 99);
+    uint32_t day = order[i] / 43200;
+    uint32_t seconds = 2 * (order[i] % 43200);
+    uint16_t date = (2023 - 1980) << 9 | (1 + day / 28) << 5 | (1 + day % 28);
+    uint16_t time = (seconds / 3600) << 11 | (seconds / 60 % 60) << 5 | (seconds % 60) / 2;
+    // room for any 32 bit index, though only seven digits fit an 8.3 name
+    char name[24];
+    if (snprintf(name, sizeof(name), "L%07lu.TXT", (unsigned long)i) > 12) {
+      return false;
+    }
+    if (!add(dirCluster, name, DIR_ATT_ARCHIVE, size, date, time)) {
+      return false;
+    }
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// follow a chain, marking its clusters as used
+bool FatImage::chain(uint32_t first, std::vector<uint32_t>* clusters,
+                     std::vector<uint8_t>* used, Report* report) const {
+  for (uint32_t c = first; !isEOC(c); c = fatGet(c)) {
+    if (c < 2 || c > clusterCount_ + 1) {
+      report->badChains++;
+      return false;
+    }
+    if ((*used)[c]) {
+      report->crossLinks++;
+      return false;
+    }
+    (*used)[c] = 1;
+    clusters->push_back(c);
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+void FatImage::walk(uint32_t dirCluster, std::vector<uint8_t>* used, Report* report) const {
+  std::vector<const dir_t*> entries;
+  if (!dirCluster && fatType_ == 16) {
+    const dir_t* dir = reinterpret_cast<const dir_t*>(&image[rootDirStart_ * 512UL]);
+    for (uint16_t i = 0; i < rootDirEntryCount_; i++) {
+      entries.push_back(&dir[i]);
+    }
+  } else {
+    std::vector<uint32_t> clusters;
+    if (!chain(dirCluster ? dirCluster : rootCluster_, &clusters, used, report)) {
+      return;
+    }
+    for (size_t k = 0; k < clusters.size(); k++) {
+      const dir_t* dir = reinterpret_cast<const dir_t*>(clusterData(clusters[k]));
+      for (uint16_t i = 0; i < clusterBytes() / 32; i++) {
+        entries.push_back(&dir[i]);
+      }
+    }
+  }
+  for (size_t i = 0; i < entries.size(); i++) {
+    const dir_t* d = entries[i];
+    if (d->name[0] == DIR_NAME_FREE) {
+      break;
+    }
+    if (d->name[0] == DIR_NAME_DELETED || d->name[0] == '.' || !DIR_IS_FILE_OR_SUBDIR(d)) {
+      continue;
+    }
+    uint32_t first = (uint32_t)d->firstClusterHigh << 16 | d->firstClusterLow;
+    if (DIR_IS_SUBDIR(d)) {
+      report->directories++;
+      walk(first, used, report);
+      continue;
+    }
+    report->files++;
+    if (!first) {
+      report->badChains += d->fileSize != 0;
+      continue;
+    }
+    std::vector<uint32_t> clusters;
+    if (chain(first, &clusters, used, report)
+        && clusters.size() != (d->fileSize + clusterBytes() - 1) / clusterBytes()) {
+      report->badChains++;
+    }
+  }
+}
+//------------------------------------------------------------------------------
+FatImage::Report FatImage::check() const {
+  Report report;
+  memset(&report, 0, sizeof(report));
+  std::vector<uint8_t> used(clusterCount_ + 2);
+  walk(0, &used, &report);
+  for (uint32_t c = 2; c < clusterCount_ + 2; c++) {
+    report.leakedClusters += fatGet(c) && !used[c];
+  }
+  report.fatsMatch = true;
+  for (uint8_t fat = 1; fat < fatCount_; fat++) {
+    report.fatsMatch &= !memcmp(&image[fatStartBlock_ * 512UL],
+                                &image[(fatStartBlock_ + fat * blocksPerFat_) * 512UL], blocksPerFat_ * 512UL);
+  }
+  return report;
+}
@@ -0,0 +1,101 @@
+/*
+   FatImage - FAT16 and FAT32 card images for the host tests of the SD library.
+
+   Formats a volume without a partition table, adds files and directories to
+   it the way a computer would, and checks its consistency after the library
+   has written to it.
+*/
+#ifndef FatImage_h
+#define FatImage_h
+
+#include <stdint.h>
+#include <vector>
+
+#include <utility/FatStructs.h>
+
+class FatImage {
+  public:
+    /** What check() found on the volume. */
+    struct Report {
+      /** Files and directories, not counting dot entries. */
+      uint32_t files;
+      uint32_t directories;
+      /** Clusters allocated in the FAT that no file or directory uses. */
+      uint32_t leakedClusters;
+      /** Chains that don't match their file size, or leave the volume. */
+      uint32_t badChains;
+      /** Clusters used by more than one chain. */
+      uint32_t crossLinks;
+      /** All FAT copies are identical. */
+      bool fatsMatch;
+
+      bool ok() const {
+        return !leakedClusters && !badChains && !crossLinks && fatsMatch;
+      }
+    };
+    /** The card contents. */
+    std::vector<uint8_t> image;
+
+    /** Format a FAT16 or FAT32 volume of \a megabytes. */
+    FatImage(uint32_t megabytes, uint8_t fatType);
+    /** Attach to a card image, for check(). */
+    explicit FatImage(const std::vector<uint8_t>& contents);
+
+    uint8_t fatType() const {
+      return fatType_;
+    }
+    uint32_t clusterCount() const {
+      return clusterCount_;
+    }
+    uint32_t clusterBytes() const {
+      return 512UL * sectorsPerCluster_;
+    }
+    /** Clusters allocated in the FAT. */
+    uint32_t usedClusters() const;
+
+    /** Add an entry to the directory starting at \a dirCluster, zero for
+        the root.  Files get contiguous clusters for \a size bytes filled
+        with pattern(), directories get an empty cluster with dot entries.
+        Returns the first cluster, zero if there is none. */
+    uint32_t add(uint32_t dirCluster, const char* name, uint8_t attributes,
+                 uint32_t size = 0, uint16_t date = 0, uint16_t time = 0);
+    /** Add a raw entry, for long name, deleted or volume label entries. */
+    void addEntry(uint32_t dirCluster, const dir_t& entry);
+    /** Add \a count log files L0000000.TXT... of 100 bytes to three
+        clusters, each with a different modify time, shuffled by \a seed.
+        Returns false if the volume is full. */
+    bool addLogs(uint32_t dirCluster, uint32_t count, uint32_t seed);
+
+    /** Byte \a i of the files added by add(). */
+    static uint8_t pattern(uint32_t i, uint32_t seed) {
+      return (uint8_t)((i * 2654435761UL + seed) >> 13);
+    }
+    /** Walk every directory and chain. */
+    Report check() const;
+
+  private:
+    uint8_t fatType_;
+    uint8_t fatCount_;
+    uint8_t sectorsPerCluster_;
+    uint32_t fatStartBlock_;
+    uint32_t blocksPerFat_;
+    uint32_t rootDirStart_;
+    uint16_t rootDirEntryCount_;
+    uint32_t dataStartBlock_;
+    uint32_t clusterCount_;
+    uint32_t rootCluster_;
+    uint32_t nextFree_;
+
+    void init();
+    uint32_t fatGet(uint32_t cluster, uint8_t fat = 0) const;
+    void fatPut(uint32_t cluster, uint32_t value);
+    bool isEOC(uint32_t cluster) const;
+    uint32_t allocate(uint32_t count);
+    uint8_t* clusterData(uint32_t cluster);
+    const uint8_t* clusterData(uint32_t cluster) const;
+    dir_t* freeEntry(uint32_t dirCluster);
+    bool chain(uint32_t first, std::vector<uint32_t>* clusters, std::vector<uint8_t>* used, Report* report) const;
+    void walk(uint32_t dirCluster, std::vector<uint8_t>* used, Report* report) const;
+};
+
+#endif  // FatImage_h
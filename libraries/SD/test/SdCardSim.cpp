@@ -0,0 +1,233 @@
+/*
+   SdCardSim - an SDHC card in SPI mode for the host tests of the SD library.
+*/
+#include "SdCardSim.h"
+
+#include <SPI.h>
+#include <string.h>
+
+SdCardSim sdCardSim;
+SPIClass SPI;
+// the AVR heap bounds that FreeRam() in SdFatUtil.h refers to
+int __bss_end;
+int* __brkval;
+//------------------------------------------------------------------------------
+uint8_t SPIClass::transfer(uint8_t data) {
+  return sdCardSim.transfer(data);
+}
+//------------------------------------------------------------------------------
+// R1 response flags
+static const uint8_t R1_IDLE = 0X01;
+static const uint8_t R1_ILLEGAL_COMMAND = 0X04;
+static const uint8_t R1_PARAMETER_ERROR = 0X40;
+// data tokens
+static const uint8_t START_BLOCK = 0XFE;
+static const uint8_t START_MULTIPLE = 0XFC;
+static const uint8_t STOP_MULTIPLE = 0XFD;
+static const uint8_t DATA_ACCEPTED = 0X05;
+//------------------------------------------------------------------------------
+void SdCardSim::insert(const std::vector<uint8_t>& contents) {
+  image = contents;
+  reset();
+}
+//------------------------------------------------------------------------------
+void SdCardSim::reset() {
+  blocksRead = 0;
+  blocksWritten = 0;
+  state_ = IDLE;
+  commandLength_ = 0;
+  appCommand_ = false;
+  multipleWrite_ = false;
+  writeBlock_ = 0;
+  eraseStart_ = 0;
+  eraseEnd_ = 0;
+  writeBuffer_.clear();
+  miso_.clear();
+}
+//------------------------------------------------------------------------------
+void SdCardSim::busy() {
+  for (uint8_t i = 0; i < busyBytes; i++) {
+    miso_.push_back(0X00);
+  }
+}
+//------------------------------------------------------------------------------
+// a data block: some access time, start token, data and CRC
+void SdCardSim::sendBlock(const uint8_t* data, uint16_t size) {
+  miso_.push_back(0XFF);
+  miso_.push_back(0XFF);
+  miso_.push_back(START_BLOCK);
+  miso_.insert(miso_.end(), data, data + size);
+  miso_.push_back(0XFF);
+  miso_.push_back(0XFF);
+}
+//------------------------------------------------------------------------------
+void SdCardSim::respond(uint8_t cmd, uint32_t arg) {
+  uint32_t blocks = image.size() / 512;
+  bool app = appCommand_;
+  appCommand_ = false;
+  // a new command aborts whatever the card was still sending
+  miso_.clear();
+  // NCR, one byte before the response
+  miso_.push_back(0XFF);
+
+  if (app) {
+    // ACMD41 leaves the idle state, ACMD23 sets the pre-erase count
+    miso_.push_back(cmd == 41 || cmd == 23 ? 0X00 : R1_ILLEGAL_COMMAND);
+    return;
+  }
+  switch (cmd) {
+    case 0:
+      miso_.push_back(R1_IDLE);
+      break;
+
+    case 8: {
+      // voltage accepted, echo of the check pattern
+      const uint8_t r7[] = {R1_IDLE, 0X00, 0X00, 0X01, 0XAA};
+      miso_.insert(miso_.end(), r7, r7 + sizeof(r7));
+      break;
+    }
+    case 55:
+      miso_.push_back(0X00);
+      appCommand_ = true;
+      break;
+
+    case 58: {
+      // OCR with power up done and high capacity
+      const uint8_t r3[] = {0X00, 0XC0, 0XFF, 0X80, 0X00};
+      miso_.insert(miso_.end(), r3, r3 + sizeof(r3));
+      break;
+    }
+    case 9: {
+      // CSD version 2, c_size is the size in 512 KiB units minus one
+      uint8_t csd[16] = {0X40, 0X0E, 0X00, 0X32, 0X5B, 0X59, 0X00};
+      uint32_t cSize = blocks / 1024 - 1;
+      csd[7] = (cSize >> 16) & 0X3F;
+      csd[8] = cSize >> 8;
+      csd[9] = cSize;
+      csd[10] = 0X7F;  // erase_blk_en and sector_size
+      csd[11] = 0X80;
+      csd[15] = 0X01;
+      miso_.push_back(0X00);
+      sendBlock(csd, sizeof(csd));
+      break;
+    }
+    case 10: {
+      uint8_t cid[16] = {0X03, 'S', 'D', 'H', 'O', 'S', 'T', ' ', ' ', 0X10};
+      miso_.push_back(0X00);
+      sendBlock(cid, sizeof(cid));
+      break;
+    }
+    case 13:
+      // R2, no error bits
+      miso_.push_back(0X00);
+      miso_.push_back(0X00);
+      break;
+
+    case 17:
+      if (arg >= blocks) {
+        miso_.push_back(R1_PARAMETER_ERROR);
+        break;
+      }
+      miso_.push_back(0X00);
+      sendBlock(&image[(size_t)arg * 512], 512);
+      blocksRead++;
+      break;
+
+    case 24:
+    case 25:
+      if (arg >= blocks) {
+        miso_.push_back(R1_PARAMETER_ERROR);
+        break;
+      }
+      miso_.push_back(0X00);
+      writeBlock_ = arg;
+      multipleWrite_ = cmd == 25;
+      state_ = WRITE_TOKEN;
+      break;
+
+    case 32:
+      eraseStart_ = arg;
+      miso_.push_back(0X00);
+      break;
+
+    case 33:
+      eraseEnd_ = arg;
+      miso_.push_back(0X00);
+      break;
+
+    case 38:
+      if (eraseStart_ > eraseEnd_ || eraseEnd_ >= blocks) {
+        miso_.push_back(R1_PARAMETER_ERROR);
+        break;
+      }
+      memset(&image[(size_t)eraseStart_ * 512], 0, (size_t)(eraseEnd_ - eraseStart_ + 1) * 512);
+      miso_.push_back(0X00);
+      busy();
+      break;
+
+    default:
+      miso_.push_back(R1_ILLEGAL_COMMAND);
+      break;
+  }
+}
+//------------------------------------------------------------------------------
+uint8_t SdCardSim::transfer(uint8_t mosi) {
+  uint8_t r = 0XFF;
+  if (!miso_.empty()) {
+    r = miso_.front();
+    miso_.pop_front();
+  }
+  switch (state_) {
+    case IDLE:
+      // commands start with 01 in the two high bits
+      if ((mosi & 0XC0) == 0X40) {
+        command_[0] = mosi;
+        commandLength_ = 1;
+        state_ = COMMAND;
+      }
+      break;
+
+    case COMMAND:
+      command_[commandLength_++] = mosi;
+      if (commandLength_ == sizeof(command_)) {
+        state_ = IDLE;
+        respond(command_[0] & 0X3F, (uint32_t)command_[1] << 24 | (uint32_t)command_[2] << 16
+                | (uint32_t)command_[3] << 8 | command_[4]);
+      }
+      break;
+
+    case WRITE_TOKEN:
+      if (mosi == START_BLOCK || (multipleWrite_ && mosi == START_MULTIPLE)) {
+        writeBuffer_.clear();
+        state_ = WRITE_DATA;
+      } else if (multipleWrite_ && mosi == STOP_MULTIPLE) {
+        state_ = IDLE;
+        miso_.push_back(0XFF);
+        busy();
+      }
+      break;
+
+    case WRITE_DATA:
+      writeBuffer_.push_back(mosi);
+      // data and two CRC bytes
+      if (writeBuffer_.size() == 514) {
+        if ((size_t)writeBlock_ * 512 + 512 > image.size()) {
+          state_ = IDLE;
+          miso_.push_back(0X0D);  // write error
+          break;
+        }
+        memcpy(&image[(size_t)writeBlock_ * 512], writeBuffer_.data(), 512);
+        blocksWritten++;
+        miso_.push_back(DATA_ACCEPTED);
+        busy();
+        if (multipleWrite_) {
+          writeBlock_++;
+          state_ = WRITE_TOKEN;
+        } else {
+          state_ = IDLE;
+        }
+      }
+      break;
+  }
+  return r;
+}
@@ -0,0 +1,60 @@
+/*
+   SdCardSim - an SDHC card in SPI mode for the host tests of the SD library.
+
+   The card answers the commands Sd2Card sends through SPI.transfer() from
+   an in-memory image: initialization (CMD0, CMD8, ACMD41, CMD58), the CSD
+   and CID registers, single and multiple block reads and writes, status
+   and erase.  After every write the card stays busy for busyBytes bytes,
+   so that the waits of Sd2Card are exercised.
+*/
+#ifndef SdCardSim_h
+#define SdCardSim_h
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+class SdCardSim {
+  public:
+    /** Card contents, a multiple of 1024 blocks (the CSD size unit). */
+    std::vector<uint8_t> image;
+    /** Blocks sent to the host, partial reads included. */
+    uint32_t blocksRead;
+    /** Blocks programmed. */
+    uint32_t blocksWritten;
+    /** Bytes the card holds MISO low after a write or an erase. */
+    uint8_t busyBytes;
+
+    SdCardSim() : busyBytes(4) {
+      reset();
+    }
+    /** Insert a card with these contents. */
+    void insert(const std::vector<uint8_t>& contents);
+    /** Return the card to its power up state and clear the counters. */
+    void reset();
+    /** Exchange one byte with the host. */
+    uint8_t transfer(uint8_t mosi);
+
+  private:
+    enum State { IDLE, COMMAND, WRITE_TOKEN, WRITE_DATA };
+
+    State state_;
+    uint8_t command_[6];
+    uint8_t commandLength_;
+    bool appCommand_;
+    bool multipleWrite_;
+    uint32_t writeBlock_;
+    uint32_t eraseStart_;
+    uint32_t eraseEnd_;
+    std::vector<uint8_t> writeBuffer_;
+    std::deque<uint8_t> miso_;
+
+    void respond(uint8_t cmd, uint32_t arg);
+    void sendBlock(const uint8_t* data, uint16_t size);
+    void busy();
+};
+
+/** The card on the SPI bus. */
+extern SdCardSim sdCardSim;
+
+#endif  // SdCardSim_h
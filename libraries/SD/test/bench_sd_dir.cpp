@@ -0,0 +1,142 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SD.h>
+
+#include "FatImage.h"
+#include "SdCardSim.h"
+
+// /LOGS of a 64 MB FAT32 card holding 5000 log files with shuffled modify times, as a logger leaves it
+static const std::vector<uint8_t> &LogImage()
+{
+    static std::vector<uint8_t> image;
+
+    if (image.empty())
+    {
+        FatImage fat(64, 32);
+        fat.addLogs(fat.add(0, "LOGS", DIR_ATT_DIRECTORY), 5000, 1);
+        image = fat.image;
+    }
+
+    return image;
+}
+
+static File OpenLogs()
+{
+    sdCardSim.insert(LogImage());
+    SD.begin(4);
+    return SD.open("/LOGS");
+}
+
+// Card traffic per iteration, the cost on a real card
+static void CountBlocks(benchmark::State &state, uint32_t blocksRead, uint32_t blocksWritten)
+{
+    state.counters["blocks_read"] = benchmark::Counter(blocksRead, benchmark::Counter::kAvgIterations);
+    state.counters["blocks_written"] = benchmark::Counter(blocksWritten, benchmark::Counter::kAvgIterations);
+}
+
+static void BM_OpenNextFile(benchmark::State &state)
+{
+    File dir = OpenLogs();
+    sdCardSim.blocksRead = 0;
+
+    for (auto _ : state)
+    {
+        uint32_t total = 0;
+        dir.rewindDirectory();
+        for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+        {
+            total += f.size();
+            f.close();
+        }
+        benchmark::DoNotOptimize(total);
+    }
+
+    CountBlocks(state, sdCardSim.blocksRead, 0);
+}
+BENCHMARK(BM_OpenNextFile)->Unit(benchmark::kMillisecond);
+
+static void BM_DirIterator(benchmark::State &state)
+{
+    File dir = OpenLogs();
+    sdCardSim.blocksRead = 0;
+
+    for (auto _ : state)
+    {
+        uint32_t total = 0;
+        SdDirIterator it = dir.dirIterator();
+        for (const dir_t *p = it.next(); p; p = it.next())
+        {
+            total += p->fileSize;
+        }
+        benchmark::DoNotOptimize(total);
+    }
+
+    CountBlocks(state, sdCardSim.blocksRead, 0);
+}
+BENCHMARK(BM_DirIterator)->Unit(benchmark::kMillisecond);
+
+// What a sketch did before removeOldest(): list, sort by modify time and SD.remove() the oldest one at a time
+static void BM_RemoveEachOldest(benchmark::State &state)
+{
+    uint32_t blocksRead = 0, blocksWritten = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        File dir = OpenLogs();
+        sdCardSim.blocksRead = sdCardSim.blocksWritten = 0;
+        state.ResumeTiming();
+
+        std::vector<std::pair<uint32_t, std::string>> files;
+        SdDirIterator it = dir.dirIterator();
+        for (const dir_t *p = it.next(); p; p = it.next())
+        {
+            char name[13];
+            SdFile::dirName(*p, name);
+            files.push_back(std::make_pair(SdDirIterator::modifyTime(p), std::string("/LOGS/") + name));
+        }
+        std::stable_sort(files.begin(), files.end(),
+                         [](const std::pair<uint32_t, std::string> &a, const std::pair<uint32_t, std::string> &b) {
+                             return a.first < b.first;
+                         });
+
+        for (int64_t i = 0; i < state.range(0); ++i)
+        {
+            SD.remove(files[i].second.c_str());
+        }
+
+        blocksRead += sdCardSim.blocksRead;
+        blocksWritten += sdCardSim.blocksWritten;
+    }
+
+    CountBlocks(state, blocksRead, blocksWritten);
+}
+BENCHMARK(BM_RemoveEachOldest)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+static void BM_RemoveOldest(benchmark::State &state)
+{
+    uint32_t blocksRead = 0, blocksWritten = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        File dir = OpenLogs();
+        sdCardSim.blocksRead = sdCardSim.blocksWritten = 0;
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(dir.removeOldest(state.range(0)));
+
+        blocksRead += sdCardSim.blocksRead;
+        blocksWritten += sdCardSim.blocksWritten;
+    }
+
+    CountBlocks(state, blocksRead, blocksWritten);
+}
+BENCHMARK(BM_RemoveOldest)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,423 @@
+#include <gtest/gtest.h>
+
+#include <SD.h>
+#include <utility/ExFat.h>
+
+#include "ExFatImage.h"
+#include "FatImage.h"
+#include "SdCardSim.h"
+
+namespace
+{
+
+::testing::AssertionResult WriteFile(ExFatFile *dir, const char *name, uint32_t size, uint32_t seed, uint16_t chunk)
+{
+    ExFatFile f;
+    uint8_t buffer[1024];
+
+    if (!f.open(dir, name, O_CREAT | O_RDWR | O_TRUNC))
+    {
+        return ::testing::AssertionFailure() << "open " << name;
+    }
+
+    for (uint32_t p = 0; p < size;)
+    {
+        uint16_t n = size - p < chunk ? size - p : chunk;
+
+        for (uint16_t i = 0; i < n; ++i)
+        {
+            buffer[i] = FatImage::pattern(p + i, seed);
+        }
+
+        if (f.write(buffer, n) != n)
+        {
+            return ::testing::AssertionFailure() << "write " << name << " at " << p;
+        }
+
+        p += n;
+    }
+
+    if (!f.close())
+    {
+        return ::testing::AssertionFailure() << "close " << name;
+    }
+
+    return ::testing::AssertionSuccess();
+}
+
+// Reads the whole file back, then seeks around in it
+::testing::AssertionResult VerifyFile(ExFatFile *dir, const char *name, uint32_t size, uint32_t seed)
+{
+    ExFatFile f;
+    uint8_t buffer[700];
+    uint32_t p = 0;
+    int16_t n;
+
+    if (!f.open(dir, name, O_READ))
+    {
+        return ::testing::AssertionFailure() << "open " << name;
+    }
+
+    if (f.fileSize() != size)
+    {
+        return ::testing::AssertionFailure() << name << " is " << f.fileSize() << " bytes";
+    }
+
+    while ((n = f.read(buffer, sizeof(buffer))) > 0)
+    {
+        for (int16_t i = 0; i < n; ++i, ++p)
+        {
+            if (buffer[i] != FatImage::pattern(p, seed))
+            {
+                return ::testing::AssertionFailure() << name << " differs at " << p;
+            }
+        }
+    }
+
+    if (n != 0 || p != size)
+    {
+        return ::testing::AssertionFailure() << "read " << name << " ended at " << p;
+    }
+
+    for (uint32_t t = 0; t < 50 && size; ++t)
+    {
+        uint32_t q = (t * 245489UL) % size;
+
+        if (!f.seekSet(q) || f.read() != FatImage::pattern(q, seed))
+        {
+            return ::testing::AssertionFailure() << name << " differs after a seek to " << q;
+        }
+    }
+
+    f.close();
+    return ::testing::AssertionSuccess();
+}
+
+std::string LogName(int i)
+{
+    char name[48];
+    snprintf(name, sizeof(name), "log file number %03d with a long name.bin", i);
+    return name;
+}
+
+void ExpectConsistent(const char *step)
+{
+    ExFatImage::Report report = ExFatImage(sdCardSim.image).check();
+
+    EXPECT_TRUE(report.ok()) << step << ": leaked " << report.leakedClusters << " unmarked " << report.unmarkedClusters
+                             << " chains " << report.badChains << " cross " << report.crossLinks << " sets "
+                             << report.badEntrySets << " lengths " << report.badLengths;
+}
+
+}  // namespace
+
+// Formatted without and with a partition table
+class ExFat : public ::testing::TestWithParam<bool>
+{
+  protected:
+    Sd2Card card;
+    ExFatVolume vol;
+    ExFatFile root;
+    uint32_t freeClusters;
+
+    void SetUp() override
+    {
+        sdCardSim.insert(ExFatImage(32, 3, GetParam()).image);
+        ASSERT_TRUE(card.init(SPI_HALF_SPEED, 4));
+        ASSERT_TRUE(vol.init(&card));
+        ASSERT_TRUE(vol.freeClusterCount(&freeClusters));
+        ASSERT_TRUE(root.openRoot(&vol));
+    }
+
+    uint32_t FreeClusters()
+    {
+        uint32_t n = 0;
+        EXPECT_TRUE(vol.freeClusterCount(&n));
+        return n;
+    }
+};
+
+TEST_P(ExFat, Mount)
+{
+    ExFatImage image(sdCardSim.image);
+
+    EXPECT_EQ(vol.blocksPerCluster(), 8u);
+    EXPECT_EQ(vol.clusterCount(), image.clusterCount());
+    EXPECT_EQ(freeClusters, vol.clusterCount() - image.usedClusters());
+    ExpectConsistent("format");
+
+    // Not a FAT volume
+    SdVolume fat;
+    EXPECT_FALSE(fat.init(&card));
+}
+
+TEST_P(ExFat, ContiguousFiles)
+{
+    uint32_t clusters = 0;
+
+    for (int i = 0; i < 40; ++i)
+    {
+        ASSERT_TRUE(WriteFile(&root, LogName(i).c_str(), 1000 + i * 3771, i, 512));
+        clusters += (1000 + i * 3771 + 4095) / 4096;
+    }
+
+    ExFatFile f;
+    ASSERT_TRUE(f.open(&root, "LOG FILE NUMBER 039 WITH A LONG NAME.BIN", O_READ));
+    EXPECT_TRUE(f.isContiguous());
+    f.close();
+
+    for (int i = 0; i < 40; i += 7)
+    {
+        EXPECT_TRUE(VerifyFile(&root, LogName(i).c_str(), 1000 + i * 3771, i));
+    }
+
+    // 40 five entry sets grow the root directory by a cluster
+    EXPECT_EQ(FreeClusters(), freeClusters - clusters - 1);
+    ExpectConsistent("contiguous files");
+    EXPECT_EQ(ExFatImage(sdCardSim.image).check().files, 40u);
+}
+
+TEST_P(ExFat, FragmentedFiles)
+{
+    ExFatFile a, b;
+    uint8_t buffer[1000];
+
+    ASSERT_TRUE(a.open(&root, "a.dat", O_CREAT | O_RDWR));
+    ASSERT_TRUE(b.open(&root, "b.dat", O_CREAT | O_RDWR));
+
+    for (uint32_t p = 0; p < 100000; p += sizeof(buffer))
+    {
+        for (uint32_t i = 0; i < sizeof(buffer); ++i)
+        {
+            buffer[i] = FatImage::pattern(p + i, 100);
+        }
+        ASSERT_EQ(a.write(buffer, sizeof(buffer)), sizeof(buffer));
+
+        for (uint32_t i = 0; i < sizeof(buffer); ++i)
+        {
+            buffer[i] = FatImage::pattern(p + i, 101);
+        }
+        ASSERT_EQ(b.write(buffer, sizeof(buffer)), sizeof(buffer));
+    }
+
+    EXPECT_FALSE(a.isContiguous());
+    EXPECT_FALSE(b.isContiguous());
+    ASSERT_TRUE(a.close());
+    ASSERT_TRUE(b.close());
+
+    EXPECT_TRUE(VerifyFile(&root, "a.dat", 100000, 100));
+    EXPECT_TRUE(VerifyFile(&root, "b.dat", 100000, 101));
+    ExpectConsistent("fragmented files");
+
+    // Truncating walks the chain of a fragmented file
+    ASSERT_TRUE(a.open(&root, "a.dat", O_RDWR));
+    ASSERT_TRUE(a.truncate(33333));
+    ASSERT_TRUE(a.close());
+    EXPECT_TRUE(VerifyFile(&root, "a.dat", 33333, 100));
+    EXPECT_EQ(FreeClusters(), freeClusters - 9 - 25);
+    ExpectConsistent("truncate");
+
+    // The 25 single cluster runs of b.dat are freed a batch at a time, not with a bitmap write per cluster
+    uint32_t written = sdCardSim.blocksWritten;
+    ASSERT_TRUE(b.open(&root, "b.dat", O_WRITE));
+    ASSERT_TRUE(b.remove());
+    EXPECT_LE(sdCardSim.blocksWritten - written, 8u);
+    EXPECT_EQ(FreeClusters(), freeClusters - 9);
+    ExpectConsistent("remove");
+
+    ASSERT_TRUE(a.open(&root, "a.dat", O_WRITE));
+    ASSERT_TRUE(a.remove());
+    EXPECT_EQ(FreeClusters(), freeClusters);
+    ExpectConsistent("remove all");
+}
+
+TEST_P(ExFat, FreeFragmentedChain)
+{
+    // Fill the first bitmap block almost to its end, so the two files below straddle the second
+    ASSERT_TRUE(WriteFile(&root, "fill.dat", (4096UL - 16) * 4096, 7, 1024));
+
+    ExFatFile a, b;
+    uint8_t buffer[4096];
+
+    ASSERT_TRUE(a.open(&root, "a.dat", O_CREAT | O_RDWR));
+    ASSERT_TRUE(b.open(&root, "b.dat", O_CREAT | O_RDWR));
+
+    // One cluster each in turn, so b.dat is many more single cluster runs than freeChain gathers in a batch
+    for (uint32_t p = 0; p < 4 * EXFAT_FREE_CHAIN_RUNS * sizeof(buffer); p += sizeof(buffer))
+    {
+        for (uint32_t i = 0; i < sizeof(buffer); ++i)
+        {
+            buffer[i] = FatImage::pattern(p + i, 100);
+        }
+        ASSERT_EQ(a.write(buffer, sizeof(buffer)), sizeof(buffer));
+
+        for (uint32_t i = 0; i < sizeof(buffer); ++i)
+        {
+            buffer[i] = FatImage::pattern(p + i, 101);
+        }
+        ASSERT_EQ(b.write(buffer, sizeof(buffer)), sizeof(buffer));
+    }
+
+    uint32_t size = b.fileSize();
+    ASSERT_TRUE(a.close());
+    ASSERT_TRUE(b.close());
+
+    ExFatImage before(sdCardSim.image);
+    ASSERT_TRUE(b.open(&root, "b.dat", O_WRITE));
+    ASSERT_TRUE(b.remove());
+    ExFatImage after(sdCardSim.image);
+
+    // Exactly the clusters of b.dat are cleared: every other one, in both bitmap blocks
+    uint32_t freed = 0, runs = 0, low = 0;
+    for (uint32_t c = 2; c < vol.clusterCount() + 2; ++c)
+    {
+        ASSERT_TRUE(after.bitmapGet(c) <= before.bitmapGet(c)) << "cluster " << c;
+        if (before.bitmapGet(c) && !after.bitmapGet(c))
+        {
+            ++freed;
+            runs += c == 2 || after.bitmapGet(c - 1);
+            low += c - 2 < 4096;
+        }
+    }
+    EXPECT_EQ(freed, size / sizeof(buffer));
+    EXPECT_EQ(runs, freed);
+    EXPECT_GT(low, 0u);
+    EXPECT_LT(low, freed);
+
+    EXPECT_EQ(FreeClusters(), vol.clusterCount() - after.usedClusters());
+    EXPECT_TRUE(VerifyFile(&root, "a.dat", size, 100));
+    ExpectConsistent("remove fragmented");
+}
+
+TEST_P(ExFat, Directories)
+{
+    ExFatFile sub;
+    ASSERT_TRUE(sub.makeDir(&root, "Sub Dir"));
+
+    char name[64];
+    for (int i = 0; i < 200; ++i)
+    {
+        snprintf(name, sizeof(name), "f%d.txt", i);
+        ASSERT_TRUE(WriteFile(&sub, name, i * 10, i, 100));
+    }
+
+    // 200 three entry sets don't fit a 4 KiB cluster
+    EXPECT_GT(sub.fileSize(), vol.blocksPerCluster() * 512);
+    ExpectConsistent("grow directory");
+
+    // Names are case insensitive
+    for (int i = 0; i < 200; i += 13)
+    {
+        snprintf(name, sizeof(name), "F%d.TXT", i);
+        EXPECT_TRUE(VerifyFile(&sub, name, i * 10, i));
+    }
+
+    ExFatFile f;
+    EXPECT_FALSE(f.open(&sub, "f3.txt", O_CREAT | O_EXCL | O_WRITE));
+    EXPECT_FALSE(f.open(&sub, "bad/name", O_CREAT | O_WRITE));
+
+    int n = 0;
+    sub.rewind();
+    while (f.openNext(&sub))
+    {
+        ASSERT_TRUE(f.getName(name, sizeof(name)));
+        char expected[16];
+        snprintf(expected, sizeof(expected), "f%d.txt", n);
+        EXPECT_STREQ(name, expected);
+        f.close();
+        ++n;
+    }
+    EXPECT_EQ(n, 200);
+
+    for (int i = 0; i < 200; i += 2)
+    {
+        snprintf(name, sizeof(name), "f%d.txt", i);
+        ASSERT_TRUE(f.open(&sub, name, O_WRITE)) << name;
+        ASSERT_TRUE(f.remove()) << name;
+    }
+    ExpectConsistent("remove half");
+
+    // rmDir only removes an empty directory
+    ExFatFile empty;
+    ASSERT_TRUE(empty.makeDir(&sub, "empty"));
+    ASSERT_TRUE(f.open(&empty, "x", O_CREAT | O_WRITE));
+    f.close();
+    EXPECT_FALSE(empty.rmDir());
+    ASSERT_TRUE(f.open(&empty, "x", O_WRITE));
+    ASSERT_TRUE(f.remove());
+    EXPECT_TRUE(empty.rmDir());
+
+    ExFatImage::Report report = ExFatImage(sdCardSim.image).check();
+    EXPECT_TRUE(report.ok());
+    EXPECT_EQ(report.files, 100u);
+    EXPECT_EQ(report.directories, 1u);
+}
+
+TEST_P(ExFat, PreAllocatedFile)
+{
+    ExFatFile f;
+    ASSERT_TRUE(WriteFile(&root, "before.bin", 5000, 1, 512));
+    ASSERT_TRUE(f.open(&root, "prealloc.log", O_CREAT | O_RDWR));
+    ASSERT_TRUE(f.preAllocate(200000));
+
+    uint32_t bgn, end;
+    ASSERT_TRUE(f.contiguousRange(&bgn, &end));
+    EXPECT_EQ(end - bgn + 1, 49u * 8);
+    EXPECT_EQ(f.fileSize(), 0u);
+    EXPECT_EQ(FreeClusters(), freeClusters - 2 - 49);
+    ExpectConsistent("preallocate");
+
+    uint8_t buffer[512];
+    for (uint32_t p = 0; p < 150016; p += sizeof(buffer))
+    {
+        for (uint32_t i = 0; i < sizeof(buffer); ++i)
+        {
+            buffer[i] = FatImage::pattern(p + i, 7);
+        }
+        ASSERT_EQ(f.write(buffer, sizeof(buffer)), sizeof(buffer));
+    }
+
+    EXPECT_TRUE(f.isContiguous());
+    ASSERT_TRUE(f.close());
+    EXPECT_TRUE(VerifyFile(&root, "prealloc.log", 150016, 7));
+    EXPECT_TRUE(VerifyFile(&root, "before.bin", 5000, 1));
+    ExpectConsistent("write preallocated");
+
+    // Truncating a contiguous file frees the tail without the FAT
+    ASSERT_TRUE(f.open(&root, "prealloc.log", O_RDWR));
+    ASSERT_TRUE(f.truncate(5000));
+    ASSERT_TRUE(f.close());
+    EXPECT_EQ(FreeClusters(), freeClusters - 2 - 2);
+    ExpectConsistent("truncate preallocated");
+}
+
+TEST_P(ExFat, InitWritesBackDirtyBlock)
+{
+    ExFatFile f;
+    uint8_t buffer[100];
+
+    for (uint32_t i = 0; i < sizeof(buffer); ++i)
+    {
+        buffer[i] = FatImage::pattern(i, 5);
+    }
+
+    // A partial block stays in the cache
+    ASSERT_TRUE(f.open(&root, "data.bin", O_CREAT | O_WRITE));
+    ASSERT_EQ(f.write(buffer, sizeof(buffer)), sizeof(buffer));
+    uint32_t offset = (vol.dataStartBlock() + ((f.firstCluster() - 2) << vol.clusterSizeShift())) * 512UL;
+    EXPECT_NE(sdCardSim.image[offset + 99], FatImage::pattern(99, 5));
+
+    ASSERT_TRUE(vol.init(&card));
+
+    for (uint32_t i = 0; i < sizeof(buffer); ++i)
+    {
+        ASSERT_EQ(sdCardSim.image[offset + i], FatImage::pattern(i, 5)) << "byte " << i;
+    }
+
+    // The file is still usable after the volume was initialised again
+    ASSERT_TRUE(f.close());
+    EXPECT_TRUE(VerifyFile(&root, "data.bin", sizeof(buffer), 5));
+    ExpectConsistent("init");
+}
+
+INSTANTIATE_TEST_SUITE_P(Partition, ExFat, ::testing::Values(false, true));
@@ -0,0 +1,259 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SD.h>
+
+#include "FatImage.h"
+#include "SdCardSim.h"
+
+namespace
+{
+
+dir_t RawEntry(const char *name, uint8_t attributes)
+{
+    dir_t entry;
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.name, name, 11);
+    entry.attributes = attributes;
+    return entry;
+}
+
+// Names and modify times of the files the iterator returns, in directory order
+std::vector<std::pair<uint32_t, std::string>> List(SdFile *dir)
+{
+    std::vector<std::pair<uint32_t, std::string>> files;
+    SdDirIterator it(dir);
+    const dir_t *p;
+
+    while ((p = it.next()))
+    {
+        char name[13];
+        SdFile::dirName(*p, name);
+        files.push_back(std::make_pair(SdDirIterator::modifyTime(p), std::string(name)));
+    }
+
+    EXPECT_FALSE(it.error());
+    return files;
+}
+
+std::vector<std::string> Names(SdFile *dir)
+{
+    std::vector<std::string> names;
+
+    for (const auto &file : List(dir))
+    {
+        names.push_back(file.second);
+    }
+
+    return names;
+}
+
+// A root with every kind of entry the iterator skips, between the files it returns
+class SdDir : public ::testing::Test
+{
+  protected:
+    Sd2Card card;
+    SdVolume vol;
+    SdFile root;
+    uint32_t bCluster;
+
+    void SetUp() override
+    {
+        FatImage fat(32, 16);
+        fat.addEntry(0, RawEntry("LOGGER     ", DIR_ATT_VOLUME_ID));
+        dir_t lfn = RawEntry("\x41" "a\0.\0t\0x\0t", DIR_ATT_LONG_NAME);
+        fat.addEntry(0, lfn);
+        fat.add(0, "A.TXT", DIR_ATT_ARCHIVE, 700);
+        dir_t deleted = RawEntry("\xE5OLD    TXT", DIR_ATT_ARCHIVE);
+        fat.addEntry(0, deleted);
+        uint32_t sub = fat.add(0, "SUB", DIR_ATT_DIRECTORY);
+        fat.add(sub, "IN.BIN", DIR_ATT_ARCHIVE, 10);
+        bCluster = fat.add(0, "B.TXT", DIR_ATT_ARCHIVE, 1500);
+
+        sdCardSim.insert(fat.image);
+        ASSERT_TRUE(card.init(SPI_HALF_SPEED, 4));
+        ASSERT_TRUE(vol.init(&card));
+        ASSERT_TRUE(root.openRoot(&vol));
+    }
+};
+
+}  // namespace
+
+TEST_F(SdDir, IteratorSkipsEntries)
+{
+    EXPECT_EQ(Names(&root), std::vector<std::string>({"A.TXT", "SUB", "B.TXT"}));
+
+    // index() is the entry just returned
+    SdDirIterator it(&root);
+    const dir_t *p;
+    std::vector<uint16_t> indices;
+    while ((p = it.next()))
+    {
+        bool isFile = DIR_IS_FILE(p);
+        uint32_t size = p->fileSize;
+        uint16_t index = it.index();
+        indices.push_back(index);
+
+        SdFile f;
+        ASSERT_TRUE(f.open(&root, index, O_READ));
+        EXPECT_EQ(f.isFile(), isFile);
+        if (isFile)
+        {
+            EXPECT_EQ(f.fileSize(), size);
+        }
+    }
+    EXPECT_EQ(indices, std::vector<uint16_t>({2, 4, 5}));
+
+    // The dot entries of a subdirectory are skipped too
+    SdFile sub;
+    ASSERT_TRUE(sub.open(&root, "SUB", O_READ));
+    EXPECT_EQ(Names(&sub), std::vector<std::string>({"IN.BIN"}));
+
+    // Nothing to iterate in a file
+    SdFile a;
+    ASSERT_TRUE(a.open(&root, "A.TXT", O_READ));
+    EXPECT_EQ(SdDirIterator(&a).next(), nullptr);
+}
+
+TEST_F(SdDir, OpenNextFile)
+{
+    ASSERT_TRUE(SD.begin(4));
+    File dir = SD.open("/");
+    ASSERT_TRUE(!!dir);
+
+    std::vector<std::string> names;
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+    {
+        names.push_back(f.name());
+
+        if (names.back() == "B.TXT")
+        {
+            EXPECT_EQ(f.size(), 1500u);
+            for (uint32_t i = 0; i < 1500; ++i)
+            {
+                ASSERT_EQ(f.read(), FatImage::pattern(i, bCluster)) << "byte " << i;
+            }
+        }
+        else if (names.back() == "SUB")
+        {
+            EXPECT_TRUE(f.isDirectory());
+            File in = f.openNextFile();
+            ASSERT_TRUE(!!in);
+            EXPECT_STREQ(in.name(), "IN.BIN");
+            EXPECT_EQ(in.size(), 10u);
+            in.close();
+            EXPECT_FALSE(!!f.openNextFile());
+        }
+        else
+        {
+            EXPECT_EQ(f.size(), 700u);
+        }
+
+        f.close();
+    }
+
+    EXPECT_EQ(names, std::vector<std::string>({"A.TXT", "SUB", "B.TXT"}));
+
+    // Not a directory
+    File a = SD.open("A.TXT");
+    EXPECT_EQ(a.removeOldest(1), -1);
+}
+
+TEST(SdRemoveOldest, OrderTiesAndSkips)
+{
+    FatImage fat(32, 16);
+    fat.add(0, "RO.TXT", DIR_ATT_READ_ONLY, 100, 0, 1);
+    fat.add(0, "OLDDIR", DIR_ATT_DIRECTORY, 0, 0, 1);
+    fat.add(0, "C.TXT", DIR_ATT_ARCHIVE, 3000, 0, 5);
+    fat.add(0, "T1.TXT", DIR_ATT_ARCHIVE, 5000, 0, 3);
+    fat.add(0, "T2.TXT", DIR_ATT_ARCHIVE, 100, 0, 3);
+    fat.add(0, "D.TXT", DIR_ATT_ARCHIVE, 2048, 0, 9);
+    fat.add(0, "E.TXT", DIR_ATT_ARCHIVE, 0, 0, 4);
+    uint32_t used = fat.usedClusters();
+
+    sdCardSim.insert(fat.image);
+    ASSERT_TRUE(SD.begin(4));
+    File root = SD.open("/");
+    ASSERT_TRUE(!!root);
+
+    // Ties go to the entry first in the directory
+    EXPECT_EQ(root.removeOldest(1), 1);
+    EXPECT_FALSE(SD.exists("T1.TXT"));
+    EXPECT_TRUE(SD.exists("T2.TXT"));
+    EXPECT_EQ(FatImage(sdCardSim.image).usedClusters(), used - 3);
+
+    EXPECT_EQ(root.removeOldest(2), 2);
+    EXPECT_FALSE(SD.exists("T2.TXT"));
+    EXPECT_FALSE(SD.exists("E.TXT"));
+    EXPECT_TRUE(SD.exists("C.TXT"));
+
+    // Fewer files than asked for, and the read-only file and the directory stay
+    EXPECT_EQ(root.removeOldest(10), 2);
+    EXPECT_EQ(root.removeOldest(1), 0);
+    EXPECT_TRUE(SD.exists("RO.TXT"));
+    EXPECT_TRUE(SD.exists("OLDDIR"));
+
+    FatImage::Report report = FatImage(sdCardSim.image).check();
+    EXPECT_TRUE(report.ok());
+    EXPECT_EQ(report.files, 1u);
+    EXPECT_EQ(report.directories, 1u);
+    EXPECT_EQ(FatImage(sdCardSim.image).usedClusters(), 2u);
+}
+
+TEST(SdRemoveOldest, Batches)
+{
+    FatImage fat(64, 32);
+    uint32_t logs = fat.add(0, "LOGS", DIR_ATT_DIRECTORY);
+    ASSERT_TRUE(fat.addLogs(logs, 200, 1));
+    uint32_t used = fat.usedClusters();
+
+    sdCardSim.insert(fat.image);
+    Sd2Card card;
+    SdVolume vol;
+    SdFile root, dir;
+    ASSERT_TRUE(card.init(SPI_HALF_SPEED, 4));
+    ASSERT_TRUE(vol.init(&card));
+    ASSERT_TRUE(root.openRoot(&vol));
+    ASSERT_TRUE(dir.open(&root, "LOGS", O_READ));
+
+    auto expected = List(&dir);
+    ASSERT_EQ(expected.size(), 200u);
+
+    uint32_t fileClusters = 0;
+    SdDirIterator it(&dir);
+    for (const dir_t *p = it.next(); p; p = it.next())
+    {
+        fileClusters += (p->fileSize + 511) / 512;
+    }
+
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const std::pair<uint32_t, std::string> &a, const std::pair<uint32_t, std::string> &b) {
+                         return a.first < b.first;
+                     });
+
+    // Several batches of SD_REMOVE_OLDEST_BATCH per call, then more calls
+    for (int removed = 0; removed < 150; removed += 50)
+    {
+        ASSERT_EQ(dir.removeOldest(50), 50);
+
+        auto remaining = List(&dir);
+        std::sort(remaining.begin(), remaining.end());
+        std::vector<std::pair<uint32_t, std::string>> newest(expected.begin() + removed + 50, expected.end());
+        std::sort(newest.begin(), newest.end());
+        EXPECT_EQ(remaining, newest);
+
+        FatImage::Report report = FatImage(sdCardSim.image).check();
+        EXPECT_TRUE(report.ok()) << "leaked " << report.leakedClusters << " bad chains " << report.badChains;
+        EXPECT_EQ(report.files, 200u - removed - 50);
+    }
+
+    EXPECT_EQ(dir.removeOldest(100), 50);
+    EXPECT_TRUE(FatImage(sdCardSim.image).check().ok());
+
+    // Every cluster of every file is free again, only the directories are left
+    EXPECT_EQ(FatImage(sdCardSim.image).usedClusters(), used - fileClusters);
+}
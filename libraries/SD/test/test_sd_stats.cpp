@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+
+#include <SD.h>
+
+#include "FatImage.h"
+#include "SdCardSim.h"
+
+// Built with SD_STATS_ENABLED=1 against the simulated card
+namespace
+{
+
+// Everything printed, as one string
+struct StringPrint : public Print
+{
+    std::string text;
+
+    size_t write(uint8_t c) override
+    {
+        text += char(c);
+        return 1;
+    }
+
+    using Print::write;
+};
+
+uint32_t BucketTotal(const SdLatencyHistogram &hist)
+{
+    uint32_t n = 0;
+
+    for (int i = 0; i < SD_STATS_BUCKETS; ++i)
+    {
+        n += hist.bucket[i];
+    }
+
+    return n;
+}
+
+}  // namespace
+
+TEST(SdStats, Print)
+{
+    sdStats.reset();
+
+    sdStats.command[SD_STATS_CMD_READ].add(1);
+    sdStats.command[SD_STATS_CMD_READ].add(3);
+    sdStats.command[SD_STATS_CMD_READ].add(5000);
+    sdStats.waitNotBusy.add(1u << 30);
+    sdStats.blocksRead = 3;
+    sdStats.cacheHits = 12;
+    sdStats.dataBlocksWritten = 7;
+
+    StringPrint out;
+    sdStats.print(&out);
+
+    EXPECT_EQ(out.text,
+              "cmd_read 3 5004 5000 0:1 2:1 4096:1\r\n"
+              "cmd_write 0 0 0\r\n"
+              "cmd_write_multiple 0 0 0\r\n"
+              "cmd_status 0 0 0\r\n"
+              "cmd_erase 0 0 0\r\n"
+              "cmd_register 0 0 0\r\n"
+              "cmd_other 0 0 0\r\n"
+              "wait_not_busy 1 1073741824 1073741824 524288:1\r\n"
+              "wait_start_block 0 0 0\r\n"
+              "busy_timeouts 0\r\n"
+              "blocks_read 3\r\n"
+              "blocks_written 0\r\n"
+              "cache_hits 12\r\n"
+              "cache_misses 0\r\n"
+              "fat_reads 0\r\n"
+              "fat_writes 0\r\n"
+              "fat_blocks_written 0\r\n"
+              "dir_blocks_written 0\r\n"
+              "data_blocks_written 7\r\n");
+
+    sdStats.reset();
+    out.text.clear();
+    sdStats.print(&out);
+    EXPECT_EQ(out.text.find("cmd_read 0 0 0\r\n"), 0u);
+    EXPECT_NE(out.text.find("cache_hits 0\r\n"), std::string::npos);
+}
+
+TEST(SdStats, CardCommands)
+{
+    FatImage fat(32, 16);
+    sdCardSim.insert(fat.image);
+    sdStats.reset();
+
+    Sd2Card card;
+    ASSERT_TRUE(card.init(SPI_HALF_SPEED, 4));
+
+    // CMD0, CMD8, CMD55 and ACMD41 then CMD58 for the OCR
+    EXPECT_EQ(sdStats.command[SD_STATS_CMD_OTHER].count, 4u);
+    EXPECT_EQ(sdStats.command[SD_STATS_CMD_REGISTER].count, 1u);
+    EXPECT_EQ(card.type(), SD_CARD_TYPE_SDHC);
+    EXPECT_EQ(card.cardSize(), 32UL * 2048);
+    EXPECT_EQ(sdStats.command[SD_STATS_CMD_REGISTER].count, 2u);
+
+    sdStats.reset();
+    uint32_t cardRead = sdCardSim.blocksRead;
+    uint32_t cardWritten = sdCardSim.blocksWritten;
+    uint8_t block[512];
+
+    ASSERT_TRUE(card.readBlock(0, block));
+    EXPECT_EQ(sdStats.command[SD_STATS_CMD_READ].count, 1u);
+    EXPECT_EQ(sdStats.waitStartBlock.count, 1u);
+    EXPECT_EQ(sdStats.blocksRead, 1u);
+
+    for (int i = 0; i < 512; ++i)
+    {
+        block[i] = uint8_t(i * 7);
+    }
+
+    ASSERT_TRUE(card.writeBlock(1000, block));
+    EXPECT_EQ(sdStats.command[SD_STATS_CMD_WRITE].count, 1u);
+    EXPECT_EQ(sdStats.command[SD_STATS_CMD_STATUS].count, 1u);
+    EXPECT_EQ(sdStats.blocksWritten, 1u);
+    EXPECT_EQ(memcmp(&sdCardSim.image[1000 * 512], block, 512), 0);
+
+    ASSERT_TRUE(card.writeStart(2000, 4));
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(card.writeData(block));
+    }
+    ASSERT_TRUE(card.writeStop());
+    EXPECT_EQ(sdStats.command[SD_STATS_CMD_WRITE_MULTIPLE].count, 1u);
+    EXPECT_EQ(sdStats.blocksWritten, 5u);
+    EXPECT_EQ(memcmp(&sdCardSim.image[2003 * 512], block, 512), 0);
+
+    ASSERT_TRUE(card.erase(2000, 2003));
+    EXPECT_EQ(sdStats.command[SD_STATS_CMD_ERASE].count, 3u);
+    EXPECT_EQ(sdCardSim.image[2003 * 512 + 1], 0);
+
+    // Counts agree with what the card saw, and every sample is in a bucket
+    EXPECT_EQ(sdStats.blocksRead, sdCardSim.blocksRead - cardRead);
+    EXPECT_EQ(sdStats.blocksWritten, sdCardSim.blocksWritten - cardWritten);
+    EXPECT_EQ(sdStats.busyTimeouts, 0u);
+
+    for (int i = 0; i < SD_STATS_CMD_COUNT; ++i)
+    {
+        EXPECT_EQ(BucketTotal(sdStats.command[i]), sdStats.command[i].count) << "class " << i;
+    }
+
+    EXPECT_GT(sdStats.waitNotBusy.count, 0u);
+    EXPECT_EQ(BucketTotal(sdStats.waitNotBusy), sdStats.waitNotBusy.count);
+}
+
+class SdStatsVolume : public ::testing::TestWithParam<int>
+{
+};
+
+TEST_P(SdStatsVolume, WriteClasses)
+{
+    FatImage fat(GetParam() == 16 ? 32 : 64, GetParam());
+    sdCardSim.insert(fat.image);
+    ASSERT_TRUE(SD.begin(4));
+
+    sdStats.reset();
+    uint32_t cardWritten = sdCardSim.blocksWritten;
+
+    File f = SD.open("DATA.BIN", FILE_WRITE);
+    ASSERT_TRUE(!!f);
+
+    uint8_t buffer[1000];
+    for (uint32_t p = 0; p < 10000; p += sizeof(buffer))
+    {
+        for (uint32_t i = 0; i < sizeof(buffer); ++i)
+        {
+            buffer[i] = FatImage::pattern(p + i, 1);
+        }
+        ASSERT_EQ(f.write(buffer, sizeof(buffer)), sizeof(buffer));
+    }
+    f.close();
+
+    uint32_t clusters = (10000 + fat.clusterBytes() - 1) / fat.clusterBytes();
+
+    // Every block written is FAT, directory or data, and each FAT block is written to both copies
+    EXPECT_EQ(sdStats.dataBlocksWritten, 20u);
+    EXPECT_GE(sdStats.dirBlocksWritten, 1u);
+    EXPECT_GE(sdStats.fatBlocksWritten, 2u);
+    EXPECT_EQ(sdStats.fatBlocksWritten % 2, 0u);
+    EXPECT_EQ(sdStats.blocksWritten,
+              sdStats.fatBlocksWritten + sdStats.dirBlocksWritten + sdStats.dataBlocksWritten);
+    EXPECT_EQ(sdStats.blocksWritten, sdCardSim.blocksWritten - cardWritten);
+    // Each new cluster is marked end of chain, then linked from the one before it
+    EXPECT_EQ(sdStats.fatWrites, 2 * clusters - 1);
+    EXPECT_EQ(sdStats.command[SD_STATS_CMD_WRITE].count, sdStats.blocksWritten);
+
+    FatImage::Report report = FatImage(sdCardSim.image).check();
+    EXPECT_TRUE(report.ok());
+    EXPECT_EQ(report.files, 1u);
+
+    // Reading a byte at a time goes through the block cache: one miss per block read, hits for the rest
+    sdStats.reset();
+    uint32_t cardRead = sdCardSim.blocksRead;
+
+    f = SD.open("DATA.BIN");
+    ASSERT_TRUE(!!f);
+
+    uint32_t n = 0;
+    for (int c = f.read(); c >= 0; c = f.read(), ++n)
+    {
+        ASSERT_EQ(c, FatImage::pattern(n, 1)) << "byte " << n;
+    }
+    f.close();
+
+    EXPECT_EQ(n, 10000u);
+    EXPECT_EQ(sdStats.blocksWritten, 0u);
+    EXPECT_GE(sdStats.cacheMisses, 20u);
+    EXPECT_EQ(sdStats.blocksRead, sdStats.cacheMisses);
+    EXPECT_EQ(sdStats.blocksRead, sdCardSim.blocksRead - cardRead);
+    EXPECT_GE(sdStats.cacheHits, 10000u - 20u);
+    EXPECT_GE(sdStats.fatReads, clusters - 1);
+
+    StringPrint out;
+    sdStats.print(&out);
+    char line[40];
+    snprintf(line, sizeof(line), "\r\nblocks_read %lu\r\n", (unsigned long)sdStats.blocksRead);
+    EXPECT_NE(out.text.find(line), std::string::npos) << out.text;
+    EXPECT_NE(out.text.find("\r\nblocks_written 0\r\n"), std::string::npos) << out.text;
+}
+
+INSTANTIATE_TEST_SUITE_P(Fat, SdStatsVolume, ::testing::Values(16, 32));
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <SD.h>
+
+#include "FatImage.h"
+#include "SdCardSim.h"
+
+namespace
+{
+
+// A FAT16 card with one file open for writing that hasn't been synced
+class SdVolumeInit : public ::testing::Test
+{
+  protected:
+    Sd2Card card;
+    SdVolume vol;
+    SdFile root, file;
+
+    void SetUp() override
+    {
+        sdCardSim.insert(FatImage(32, 16).image);
+        ASSERT_TRUE(card.init(SPI_HALF_SPEED, 4));
+        ASSERT_TRUE(vol.init(&card));
+        ASSERT_TRUE(root.openRoot(&vol));
+        ASSERT_TRUE(file.open(&root, "DATA.BIN", O_CREAT | O_WRITE));
+    }
+
+    void Write(uint32_t size)
+    {
+        uint8_t block[512];
+
+        for (uint32_t p = 0; p < size; p += sizeof(block))
+        {
+            uint16_t n = size - p < sizeof(block) ? size - p : sizeof(block);
+            for (uint16_t i = 0; i < n; ++i)
+            {
+                block[i] = FatImage::pattern(p + i, 3);
+            }
+            ASSERT_EQ(file.write(block, n), n);
+        }
+    }
+
+    // Offset of the first cluster on the card
+    uint32_t FirstClusterOffset()
+    {
+        return (vol.dataStartBlock() + (file.firstCluster() - 2) * vol.blocksPerCluster()) * 512UL;
+    }
+};
+
+}  // namespace
+
+TEST_F(SdVolumeInit, WritesBackDirtyDataBlock)
+{
+    // A partial block stays in the cache
+    Write(100);
+    uint32_t offset = FirstClusterOffset();
+    EXPECT_NE(sdCardSim.image[offset + 99], FatImage::pattern(99, 3));
+
+    ASSERT_TRUE(vol.init(&card));
+
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        ASSERT_EQ(sdCardSim.image[offset + i], FatImage::pattern(i, 3)) << "byte " << i;
+    }
+
+    // The file is still usable after the volume was initialised again
+    ASSERT_TRUE(file.close());
+    ASSERT_TRUE(file.open(&root, "DATA.BIN", O_READ));
+    EXPECT_EQ(file.fileSize(), 100u);
+    EXPECT_TRUE(FatImage(sdCardSim.image).check().ok());
+}
+
+TEST_F(SdVolumeInit, WritesBackDirtyFatBlockToBothFats)
+{
+    // Whole blocks go straight to the card, leaving the FAT block of the new cluster dirty in the cache with its
+    // mirror pending
+    Write(2048);
+    EXPECT_EQ(FatImage(sdCardSim.image).usedClusters(), 0u);
+
+    ASSERT_TRUE(vol.init(&card));
+
+    FatImage::Report report = FatImage(sdCardSim.image).check();
+    EXPECT_TRUE(report.fatsMatch);
+    EXPECT_EQ(FatImage(sdCardSim.image).usedClusters(), 1u);
+
+    ASSERT_TRUE(file.close());
+    report = FatImage(sdCardSim.image).check();
+    EXPECT_TRUE(report.ok());
+    EXPECT_EQ(report.files, 1u);
+}
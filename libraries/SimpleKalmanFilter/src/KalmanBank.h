@@ -0,0 +1,138 @@
+/*
+ * KalmanBank - N single variable Kalman filters updated together, e.g. one per analog channel.
+ * Each channel behaves as a SimpleKalmanFilter, with an optional constant process noise
+ * that makes it behave as a TrivialKalmanFilter instead.
+ * Released under MIT License - see LICENSE file for details.
+ */
+
+#ifndef KalmanBank_h
+#define KalmanBank_h
+
+#include <math.h>
+
+// The state of every channel is stored per quantity (structure of arrays), so that the update of all channels is
+// one loop without dependencies between iterations: it vectorizes on the host and is unrolled on the MCU.
+template <int N>
+class KalmanBank
+{
+
+public:
+  KalmanBank(float mea_e, float est_e, float q);
+
+  // Updates every channel with its measure mea[i] and returns the N estimates
+  const float *updateEstimate(const float *mea);
+  float getEstimate(int i) const;
+
+  void setEstimate(int i, float est);
+  void setMeasurementError(int i, float mea_e);
+  void setEstimateError(int i, float est_e);
+  void setProcessNoise(int i, float q);
+  void setConstantProcessNoise(int i, float q);
+  float getKalmanGain(int i) const;
+
+  // Keep the current gains: updates are then est += gain * (mea - est), without any division
+  void setFixedGains(bool fixed);
+
+private:
+  float _err_measure[N];
+  float _err_estimate[N];
+  float _q[N];
+  float _q_constant[N];
+  float _estimate[N];
+  float _kalman_gain[N];
+  bool _fixed_gains;
+
+};
+
+template <int N>
+KalmanBank<N>::KalmanBank(float mea_e, float est_e, float q)
+{
+  for (int i = 0; i < N; i++) {
+    _err_measure[i] = mea_e;
+    _err_estimate[i] = est_e;
+    _q[i] = q;
+    _q_constant[i] = 0.0f;
+    _estimate[i] = 0.0f;
+    _kalman_gain[i] = 0.0f;
+  }
+  _fixed_gains = false;
+}
+
+template <int N>
+const float *KalmanBank<N>::updateEstimate(const float *mea)
+{
+  if (_fixed_gains) {
+#if defined(__GNUC__) && __GNUC__ >= 8
+#pragma GCC unroll 4
+#endif
+    for (int i = 0; i < N; i++) {
+      _estimate[i] += _kalman_gain[i] * (mea[i] - _estimate[i]);
+    }
+    return _estimate;
+  }
+
+#if defined(__GNUC__) && __GNUC__ >= 8
+#pragma GCC unroll 4
+#endif
+  for (int i = 0; i < N; i++) {
+    float err_estimate = _err_estimate[i] + _q_constant[i];
+    float gain = err_estimate / (err_estimate + _err_measure[i]);
+    float estimate = _estimate[i] + gain * (mea[i] - _estimate[i]);
+    _err_estimate[i] = (1.0f - gain) * err_estimate + fabsf(_estimate[i] - estimate) * _q[i];
+    _kalman_gain[i] = gain;
+    _estimate[i] = estimate;
+  }
+  return _estimate;
+}
+
+template <int N>
+float KalmanBank<N>::getEstimate(int i) const
+{
+  return _estimate[i];
+}
+
+template <int N>
+void KalmanBank<N>::setEstimate(int i, float est)
+{
+  _estimate[i] = est;
+}
+
+template <int N>
+void KalmanBank<N>::setMeasurementError(int i, float mea_e)
+{
+  _err_measure[i] = mea_e;
+}
+
+template <int N>
+void KalmanBank<N>::setEstimateError(int i, float est_e)
+{
+  _err_estimate[i] = est_e;
+}
+
+// Process noise scaled by the change of the estimate, as in SimpleKalmanFilter
+template <int N>
+void KalmanBank<N>::setProcessNoise(int i, float q)
+{
+  _q[i] = q;
+}
+
+// Process noise added before each update, as Qk in TrivialKalmanFilter
+template <int N>
+void KalmanBank<N>::setConstantProcessNoise(int i, float q)
+{
+  _q_constant[i] = q;
+}
+
+template <int N>
+float KalmanBank<N>::getKalmanGain(int i) const
+{
+  return _kalman_gain[i];
+}
+
+template <int N>
+void KalmanBank<N>::setFixedGains(bool fixed)
+{
+  _fixed_gains = fixed;
+}
+
+#endif
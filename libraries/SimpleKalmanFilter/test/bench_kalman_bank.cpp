@@ -0,0 +1,88 @@
+#include <benchmark/benchmark.h>
+
+#include "../src/KalmanBank.h"
+#include "../src/SimpleKalmanFilter.h"
+#include "../../TrivialKalmanFilter/src/TrivialKalmanFilter.h"
+
+#include <vector>
+
+// Update cost of Channels analog channels, reported per channel
+
+template <int Channels>
+void Readings(float (&mea)[Channels], int step)
+{
+    for (int i = 0; i < Channels; ++i)
+    {
+        mea[i] = 512.0f + float((step * 31 + i * 17) % 64);
+    }
+}
+
+template <int Channels>
+void BM_SimpleKalmanFilter(benchmark::State &state)
+{
+    std::vector<SimpleKalmanFilter> filters(Channels, SimpleKalmanFilter(2.0f, 2.0f, 0.01f));
+    float mea[Channels];
+    int step = 0;
+
+    for (auto _ : state)
+    {
+        Readings(mea, step++);
+
+        for (int i = 0; i < Channels; ++i)
+        {
+            benchmark::DoNotOptimize(filters[i].updateEstimate(mea[i]));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * Channels);
+}
+
+template <int Channels>
+void BM_TrivialKalmanFilter(benchmark::State &state)
+{
+    std::vector<TrivialKalmanFilter<float>> filters(Channels, TrivialKalmanFilter<float>(4.7e-3f, 1e-5f));
+    float mea[Channels];
+    int step = 0;
+
+    for (auto _ : state)
+    {
+        Readings(mea, step++);
+
+        for (int i = 0; i < Channels; ++i)
+        {
+            benchmark::DoNotOptimize(filters[i].update(mea[i]));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * Channels);
+}
+
+template <int Channels>
+void BM_KalmanBank(benchmark::State &state)
+{
+    KalmanBank<Channels> bank(2.0f, 2.0f, 0.01f);
+    float mea[Channels];
+    int step = 0;
+
+    bank.setFixedGains(state.range(0));
+
+    for (auto _ : state)
+    {
+        Readings(mea, step++);
+        benchmark::DoNotOptimize(bank.updateEstimate(mea));
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * Channels);
+}
+
+#define BENCHMARK_KALMAN_BANK(Channels)                          \
+    BENCHMARK_TEMPLATE(BM_SimpleKalmanFilter, Channels);         \
+    BENCHMARK_TEMPLATE(BM_TrivialKalmanFilter, Channels);        \
+    BENCHMARK_TEMPLATE(BM_KalmanBank, Channels)->ArgName("fixed")->Arg(0)->Arg(1)
+
+BENCHMARK_KALMAN_BANK(8);
+BENCHMARK_KALMAN_BANK(32);
+BENCHMARK_KALMAN_BANK(64);
+
+BENCHMARK_MAIN();
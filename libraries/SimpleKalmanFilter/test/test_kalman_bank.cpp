@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include "../src/KalmanBank.h"
+#include "../src/SimpleKalmanFilter.h"
+#include "../../TrivialKalmanFilter/src/TrivialKalmanFilter.h"
+
+#include <new>
+#include <vector>
+
+namespace
+{
+
+// Analog readings: a slow sine per channel plus a deterministic noise
+float Reading(int channel, int step)
+{
+    uint32_t hash = uint32_t(channel * 7919 + step) * 2654435761u;
+    return 512.0f + 100.0f * sin(0.01f * step + channel) + float(hash >> 24) * 0.1f;
+}
+
+}  // namespace
+
+TEST(KalmanBank, MatchesSimpleKalmanFilter)
+{
+    const int channels = 33;
+
+    KalmanBank<channels> bank(2.0f, 2.0f, 0.01f);
+
+    // SimpleKalmanFilter leaves its first estimate uninitialised, so build the filters on zeroed memory to start from 0
+    // like the bank does
+    alignas(SimpleKalmanFilter) static unsigned char memory[channels * sizeof(SimpleKalmanFilter)] = {};
+    SimpleKalmanFilter *filters = reinterpret_cast<SimpleKalmanFilter *>(memory);
+
+    for (int i = 0; i < channels; ++i)
+    {
+        new (&filters[i]) SimpleKalmanFilter(2.0f + i, 2.0f, 0.01f);
+        bank.setMeasurementError(i, 2.0f + i);
+    }
+
+    float mea[channels];
+
+    for (int step = 0; step < 1000; ++step)
+    {
+        for (int i = 0; i < channels; ++i)
+        {
+            mea[i] = Reading(i, step);
+        }
+
+        const float *est = bank.updateEstimate(mea);
+
+        for (int i = 0; i < channels; ++i)
+        {
+            float expected = filters[i].updateEstimate(mea[i]);
+            ASSERT_NEAR(est[i], expected, 1e-5 * fabs(expected)) << "channel " << i << " step " << step;
+            ASSERT_NEAR(bank.getKalmanGain(i), filters[i].getKalmanGain(), 1e-5);
+        }
+    }
+}
+
+TEST(KalmanBank, MatchesTrivialKalmanFilter)
+{
+    const int channels = 5;
+
+    KalmanBank<channels> bank(4.7e-3f, 1.0f, 0.0f);
+    std::vector<TrivialKalmanFilter<float>> filters;
+
+    for (int i = 0; i < channels; ++i)
+    {
+        filters.emplace_back(4.7e-3f, 1e-5f * (i + 1));
+        bank.setConstantProcessNoise(i, 1e-5f * (i + 1));
+    }
+
+    float mea[channels];
+
+    for (int step = 0; step < 1000; ++step)
+    {
+        for (int i = 0; i < channels; ++i)
+        {
+            mea[i] = Reading(i, step) * 0.01f;
+        }
+
+        bank.updateEstimate(mea);
+
+        for (int i = 0; i < channels; ++i)
+        {
+            float expected = filters[i].update(mea[i]);
+            ASSERT_NEAR(bank.getEstimate(i), expected, 1e-5 * fabs(expected));
+        }
+    }
+}
+
+TEST(KalmanBank, FixedGains)
+{
+    KalmanBank<3> bank(1.0f, 1.0f, 0.0f);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        bank.setConstantProcessNoise(i, 0.1f);
+    }
+
+    float mea[3] = {1.0f, 2.0f, 3.0f};
+
+    for (int step = 0; step < 100; ++step)
+    {
+        bank.updateEstimate(mea);
+    }
+
+    bank.setFixedGains(true);
+    float gain = bank.getKalmanGain(0);
+    float before = bank.getEstimate(0);
+    mea[0] = 11.0f;
+
+    bank.updateEstimate(mea);
+
+    EXPECT_FLOAT_EQ(bank.getKalmanGain(0), gain);
+    EXPECT_FLOAT_EQ(bank.getEstimate(0), before + gain * (11.0f - before));
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+// Just enough of the Arduino core to build the libraries and their tests on the host
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#define DEC 10
+#define HEX 16
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+const uint8_t SS = 10;
+const uint8_t MOSI = 11;
+const uint8_t MISO = 12;
+const uint8_t SCK = 13;
+const uint8_t A0 = 14;
+
+inline void pinMode(uint8_t, uint8_t) {}
+
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+inline int analogRead(uint8_t) { return 0; }
+
+inline unsigned long micros()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline unsigned long millis() { return micros() / 1000; }
+
+inline void randomSeed(unsigned long seed) { srand(seed); }
+
+inline long random(long min, long max) { return max > min ? min + rand() % (max - min) : min; }
+
+inline long random(long max) { return random(0, max); }
+
+using std::max;
+
+// Only what the overloads taking a String need
+struct String : public std::string
+{
+    String(const char* str = "") : std::string(str) {}
+};
+
+// Formats like the core's Print, so that tests can compare the text a library prints
+struct Print
+{
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+
+    virtual size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t n = 0;
+        while (size-- && write(*buffer++))
+        {
+            n++;
+        }
+        return n;
+    }
+
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+
+    virtual int availableForWrite() { return 0; }
+
+    virtual void flush() {}
+
+    int getWriteError() { return writeError; }
+
+    void clearWriteError() { writeError = 0; }
+
+    size_t print(const char* str) { return write(str); }
+
+    size_t print(const std::string& str) { return write(str.c_str()); }
+
+    size_t print(char c) { return write(uint8_t(c)); }
+
+    size_t print(unsigned long n, int base = DEC)
+    {
+        char str[8 * sizeof(long) + 1];
+        snprintf(str, sizeof(str), base == HEX ? "%lX" : "%lu", n);
+        return write(str);
+    }
+
+    size_t print(long n, int base = DEC)
+    {
+        if (base != DEC) return print((unsigned long)n, base);
+
+        char str[8 * sizeof(long) + 2];
+        snprintf(str, sizeof(str), "%ld", n);
+        return write(str);
+    }
+
+    size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+
+    size_t print(double n, int digits = 2)
+    {
+        char str[64];
+        snprintf(str, sizeof(str), "%.*f", digits, n);
+        return write(str);
+    }
+
+    size_t println() { return write("\r\n"); }
+
+    template <typename T>
+    size_t println(const T& obj)
+    {
+        size_t n = print(obj);
+        return n + println();
+    }
+
+    template <typename T>
+    size_t println(const T& obj, int format)
+    {
+        size_t n = print(obj, format);
+        return n + println();
+    }
+
+   protected:
+    void setWriteError(int err = 1) { writeError = err; }
+
+   private:
+    int writeError = 0;
+};
+
+// The readBytes() of the stub doesn't wait for a timeout. As in the core it isn't virtual.
+struct Stream : public Print
+{
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    size_t readBytes(char* buffer, size_t length)
+    {
+        size_t n = 0;
+        int c;
+        while (n < length && (c = read()) >= 0)
+        {
+            buffer[n++] = char(c);
+        }
+        return n;
+    }
+
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+};
+
+// Keeps everything printed to it, so that tests can check the output
+struct HostSerial : public Stream
+{
+    std::string output;
+
+    void begin(unsigned long) { output.clear(); }
+
+    size_t write(uint8_t c) override
+    {
+        output += char(c);
+        return 1;
+    }
+
+    using Print::write;
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+
+// Internal linkage, so that a library .cpp and a test can both include the stub
+static HostSerial Serial;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define SPI_MODE0 0x00
+
+struct SPISettings
+{
+    SPISettings() {}
+    SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+
+// transfer() is left to the test, which plays the device on the bus
+struct SPIClass
+{
+    void begin() {}
+    void end() {}
+    void beginTransaction(SPISettings) {}
+    void endTransaction() {}
+    uint8_t transfer(uint8_t data);
+};
+
+extern SPIClass SPI;